@@ -0,0 +1,562 @@
+/*
+ * @file bbgraph.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Basic block graph: construction, dominators, loop nesting forest,
+ * loop aware reverse postorder and strongly connected components.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "bbgraph.h"
+
+bb_graph_t *bb_graph_create(int nblocks)
+{
+    bb_graph_t *g = calloc(1, sizeof(bb_graph_t));
+
+    if (!g)
+        return NULL;
+
+    g->blocks = calloc(nblocks > 0 ? nblocks : 1, sizeof(bb_block_t));
+    if (!g->blocks) {
+        free(g);
+        return NULL;
+    }
+
+    g->nblocks = nblocks;
+    g->entry = BB_NONE;
+    for (int i = 0; i < nblocks; ++i) {
+        g->blocks[i].id = i;
+        g->blocks[i].rpo = BB_NONE;
+        g->blocks[i].idom = BB_NONE;
+        g->blocks[i].dpre = BB_NONE;
+        g->blocks[i].dlast = BB_NONE;
+        g->blocks[i].loop = BB_NONE;
+        g->blocks[i].scc = BB_NONE;
+    }
+
+    return g;
+}
+
+void bb_graph_destroy(bb_graph_t *g)
+{
+    if (!g)
+        return;
+
+    for (int i = 0; i < g->nblocks; ++i) {
+        free(g->blocks[i].refs);
+        free(g->blocks[i].succ);
+        free(g->blocks[i].pred);
+    }
+    free(g->blocks);
+    free(g->rpo);
+    free(g->loops);
+    free(g);
+}
+
+int bb_graph_set_refs(bb_graph_t *g, int block, const bb_ref_t *refs, int nrefs)
+{
+    bb_block_t *b = &g->blocks[block];
+    bb_ref_t *tmp;
+
+    if (nrefs <= 0)
+        return SUCCEED;
+
+    tmp = realloc(b->refs, sizeof(bb_ref_t) * (b->nrefs + nrefs));
+    if (!tmp)
+        return FAIL;
+
+    memcpy(tmp + b->nrefs, refs, sizeof(bb_ref_t) * nrefs);
+    b->refs = tmp;
+    b->nrefs += nrefs;
+
+    return SUCCEED;
+}
+
+static int append_int(int **arr, int *n, int val)
+{
+    int *tmp = realloc(*arr, sizeof(int) * (*n + 1));
+
+    if (!tmp)
+        return FAIL;
+
+    tmp[(*n)++] = val;
+    *arr = tmp;
+
+    return SUCCEED;
+}
+
+int bb_graph_add_edge(bb_graph_t *g, int from, int to)
+{
+    bb_block_t *f = &g->blocks[from], *t = &g->blocks[to];
+
+    for (int i = 0; i < f->nsucc; ++i)
+        if (f->succ[i] == to)
+            return SUCCEED;
+
+    if (SUCCEED != append_int(&f->succ, &f->nsucc, to) ||
+        SUCCEED != append_int(&t->pred, &t->npred, from))
+        return FAIL;
+
+    return SUCCEED;
+}
+
+int bb_loop_contains(const bb_graph_t *g, int l, int b)
+{
+    for (int x = g->blocks[b].loop; x != BB_NONE; x = g->loops[x].parent)
+        if (x == l)
+            return 1;
+
+    return 0;
+}
+
+int bb_loop_set_bound(bb_graph_t *g, int header, unsigned int bound)
+{
+    for (int l = 0; l < g->nloops; ++l) {
+        if (g->loops[l].header == header) {
+            g->loops[l].bound = bound;
+            return SUCCEED;
+        }
+    }
+
+    return FAIL;
+}
+
+/*
+ * iterative dfs from the entry, fills order[] with the reverse postorder
+ * and returns the number of reachable blocks.
+ */
+static int dfs_rpo(bb_graph_t *g, int *order, int *stack, int *next,
+                   char *seen)
+{
+    int sp = 0, n = 0;
+
+    memset(seen, 0, g->nblocks);
+    memset(next, 0, sizeof(int) * g->nblocks);
+
+    stack[sp++] = g->entry;
+    seen[g->entry] = 1;
+    while (sp) {
+        bb_block_t *b = &g->blocks[stack[sp - 1]];
+
+        if (next[b->id] < b->nsucc) {
+            int s = b->succ[next[b->id]++];
+
+            if (!seen[s]) {
+                seen[s] = 1;
+                stack[sp++] = s;
+            }
+            continue;
+        }
+        order[n++] = b->id;
+        sp--;
+    }
+
+    /* postorder -> reverse postorder */
+    for (int i = 0; i < n / 2; ++i) {
+        int tmp = order[i];
+        order[i] = order[n - 1 - i];
+        order[n - 1 - i] = tmp;
+    }
+
+    return n;
+}
+
+static void number_rpo(bb_graph_t *g)
+{
+    for (int i = 0; i < g->nblocks; ++i)
+        g->blocks[i].rpo = BB_NONE;
+
+    for (int i = 0; i < g->nreach; ++i)
+        g->blocks[g->rpo[i]].rpo = i;
+}
+
+/*
+ * Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm".
+ */
+static void compute_dominators(bb_graph_t *g)
+{
+    bb_block_t *blk = g->blocks;
+    int changed = 1;
+
+    blk[g->entry].idom = g->entry;
+    while (changed) {
+        changed = 0;
+        for (int i = 1; i < g->nreach; ++i) {
+            bb_block_t *b = &blk[g->rpo[i]];
+            int idom = BB_NONE;
+
+            for (int p = 0; p < b->npred; ++p) {
+                int f1 = b->pred[p], f2 = idom;
+
+                if (blk[f1].rpo == BB_NONE || blk[f1].idom == BB_NONE)
+                    continue;
+                if (idom == BB_NONE) {
+                    idom = f1;
+                    continue;
+                }
+                while (f1 != f2) {
+                    while (blk[f1].rpo > blk[f2].rpo)
+                        f1 = blk[f1].idom;
+                    while (blk[f2].rpo > blk[f1].rpo)
+                        f2 = blk[f2].idom;
+                }
+                idom = f1;
+            }
+            if (b->idom != idom) {
+                b->idom = idom;
+                changed = 1;
+            }
+        }
+    }
+}
+
+/*
+ * number the dominator tree in preorder. the subtree of b is then
+ * [dpre, dlast] and dominance is an interval test.
+ */
+static int number_domtree(bb_graph_t *g, int *stack, int *next)
+{
+    int *first = calloc(g->nblocks + 1, sizeof(int));
+    int *child = malloc(sizeof(int) * (g->nblocks ? g->nblocks : 1));
+    int sp = 0, counter = 0;
+
+    if (!first || !child) {
+        free(first);
+        free(child);
+        return FAIL;
+    }
+
+    for (int i = 0; i < g->nblocks; ++i)
+        g->blocks[i].dpre = g->blocks[i].dlast = BB_NONE;
+    for (int i = 1; i < g->nreach; ++i)
+        first[g->blocks[g->rpo[i]].idom + 1]++;
+    for (int i = 0; i < g->nblocks; ++i) {
+        first[i + 1] += first[i];
+        next[i] = first[i];
+    }
+    for (int i = 1; i < g->nreach; ++i)
+        child[next[g->blocks[g->rpo[i]].idom]++] = g->rpo[i];
+
+    g->blocks[g->entry].dpre = counter++;
+    next[g->entry] = first[g->entry];
+    stack[sp++] = g->entry;
+    while (sp) {
+        int b = stack[sp - 1];
+
+        if (next[b] < first[b + 1]) {
+            int c = child[next[b]++];
+
+            g->blocks[c].dpre = counter++;
+            next[c] = first[c];
+            stack[sp++] = c;
+        } else {
+            g->blocks[b].dlast = counter - 1;
+            sp--;
+        }
+    }
+
+    free(first);
+    free(child);
+
+    return SUCCEED;
+}
+
+int bb_dominates(const bb_graph_t *g, int d, int b)
+{
+    return g->blocks[d].dpre != BB_NONE && g->blocks[b].dpre != BB_NONE &&
+           g->blocks[d].dpre <= g->blocks[b].dpre &&
+           g->blocks[b].dpre <= g->blocks[d].dlast;
+}
+
+static int cmp_loop_size(const void *a, const void *b)
+{
+    const bb_loop_t *la = a, *lb = b;
+
+    if (la->nblocks != lb->nblocks)
+        return lb->nblocks - la->nblocks;
+    return la->header - lb->header;
+}
+
+/*
+ * collect the body of the natural loop of header h into body[], using
+ * every back edge that targets h. returns the body size.
+ */
+static int loop_body(const bb_graph_t *g, int h, int *body, char *mark)
+{
+    const bb_block_t *hb = &g->blocks[h];
+    int n = 0, top = 0;
+
+    mark[h] = 1;
+    body[n++] = h;
+    for (int p = 0; p < hb->npred; ++p) {
+        int l = hb->pred[p];
+
+        if (g->blocks[l].rpo == BB_NONE || !bb_dominates(g, h, l) || mark[l])
+            continue;
+        mark[l] = 1;
+        body[n++] = l;
+    }
+
+    /* body[1..n) is used as the work stack while it grows */
+    top = 1;
+    while (top < n) {
+        const bb_block_t *b = &g->blocks[body[top++]];
+
+        for (int p = 0; p < b->npred; ++p) {
+            int x = b->pred[p];
+
+            if (g->blocks[x].rpo == BB_NONE || mark[x])
+                continue;
+            mark[x] = 1;
+            body[n++] = x;
+        }
+    }
+
+    for (int i = 0; i < n; ++i)
+        mark[body[i]] = 0;
+
+    return n;
+}
+
+static int compute_loops(bb_graph_t *g, int *scratch, char *mark)
+{
+    int **bodies = NULL, nheaders = 0;
+    int *map = NULL, *tmp = NULL;
+    int ret = FAIL;
+
+    /* headers are targets of back edges, i.e. of edges to a dominator */
+    for (int i = 0; i < g->nreach; ++i) {
+        bb_block_t *b = &g->blocks[g->rpo[i]];
+
+        for (int s = 0; s < b->nsucc; ++s) {
+            int h = b->succ[s];
+
+            if (!mark[h] && bb_dominates(g, h, b->id)) {
+                mark[h] = 1;
+                scratch[nheaders++] = h;
+            }
+        }
+    }
+    for (int i = 0; i < nheaders; ++i)
+        mark[scratch[i]] = 0;
+
+    g->nloops = nheaders;
+    g->loops = calloc(nheaders ? nheaders : 1, sizeof(bb_loop_t));
+    bodies = calloc(nheaders ? nheaders : 1, sizeof(int *));
+    map = malloc(sizeof(int) * (nheaders ? nheaders : 1));
+    tmp = malloc(sizeof(int) * (g->nreach ? g->nreach : 1));
+    if (!g->loops || !bodies || !map || !tmp)
+        goto out;
+
+    for (int l = 0; l < nheaders; ++l) {
+        g->loops[l].header = scratch[l];
+        g->loops[l].parent = BB_NONE;
+    }
+
+    for (int l = 0; l < nheaders; ++l) {
+        int n = loop_body(g, g->loops[l].header, tmp, mark);
+
+        bodies[l] = malloc(sizeof(int) * n);
+        if (!bodies[l])
+            goto out;
+        memcpy(bodies[l], tmp, sizeof(int) * n);
+        g->loops[l].nblocks = n;
+    }
+
+    /*
+     * outer loops are strictly larger than the loops they contain, so
+     * sorting by size gives parents a smaller index. the header field
+     * carries the original index through the sort.
+     */
+    for (int l = 0; l < nheaders; ++l) {
+        map[l] = g->loops[l].header;
+        g->loops[l].header = l;
+    }
+    qsort(g->loops, nheaders, sizeof(bb_loop_t), cmp_loop_size);
+
+    /*
+     * walking from the largest loop to the smallest, every block ends up
+     * in its innermost loop and a header still points at its parent loop
+     * when its own loop is reached.
+     */
+    for (int l = 0; l < nheaders; ++l) {
+        int orig = g->loops[l].header, *body = bodies[orig];
+        int h = map[orig];
+
+        g->loops[l].header = h;
+        g->loops[l].parent = g->blocks[h].loop;
+        g->loops[l].depth = g->loops[l].parent == BB_NONE ? 1 :
+                            g->loops[g->loops[l].parent].depth + 1;
+        for (int i = 0; i < g->loops[l].nblocks; ++i)
+            g->blocks[body[i]].loop = l;
+    }
+
+    ret = SUCCEED;
+out:
+    if (bodies)
+        for (int l = 0; l < nheaders; ++l)
+            free(bodies[l]);
+    free(bodies);
+    free(map);
+    free(tmp);
+
+    return ret;
+}
+
+/*
+ * depth of the innermost loop containing both a and b.
+ */
+static int common_depth(const bb_graph_t *g, int a, int b)
+{
+    for (int l = g->blocks[b].loop; l != BB_NONE; l = g->loops[l].parent)
+        if (bb_loop_contains(g, l, a))
+            return g->loops[l].depth;
+
+    return 0;
+}
+
+/*
+ * Order successors so that the dfs leaves the outermost loop first.
+ * Exits then finish before the loop body and the resulting reverse
+ * postorder keeps every loop body contiguous behind its header, which
+ * is what lets the worklist stabilise inner loops before moving on.
+ */
+static void sort_successors(bb_graph_t *g)
+{
+    for (int i = 0; i < g->nreach; ++i) {
+        bb_block_t *b = &g->blocks[g->rpo[i]];
+
+        for (int j = 1; j < b->nsucc; ++j) {
+            int s = b->succ[j], d = common_depth(g, b->id, s), k = j - 1;
+
+            while (k >= 0 && common_depth(g, b->id, b->succ[k]) > d) {
+                b->succ[k + 1] = b->succ[k];
+                k--;
+            }
+            b->succ[k + 1] = s;
+        }
+    }
+}
+
+/*
+ * iterative Tarjan, components come out in reverse topological order.
+ */
+static int compute_sccs(bb_graph_t *g, int *stack, int *next)
+{
+    int *index = malloc(sizeof(int) * g->nblocks);
+    int *low = malloc(sizeof(int) * g->nblocks);
+    int *cstack = malloc(sizeof(int) * g->nblocks);
+    char *onstack = calloc(g->nblocks, 1);
+    int sp = 0, csp = 0, counter = 0, ncomp = 0;
+
+    if (!index || !low || !cstack || !onstack) {
+        free(index);
+        free(low);
+        free(cstack);
+        free(onstack);
+        return FAIL;
+    }
+
+    for (int i = 0; i < g->nblocks; ++i)
+        index[i] = BB_NONE;
+    memset(next, 0, sizeof(int) * g->nblocks);
+
+    index[g->entry] = low[g->entry] = counter++;
+    stack[sp++] = g->entry;
+    onstack[g->entry] = 1;
+    cstack[csp++] = g->entry;
+    while (csp) {
+        int v = cstack[csp - 1];
+        bb_block_t *b = &g->blocks[v];
+
+        if (next[v] < b->nsucc) {
+            int w = b->succ[next[v]++];
+
+            if (index[w] == BB_NONE) {
+                index[w] = low[w] = counter++;
+                stack[sp++] = w;
+                onstack[w] = 1;
+                cstack[csp++] = w;
+            } else if (onstack[w] && index[w] < low[v]) {
+                low[v] = index[w];
+            }
+            continue;
+        }
+
+        csp--;
+        if (low[v] == index[v]) {
+            int w;
+
+            do {
+                w = stack[--sp];
+                onstack[w] = 0;
+                g->blocks[w].scc = ncomp;
+            } while (w != v);
+            ncomp++;
+        }
+        if (csp && low[v] < low[cstack[csp - 1]])
+            low[cstack[csp - 1]] = low[v];
+    }
+
+    for (int i = 0; i < g->nblocks; ++i)
+        if (g->blocks[i].scc != BB_NONE)
+            g->blocks[i].scc = ncomp - 1 - g->blocks[i].scc;
+    g->nsccs = ncomp;
+
+    free(index);
+    free(low);
+    free(cstack);
+    free(onstack);
+
+    return SUCCEED;
+}
+
+int bb_graph_finalize(bb_graph_t *g, int entry)
+{
+    int *stack = NULL, *next = NULL;
+    char *mark = NULL;
+    int ret = FAIL;
+
+    if (entry < 0 || entry >= g->nblocks) {
+        LOG_ERR("invalid entry block %d", entry);
+        return FAIL;
+    }
+
+    g->entry = entry;
+    g->rpo = malloc(sizeof(int) * g->nblocks);
+    stack = malloc(sizeof(int) * g->nblocks);
+    next = malloc(sizeof(int) * g->nblocks);
+    mark = calloc(g->nblocks, 1);
+    if (!g->rpo || !stack || !next || !mark)
+        goto out;
+
+    g->nreach = dfs_rpo(g, g->rpo, stack, next, mark);
+    number_rpo(g);
+    compute_dominators(g);
+    if (SUCCEED != number_domtree(g, stack, next))
+        goto out;
+
+    memset(mark, 0, g->nblocks);
+    if (SUCCEED != compute_loops(g, stack, mark))
+        goto out;
+
+    sort_successors(g);
+    g->nreach = dfs_rpo(g, g->rpo, stack, next, mark);
+    number_rpo(g);
+
+    ret = compute_sccs(g, stack, next);
+out:
+    free(stack);
+    free(next);
+    free(mark);
+
+    return ret;
+}
@@ -0,0 +1,1486 @@
+/*
+ * @file cache_analysis.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Set parallel LRU must / may analysis.
+ *
+ * Must (Ferdinand): ages are upper bounds, join is intersection with the
+ * maximal age, a block in the state always hits.
+ * May: ages are lower bounds, join is union with the minimal age, a block
+ * out of the state always misses.
+ *
+ * Set states are hash consed, so equal states share one id and storage,
+ * and transfer / join results are memoized on their input ids.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "cfg.h"
+#include "fastmod.h"
+#include "fixpoint.h"
+#include "state_intern.h"
+#include "cache_analysis.h"
+
+/*
+ * an abstract line is a single word, the memory block in the high bits
+ * and its age in the low CA_AGE_BITS, so sorting words sorts by memory
+ * block and states hash and compare as plain word arrays.
+ */
+#define CA_AGE_BITS         16
+#define CA_MAX_WAYS         ((1U << CA_AGE_BITS) - 1)
+#define CA_LINE(m, age)     ((uint64_t)(m) << CA_AGE_BITS | (age))
+#define CA_MBLOCK(w)        ((w) >> CA_AGE_BITS)
+#define CA_AGE(w)           ((unsigned int)((w) & CA_MAX_WAYS))
+
+#define CA_PROGRAM_MEMO     64
+
+typedef struct ca_scope_line {
+    int loop;
+    unsigned long mblock;
+} ca_scope_line_t;
+
+typedef enum ca_kind {
+    CA_must = 0,
+    CA_may,
+} ca_kind_t;
+
+/* dominance frontiers, block b has df[df_first[b] .. df_first[b + 1]) */
+typedef struct ca_dom {
+    int *df_first;
+    int *df;
+} ca_dom_t;
+
+/* per worker context, reused for every set the worker analyzes */
+typedef struct ca_set_ctx {
+    const bb_graph_t *g;
+    const ca_access_t *acc;
+    const ca_cac_t *cac;        /* NULL when every access reaches the level */
+    const int *sacc;            /* accesses of the current set, by block */
+    int nsacc;
+    unsigned int ways;
+    ca_kind_t kind;
+    si_table_t *states;         /* shared by must and may */
+    si_memo_t *transfer_memo[2];
+    si_memo_t *join_memo[2];
+    uint64_t *scratch[4];       /* 0, 1 transfer / replay, 2, 3 ca_apply */
+    size_t nscratch;
+    ca_scope_line_t *pairs;     /* persistence, (loop, block) of the set */
+    size_t npairs;
+    int *conflicts;             /* persistence, distinct blocks per loop */
+    const ca_dom_t *dom;
+    int epoch;                  /* stamps of the current sparse graph */
+    int *mark;                  /* per block, in the sparse graph */
+    int *queued;                /* per block, on the frontier worklist */
+    int *seg;                   /* per block, its sparse graph node */
+    int *nodes;                 /* sparse graph node -> block */
+    uint64_t *keys;             /* dominator preorder << 32 | block */
+    int *mparent;               /* per node, nearest dominating node */
+    int *work;
+    unsigned long transfers;
+    unsigned long memo_hits;
+    unsigned long nstates;
+    int oom;
+} ca_set_ctx_t;
+
+typedef struct ca_lines {
+    unsigned int linesize;
+    int *first;
+    ca_access_t *acc;
+    int naccesses;
+} ca_lines_t;
+
+typedef struct ca_level_key {
+    unsigned int sets;
+    unsigned int ways;
+    unsigned int linesize;
+    int hp;
+    int cp;
+    int incl;                   /* an inclusive level at or below */
+} ca_level_key_t;
+
+/* raw result of a level prefix, before any back invalidation */
+typedef struct ca_memo_entry {
+    int nkey;
+    ca_level_key_t *key;
+    int nanalyzed;
+    cache_H_M_category_t *chmc;
+    int *scope;
+    unsigned long used;         /* lru stamp */
+} ca_memo_entry_t;
+
+struct ca_program {
+    const bb_graph_t *g;
+    ca_dom_t dom;
+    pthread_mutex_t lock;
+    ca_lines_t **lines;         /* one per linesize */
+    int nlines;
+    ca_memo_entry_t *memo;
+    int nmemo;
+    int cap;
+    unsigned long clock;
+    unsigned long reused;
+    unsigned long analyzed;
+};
+
+typedef struct ca_job {
+    const bb_graph_t *g;
+    const ca_geometry_t *geo;
+    const ca_dom_t *dom;
+    const ca_cac_t *cac;
+    ca_result_t *res;
+    const int *set_first;
+    const int *set_acc;
+    unsigned int next;
+    unsigned int group;
+    int failed;
+} ca_job_t;
+
+static fp_state_t ca_intern(ca_set_ctx_t *ctx, const uint64_t *w,
+                            unsigned int n)
+{
+    fp_state_t id = si_intern(ctx->states, w, n);
+
+    /* the solver sees an unreached point, the caller checks ctx->oom */
+    if (id == FP_STATE_NONE)
+        ctx->oom = 1;
+
+    return id;
+}
+
+static void ca_memo_put(ca_set_ctx_t *ctx, si_memo_t *m, uint32_t a,
+                        uint32_t b, fp_state_t v)
+{
+    if (v != FP_STATE_NONE && SUCCEED != si_memo_put(m, a, b, v))
+        ctx->oom = 1;
+}
+
+/*
+ * LRU update of an abstract set for an access to mblock, in place.
+ * line has room for one more entry. returns the new number of lines.
+ */
+static unsigned int lru_update(ca_kind_t kind, unsigned int ways,
+                               uint64_t *line, unsigned int n,
+                               unsigned long mblock)
+{
+    unsigned int age = ways, out = 0, i;
+
+    for (i = 0; i < n; ++i) {
+        if (CA_MBLOCK(line[i]) == mblock) {
+            age = CA_AGE(line[i]);
+            break;
+        }
+    }
+
+    /* must: younger lines age, may: lines no older than mblock age */
+    for (i = 0; i < n; ++i) {
+        unsigned long m = CA_MBLOCK(line[i]);
+        unsigned int a = CA_AGE(line[i]);
+
+        if (m == mblock)
+            a = 0;
+        else if (a < age || (kind == CA_may && a == age))
+            a++;
+        if (a >= ways)
+            continue;
+        line[out++] = CA_LINE(m, a);
+    }
+
+    if (age == ways) {
+        /* not cached before, insert keeping the order */
+        i = out;
+        while (i > 0 && CA_MBLOCK(line[i - 1]) > mblock) {
+            line[i] = line[i - 1];
+            i--;
+        }
+        line[i] = CA_LINE(mblock, 0);
+        out++;
+    }
+
+    return out;
+}
+
+/*
+ * join of two sorted abstract sets into out, returns the number of lines.
+ */
+static unsigned int join_lines(ca_kind_t kind, const uint64_t *wa,
+                               unsigned int na, const uint64_t *wb,
+                               unsigned int nb, uint64_t *out)
+{
+    unsigned int i = 0, j = 0, n = 0;
+
+    while (i < na || j < nb) {
+        if (i < na && j < nb && CA_MBLOCK(wa[i]) == CA_MBLOCK(wb[j])) {
+            unsigned int x = CA_AGE(wa[i]), y = CA_AGE(wb[j]);
+
+            if (kind == CA_must)
+                out[n++] = CA_LINE(CA_MBLOCK(wa[i]), x > y ? x : y);
+            else
+                out[n++] = CA_LINE(CA_MBLOCK(wa[i]), x < y ? x : y);
+            i++;
+            j++;
+        } else if (i < na && (j == nb || CA_MBLOCK(wa[i]) < CA_MBLOCK(wb[j]))) {
+            if (kind == CA_may)
+                out[n++] = wa[i];
+            i++;
+        } else {
+            if (kind == CA_may)
+                out[n++] = wb[j];
+            j++;
+        }
+    }
+
+    return n;
+}
+
+/*
+ * apply access id to line in place. an access that only may reach this
+ * level updates to the join of the states with and without it.
+ */
+static unsigned int ca_apply(ca_set_ctx_t *ctx, ca_kind_t kind, uint64_t *line,
+                             unsigned int n, int id)
+{
+    unsigned long m = ctx->acc[id].mblock;
+    uint64_t *upd = ctx->scratch[2], *out = ctx->scratch[3];
+    unsigned int nu;
+
+    if (!ctx->cac || ctx->cac[id] == CAC_always)
+        return lru_update(kind, ctx->ways, line, n, m);
+    if (ctx->cac[id] == CAC_never)
+        return n;
+
+    memcpy(upd, line, sizeof(uint64_t) * n);
+    nu = lru_update(kind, ctx->ways, upd, n, m);
+    n = join_lines(kind, line, n, upd, nu, out);
+    memcpy(line, out, sizeof(uint64_t) * n);
+
+    return n;
+}
+
+static int set_range(const ca_set_ctx_t *ctx, int block, int *lo)
+{
+    int l = 0, h = ctx->nsacc;
+
+    while (l < h) {
+        int m = (l + h) / 2;
+
+        if (ctx->acc[ctx->sacc[m]].block < block)
+            l = m + 1;
+        else
+            h = m;
+    }
+    *lo = l;
+    for (h = l; h < ctx->nsacc && ctx->acc[ctx->sacc[h]].block == block; ++h)
+        ;
+
+    return h;
+}
+
+static fp_state_t ca_entry(void *c)
+{
+    return ca_intern(c, NULL, 0);
+}
+
+static fp_state_t ca_transfer(void *c, const bb_graph_t *g, int block,
+                              fp_state_t in)
+{
+    ca_set_ctx_t *ctx = c;
+    si_memo_t *memo = ctx->transfer_memo[ctx->kind];
+    uint64_t *line = ctx->scratch[0];
+    const uint64_t *w;
+    unsigned int n;
+    fp_state_t out;
+    int lo, hi;
+
+    /* g is the sparse graph of the set */
+    block = ctx->nodes[block];
+    hi = set_range(ctx, block, &lo);
+    if (lo == hi)
+        return in;
+
+    out = si_memo_get(memo, in, block);
+    if (out != FP_STATE_NONE) {
+        ctx->memo_hits++;
+        return out;
+    }
+
+    ctx->transfers++;
+    w = si_state(ctx->states, in, &n);
+    memcpy(line, w, sizeof(uint64_t) * n);
+    for (int i = lo; i < hi; ++i)
+        n = ca_apply(ctx, ctx->kind, line, n, ctx->sacc[i]);
+
+    out = ca_intern(ctx, line, n);
+    ca_memo_put(ctx, memo, in, block, out);
+
+    return out;
+}
+
+static fp_state_t ca_join(void *c, fp_state_t a, fp_state_t b)
+{
+    ca_set_ctx_t *ctx = c;
+    si_memo_t *memo = ctx->join_memo[ctx->kind];
+    uint64_t *line = ctx->scratch[0];
+    const uint64_t *wa, *wb;
+    unsigned int n, na, nb;
+    fp_state_t out;
+
+    if (a == b)
+        return a;
+    if (a > b) {
+        fp_state_t tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    out = si_memo_get(memo, a, b);
+    if (out != FP_STATE_NONE) {
+        ctx->memo_hits++;
+        return out;
+    }
+
+    wa = si_state(ctx->states, a, &na);
+    wb = si_state(ctx->states, b, &nb);
+    n = join_lines(ctx->kind, wa, na, wb, nb, line);
+
+    out = ca_intern(ctx, line, n);
+    ca_memo_put(ctx, memo, a, b, out);
+
+    return out;
+}
+
+static int find_line(const uint64_t *line, unsigned int n,
+                     unsigned long mblock)
+{
+    for (unsigned int i = 0; i < n; ++i)
+        if (CA_MBLOCK(line[i]) == mblock)
+            return 1;
+
+    return 0;
+}
+
+static int cmp_scope_line(const void *a, const void *b)
+{
+    const ca_scope_line_t *x = a, *y = b;
+
+    if (x->loop != y->loop)
+        return x->loop - y->loop;
+    if (x->mblock != y->mblock)
+        return x->mblock < y->mblock ? -1 : 1;
+    return 0;
+}
+
+/*
+ * scope aware persistence of the still unclassified accesses of the
+ * current set. conflicts[l] counts the distinct blocks of this set
+ * accessed anywhere in loop l, nested loops included; a block is
+ * persistent in l when that count fits the ways. persistence in a loop
+ * implies persistence in its inner loops, so the scope of an access is
+ * found walking outwards from its innermost loop.
+ */
+static int persistence(ca_set_ctx_t *ctx, cache_H_M_category_t *chmc,
+                       int *scope)
+{
+    const bb_graph_t *g = ctx->g;
+    size_t n = 0;
+
+    for (int i = 0; i < ctx->nsacc; ++i) {
+        const ca_access_t *a = &ctx->acc[ctx->sacc[i]];
+
+        for (int l = g->blocks[a->block].loop; l != BB_NONE;
+             l = g->loops[l].parent) {
+            if (n == ctx->npairs) {
+                size_t cap = ctx->npairs ? ctx->npairs * 2 : 256;
+                ca_scope_line_t *tmp = realloc(ctx->pairs,
+                                               sizeof(ca_scope_line_t) * cap);
+
+                if (!tmp)
+                    return FAIL;
+                ctx->pairs = tmp;
+                ctx->npairs = cap;
+            }
+            ctx->pairs[n].loop = l;
+            ctx->pairs[n++].mblock = a->mblock;
+        }
+    }
+    if (!n)
+        goto classify;
+
+    qsort(ctx->pairs, n, sizeof(ca_scope_line_t), cmp_scope_line);
+    for (size_t i = 0; i < n; ++i)
+        if (!i || cmp_scope_line(&ctx->pairs[i - 1], &ctx->pairs[i]))
+            ctx->conflicts[ctx->pairs[i].loop]++;
+
+classify:
+    for (int i = 0; i < ctx->nsacc; ++i) {
+        int id = ctx->sacc[i], l = g->blocks[ctx->acc[id].block].loop;
+
+        scope[id] = BB_NONE;
+        if (chmc[id] != CHMC_not_classified)
+            continue;
+        for (; l != BB_NONE && ctx->conflicts[l] <= (int)ctx->ways;
+             l = g->loops[l].parent)
+            scope[id] = l;
+        if (scope[id] != BB_NONE)
+            chmc[id] = CHMC_first_miss;
+    }
+
+    /* only touched loops are non zero, clear them for the next set */
+    for (size_t i = 0; i < n; ++i)
+        ctx->conflicts[ctx->pairs[i].loop] = 0;
+
+    return SUCCEED;
+}
+
+static void ca_reset(ca_set_ctx_t *ctx)
+{
+    ctx->nstates += si_table_count(ctx->states);
+    si_table_reset(ctx->states);
+    for (int k = 0; k < 2; ++k) {
+        si_memo_reset(ctx->transfer_memo[k]);
+        si_memo_reset(ctx->join_memo[k]);
+    }
+}
+
+#define CA_KEY(g, b)        ((uint64_t)(g)->blocks[b].dpre << 32 | (b))
+#define CA_KEY_BLOCK(k)     ((int)((k) & 0xffffffff))
+#define CA_KEY_PRE(k)       ((int)((k) >> 32))
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* the sparse graph node whose state reaches the end of block b */
+static int nearest_node(const ca_set_ctx_t *ctx, int n, int b)
+{
+    int pre = ctx->g->blocks[b].dpre, l = 0, h = n;
+
+    /* last node not after b in dominator preorder */
+    while (l < h) {
+        int m = (l + h) / 2;
+
+        if (CA_KEY_PRE(ctx->keys[m]) <= pre)
+            l = m + 1;
+        else
+            h = m;
+    }
+    for (l--; !bb_dominates(ctx->g, ctx->nodes[l], b); l = ctx->mparent[l])
+        ;
+
+    return l;
+}
+
+/*
+ * Sparse evaluation graph of the current set: the entry, the blocks
+ * accessing the set and their iterated dominance frontier, i.e. where
+ * paths carrying different states of the set meet. Any other block
+ * leaves the set unchanged, so the state at the end of a block is the
+ * one at the end of its nearest dominator in the graph, as for SSA.
+ * The set fixpoint then costs its accesses instead of the whole task.
+ */
+static bb_graph_t *sparse_graph(ca_set_ctx_t *ctx)
+{
+    const bb_graph_t *g = ctx->g;
+    int n = 0, nw = 0, sp = 0, e = ++ctx->epoch;
+    bb_graph_t *seg;
+
+    ctx->mark[g->entry] = e;
+    ctx->keys[n++] = CA_KEY(g, g->entry);
+    for (int i = 0; i < ctx->nsacc; ++i) {
+        int b = ctx->acc[ctx->sacc[i]].block;
+
+        if (g->blocks[b].rpo == BB_NONE || ctx->mark[b] == e)
+            continue;
+        ctx->mark[b] = e;
+        ctx->keys[n++] = CA_KEY(g, b);
+    }
+
+    for (int i = 0; i < n; ++i) {
+        int b = CA_KEY_BLOCK(ctx->keys[i]);
+
+        ctx->queued[b] = e;
+        ctx->work[nw++] = b;
+    }
+    while (nw) {
+        int x = ctx->work[--nw];
+
+        for (int j = ctx->dom->df_first[x]; j < ctx->dom->df_first[x + 1]; ++j) {
+            int y = ctx->dom->df[j];
+
+            if (ctx->mark[y] != e) {
+                ctx->mark[y] = e;
+                ctx->keys[n++] = CA_KEY(g, y);
+            }
+            if (ctx->queued[y] != e) {
+                ctx->queued[y] = e;
+                ctx->work[nw++] = y;
+            }
+        }
+    }
+
+    /* preorder puts the entry first and every node after its dominators */
+    qsort(ctx->keys, n, sizeof(uint64_t), cmp_u64);
+    for (int i = 0; i < n; ++i) {
+        int b = CA_KEY_BLOCK(ctx->keys[i]);
+
+        ctx->nodes[i] = b;
+        ctx->seg[b] = i;
+        while (sp && !bb_dominates(g, ctx->nodes[ctx->work[sp - 1]], b))
+            sp--;
+        ctx->mparent[i] = sp ? ctx->work[sp - 1] : BB_NONE;
+        ctx->work[sp++] = i;
+    }
+
+    seg = bb_graph_create(n);
+    if (!seg)
+        return NULL;
+    for (int i = 0; i < n; ++i) {
+        const bb_block_t *b = &g->blocks[ctx->nodes[i]];
+
+        for (int p = 0; p < b->npred; ++p) {
+            if (g->blocks[b->pred[p]].rpo == BB_NONE)
+                continue;
+            if (SUCCEED != bb_graph_add_edge(seg, nearest_node(ctx, n, b->pred[p]),
+                                             i))
+                goto fail;
+        }
+    }
+    if (SUCCEED != bb_graph_finalize(seg, 0))
+        goto fail;
+
+    return seg;
+fail:
+    bb_graph_destroy(seg);
+
+    return NULL;
+}
+
+static int analyze_set(ca_set_ctx_t *ctx, const ca_job_t *job,
+                       unsigned int set)
+{
+    fp_domain_t dom = {
+        .ctx = ctx,
+        .entry = ca_entry,
+        .transfer = ca_transfer,
+        .join = ca_join,
+    };
+    fp_result_t must, may;
+    cache_H_M_category_t *chmc = job->res->chmc;
+    bb_graph_t *seg = NULL;
+    size_t need;
+    int ret = FAIL;
+
+    ctx->sacc = job->set_acc + job->set_first[set];
+    ctx->nsacc = job->set_first[set + 1] - job->set_first[set];
+    if (!ctx->nsacc)
+        return SUCCEED;
+
+    /* an abstract set never holds more lines than the set has blocks */
+    need = ctx->nsacc + ctx->ways + 1;
+    if (need > ctx->nscratch) {
+        for (int k = 0; k < 4; ++k) {
+            uint64_t *tmp = realloc(ctx->scratch[k], sizeof(uint64_t) * need);
+
+            if (!tmp)
+                return FAIL;
+            ctx->scratch[k] = tmp;
+        }
+        ctx->nscratch = need;
+    }
+
+    seg = sparse_graph(ctx);
+    if (!seg)
+        goto out;
+
+    ctx->kind = CA_must;
+    if (SUCCEED != fp_solve(seg, &dom, &must))
+        goto out;
+    ctx->kind = CA_may;
+    if (SUCCEED != fp_solve(seg, &dom, &may)) {
+        fp_result_release(&must);
+        goto out;
+    }
+    if (ctx->oom)
+        goto release;
+
+    /* replay every block with its fixpoint input to classify accesses */
+    for (int i = 0; i < ctx->nsacc; ) {
+        int b = ctx->acc[ctx->sacc[i]].block, lo, hi = set_range(ctx, b, &lo);
+        uint64_t *mu = ctx->scratch[0], *ma = ctx->scratch[1];
+        const uint64_t *w;
+        unsigned int nmu, nma;
+        int node = ctx->g->blocks[b].rpo == BB_NONE ? BB_NONE : ctx->seg[b];
+
+        if (node == BB_NONE || must.in[node] == FP_STATE_NONE ||
+            may.in[node] == FP_STATE_NONE) {
+            for (; i < hi; ++i)
+                chmc[ctx->sacc[i]] = CHMC_unknown;
+            continue;
+        }
+
+        w = si_state(ctx->states, must.in[node], &nmu);
+        memcpy(mu, w, sizeof(uint64_t) * nmu);
+        w = si_state(ctx->states, may.in[node], &nma);
+        memcpy(ma, w, sizeof(uint64_t) * nma);
+        /* an uncertain access is classified for when it does reach */
+        for (; i < hi; ++i) {
+            int id = ctx->sacc[i];
+            unsigned long m = ctx->acc[id].mblock;
+
+            if (find_line(mu, nmu, m))
+                chmc[id] = CHMC_hit;
+            else if (!find_line(ma, nma, m))
+                chmc[id] = CHMC_miss;
+            else
+                chmc[id] = CHMC_not_classified;
+            nmu = ca_apply(ctx, CA_must, mu, nmu, id);
+            nma = ca_apply(ctx, CA_may, ma, nma, id);
+        }
+    }
+
+    ret = persistence(ctx, chmc, job->res->scope);
+release:
+    fp_result_release(&must);
+    fp_result_release(&may);
+out:
+    bb_graph_destroy(seg);
+    ca_reset(ctx);
+
+    return ret;
+}
+
+static void *ca_worker(void *arg)
+{
+    ca_job_t *job = arg;
+    ca_set_ctx_t ctx = {
+        .g = job->g,
+        .acc = job->res->acc,
+        .cac = job->cac,
+        .ways = job->geo->ways,
+    };
+    int nb = job->g->nblocks ? job->g->nblocks : 1, ok;
+
+    ctx.states = si_table_create();
+    ctx.conflicts = calloc(job->g->nloops ? job->g->nloops : 1, sizeof(int));
+    ctx.dom = job->dom;
+    ctx.mark = calloc(nb, sizeof(int));
+    ctx.queued = calloc(nb, sizeof(int));
+    ctx.seg = malloc(sizeof(int) * nb);
+    ctx.nodes = malloc(sizeof(int) * nb);
+    ctx.keys = malloc(sizeof(uint64_t) * nb);
+    ctx.mparent = malloc(sizeof(int) * nb);
+    ctx.work = malloc(sizeof(int) * nb);
+    ok = ctx.conflicts && ctx.mark && ctx.queued && ctx.seg && ctx.nodes &&
+         ctx.keys && ctx.mparent && ctx.work;
+    for (int k = 0; k < 2; ++k) {
+        ctx.transfer_memo[k] = si_memo_create();
+        ctx.join_memo[k] = si_memo_create();
+        ok = ok && ctx.transfer_memo[k] && ctx.join_memo[k];
+    }
+    if (!ctx.states || !ok)
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+
+    while (!__atomic_load_n(&job->failed, __ATOMIC_RELAXED)) {
+        unsigned int set = __atomic_fetch_add(&job->next, job->group,
+                                              __ATOMIC_RELAXED);
+
+        if (set >= job->geo->sets)
+            break;
+        for (unsigned int s = set; s < set + job->group && s < job->geo->sets;
+             ++s) {
+            if (SUCCEED != analyze_set(&ctx, job, s)) {
+                __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+                break;
+            }
+        }
+    }
+
+    __atomic_fetch_add(&job->res->transfers, ctx.transfers, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&job->res->memo_hits, ctx.memo_hits, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&job->res->states, ctx.nstates, __ATOMIC_RELAXED);
+    si_table_destroy(ctx.states);
+    for (int k = 0; k < 2; ++k) {
+        si_memo_destroy(ctx.transfer_memo[k]);
+        si_memo_destroy(ctx.join_memo[k]);
+    }
+    for (int k = 0; k < 4; ++k)
+        free(ctx.scratch[k]);
+    free(ctx.pairs);
+    free(ctx.conflicts);
+    free(ctx.mark);
+    free(ctx.queued);
+    free(ctx.seg);
+    free(ctx.nodes);
+    free(ctx.keys);
+    free(ctx.mparent);
+    free(ctx.work);
+
+    return NULL;
+}
+
+/*
+ * expand the references of every block into line accesses, in block and
+ * reference order. only depends on the program and the linesize.
+ */
+static int expand_accesses(const bb_graph_t *g, unsigned int linesize,
+                           ca_lines_t *lines)
+{
+    int n = 0;
+
+    lines->linesize = linesize;
+    lines->first = malloc(sizeof(int) * (g->nblocks + 1));
+    if (!lines->first)
+        return FAIL;
+
+    for (int b = 0; b < g->nblocks; ++b) {
+        lines->first[b] = n;
+        for (int r = 0; r < g->blocks[b].nrefs; ++r) {
+            const bb_ref_t *ref = &g->blocks[b].refs[r];
+            unsigned int size = ref->size ? ref->size : 1;
+
+            n += (ref->addr + size - 1) / linesize - ref->addr / linesize + 1;
+        }
+    }
+    lines->first[g->nblocks] = n;
+    lines->naccesses = n;
+
+    lines->acc = malloc(sizeof(ca_access_t) * (n ? n : 1));
+    if (!lines->acc) {
+        free(lines->first);
+        lines->first = NULL;
+        return FAIL;
+    }
+
+    n = 0;
+    for (int b = 0; b < g->nblocks; ++b) {
+        for (int r = 0; r < g->blocks[b].nrefs; ++r) {
+            const bb_ref_t *ref = &g->blocks[b].refs[r];
+            unsigned int size = ref->size ? ref->size : 1;
+            unsigned long m = ref->addr / linesize;
+
+            for (; m <= (ref->addr + size - 1) / linesize; ++m, ++n) {
+                lines->acc[n].block = b;
+                lines->acc[n].ref = r;
+                lines->acc[n].mblock = m;
+            }
+        }
+    }
+
+    return SUCCEED;
+}
+
+/*
+ * dominance frontiers (Cooper, Harvey and Kennedy): a join block is in
+ * the frontier of every block from each of its predecessors up to, not
+ * including, its immediate dominator. only depends on the program.
+ */
+static int build_frontiers(const bb_graph_t *g, ca_dom_t *dom)
+{
+    int *last = malloc(sizeof(int) * (g->nblocks ? g->nblocks : 1));
+    int *next = NULL, n = 0;
+
+    dom->df_first = calloc(g->nblocks + 1, sizeof(int));
+    dom->df = NULL;
+    if (!last || !dom->df_first)
+        goto fail;
+
+    /* the first pass counts, the second fills */
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < g->nblocks; ++i)
+            last[i] = BB_NONE;
+        for (int i = 0; i < g->nreach; ++i) {
+            const bb_block_t *b = &g->blocks[g->rpo[i]];
+
+            for (int p = 0; p < b->npred; ++p) {
+                int r = b->pred[p];
+
+                if (g->blocks[r].rpo == BB_NONE)
+                    continue;
+                /* the entry is its own idom, and in its own frontier */
+                for (; r != b->idom || r == b->id; r = g->blocks[r].idom) {
+                    if (last[r] != b->id) {
+                        last[r] = b->id;
+                        if (pass)
+                            dom->df[next[r]++] = b->id;
+                        else
+                            dom->df_first[r + 1]++;
+                    }
+                    if (r == g->entry)
+                        break;
+                }
+            }
+        }
+        if (pass)
+            break;
+
+        for (int i = 0; i < g->nblocks; ++i)
+            dom->df_first[i + 1] += dom->df_first[i];
+        n = dom->df_first[g->nblocks];
+        dom->df = malloc(sizeof(int) * (n ? n : 1));
+        next = malloc(sizeof(int) * (g->nblocks ? g->nblocks : 1));
+        if (!dom->df || !next)
+            goto fail;
+        memcpy(next, dom->df_first, sizeof(int) * g->nblocks);
+    }
+
+    free(last);
+    free(next);
+
+    return SUCCEED;
+fail:
+    free(last);
+    free(next);
+    free(dom->df_first);
+    free(dom->df);
+    dom->df_first = dom->df = NULL;
+
+    return FAIL;
+}
+
+/*
+ * bucket the accesses by set, keeping block order inside a set. accesses
+ * that never reach the level stay out of the buckets and keep
+ * CHMC_unknown.
+ */
+static int bucket_accesses(const ca_geometry_t *geo, const ca_cac_t *cac,
+                           ca_result_t *res, int **set_first, int **set_acc)
+{
+    int n = res->naccesses;
+    fastmod_t index;
+
+    fastmod_init(&index, geo->sets);
+    res->chmc = malloc(sizeof(cache_H_M_category_t) * (n ? n : 1));
+    res->scope = malloc(sizeof(int) * (n ? n : 1));
+    *set_first = calloc(geo->sets + 1, sizeof(int));
+    *set_acc = malloc(sizeof(int) * (n ? n : 1));
+    if (!res->chmc || !res->scope || !*set_first || !*set_acc)
+        return FAIL;
+
+    for (int i = 0; i < n; ++i) {
+        res->chmc[i] = CHMC_unknown;
+        res->scope[i] = BB_NONE;
+        if (cac && cac[i] == CAC_never)
+            continue;
+        (*set_first)[fastmod_reduce(&index, res->acc[i].mblock) + 1]++;
+        res->nanalyzed++;
+    }
+
+    for (unsigned int s = 0; s < geo->sets; ++s)
+        (*set_first)[s + 1] += (*set_first)[s];
+    for (int i = 0; i < n; ++i)
+        if (!cac || cac[i] != CAC_never)
+            (*set_acc)[(*set_first)[fastmod_reduce(&index,
+                                                   res->acc[i].mblock)]++] = i;
+    for (unsigned int s = geo->sets; s > 0; --s)
+        (*set_first)[s] = (*set_first)[s - 1];
+    (*set_first)[0] = 0;
+
+    return SUCCEED;
+}
+
+static void release_frontiers(ca_dom_t *dom)
+{
+    free(dom->df_first);
+    free(dom->df);
+    dom->df_first = dom->df = NULL;
+}
+
+/*
+ * classify the accesses reaching one level. the line accesses are
+ * borrowed from lines, or expanded and owned by res when it is NULL,
+ * the frontiers are borrowed from dom or built for this call.
+ * without lru the replacement is not modeled and every reaching access
+ * is left not classified.
+ */
+static int analyze_level(const bb_graph_t *g, const ca_geometry_t *geo,
+                         const ca_lines_t *lines, const ca_dom_t *dom,
+                         const ca_cac_t *cac, int lru, int nthreads,
+                         ca_result_t *res)
+{
+    ca_job_t job = {
+        .g = g,
+        .geo = geo,
+        .dom = dom,
+        .cac = cac,
+        .res = res,
+    };
+    int *set_first = NULL, *set_acc = NULL;
+    pthread_t *tids = NULL;
+    ca_lines_t own;
+    ca_dom_t own_dom = {NULL, NULL};
+    int started = 0;
+
+    memset(res, 0, sizeof(*res));
+    if (!geo->sets || !geo->ways || geo->ways > CA_MAX_WAYS ||
+        !geo->linesize) {
+        LOG_ERR("invalid cache geometry %u sets, %u ways, %uB lines",
+                geo->sets, geo->ways, geo->linesize);
+        return FAIL;
+    }
+
+    res->nblocks = g->nblocks;
+    if (lines) {
+        res->shared = 1;
+    } else {
+        if (SUCCEED != expand_accesses(g, geo->linesize, &own))
+            goto fail;
+        lines = &own;
+    }
+    res->first = lines->first;
+    res->acc = lines->acc;
+    res->naccesses = lines->naccesses;
+
+    if (SUCCEED != bucket_accesses(geo, cac, res, &set_first, &set_acc))
+        goto fail;
+
+    if (!lru) {
+        for (int i = 0; i < res->naccesses; ++i)
+            if (!cac || cac[i] != CAC_never)
+                res->chmc[i] = CHMC_not_classified;
+        goto done;
+    }
+
+    if (!dom) {
+        if (SUCCEED != build_frontiers(g, &own_dom))
+            goto fail;
+        job.dom = &own_dom;
+    }
+    job.set_first = set_first;
+    job.set_acc = set_acc;
+
+    if (nthreads <= 0)
+        nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads <= 0)
+        nthreads = 1;
+    if ((unsigned int)nthreads > geo->sets)
+        nthreads = geo->sets;
+
+    /* a few groups per thread keeps the tail short */
+    job.group = geo->sets / (nthreads * 4);
+    if (!job.group)
+        job.group = 1;
+
+    if (nthreads == 1) {
+        ca_worker(&job);
+    } else {
+        tids = malloc(sizeof(pthread_t) * nthreads);
+        if (!tids)
+            goto fail;
+        for (; started < nthreads; ++started)
+            if (pthread_create(&tids[started], NULL, ca_worker, &job))
+                break;
+        if (!started)
+            ca_worker(&job);
+        for (int i = 0; i < started; ++i)
+            pthread_join(tids[i], NULL);
+        free(tids);
+    }
+
+    if (job.failed)
+        goto fail;
+
+done:
+    release_frontiers(&own_dom);
+    free(set_first);
+    free(set_acc);
+
+    return SUCCEED;
+fail:
+    LOG_ERR("cache analysis failed");
+    release_frontiers(&own_dom);
+    free(set_first);
+    free(set_acc);
+    ca_result_release(res);
+
+    return FAIL;
+}
+
+int ca_analyze(const bb_graph_t *g, const ca_geometry_t *geo, int nthreads,
+               ca_result_t *res)
+{
+    return analyze_level(g, geo, NULL, NULL, NULL, 1, nthreads, res);
+}
+
+int ca_analyze_level(const bb_graph_t *g, const ca_geometry_t *geo,
+                     const ca_cac_t *cac, int nthreads, ca_result_t *res)
+{
+    return analyze_level(g, geo, NULL, NULL, cac, 1, nthreads, res);
+}
+
+/*
+ * CAC of an access at the level below, from its CAC and class here.
+ * an inclusive level anywhere below may back invalidate this level, so
+ * hits here are not a proof the access stays off the level below.
+ */
+static ca_cac_t next_cac(ca_cac_t cac, cache_H_M_category_t chmc, int incl)
+{
+    if (cac == CAC_never)
+        return CAC_never;
+
+    switch (chmc) {
+    case CHMC_miss:
+        return cac;
+    case CHMC_hit:
+        return incl ? CAC_uncertain : CAC_never;
+    case CHMC_first_miss:
+    case CHMC_not_classified:
+        return CAC_uncertain;
+    default:
+        /* unreachable code */
+        return CAC_never;
+    }
+}
+
+static int loop_within(const bb_graph_t *g, int inner, int outer)
+{
+    for (; inner != BB_NONE; inner = g->loops[inner].parent)
+        if (inner == outer)
+            return 1;
+
+    return 0;
+}
+
+/*
+ * an eviction from an inclusive level invalidates the line in every level
+ * above it, above is one of them. a
+ * hit above survives only when the line is sure to be kept below, a
+ * first miss above when it persists below in a scope covering its own.
+ */
+static void back_invalidate(const bb_graph_t *g, ca_result_t *above,
+                            const ca_result_t *below)
+{
+    for (int i = 0; i < above->naccesses; ++i) {
+        cache_H_M_category_t c = below->chmc[i];
+
+        if (above->chmc[i] == CHMC_hit && c == CHMC_hit)
+            continue;
+        if (above->chmc[i] == CHMC_first_miss &&
+            (c == CHMC_hit || (c == CHMC_first_miss &&
+                               loop_within(g, above->scope[i], below->scope[i]))))
+            continue;
+        if (above->chmc[i] == CHMC_hit || above->chmc[i] == CHMC_first_miss) {
+            above->chmc[i] = CHMC_not_classified;
+            above->scope[i] = BB_NONE;
+        }
+    }
+}
+
+static int level_lru(const ca_level_t *levels, int l)
+{
+    /* the exclusive fill path is not modeled, lines come from evictions */
+    return levels[l].cp == CP_lru && (!l || levels[l].hp != H_exclusive);
+}
+
+/* whether a level from l down is inclusive */
+static int inclusive_from(const ca_level_t *levels, int nlevels, int l)
+{
+    for (; l < nlevels; ++l)
+        if (levels[l].hp == H_inclusive)
+            return 1;
+
+    return 0;
+}
+
+/*
+ * what the raw result of level l depends on besides the levels above.
+ * the policy of L1 has no level above, and a level that is not analyzed
+ * does not depend on its geometry. the CAC of level l depends on the
+ * inclusive levels from l down.
+ */
+static void level_key(const ca_level_t *levels, int nlevels, int l,
+                      ca_level_key_t *key)
+{
+    int lru = level_lru(levels, l);
+
+    key->sets = lru ? levels[l].geo.sets : 0;
+    key->ways = lru ? levels[l].geo.ways : 0;
+    key->linesize = levels[l].geo.linesize;
+    key->hp = l ? levels[l].hp : H_unknown;
+    key->cp = levels[l].cp;
+    key->incl = l ? inclusive_from(levels, nlevels, l) : 0;
+}
+
+static int key_equal(const ca_level_key_t *a, const ca_level_key_t *b, int n)
+{
+    for (int i = 0; i < n; ++i)
+        if (a[i].sets != b[i].sets || a[i].ways != b[i].ways ||
+            a[i].linesize != b[i].linesize || a[i].hp != b[i].hp ||
+            a[i].cp != b[i].cp || a[i].incl != b[i].incl)
+            return 0;
+
+    return 1;
+}
+
+static const ca_lines_t *program_lines(ca_program_t *prog,
+                                       unsigned int linesize)
+{
+    ca_lines_t *lines = NULL, **tmp;
+
+    pthread_mutex_lock(&prog->lock);
+    for (int i = 0; i < prog->nlines; ++i)
+        if (prog->lines[i]->linesize == linesize)
+            lines = prog->lines[i];
+    if (lines)
+        goto out;
+
+    tmp = realloc(prog->lines, sizeof(ca_lines_t *) * (prog->nlines + 1));
+    if (!tmp)
+        goto out;
+    prog->lines = tmp;
+    lines = malloc(sizeof(ca_lines_t));
+    if (lines && SUCCEED != expand_accesses(prog->g, linesize, lines)) {
+        free(lines);
+        lines = NULL;
+    }
+    if (lines)
+        prog->lines[prog->nlines++] = lines;
+out:
+    pthread_mutex_unlock(&prog->lock);
+
+    return lines;
+}
+
+/*
+ * copy the memoized raw result of the level prefix key[0..n) into res.
+ * return SUCCEED or FAIL if it is not memoized.
+ */
+static int memo_get(ca_program_t *prog, const ca_level_key_t *key, int n,
+                    const ca_lines_t *lines, ca_result_t *res)
+{
+    int ret = FAIL, na = lines->naccesses;
+
+    pthread_mutex_lock(&prog->lock);
+    for (int i = 0; i < prog->nmemo; ++i) {
+        ca_memo_entry_t *e = &prog->memo[i];
+
+        if (e->nkey != n || !key_equal(e->key, key, n))
+            continue;
+
+        memset(res, 0, sizeof(*res));
+        res->nblocks = prog->g->nblocks;
+        res->first = lines->first;
+        res->acc = lines->acc;
+        res->naccesses = na;
+        res->shared = 1;
+        res->nanalyzed = e->nanalyzed;
+        res->chmc = malloc(sizeof(cache_H_M_category_t) * (na ? na : 1));
+        res->scope = malloc(sizeof(int) * (na ? na : 1));
+        if (!res->chmc || !res->scope) {
+            ca_result_release(res);
+            break;
+        }
+        memcpy(res->chmc, e->chmc, sizeof(cache_H_M_category_t) * na);
+        memcpy(res->scope, e->scope, sizeof(int) * na);
+        e->used = ++prog->clock;
+        prog->reused++;
+        ret = SUCCEED;
+        break;
+    }
+    pthread_mutex_unlock(&prog->lock);
+
+    return ret;
+}
+
+static void memo_entry_release(ca_memo_entry_t *e)
+{
+    free(e->key);
+    free(e->chmc);
+    free(e->scope);
+    memset(e, 0, sizeof(*e));
+}
+
+/*
+ * remember a raw level result, evicting the least recently used entry.
+ * out of memory only loses the entry.
+ */
+static void memo_put(ca_program_t *prog, const ca_level_key_t *key, int n,
+                     const ca_result_t *res)
+{
+    ca_memo_entry_t e = {
+        .nkey = n,
+        .nanalyzed = res->nanalyzed,
+    };
+    int na = res->naccesses, victim = 0;
+
+    e.key = malloc(sizeof(ca_level_key_t) * n);
+    e.chmc = malloc(sizeof(cache_H_M_category_t) * (na ? na : 1));
+    e.scope = malloc(sizeof(int) * (na ? na : 1));
+    if (!e.key || !e.chmc || !e.scope) {
+        memo_entry_release(&e);
+        return;
+    }
+    memcpy(e.key, key, sizeof(ca_level_key_t) * n);
+    memcpy(e.chmc, res->chmc, sizeof(cache_H_M_category_t) * na);
+    memcpy(e.scope, res->scope, sizeof(int) * na);
+
+    pthread_mutex_lock(&prog->lock);
+    prog->analyzed++;
+    for (int i = 0; i < prog->nmemo; ++i) {
+        /* another thread got there first */
+        if (prog->memo[i].nkey == n && key_equal(prog->memo[i].key, key, n)) {
+            pthread_mutex_unlock(&prog->lock);
+            memo_entry_release(&e);
+            return;
+        }
+        if (prog->memo[i].used < prog->memo[victim].used)
+            victim = i;
+    }
+    if (prog->nmemo < prog->cap)
+        victim = prog->nmemo++;
+    else
+        memo_entry_release(&prog->memo[victim]);
+    e.used = ++prog->clock;
+    prog->memo[victim] = e;
+    pthread_mutex_unlock(&prog->lock);
+}
+
+/*
+ * top down over the levels, see cache_analysis.h. with a program the line
+ * accesses are shared and level results are looked up by their prefix
+ * of level configurations first.
+ */
+static int analyze_hierarchy(const bb_graph_t *g, ca_program_t *prog,
+                             ca_level_t *levels, int nlevels, int nthreads)
+{
+    const ca_lines_t *lines = NULL;
+    ca_level_key_t *key = NULL;
+    ca_dom_t own_dom = {NULL, NULL};
+    const ca_dom_t *dom = prog ? &prog->dom : &own_dom;
+    int incl;
+
+    if (!prog && SUCCEED != build_frontiers(g, &own_dom))
+        goto fail;
+    if (prog) {
+        lines = program_lines(prog, levels[0].geo.linesize);
+        key = malloc(sizeof(ca_level_key_t) * nlevels);
+        if (!lines || !key)
+            goto fail;
+        for (int l = 0; l < nlevels; ++l)
+            level_key(levels, nlevels, l, &key[l]);
+    }
+
+    for (int l = 0; l < nlevels; ++l) {
+        ca_level_t *lv = &levels[l];
+
+        if (lv->geo.linesize != levels[0].geo.linesize) {
+            LOG_ERR("level %d linesize %u differs from L1 %u", l + 1,
+                    lv->geo.linesize, levels[0].geo.linesize);
+            goto fail;
+        }
+        if (!prog || SUCCEED != memo_get(prog, key, l + 1, lines, &lv->res)) {
+            if (SUCCEED != analyze_level(g, &lv->geo, lines, dom, lv->cac,
+                                         level_lru(levels, l), nthreads,
+                                         &lv->res))
+                goto fail;
+            if (prog)
+                memo_put(prog, key, l + 1, &lv->res);
+        }
+        if (l && lv->hp == H_inclusive)
+            for (int j = 0; j < l; ++j)
+                back_invalidate(g, &levels[j].res, &lv->res);
+        if (l + 1 == nlevels)
+            break;
+
+        incl = inclusive_from(levels, nlevels, l + 1);
+        levels[l + 1].cac = malloc(sizeof(ca_cac_t) *
+                                   (lv->res.naccesses ? lv->res.naccesses : 1));
+        if (!levels[l + 1].cac)
+            goto fail;
+        for (int i = 0; i < lv->res.naccesses; ++i)
+            levels[l + 1].cac[i] = next_cac(lv->cac ? lv->cac[i] : CAC_always,
+                                            lv->res.chmc[i], incl);
+    }
+    free(key);
+    release_frontiers(&own_dom);
+
+    return SUCCEED;
+fail:
+    LOG_ERR("cache hierarchy analysis failed");
+    free(key);
+    release_frontiers(&own_dom);
+    ca_levels_release(levels, nlevels);
+
+    return FAIL;
+}
+
+int ca_analyze_hierarchy(const bb_graph_t *g, ca_level_t *levels, int nlevels,
+                         int nthreads)
+{
+    return analyze_hierarchy(g, NULL, levels, nlevels, nthreads);
+}
+
+ca_program_t *ca_program_create(const bb_graph_t *g, int nmemo)
+{
+    ca_program_t *prog = calloc(1, sizeof(ca_program_t));
+
+    if (!prog)
+        return NULL;
+
+    prog->g = g;
+    prog->cap = nmemo > 0 ? nmemo : CA_PROGRAM_MEMO;
+    prog->memo = calloc(prog->cap, sizeof(ca_memo_entry_t));
+    if (!prog->memo || SUCCEED != build_frontiers(g, &prog->dom)) {
+        free(prog->memo);
+        free(prog);
+        return NULL;
+    }
+    pthread_mutex_init(&prog->lock, NULL);
+
+    return prog;
+}
+
+void ca_program_destroy(ca_program_t *prog)
+{
+    if (!prog)
+        return;
+
+    for (int i = 0; i < prog->nlines; ++i) {
+        free(prog->lines[i]->first);
+        free(prog->lines[i]->acc);
+        free(prog->lines[i]);
+    }
+    free(prog->lines);
+    for (int i = 0; i < prog->nmemo; ++i)
+        memo_entry_release(&prog->memo[i]);
+    free(prog->memo);
+    release_frontiers(&prog->dom);
+    pthread_mutex_destroy(&prog->lock);
+    free(prog);
+}
+
+int ca_program_analyze(ca_program_t *prog, ca_level_t *levels, int nlevels,
+                       int nthreads)
+{
+    return analyze_hierarchy(prog->g, prog, levels, nlevels, nthreads);
+}
+
+void ca_program_stats(ca_program_t *prog, unsigned long *reused,
+                      unsigned long *analyzed)
+{
+    pthread_mutex_lock(&prog->lock);
+    *reused = prog->reused;
+    *analyzed = prog->analyzed;
+    pthread_mutex_unlock(&prog->lock);
+}
+
+/* one level per cache of the list, analysis inputs only */
+static int caches_to_levels(struct list_head *caches, ca_level_t **levels,
+                            int *nlevels)
+{
+    cache_t *cache;
+    int n = 0;
+
+    *levels = NULL;
+    *nlevels = 0;
+    list_for_each_entry(cache, caches, list)
+        n++;
+    if (!n)
+        return FAIL;
+
+    *levels = calloc(n, sizeof(ca_level_t));
+    if (!*levels)
+        return FAIL;
+
+    n = 0;
+    list_for_each_entry(cache, caches, list) {
+        ca_level_t *lv = &(*levels)[n++];
+
+        lv->geo.sets = cache->sets;
+        lv->geo.ways = cache->ways;
+        lv->geo.linesize = cache->linesize;
+        lv->hp = cache->hp_cache;
+        lv->cp = cache->cp_cache;
+    }
+    *nlevels = n;
+
+    return SUCCEED;
+}
+
+static int analyze_caches(const bb_graph_t *g, ca_program_t *prog,
+                          struct list_head *caches, int nthreads,
+                          ca_level_t **levels, int *nlevels)
+{
+    int n;
+
+    if (SUCCEED != caches_to_levels(caches, levels, &n))
+        return FAIL;
+
+    if (SUCCEED != analyze_hierarchy(g, prog, *levels, n, nthreads)) {
+        free(*levels);
+        *levels = NULL;
+        *nlevels = 0;
+        return FAIL;
+    }
+    *nlevels = n;
+
+    return SUCCEED;
+}
+
+int ca_analyze_caches(const bb_graph_t *g, struct list_head *caches,
+                      int nthreads, ca_level_t **levels, int *nlevels)
+{
+    return analyze_caches(g, NULL, caches, nthreads, levels, nlevels);
+}
+
+int ca_program_analyze_caches(ca_program_t *prog, struct list_head *caches,
+                              int nthreads, ca_level_t **levels, int *nlevels)
+{
+    return analyze_caches(prog->g, prog, caches, nthreads, levels, nlevels);
+}
+
+void ca_levels_release(ca_level_t *levels, int nlevels)
+{
+    for (int l = 0; l < nlevels; ++l) {
+        free(levels[l].cac);
+        levels[l].cac = NULL;
+        ca_result_release(&levels[l].res);
+    }
+}
+
+static int chmc_rank(cache_H_M_category_t c)
+{
+    switch (c) {
+    case CHMC_hit:
+        return 0;
+    case CHMC_first_miss:
+        return 1;
+    case CHMC_not_classified:
+        return 2;
+    case CHMC_miss:
+        return 3;
+    default:
+        return 4;
+    }
+}
+
+cache_H_M_category_t ca_ref_chmc(const ca_result_t *res, int block, int ref)
+{
+    cache_H_M_category_t c = CHMC_hit;
+
+    for (int i = res->first[block]; i < res->first[block + 1]; ++i)
+        if (res->acc[i].ref == ref && chmc_rank(res->chmc[i]) > chmc_rank(c))
+            c = res->chmc[i];
+
+    return c;
+}
+
+void ca_result_release(ca_result_t *res)
+{
+    if (!res->shared) {
+        free(res->first);
+        free(res->acc);
+    }
+    free(res->chmc);
+    free(res->scope);
+    memset(res, 0, sizeof(*res));
+}
@@ -0,0 +1,85 @@
+/*
+ * @file cfg_import.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Convert the basic block lists of cfg_make() into a bb_graph_t.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libdis.h>
+#include "../example/libdiscfg/cfg.h"
+
+#include "cfg.h"
+#include "bbgraph.h"
+
+int bb_graph_from_cfg(bb_graph_t **graph, struct cfg_node_list *nodes,
+                      void **insts, int insts_len, unsigned long entry_addr)
+{
+    x86_insn_t **in = (x86_insn_t **)insts;
+    struct cfg_node_list *nl, *cl;
+    int *inst2block = NULL;
+    bb_ref_t *refs = NULL;
+    bb_graph_t *g = NULL;
+    int nblocks = 0, entry = 0, id;
+
+    for (nl = nodes; nl != NULL; nl = nl->next)
+        nblocks++;
+
+    if (!nblocks || insts_len <= 0) {
+        LOG_ERR("empty control flow graph");
+        return FAIL;
+    }
+
+    inst2block = malloc(sizeof(int) * insts_len);
+    refs = malloc(sizeof(bb_ref_t) * insts_len);
+    g = bb_graph_create(nblocks);
+    if (!inst2block || !refs || !g)
+        goto fail;
+
+    for (nl = nodes, id = 0; nl != NULL; nl = nl->next, ++id) {
+        struct cfg_node *node = nl->node;
+
+        for (int i = 0; i < node->block_len; ++i) {
+            x86_insn_t *insn = in[node->start_inst + i];
+
+            inst2block[node->start_inst + i] = id;
+            refs[i].addr = insn->addr;
+            refs[i].size = insn->size;
+        }
+        if (SUCCEED != bb_graph_set_refs(g, id, refs, node->block_len))
+            goto fail;
+
+        if (entry_addr && in[node->start_inst]->addr == entry_addr)
+            entry = id;
+    }
+
+    for (nl = nodes, id = 0; nl != NULL; nl = nl->next, ++id) {
+        for (cl = nl->node->children; cl != NULL; cl = cl->next) {
+            if (SUCCEED != bb_graph_add_edge(g, id,
+                                             inst2block[cl->node->start_inst]))
+                goto fail;
+        }
+    }
+
+    if (SUCCEED != bb_graph_finalize(g, entry))
+        goto fail;
+
+    free(inst2block);
+    free(refs);
+    *graph = g;
+
+    return SUCCEED;
+fail:
+    LOG_ERR("cannot build the block graph");
+    free(inst2block);
+    free(refs);
+    bb_graph_destroy(g);
+
+    return FAIL;
+}
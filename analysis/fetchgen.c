@@ -0,0 +1,332 @@
+/*
+ * @file fetchgen.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Instruction fetch traces from the block graph, see fetchgen.h.
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "fetchgen.h"
+
+typedef struct fetch_block {
+    int run;                    /* first of its runs */
+    int nruns;
+    int edge;                   /* weight of its first successor */
+    int hloop;                  /* loop it heads, BB_NONE if none */
+    unsigned int turn;          /* successors taken so far */
+    uint64_t wsum;              /* of the weights of its edges */
+} fetch_block_t;
+
+struct fetchgen {
+    const bb_graph_t *g;
+    unsigned int lineshift;
+    fetch_block_t *blocks;
+    trace_ref_t *runs;          /* ready to copy out */
+    uint64_t *weights;          /* per edge */
+    unsigned int *iter;         /* header executions of this entry */
+    int *cand;
+    int block;                  /* being fetched */
+    int next;                   /* run of block */
+    uint64_t walks;
+    uint64_t rng;
+};
+
+static inline uint64_t xorshift(uint64_t *x)
+{
+    *x ^= *x << 13;
+    *x ^= *x >> 7;
+    *x ^= *x << 17;
+
+    return *x;
+}
+
+/* the runs of consecutive lines of block b, appended to f->runs */
+static int block_runs(fetchgen_t *f, int b, int *nruns)
+{
+    const bb_block_t *bb = &f->g->blocks[b];
+    uint64_t first = 0, last = 0;
+    int n = 0;
+
+    for (int i = 0; i < bb->nrefs; ++i) {
+        uint64_t lo = bb->refs[i].addr >> f->lineshift;
+        uint64_t hi = (bb->refs[i].addr + (bb->refs[i].size ?
+                       bb->refs[i].size - 1 : 0)) >> f->lineshift;
+
+        if (n && lo >= first && lo <= last + 1) {
+            if (hi > last)
+                last = hi;
+            continue;
+        }
+        if (n) {
+            f->runs[*nruns].addr = first << f->lineshift;
+            f->runs[*nruns].size = (last - first + 1) << f->lineshift;
+            (*nruns)++;
+        }
+        memset(&f->runs[*nruns], 0, sizeof(trace_ref_t));
+        f->runs[*nruns].pc = bb->refs[0].addr;
+        f->runs[*nruns].op = TRACE_ifetch;
+        first = lo;
+        last = hi;
+        n++;
+    }
+    if (n) {
+        f->runs[*nruns].addr = first << f->lineshift;
+        f->runs[*nruns].size = (last - first + 1) << f->lineshift;
+        (*nruns)++;
+    }
+
+    return n;
+}
+
+fetchgen_t *fetch_create(const bb_graph_t *g, unsigned int linesize,
+                         uint64_t seed)
+{
+    fetchgen_t *f;
+    int nrefs = 0, nedges = 0, maxsucc = 1, nruns = 0, i;
+
+    if (!g->nblocks || !linesize || (linesize & (linesize - 1))) {
+        LOG_ERR("no blocks or a bad linesize %u", linesize);
+        return NULL;
+    }
+    if (!(f = calloc(1, sizeof(fetchgen_t))))
+        return NULL;
+
+    for (int b = 0; b < g->nblocks; ++b) {
+        nrefs += g->blocks[b].nrefs;
+        nedges += g->blocks[b].nsucc;
+        if (g->blocks[b].nsucc > maxsucc)
+            maxsucc = g->blocks[b].nsucc;
+    }
+    /* a walk that never fetches would never end */
+    for (i = 0; i < g->nreach && !g->blocks[g->rpo[i]].nrefs; ++i)
+        ;
+    if (i == g->nreach) {
+        LOG_ERR("no instructions to fetch from the entry");
+        fetch_destroy(f);
+        return NULL;
+    }
+    f->g = g;
+    f->lineshift = __builtin_ctz(linesize);
+    f->blocks = calloc(g->nblocks, sizeof(fetch_block_t));
+    f->runs = malloc(sizeof(trace_ref_t) * nrefs);
+    f->weights = calloc(nedges ? nedges : 1, sizeof(uint64_t));
+    f->iter = calloc(g->nloops ? g->nloops : 1, sizeof(unsigned int));
+    f->cand = malloc(sizeof(int) * maxsucc);
+    if (!f->blocks || !f->runs || !f->weights || !f->iter || !f->cand) {
+        fetch_destroy(f);
+        return NULL;
+    }
+
+    nedges = 0;
+    for (int b = 0; b < g->nblocks; ++b) {
+        f->blocks[b].run = nruns;
+        f->blocks[b].nruns = block_runs(f, b, &nruns);
+        f->blocks[b].edge = nedges;
+        f->blocks[b].hloop = BB_NONE;
+        nedges += g->blocks[b].nsucc;
+    }
+    for (int l = 0; l < g->nloops; ++l)
+        f->blocks[g->loops[l].header].hloop = l;
+
+    /* splitmix64 of the seed, never 0 for xorshift */
+    f->rng = seed + 0x9e3779b97f4a7c15ULL;
+    f->rng = (f->rng ^ (f->rng >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    f->rng = (f->rng ^ (f->rng >> 27)) * 0x94d049bb133111ebULL;
+    f->rng ^= f->rng >> 31;
+    if (!f->rng)
+        f->rng = 1;
+    f->block = g->entry;
+    if (f->blocks[g->entry].hloop != BB_NONE)
+        f->iter[f->blocks[g->entry].hloop] = 1;
+
+    return f;
+}
+
+void fetch_destroy(fetchgen_t *f)
+{
+    if (!f)
+        return;
+
+    free(f->blocks);
+    free(f->runs);
+    free(f->weights);
+    free(f->iter);
+    free(f->cand);
+    free(f);
+}
+
+int fetch_weight(fetchgen_t *f, int from, int to, uint64_t weight)
+{
+    const bb_block_t *bb;
+    fetch_block_t *fb;
+
+    if (from < 0 || from >= f->g->nblocks)
+        return FAIL;
+    bb = &f->g->blocks[from];
+    fb = &f->blocks[from];
+    for (int k = 0; k < bb->nsucc; ++k) {
+        if (bb->succ[k] != to)
+            continue;
+        fb->wsum += weight - f->weights[fb->edge + k];
+        f->weights[fb->edge + k] = weight;
+        return SUCCEED;
+    }
+
+    return FAIL;
+}
+
+uint64_t fetch_walks(const fetchgen_t *f)
+{
+    return f->walks;
+}
+
+/*
+ * header executions a loop may have per entry, as block b sees it: with
+ * no bound, the profile of b decides when to leave, if it has one.
+ */
+static inline unsigned int cap(const fetchgen_t *f, int b, int l)
+{
+    if (f->g->loops[l].bound)
+        return f->g->loops[l].bound;
+
+    return f->blocks[b].wsum ? UINT_MAX : FETCH_BOUND;
+}
+
+/* whether b -> s goes back to the header of a loop of b */
+static inline int back_edge(const fetchgen_t *f, int b, int s)
+{
+    int l = f->blocks[s].hloop;
+
+    return l != BB_NONE && bb_loop_contains(f->g, l, b);
+}
+
+/* the successor of b, b having some */
+static int choose(fetchgen_t *f, int b)
+{
+    const bb_block_t *bb = &f->g->blocks[b];
+    const fetch_block_t *fb = &f->blocks[b];
+    int l = bb->loop, n = 0, leave, pick;
+    uint64_t sum = 0, r;
+
+    /* the successors not going round a loop past its bound */
+    for (int k = 0; k < bb->nsucc; ++k) {
+        int s = bb->succ[k];
+
+        if (!back_edge(f, b, s) ||
+            f->iter[f->blocks[s].hloop] < cap(f, b, f->blocks[s].hloop))
+            f->cand[n++] = k;
+    }
+    /* a loop with no way out goes on */
+    if (!n)
+        for (int k = 0; k < bb->nsucc; ++k)
+            f->cand[n++] = k;
+
+    if (fb->wsum) {
+        for (int i = 0; i < n; ++i)
+            sum += f->weights[fb->edge + f->cand[i]];
+        if (sum) {
+            r = xorshift(&f->rng) % sum;
+            for (pick = 0; r >= f->weights[fb->edge + f->cand[pick]];
+                 ++pick)
+                r -= f->weights[fb->edge + f->cand[pick]];
+            return bb->succ[f->cand[pick]];
+        }
+    }
+
+    /* in turn, staying in the loop up to its bound, then leaving it */
+    if (l != BB_NONE) {
+        int m = 0;
+
+        leave = f->iter[l] >= cap(f, b, l);
+        for (int i = 0; i < n; ++i)
+            if (bb_loop_contains(f->g, l, bb->succ[f->cand[i]]) != leave)
+                f->cand[m++] = f->cand[i];
+        if (m)
+            n = m;
+    }
+    pick = f->cand[f->blocks[b].turn++ % n];
+
+    return bb->succ[pick];
+}
+
+static void enter(fetchgen_t *f, int from, int s)
+{
+    int l = f->blocks[s].hloop;
+
+    if (l != BB_NONE) {
+        if (from != BB_NONE && back_edge(f, from, s))
+            f->iter[l]++;
+        else
+            f->iter[l] = 1;
+    }
+    f->block = s;
+    f->next = 0;
+}
+
+/* up to n references, ending early once walks walks are done, 0: never */
+static int fill(fetchgen_t *f, trace_ref_t *refs, int n, uint64_t walks)
+{
+    int got = 0;
+
+    while (got < n) {
+        const fetch_block_t *fb = &f->blocks[f->block];
+        int take = fb->nruns - f->next;
+
+        if (take > n - got)
+            take = n - got;
+        memcpy(refs + got, f->runs + fb->run + f->next,
+               sizeof(trace_ref_t) * take);
+        got += take;
+        f->next += take;
+        if (f->next < fb->nruns)
+            break;
+
+        if (f->g->blocks[f->block].nsucc) {
+            enter(f, f->block, choose(f, f->block));
+            continue;
+        }
+        f->walks++;
+        enter(f, BB_NONE, f->g->entry);
+        if (walks && f->walks >= walks)
+            break;
+    }
+
+    return got;
+}
+
+int fetch_next(fetchgen_t *f, trace_ref_t *refs, int n)
+{
+    return fill(f, refs, n, 0);
+}
+
+uint64_t fetch_simulate(fetchgen_t *f, sim_t *sim, uint64_t walks,
+                        uint64_t refs)
+{
+    trace_ref_t batch[TRACE_BATCH];
+    uint64_t done = 0, until = f->walks + walks;
+    int n;
+
+    if (!walks && !refs)
+        return 0;
+    while (!refs || done < refs) {
+        n = TRACE_BATCH;
+        if (refs && refs - done < (uint64_t)n)
+            n = refs - done;
+        n = fill(f, batch, n, refs ? 0 : until);
+        for (int i = 0; i < n; ++i)
+            sim_ref(sim, &batch[i]);
+        done += n;
+        if (!refs && f->walks >= until)
+            break;
+    }
+
+    return done;
+}
@@ -0,0 +1,179 @@
+/*
+ * @file fixpoint.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Priority worklist fixpoint solver.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "str.h"
+#include "fixpoint.h"
+
+typedef struct fp_heap {
+    int n;
+    int *keys;          /* solve order positions */
+    char *queued;       /* indexed by position */
+} fp_heap_t;
+
+static void heap_push(fp_heap_t *h, int key)
+{
+    int i;
+
+    if (h->queued[key])
+        return;
+
+    h->queued[key] = 1;
+    for (i = h->n++; i > 0 && h->keys[(i - 1) / 2] > key; i = (i - 1) / 2)
+        h->keys[i] = h->keys[(i - 1) / 2];
+    h->keys[i] = key;
+}
+
+static int heap_pop(fp_heap_t *h)
+{
+    int top = h->keys[0], last = h->keys[--h->n], i = 0;
+
+    while (2 * i + 1 < h->n) {
+        int c = 2 * i + 1;
+
+        if (c + 1 < h->n && h->keys[c + 1] < h->keys[c])
+            c++;
+        if (last <= h->keys[c])
+            break;
+        h->keys[i] = h->keys[c];
+        i = c;
+    }
+    h->keys[i] = last;
+    h->queued[top] = 0;
+
+    return top;
+}
+
+/*
+ * solve order: component first, then loop aware rpo inside it.
+ * a counting sort over the components keeps the rpo stable and needs
+ * no global state, several solvers may share one graph.
+ */
+static int solve_order(const bb_graph_t *g, int *order, int *pos)
+{
+    int *first = calloc(g->nsccs + 1, sizeof(int));
+
+    if (!first)
+        return FAIL;
+
+    for (int i = 0; i < g->nreach; ++i)
+        first[g->blocks[g->rpo[i]].scc + 1]++;
+    for (int c = 0; c < g->nsccs; ++c)
+        first[c + 1] += first[c];
+    for (int i = 0; i < g->nreach; ++i) {
+        int b = g->rpo[i];
+
+        order[first[g->blocks[b].scc]] = b;
+        pos[b] = first[g->blocks[b].scc]++;
+    }
+    free(first);
+
+    return SUCCEED;
+}
+
+static inline int same_state(const fp_domain_t *dom, fp_state_t a,
+                             fp_state_t b)
+{
+    if (a == b)
+        return 1;
+    if (a == FP_STATE_NONE || b == FP_STATE_NONE || !dom->equal)
+        return 0;
+    return dom->equal(dom->ctx, a, b);
+}
+
+int fp_solve(const bb_graph_t *g, const fp_domain_t *dom, fp_result_t *res)
+{
+    int *order = malloc(sizeof(int) * (g->nreach ? g->nreach : 1));
+    int *pos = malloc(sizeof(int) * g->nblocks);
+    fp_heap_t heap = {0};
+    int scc = 0;
+
+    memset(res, 0, sizeof(*res));
+    res->nblocks = g->nblocks;
+    res->in = malloc(sizeof(fp_state_t) * g->nblocks);
+    res->out = malloc(sizeof(fp_state_t) * g->nblocks);
+    heap.keys = malloc(sizeof(int) * (g->nreach ? g->nreach : 1));
+    heap.queued = calloc(g->nreach ? g->nreach : 1, 1);
+    if (!order || !pos || !res->in || !res->out || !heap.keys ||
+        !heap.queued || SUCCEED != solve_order(g, order, pos)) {
+        free(order);
+        free(pos);
+        free(heap.keys);
+        free(heap.queued);
+        fp_result_release(res);
+        return FAIL;
+    }
+
+    for (int i = 0; i < g->nblocks; ++i)
+        res->in[i] = res->out[i] = FP_STATE_NONE;
+
+    heap_push(&heap, pos[g->entry]);
+    while (heap.n) {
+        const bb_block_t *b = &g->blocks[order[heap_pop(&heap)]];
+        fp_state_t in = FP_STATE_NONE, out;
+
+        /* every component before this one is stable now */
+        for (; scc < b->scc; ++scc)
+            if (dom->scc_done)
+                dom->scc_done(dom->ctx, g, scc);
+
+        if (b->id == g->entry)
+            in = dom->entry(dom->ctx);
+        for (int p = 0; p < b->npred; ++p) {
+            int from = b->pred[p];
+            fp_state_t s = res->out[from];
+
+            if (s == FP_STATE_NONE)
+                continue;
+            if (dom->edge)
+                s = dom->edge(dom->ctx, g, from, b->id, s);
+            in = in == FP_STATE_NONE ? s : dom->join(dom->ctx, in, s);
+        }
+
+        if (in == FP_STATE_NONE)
+            continue;
+        if (res->out[b->id] != FP_STATE_NONE &&
+            same_state(dom, res->in[b->id], in))
+            continue;
+
+        res->in[b->id] = in;
+        out = dom->transfer(dom->ctx, g, b->id, in);
+        res->transfers++;
+        if (same_state(dom, res->out[b->id], out))
+            continue;
+
+        res->out[b->id] = out;
+        res->updates++;
+        for (int s = 0; s < b->nsucc; ++s)
+            heap_push(&heap, pos[b->succ[s]]);
+    }
+
+    for (; scc < g->nsccs; ++scc)
+        if (dom->scc_done)
+            dom->scc_done(dom->ctx, g, scc);
+
+    free(order);
+    free(pos);
+    free(heap.keys);
+    free(heap.queued);
+
+    return SUCCEED;
+}
+
+void fp_result_release(fp_result_t *res)
+{
+    free(res->in);
+    free(res->out);
+    res->in = res->out = NULL;
+}
@@ -0,0 +1,388 @@
+/*
+ * @file ipet.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Structural IPET solver over the loop nesting forest.
+ *
+ * A region is a loop, or the whole task for BB_NONE. Its nodes are the
+ * blocks whose innermost loop is the region and the headers of its child
+ * loops, which stand for the collapsed child. The loop aware RPO keeps
+ * every loop body contiguous behind its header, so walking the RPO range
+ * of a region visits its nodes in topological order.
+ *
+ * in[b] is the longest path from the region start to the entry of block
+ * b, sin[l] the same for the collapsed loop l in its parent region. the
+ * cost of leaving a region through block u then unrolls the loops from
+ * the innermost loop of u outwards, see leave().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "ipet.h"
+
+struct ipet {
+    const bb_graph_t *g;
+    uint64_t *bcost;            /* costs of the last solve */
+    uint64_t *lcost;
+    unsigned int *bound;
+    uint64_t *in;               /* per block */
+    int *bpred;                 /* per block, source of the best arrival */
+    uint64_t *sin;              /* per loop, in its parent region */
+    int *lpred;
+    uint64_t *cyc;              /* per loop, best cycle back to the header */
+    int *latch;
+    char *dirty;                /* per loop */
+    int solved;
+    int sink;
+};
+
+static inline uint64_t sat_add(uint64_t a, uint64_t b)
+{
+    uint64_t r;
+
+    if (a == IPET_NONE || b == IPET_NONE)
+        return IPET_NONE;
+    if (__builtin_add_overflow(a, b, &r) || r == IPET_NONE)
+        return IPET_NONE - 1;
+
+    return r;
+}
+
+static inline uint64_t sat_mul(uint64_t a, uint64_t b)
+{
+    uint64_t r;
+
+    if (__builtin_mul_overflow(a, b, &r) || r == IPET_NONE)
+        return IPET_NONE - 1;
+
+    return r;
+}
+
+/* the cost of the bound - 1 cycles of loop l, per entry */
+static uint64_t cycles(const ipet_t *p, int l)
+{
+    if (p->cyc[l] == IPET_NONE || p->g->loops[l].bound < 2)
+        return 0;
+
+    return sat_mul(p->cyc[l], p->g->loops[l].bound - 1);
+}
+
+/*
+ * longest path from the start of region r to the exit of block u, u in r
+ * or in one of its nested loops. the path of the innermost loop of u is
+ * wrapped by every loop up to r: reaching the loop in its parent, its
+ * entry cost and its cycles.
+ */
+static uint64_t leave(const ipet_t *p, int r, int u)
+{
+    const bb_graph_t *g = p->g;
+    uint64_t v = sat_add(p->in[u], p->bcost[u]);
+
+    for (int l = g->blocks[u].loop; l != r; l = g->loops[l].parent) {
+        uint64_t lc = p->lcost ? p->lcost[l] : 0;
+
+        v = sat_add(sat_add(p->sin[l], lc), sat_add(cycles(p, l), v));
+    }
+
+    return v;
+}
+
+static void solve_region(ipet_t *p, int r)
+{
+    const bb_graph_t *g = p->g;
+    int lo = 0, hi = g->nreach, start = g->entry;
+
+    if (r != BB_NONE) {
+        start = g->loops[r].header;
+        lo = g->blocks[start].rpo;
+        hi = lo + g->loops[r].nblocks;
+    }
+
+    for (int pos = lo; pos < hi; ++pos) {
+        int v = g->rpo[pos], l = g->blocks[v].loop;
+        uint64_t best = IPET_NONE, *in = &p->in[v];
+        int pred = BB_NONE, *ppred = &p->bpred[v];
+
+        if (l != r) {
+            /* only the header of a child loop is a node of r */
+            if (g->loops[l].header != v || g->loops[l].parent != r)
+                continue;
+            in = &p->sin[l];
+            ppred = &p->lpred[l];
+        }
+
+        if (v == start) {
+            best = 0;
+        } else {
+            for (int i = 0; i < g->blocks[v].npred; ++i) {
+                int u = g->blocks[v].pred[i];
+                uint64_t c;
+
+                /* dead code and back edges of the child loop */
+                if (g->blocks[u].rpo == BB_NONE ||
+                    (l != r && bb_loop_contains(g, l, u)))
+                    continue;
+                c = leave(p, r, u);
+                if (c != IPET_NONE && (best == IPET_NONE || c > best)) {
+                    best = c;
+                    pred = u;
+                }
+            }
+        }
+        *in = best;
+        *ppred = pred;
+    }
+
+    if (r == BB_NONE)
+        return;
+
+    p->cyc[r] = IPET_NONE;
+    p->latch[r] = BB_NONE;
+    for (int i = 0; i < g->blocks[start].npred; ++i) {
+        int u = g->blocks[start].pred[i];
+        uint64_t c;
+
+        if (!bb_loop_contains(g, r, u))
+            continue;
+        c = leave(p, r, u);
+        if (c != IPET_NONE && (p->cyc[r] == IPET_NONE || c > p->cyc[r])) {
+            p->cyc[r] = c;
+            p->latch[r] = u;
+        }
+    }
+}
+
+ipet_t *ipet_create(const bb_graph_t *g)
+{
+    ipet_t *p;
+    int ok = 1;
+
+    for (int l = 0; l < g->nloops; ++l) {
+        if (!g->loops[l].bound) {
+            LOG_ERR("loop at block %d has no bound", g->loops[l].header);
+            ok = 0;
+        }
+    }
+
+    /* a retreating edge that is no back edge means an irreducible cycle */
+    for (int i = 0; i < g->nreach; ++i) {
+        const bb_block_t *b = &g->blocks[g->rpo[i]];
+
+        for (int j = 0; j < b->nsucc; ++j) {
+            const bb_block_t *s = &g->blocks[b->succ[j]];
+
+            if (s->rpo > b->rpo)
+                continue;
+            if (s->loop == BB_NONE || g->loops[s->loop].header != s->id ||
+                !bb_loop_contains(g, s->loop, b->id)) {
+                LOG_ERR("irreducible edge %d -> %d", b->id, s->id);
+                ok = 0;
+            }
+        }
+    }
+    if (!ok)
+        return NULL;
+
+    p = calloc(1, sizeof(ipet_t));
+    if (!p)
+        return NULL;
+
+    p->g = g;
+    p->bcost = malloc(sizeof(uint64_t) * (g->nblocks + 1));
+    p->in = malloc(sizeof(uint64_t) * (g->nblocks + 1));
+    p->bpred = malloc(sizeof(int) * (g->nblocks + 1));
+    p->lcost = calloc(g->nloops + 1, sizeof(uint64_t));
+    p->bound = calloc(g->nloops + 1, sizeof(unsigned int));
+    p->sin = malloc(sizeof(uint64_t) * (g->nloops + 1));
+    p->lpred = malloc(sizeof(int) * (g->nloops + 1));
+    p->cyc = malloc(sizeof(uint64_t) * (g->nloops + 1));
+    p->latch = malloc(sizeof(int) * (g->nloops + 1));
+    p->dirty = malloc(g->nloops + 1);
+    p->sink = BB_NONE;
+    if (!p->bcost || !p->in || !p->bpred || !p->lcost || !p->bound ||
+        !p->sin || !p->lpred || !p->cyc || !p->latch || !p->dirty) {
+        ipet_destroy(p);
+        return NULL;
+    }
+
+    return p;
+}
+
+void ipet_destroy(ipet_t *p)
+{
+    if (!p)
+        return;
+
+    free(p->bcost);
+    free(p->lcost);
+    free(p->bound);
+    free(p->in);
+    free(p->bpred);
+    free(p->sin);
+    free(p->lpred);
+    free(p->cyc);
+    free(p->latch);
+    free(p->dirty);
+    free(p);
+}
+
+static void mark_dirty(ipet_t *p, int l)
+{
+    for (; l != BB_NONE && !p->dirty[l]; l = p->g->loops[l].parent)
+        p->dirty[l] = 1;
+}
+
+int ipet_solve(ipet_t *p, const uint64_t *block_cost,
+               const uint64_t *loop_cost, ipet_result_t *res)
+{
+    const bb_graph_t *g = p->g;
+    uint64_t best = IPET_NONE;
+
+    memset(p->dirty, !p->solved, g->nloops + 1);
+    if (p->solved) {
+        for (int b = 0; b < g->nblocks; ++b)
+            if (block_cost[b] != p->bcost[b])
+                mark_dirty(p, g->blocks[b].loop);
+        /* the entry cost and bound of a loop are used by its parent */
+        for (int l = 0; l < g->nloops; ++l)
+            if ((loop_cost ? loop_cost[l] : 0) != p->lcost[l] ||
+                g->loops[l].bound != p->bound[l])
+                mark_dirty(p, g->loops[l].parent);
+    }
+    memcpy(p->bcost, block_cost, sizeof(uint64_t) * g->nblocks);
+    for (int l = 0; l < g->nloops; ++l) {
+        p->lcost[l] = loop_cost ? loop_cost[l] : 0;
+        p->bound[l] = g->loops[l].bound;
+    }
+
+    /* children have larger indices, solve them first */
+    res->resolved = 0;
+    for (int l = g->nloops - 1; l >= 0; --l) {
+        if (!p->dirty[l])
+            continue;
+        solve_region(p, l);
+        res->resolved++;
+    }
+    solve_region(p, BB_NONE);
+
+    p->sink = BB_NONE;
+    for (int i = 0; i < g->nreach; ++i) {
+        int u = g->rpo[i];
+        uint64_t c;
+
+        if (g->blocks[u].nsucc)
+            continue;
+        c = leave(p, BB_NONE, u);
+        if (c != IPET_NONE && (best == IPET_NONE || c > best)) {
+            best = c;
+            p->sink = u;
+        }
+    }
+    p->solved = 1;
+
+    res->wcet = best;
+    res->sink = p->sink;
+    if (p->sink == BB_NONE) {
+        LOG_ERR("no reachable exit block");
+        return FAIL;
+    }
+
+    return SUCCEED;
+}
+
+/*
+ * add m to the counts of the path that leaves region r through block u.
+ * walks the predecessors back to the region start and, for every loop
+ * crossed, its exit path and its cycles.
+ */
+static void trace_leave(const ipet_t *p, int r, int u, uint64_t m,
+                        uint64_t *count)
+{
+    const bb_graph_t *g = p->g;
+
+    while (u != BB_NONE) {
+        int l = g->blocks[u].loop;
+
+        if (l == r) {
+            count[u] = sat_add(count[u], m);
+            u = p->bpred[u];
+            continue;
+        }
+
+        /* the child of r the path leaves through u */
+        while (g->loops[l].parent != r)
+            l = g->loops[l].parent;
+        trace_leave(p, l, u, m, count);
+        if (g->loops[l].bound > 1 && p->latch[l] != BB_NONE)
+            trace_leave(p, l, p->latch[l],
+                        sat_mul(m, g->loops[l].bound - 1), count);
+        u = p->lpred[l];
+    }
+}
+
+void ipet_counts(const ipet_t *p, uint64_t *count)
+{
+    memset(count, 0, sizeof(uint64_t) * p->g->nblocks);
+    if (p->sink != BB_NONE)
+        trace_leave(p, BB_NONE, p->sink, 1, count);
+}
+
+/*
+ * worst latency of access i from level l down, first misses counted as
+ * misses.
+ */
+static uint64_t served_below(const ca_level_t *levels, int nlevels,
+                             const unsigned int *latency, int i, int l)
+{
+    for (; l < nlevels; ++l)
+        if (levels[l].res.chmc[i] == CHMC_hit)
+            return latency[l];
+
+    return latency[nlevels];
+}
+
+void ipet_cache_costs(const bb_graph_t *g, const ca_level_t *levels,
+                      int nlevels, const unsigned int *latency,
+                      uint64_t *block_cost, uint64_t *loop_cost)
+{
+    const ca_result_t *top = &levels[0].res;
+
+    memset(block_cost, 0, sizeof(uint64_t) * g->nblocks);
+    memset(loop_cost, 0, sizeof(uint64_t) * g->nloops);
+
+    for (int i = 0; i < top->naccesses; ++i) {
+        uint64_t c = latency[nlevels];
+        int b = top->acc[i].block;
+
+        for (int l = 0; l < nlevels; ++l) {
+            const ca_result_t *res = &levels[l].res;
+
+            if (res->chmc[i] == CHMC_unknown) {
+                /* dead code, never executed */
+                c = 0;
+                break;
+            }
+            if (res->chmc[i] == CHMC_hit) {
+                c = latency[l];
+                break;
+            }
+            if (res->chmc[i] == CHMC_first_miss) {
+                uint64_t miss = served_below(levels, nlevels, latency, i,
+                                             l + 1);
+
+                c = latency[l];
+                if (res->scope[i] != BB_NONE && miss > c)
+                    loop_cost[res->scope[i]] += miss - c;
+                break;
+            }
+        }
+        block_cost[b] += c;
+    }
+}
@@ -0,0 +1,337 @@
+/*
+ * @file reuse.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Reuse distance histogram, see reuse.h.
+ *
+ * Time t is node t + 1 of the Fenwick tree, which holds 1 at the last
+ * access time of every line seen. The distance of an access to a line
+ * last touched at p is the number of marks after p, live - prefix(p).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "reuse.h"
+
+#define REUSE_INIT          1024
+#define REUSE_NONE          UINT64_MAX
+
+struct reuse {
+    unsigned int lineshift;
+    reuse_hist_t hist;
+
+    /* line + 1 -> last access time, open addressing */
+    uint64_t *keys;
+    uint32_t *times;
+    uint64_t cap;
+    uint64_t live;              /* lines seen, marks in the tree */
+
+    uint32_t *tree;             /* tcap + 1 nodes */
+    uint64_t *line_of;          /* line of a marked time, else REUSE_NONE */
+    uint64_t tcap;
+    uint64_t now;
+};
+
+static inline uint64_t hash_line(uint64_t line, uint64_t cap)
+{
+    return (line * 0x9e3779b97f4a7c15ULL) >> 32 & (cap - 1);
+}
+
+static uint64_t find_slot(const reuse_t *r, uint64_t line)
+{
+    uint64_t i = hash_line(line, r->cap);
+
+    while (r->keys[i] && r->keys[i] != line + 1)
+        i = (i + 1) & (r->cap - 1);
+
+    return i;
+}
+
+static int grow_map(reuse_t *r)
+{
+    uint64_t *keys = r->keys, cap = r->cap;
+    uint32_t *times = r->times;
+
+    r->cap = cap * 2;
+    r->keys = calloc(r->cap, sizeof(uint64_t));
+    r->times = malloc(r->cap * sizeof(uint32_t));
+    if (!r->keys || !r->times) {
+        free(r->keys);
+        free(r->times);
+        r->keys = keys;
+        r->times = times;
+        r->cap = cap;
+        return FAIL;
+    }
+
+    for (uint64_t i = 0; i < cap; ++i) {
+        uint64_t j;
+
+        if (!keys[i])
+            continue;
+        j = find_slot(r, keys[i] - 1);
+        r->keys[j] = keys[i];
+        r->times[j] = times[i];
+    }
+    free(keys);
+    free(times);
+
+    return SUCCEED;
+}
+
+static inline void tree_add(reuse_t *r, uint64_t t, int v)
+{
+    for (uint64_t i = t + 1; i <= r->tcap; i += i & -i)
+        r->tree[i] += v;
+}
+
+/* marks at times up to t */
+static inline uint64_t tree_prefix(const reuse_t *r, uint64_t t)
+{
+    uint64_t sum = 0;
+
+    for (uint64_t i = t + 1; i; i -= i & -i)
+        sum += r->tree[i];
+
+    return sum;
+}
+
+/* renumber the marked times 0..live - 1, in order */
+static int compact(reuse_t *r)
+{
+    uint64_t tcap = 2 * (r->live + 1) > REUSE_INIT ?
+                    2 * (r->live + 1) : REUSE_INIT, k = 0;
+    uint64_t *line_of = malloc(tcap * sizeof(uint64_t));
+    uint32_t *tree = malloc((tcap + 1) * sizeof(uint32_t));
+
+    if (!line_of || !tree || tcap > UINT32_MAX) {
+        free(line_of);
+        free(tree);
+        return FAIL;
+    }
+
+    for (uint64_t t = 0; t < r->now; ++t) {
+        if (r->line_of[t] == REUSE_NONE)
+            continue;
+        r->times[find_slot(r, r->line_of[t])] = k;
+        line_of[k++] = r->line_of[t];
+    }
+    for (uint64_t t = k; t < tcap; ++t)
+        line_of[t] = REUSE_NONE;
+    /* a tree of k ones */
+    tree[0] = 0;
+    for (uint64_t i = 1; i <= tcap; ++i)
+        tree[i] = i <= k ? (i & -i) : 0;
+    for (uint64_t i = k + 1; i <= tcap; ++i) {
+        uint64_t lo = i - (i & -i);
+
+        if (lo < k)
+            tree[i] = k - lo;
+    }
+
+    free(r->line_of);
+    free(r->tree);
+    r->line_of = line_of;
+    r->tree = tree;
+    r->tcap = tcap;
+    r->now = k;
+
+    return SUCCEED;
+}
+
+reuse_t *reuse_create(unsigned int linesize)
+{
+    reuse_t *r = calloc(1, sizeof(reuse_t));
+
+    if (!r)
+        return NULL;
+
+    r->lineshift = linesize ? __builtin_ctz(linesize) : 0;
+    r->cap = REUSE_INIT;
+    r->keys = calloc(r->cap, sizeof(uint64_t));
+    r->times = malloc(r->cap * sizeof(uint32_t));
+    if (!r->keys || !r->times || SUCCEED != compact(r)) {
+        reuse_destroy(r);
+        return NULL;
+    }
+
+    return r;
+}
+
+void reuse_destroy(reuse_t *r)
+{
+    if (!r)
+        return;
+
+    free(r->keys);
+    free(r->times);
+    free(r->tree);
+    free(r->line_of);
+    free(r);
+}
+
+int reuse_bin(uint64_t distance)
+{
+    int o;
+
+    if (distance < REUSE_SUBBINS)
+        return distance;
+    o = 63 - __builtin_clzll(distance);
+
+    return REUSE_SUBBINS * (o - 2) +
+           ((distance >> (o - 3)) & (REUSE_SUBBINS - 1));
+}
+
+uint64_t reuse_bin_lower(int bin)
+{
+    if (bin < REUSE_SUBBINS)
+        return bin;
+
+    return (uint64_t)(REUSE_SUBBINS + bin % REUSE_SUBBINS) <<
+           (bin / REUSE_SUBBINS - 1);
+}
+
+uint64_t reuse_access(reuse_t *r, uint64_t line)
+{
+    uint64_t slot, d = REUSE_COLD, p;
+
+    /* lines take half the map at most, times all of the tree */
+    if (2 * (r->live + 1) > r->cap && SUCCEED != grow_map(r))
+        return REUSE_COLD;
+    if (r->now == r->tcap && SUCCEED != compact(r))
+        return REUSE_COLD;
+
+    slot = find_slot(r, line);
+    if (r->keys[slot]) {
+        p = r->times[slot];
+        d = r->live - tree_prefix(r, p);
+        tree_add(r, p, -1);
+        r->line_of[p] = REUSE_NONE;
+        r->hist.bins[reuse_bin(d)]++;
+    } else {
+        r->keys[slot] = line + 1;
+        r->live++;
+        r->hist.cold++;
+    }
+    r->times[slot] = r->now;
+    r->line_of[r->now] = line;
+    tree_add(r, r->now++, 1);
+    r->hist.refs++;
+
+    return d;
+}
+
+void reuse_forget(reuse_t *r, uint64_t line)
+{
+    uint64_t mask = r->cap - 1, i = find_slot(r, line), j = i, h;
+
+    if (!r->keys[i])
+        return;
+    tree_add(r, r->times[i], -1);
+    r->line_of[r->times[i]] = REUSE_NONE;
+    r->live--;
+
+    /* backward shift, j may fill the hole unless its home is in (i, j] */
+    for (;;) {
+        j = (j + 1) & mask;
+        if (!r->keys[j])
+            break;
+        h = hash_line(r->keys[j] - 1, r->cap);
+        if (j > i ? (h <= i || h > j) : (h <= i && h > j)) {
+            r->keys[i] = r->keys[j];
+            r->times[i] = r->times[j];
+            i = j;
+        }
+    }
+    r->keys[i] = 0;
+}
+
+void reuse_ref(reuse_t *r, const trace_ref_t *ref)
+{
+    uint64_t line = ref->addr >> r->lineshift;
+    uint64_t last = (ref->addr + (ref->size ? ref->size - 1 : 0)) >>
+                    r->lineshift;
+
+    for (; line <= last; ++line)
+        reuse_access(r, line);
+}
+
+int reuse_run(reuse_t *r, const char *trace)
+{
+    trace_reader_t *reader = trace_open(trace);
+    const trace_batch_t *b;
+    trace_stream_t *s;
+    uint32_t n;
+
+    if (!reader)
+        return FAIL;
+    if (!(s = trace_stream_start(reader))) {
+        trace_close(reader);
+        return FAIL;
+    }
+
+    while ((b = trace_stream_next(s, &n))) {
+        for (uint32_t i = 0; i < n; ++i)
+            reuse_ref(r, &b->refs[i]);
+        trace_stream_release(s);
+    }
+
+    return trace_stream_stop(s);
+}
+
+const reuse_hist_t *reuse_hist(const reuse_t *r)
+{
+    return &r->hist;
+}
+
+double reuse_miss_ratio(const reuse_hist_t *h, uint64_t lines)
+{
+    double misses = h->cold;
+
+    if (!h->refs)
+        return 0.0;
+
+    for (int b = REUSE_BINS - 1; b >= 0; --b) {
+        uint64_t lo = reuse_bin_lower(b);
+        uint64_t hi = b + 1 < REUSE_BINS ? reuse_bin_lower(b + 1) : UINT64_MAX;
+
+        if (lo >= lines) {
+            misses += h->bins[b];
+        } else {
+            if (hi > lines)
+                misses += (double)h->bins[b] * (hi - lines) / (hi - lo);
+            break;
+        }
+    }
+
+    return misses / h->refs;
+}
+
+void reuse_report(const reuse_hist_t *h, unsigned int linesize, FILE *out)
+{
+    int last = -1;
+
+    for (int b = 0; b < REUSE_BINS; ++b)
+        if (h->bins[b])
+            last = b;
+
+    fprintf(out, "line accesses: %llu, cold: %llu\n",
+            (unsigned long long)h->refs, (unsigned long long)h->cold);
+    fprintf(out, "# distance histogram: lines count\n");
+    for (int b = 0; b <= last; ++b)
+        if (h->bins[b])
+            fprintf(out, "%llu %llu\n", (unsigned long long)reuse_bin_lower(b),
+                    (unsigned long long)h->bins[b]);
+
+    fprintf(out, "# miss ratio curve: bytes miss_ratio\n");
+    for (int b = 1; b <= last + 1 && b < REUSE_BINS; ++b)
+        fprintf(out, "%llu %.6f\n",
+                (unsigned long long)reuse_bin_lower(b) * linesize,
+                reuse_miss_ratio(h, reuse_bin_lower(b)));
+}
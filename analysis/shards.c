@@ -0,0 +1,204 @@
+/*
+ * @file shards.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Fixed size SHARDS, see shards.h. The sampled lines sit in a max heap
+ * by hash, its top is the next to leave when the sample is full.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "shards.h"
+
+typedef struct sample {
+    uint64_t hash;
+    uint64_t line;
+} sample_t;
+
+struct shards {
+    unsigned int lineshift;
+    reuse_t *r;                 /* distances among the sampled lines */
+    uint64_t threshold;         /* sampled: hash < threshold */
+    double rate;
+
+    sample_t *heap;
+    uint64_t n;
+    uint64_t max_lines;
+
+    uint64_t refs;              /* all line accesses */
+    double sampled;             /* sampled accesses, at the rate now */
+    double cold;
+    double bins[REUSE_BINS];
+};
+
+/* splitmix64 finalizer */
+static inline uint64_t hash_line(uint64_t line)
+{
+    line += 0x9e3779b97f4a7c15ULL;
+    line = (line ^ (line >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    line = (line ^ (line >> 27)) * 0x94d049bb133111ebULL;
+
+    return line ^ (line >> 31);
+}
+
+static void heap_push(shards_t *s, uint64_t hash, uint64_t line)
+{
+    uint64_t i = s->n++;
+
+    while (i && s->heap[(i - 1) / 2].hash < hash) {
+        s->heap[i] = s->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    s->heap[i].hash = hash;
+    s->heap[i].line = line;
+}
+
+static void heap_pop(shards_t *s)
+{
+    sample_t last = s->heap[--s->n];
+    uint64_t i = 0, c;
+
+    while ((c = 2 * i + 1) < s->n) {
+        if (c + 1 < s->n && s->heap[c + 1].hash > s->heap[c].hash)
+            c++;
+        if (s->heap[c].hash <= last.hash)
+            break;
+        s->heap[i] = s->heap[c];
+        i = c;
+    }
+    s->heap[i] = last;
+}
+
+/* drop the largest hashes, the counts so far follow the lower rate */
+static void lower_rate(shards_t *s)
+{
+    uint64_t threshold = s->heap[0].hash;
+    double scale;
+
+    while (s->n && s->heap[0].hash >= threshold) {
+        reuse_forget(s->r, s->heap[0].line);
+        heap_pop(s);
+    }
+
+    scale = (double)threshold / s->threshold;
+    s->threshold = threshold;
+    s->rate = threshold / 18446744073709551616.0;
+    s->sampled *= scale;
+    s->cold *= scale;
+    for (int b = 0; b < REUSE_BINS; ++b)
+        s->bins[b] *= scale;
+}
+
+shards_t *shards_create(unsigned int linesize, uint64_t max_lines)
+{
+    shards_t *s = calloc(1, sizeof(shards_t));
+
+    if (!s)
+        return NULL;
+
+    s->lineshift = linesize ? __builtin_ctz(linesize) : 0;
+    s->threshold = UINT64_MAX;
+    s->rate = 1.0;
+    s->max_lines = max_lines ? max_lines : 1;
+    s->heap = malloc(sizeof(sample_t) * (s->max_lines + 1));
+    s->r = reuse_create(linesize);
+    if (!s->heap || !s->r) {
+        shards_destroy(s);
+        return NULL;
+    }
+
+    return s;
+}
+
+void shards_destroy(shards_t *s)
+{
+    if (!s)
+        return;
+
+    reuse_destroy(s->r);
+    free(s->heap);
+    free(s);
+}
+
+void shards_access(shards_t *s, uint64_t line)
+{
+    uint64_t hash = hash_line(line), d;
+
+    s->refs++;
+    if (hash >= s->threshold)
+        return;
+
+    s->sampled += 1;
+    d = reuse_access(s->r, line);
+    if (d != REUSE_COLD) {
+        s->bins[reuse_bin(d / s->rate)] += 1;
+        return;
+    }
+
+    s->cold += 1;
+    heap_push(s, hash, line);
+    if (s->n > s->max_lines)
+        lower_rate(s);
+}
+
+void shards_ref(shards_t *s, const trace_ref_t *ref)
+{
+    uint64_t line = ref->addr >> s->lineshift;
+    uint64_t last = (ref->addr + (ref->size ? ref->size - 1 : 0)) >>
+                    s->lineshift;
+
+    for (; line <= last; ++line)
+        shards_access(s, line);
+}
+
+int shards_run(shards_t *s, const char *trace)
+{
+    trace_reader_t *reader = trace_open(trace);
+    const trace_batch_t *b;
+    trace_stream_t *stream;
+    uint32_t n;
+
+    if (!reader)
+        return FAIL;
+    if (!(stream = trace_stream_start(reader))) {
+        trace_close(reader);
+        return FAIL;
+    }
+
+    while ((b = trace_stream_next(stream, &n))) {
+        for (uint32_t i = 0; i < n; ++i)
+            shards_ref(s, &b->refs[i]);
+        trace_stream_release(stream);
+    }
+
+    return trace_stream_stop(stream);
+}
+
+double shards_rate(const shards_t *s)
+{
+    return s->rate;
+}
+
+void shards_hist(const shards_t *s, reuse_hist_t *h)
+{
+    /*
+     * SHARDS_adj: the gap between the expected and the sampled accesses
+     * goes to the shortest distances, so the curve starts at 1
+     */
+    double adjust = s->refs * s->rate - s->sampled, bin;
+
+    memset(h, 0, sizeof(*h));
+    h->refs = s->refs;
+    h->cold = s->cold / s->rate + 0.5;
+    for (int b = 0; b < REUSE_BINS; ++b) {
+        bin = s->bins[b] + adjust;
+        adjust = bin < 0 ? bin : 0;
+        h->bins[b] = bin > 0 ? bin / s->rate + 0.5 : 0;
+    }
+}
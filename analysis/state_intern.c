@@ -0,0 +1,331 @@
+/*
+ * @file state_intern.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Hash consing table and memo table, both open addressing with linear
+ * probing kept at most half full.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "str.h"
+#include "state_intern.h"
+
+#define SI_CHUNK_SIZE       (256 * 1024)
+#define SI_MIN_SLOTS        1024
+#define SI_MEMO_EMPTY       (~(uint64_t)0)
+
+typedef struct si_entry {
+    uint32_t n;
+    uint32_t hash;
+    uint64_t w[];
+} si_entry_t;
+
+typedef struct si_chunk {
+    struct si_chunk *next;
+    size_t used;
+    size_t size;
+    char data[];
+} si_chunk_t;
+
+struct si_table {
+    si_entry_t **entries;       /* id -> state */
+    uint32_t count;
+    uint32_t cap;
+    uint32_t *slots;            /* ids, FP_STATE_NONE when empty */
+    uint32_t mask;
+    si_chunk_t *chunks;
+    size_t bytes;
+};
+
+typedef struct si_memo_slot {
+    uint64_t key;
+    fp_state_t val;
+} si_memo_slot_t;
+
+struct si_memo {
+    si_memo_slot_t *slot;
+    uint32_t mask;
+    uint32_t count;
+};
+
+static inline uint32_t hash_words(const uint64_t *w, unsigned int n)
+{
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ n;
+
+    for (unsigned int i = 0; i < n; ++i) {
+        h = (h ^ w[i]) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 32;
+    }
+
+    return (uint32_t)(h ^ (h >> 29));
+}
+
+static inline uint32_t hash_key(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+
+    return (uint32_t)key;
+}
+
+si_table_t *si_table_create(void)
+{
+    si_table_t *t = calloc(1, sizeof(si_table_t));
+
+    if (!t)
+        return NULL;
+
+    t->slots = malloc(sizeof(uint32_t) * SI_MIN_SLOTS);
+    if (!t->slots) {
+        free(t);
+        return NULL;
+    }
+    memset(t->slots, 0xff, sizeof(uint32_t) * SI_MIN_SLOTS);
+    t->mask = SI_MIN_SLOTS - 1;
+
+    return t;
+}
+
+void si_table_destroy(si_table_t *t)
+{
+    if (!t)
+        return;
+
+    while (t->chunks) {
+        si_chunk_t *next = t->chunks->next;
+
+        free(t->chunks);
+        t->chunks = next;
+    }
+    free(t->entries);
+    free(t->slots);
+    free(t);
+}
+
+void si_table_reset(si_table_t *t)
+{
+    si_chunk_t *c = t->chunks, *next;
+
+    /* keep the newest chunk around for the next run */
+    if (c) {
+        for (next = c->next; next; next = c->next) {
+            c->next = next->next;
+            free(next);
+        }
+        c->used = 0;
+    }
+    if (t->count)
+        memset(t->slots, 0xff, sizeof(uint32_t) * (t->mask + 1));
+    t->count = 0;
+    t->bytes = 0;
+}
+
+static void *chunk_alloc(si_table_t *t, size_t size)
+{
+    si_chunk_t *c = t->chunks;
+    void *p;
+
+    size = (size + 7) & ~(size_t)7;
+    if (!c || c->used + size > c->size) {
+        size_t csize = size > SI_CHUNK_SIZE ? size : SI_CHUNK_SIZE;
+
+        c = malloc(sizeof(si_chunk_t) + csize);
+        if (!c)
+            return NULL;
+        c->next = t->chunks;
+        c->used = 0;
+        c->size = csize;
+        t->chunks = c;
+    }
+    p = c->data + c->used;
+    c->used += size;
+    t->bytes += size;
+
+    return p;
+}
+
+static int table_grow(si_table_t *t)
+{
+    uint32_t nslots = (t->mask + 1) * 2;
+    uint32_t *slots = malloc(sizeof(uint32_t) * nslots);
+
+    if (!slots)
+        return FAIL;
+
+    memset(slots, 0xff, sizeof(uint32_t) * nslots);
+    for (uint32_t id = 0; id < t->count; ++id) {
+        uint32_t i = t->entries[id]->hash & (nslots - 1);
+
+        while (slots[i] != FP_STATE_NONE)
+            i = (i + 1) & (nslots - 1);
+        slots[i] = id;
+    }
+    free(t->slots);
+    t->slots = slots;
+    t->mask = nslots - 1;
+
+    return SUCCEED;
+}
+
+fp_state_t si_intern(si_table_t *t, const uint64_t *w, unsigned int n)
+{
+    uint32_t h = hash_words(w, n), i;
+    si_entry_t *e;
+
+    for (i = h & t->mask; t->slots[i] != FP_STATE_NONE; i = (i + 1) & t->mask) {
+        e = t->entries[t->slots[i]];
+        if (e->hash == h && e->n == n &&
+            (!n || !memcmp(e->w, w, sizeof(uint64_t) * n)))
+            return t->slots[i];
+    }
+
+    if (t->count == t->cap) {
+        uint32_t cap = t->cap ? t->cap * 2 : SI_MIN_SLOTS;
+        si_entry_t **tmp = realloc(t->entries, sizeof(si_entry_t *) * cap);
+
+        if (!tmp)
+            return FP_STATE_NONE;
+        t->entries = tmp;
+        t->cap = cap;
+    }
+
+    e = chunk_alloc(t, sizeof(si_entry_t) + sizeof(uint64_t) * n);
+    if (!e)
+        return FP_STATE_NONE;
+    e->n = n;
+    e->hash = h;
+    if (n)
+        memcpy(e->w, w, sizeof(uint64_t) * n);
+
+    t->slots[i] = t->count;
+    t->entries[t->count] = e;
+    if (++t->count * 2 > t->mask + 1 && SUCCEED != table_grow(t))
+        return FP_STATE_NONE;
+
+    return t->count - 1;
+}
+
+const uint64_t *si_state(const si_table_t *t, fp_state_t id, unsigned int *n)
+{
+    *n = t->entries[id]->n;
+
+    return t->entries[id]->w;
+}
+
+unsigned long si_table_count(const si_table_t *t)
+{
+    return t->count;
+}
+
+size_t si_table_bytes(const si_table_t *t)
+{
+    return t->bytes + sizeof(si_entry_t *) * t->cap +
+           sizeof(uint32_t) * (t->mask + 1);
+}
+
+si_memo_t *si_memo_create(void)
+{
+    si_memo_t *m = calloc(1, sizeof(si_memo_t));
+
+    if (!m)
+        return NULL;
+
+    m->slot = malloc(sizeof(si_memo_slot_t) * SI_MIN_SLOTS);
+    if (!m->slot) {
+        free(m);
+        return NULL;
+    }
+    m->mask = SI_MIN_SLOTS - 1;
+    for (uint32_t i = 0; i <= m->mask; ++i)
+        m->slot[i].key = SI_MEMO_EMPTY;
+
+    return m;
+}
+
+void si_memo_destroy(si_memo_t *m)
+{
+    if (!m)
+        return;
+
+    free(m->slot);
+    free(m);
+}
+
+void si_memo_reset(si_memo_t *m)
+{
+    if (!m->count)
+        return;
+
+    for (uint32_t i = 0; i <= m->mask; ++i)
+        m->slot[i].key = SI_MEMO_EMPTY;
+    m->count = 0;
+}
+
+fp_state_t si_memo_get(const si_memo_t *m, uint32_t a, uint32_t b)
+{
+    uint64_t key = (uint64_t)a << 32 | b;
+
+    for (uint32_t i = hash_key(key) & m->mask; m->slot[i].key != SI_MEMO_EMPTY;
+         i = (i + 1) & m->mask)
+        if (m->slot[i].key == key)
+            return m->slot[i].val;
+
+    return FP_STATE_NONE;
+}
+
+static int memo_grow(si_memo_t *m)
+{
+    uint32_t nslots = (m->mask + 1) * 2;
+    si_memo_slot_t *slot = malloc(sizeof(si_memo_slot_t) * nslots);
+
+    if (!slot)
+        return FAIL;
+
+    for (uint32_t i = 0; i < nslots; ++i)
+        slot[i].key = SI_MEMO_EMPTY;
+    for (uint32_t i = 0; i <= m->mask; ++i) {
+        uint32_t j;
+
+        if (m->slot[i].key == SI_MEMO_EMPTY)
+            continue;
+        for (j = hash_key(m->slot[i].key) & (nslots - 1);
+             slot[j].key != SI_MEMO_EMPTY; j = (j + 1) & (nslots - 1))
+            ;
+        slot[j] = m->slot[i];
+    }
+    free(m->slot);
+    m->slot = slot;
+    m->mask = nslots - 1;
+
+    return SUCCEED;
+}
+
+int si_memo_put(si_memo_t *m, uint32_t a, uint32_t b, fp_state_t v)
+{
+    uint64_t key = (uint64_t)a << 32 | b;
+    uint32_t i;
+
+    if ((m->count + 1) * 2 > m->mask + 1 && SUCCEED != memo_grow(m))
+        return FAIL;
+
+    for (i = hash_key(key) & m->mask; m->slot[i].key != SI_MEMO_EMPTY;
+         i = (i + 1) & m->mask) {
+        if (m->slot[i].key == key) {
+            m->slot[i].val = v;
+            return SUCCEED;
+        }
+    }
+    m->slot[i].key = key;
+    m->slot[i].val = v;
+    m->count++;
+
+    return SUCCEED;
+}
@@ -0,0 +1,435 @@
+/*
+ * @file bench.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Throughput of the simulation engine: sim_access() over synthetic line
+ * streams, for every replacement policy, hierarchy and a few geometries.
+ *
+ * Every case runs warm-up rounds, then timed rounds of the same stream on
+ * the warm caches, and reports ns per access: min, median, mean and the
+ * standard deviation over the timed rounds. The streams come from the
+ * trace generator (tracegen.h) before the clock starts, except
+ * pointer-chase, whose next line is a load from a random cycle so the
+ * accesses depend on each other.
+ *
+ * usage: bench [-n accesses] [-r rounds] [-w warm-up rounds] [-s]
+ *              [-f filter] [-o results] [-b baseline [-t percent]]
+ * -s keeps the counters of stats.h, for their overhead, and adds /stats
+ * to the labels. -f runs the cases whose label holds the filter, -o saves
+ * the medians and -b compares them with a saved run: a case slower by
+ * more than -t percent (10 by default) is a regression, and the exit
+ * status is 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "str.h"
+#include "cfg.h"
+#include "list.h"
+#include "arena.h"
+#include "simulat.h"
+#include "stats.h"
+#include "tracegen.h"
+
+#define LINESIZE            64
+#define MAX_LEVELS          3
+#define MAX_ROUNDS          100
+#define LABEL_LEN           96
+
+typedef enum pattern {
+    P_sequential = 0,
+    P_strided,
+    P_uniform,
+    P_zipf,
+    P_stencil,
+    P_matmul,
+    P_hash,
+    P_chase,
+    PATTERNS,
+} pattern_t;
+
+static const char *pattern_names[PATTERNS] = {
+    "sequential", "strided", "uniform", "zipf", "stencil", "matmul", "hash",
+    "chase",
+};
+
+static const char *policy_names[] = {
+    [CP_random] = "random", [CP_lru] = "lru", [CP_fifo] = "fifo",
+    [CP_lifo] = "lifo", [CP_tlru] = "tlru", [CP_mru] = "mru",
+};
+
+static const char *hierarchy_names[] = {
+    [H_inclusive] = "inclusive", [H_exclusive] = "exclusive",
+    [H_non_exclusive] = "non-inclusive",
+};
+
+typedef struct geometry {
+    const char *name;
+    int levels;
+    uint64_t size[MAX_LEVELS];
+    unsigned int ways[MAX_LEVELS];
+} geometry_t;
+
+static const geometry_t geometries[] = {
+    { "L1",          1, { 32 << 10 },                      { 8 } },
+    { "L1+L2",       2, { 32 << 10, 1 << 20 },             { 8, 16 } },
+    { "L1+L2+L3",    3, { 48 << 10, 1280 << 10, 32 << 20 }, { 12, 20, 16 } },
+};
+
+typedef struct result {
+    char label[LABEL_LEN];
+    double median;
+} result_t;
+
+static uint64_t xorshift(uint64_t *x)
+{
+    *x ^= *x << 13;
+    *x ^= *x >> 7;
+    *x ^= *x << 17;
+
+    return *x;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* the generator stream of a pattern over footprint lines */
+static void pattern_spec(pattern_t p, uint64_t footprint, gen_spec_t *sp)
+{
+    uint64_t bytes = footprint * LINESIZE;
+
+    switch (p) {
+    case P_sequential:
+    case P_strided:
+        gen_spec_init(sp, GEN_strided, 0);
+        sp->n = footprint;
+        sp->elem = LINESIZE;
+        /* 17 lines, every set is visited, unlike a power of two */
+        sp->stride = p == P_strided ? 17 : 1;
+        break;
+    case P_uniform:
+        gen_spec_init(sp, GEN_hash, 0);
+        sp->n = footprint;
+        sp->elem = LINESIZE;
+        sp->probes = 1;
+        break;
+    case P_zipf:
+        /* s = 0.99, the ranks scattered over the footprint */
+        gen_spec_init(sp, GEN_zipf, 0);
+        sp->n = footprint;
+        sp->elem = LINESIZE;
+        break;
+    case P_stencil:
+        /* two grids of doubles */
+        gen_spec_init(sp, GEN_stencil, 0);
+        sp->n = sqrt(bytes / 16);
+        break;
+    case P_matmul:
+        /* three matrices of doubles, 32 x 32 tiles */
+        gen_spec_init(sp, GEN_matmul, 0);
+        sp->n = sqrt(bytes / 24);
+        break;
+    default:
+        /* 16 byte buckets, up to 4 probes */
+        gen_spec_init(sp, GEN_hash, 0);
+        sp->n = bytes / 16;
+        break;
+    }
+    /* the stores of the patterns that have none of their own */
+    sp->writes = 12;
+}
+
+/*
+ * the line stream of a pattern over footprint lines (a power of two),
+ * line << 1 | 1 for a write. for P_chase, lines is the cycle: next line
+ * of l is lines[l].
+ */
+static uint64_t *make_stream(pattern_t p, uint64_t n, uint64_t footprint)
+{
+    uint64_t len = p == P_chase ? footprint : n, x = 88172645463325252ULL;
+    uint64_t *lines = malloc(sizeof(uint64_t) * len);
+    trace_ref_t refs[TRACE_BATCH];
+    gen_spec_t spec;
+    gen_t *gen;
+    int got;
+
+    if (!lines)
+        return NULL;
+
+    if (p == P_chase) {
+        /* one random cycle through every line, Sattolo's shuffle */
+        for (uint64_t i = 0; i < footprint; ++i)
+            lines[i] = i;
+        for (uint64_t i = footprint - 1; i > 0; --i) {
+            uint64_t j = xorshift(&x) % i, t = lines[i];
+
+            lines[i] = lines[j];
+            lines[j] = t;
+        }
+        return lines;
+    }
+
+    pattern_spec(p, footprint, &spec);
+    if (!(gen = gen_create(&spec, 1, 1, n))) {
+        free(lines);
+        return NULL;
+    }
+    for (uint64_t i = 0; (got = gen_next(gen, refs, TRACE_BATCH)); )
+        for (int k = 0; k < got; ++k)
+            lines[i++] = refs[k].addr / LINESIZE << 1 |
+                         (refs[k].op == TRACE_write);
+    gen_destroy(gen);
+
+    return lines;
+}
+
+/* one round, return ns per access */
+static double round_ns(sim_t *sim, pattern_t p, const uint64_t *lines,
+                       uint64_t n, uint64_t *chase)
+{
+    double start = now_ns();
+
+    if (p == P_chase) {
+        uint64_t line = *chase;
+
+        for (uint64_t i = 0; i < n; ++i) {
+            sim_access(sim, line, TRACE_read);
+            line = lines[line];
+        }
+        *chase = line;
+    } else {
+        for (uint64_t i = 0; i < n; ++i)
+            sim_access(sim, lines[i] >> 1,
+                       lines[i] & 1 ? TRACE_write : TRACE_read);
+    }
+
+    return (now_ns() - start) / n;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* the levels of a case, return NULL out of memory */
+static sim_t *make_sim(arena_t *arena, struct list_head *caches,
+                       const geometry_t *g, cache_hierarchy_policy_t hp,
+                       cache_conservative_policy_t cp, stats_t **stats)
+{
+    unsigned int sets[MAX_LEVELS];
+    sim_t *sim;
+
+    INIT_LIST_HEAD(caches);
+    for (int l = 0; l < g->levels; ++l) {
+        cache_t *c = arena_alloc(arena, sizeof(cache_t));
+        uint64_t n = g->size[l] / LINESIZE;
+
+        if (!c)
+            return NULL;
+        c->t_cache = DCache;
+        c->l_cache = L1 + l;
+        c->hp_cache = hp;
+        c->cp_cache = cp;
+        c->sets = sets[l] = n / g->ways[l];
+        c->ways = g->ways[l];
+        c->linesize = LINESIZE;
+        fastmod_init(&c->set_index, c->sets);
+        c->tags = arena_alloc(arena, sizeof(uint64_t) * n);
+        c->repl = arena_alloc(arena, sizeof(uint32_t) * n);
+        if (!c->tags || !c->repl)
+            return NULL;
+        list_add_tail(&c->list, caches);
+    }
+
+    if (!(sim = sim_create(caches)) || !stats)
+        return sim;
+    if (!(*stats = stats_create(g->levels, sets, 1, 4096)) ||
+        SUCCEED != sim_stats(sim, *stats, 0)) {
+        sim_destroy(sim);
+        return NULL;
+    }
+
+    return sim;
+}
+
+static int load_baseline(const char *path, result_t **base, int *nbase)
+{
+    char line[256];
+    int cap = 0;
+    FILE *f = fopen(path, "r");
+
+    if (!f) {
+        perror(path);
+        return FAIL;
+    }
+    *nbase = 0;
+    while (fgets(line, sizeof(line), f)) {
+        result_t r;
+
+        if (sscanf(line, "%95s %lf", r.label, &r.median) != 2)
+            continue;
+        if (*nbase == cap) {
+            result_t *more = realloc(*base, sizeof(result_t) *
+                                     (cap = cap ? 2 * cap : 256));
+
+            if (!more) {
+                fclose(f);
+                return FAIL;
+            }
+            *base = more;
+        }
+        (*base)[(*nbase)++] = r;
+    }
+    fclose(f);
+
+    return SUCCEED;
+}
+
+static const result_t *find(const result_t *base, int nbase,
+                            const char *label)
+{
+    for (int i = 0; i < nbase; ++i)
+        if (!strcmp(base[i].label, label))
+            return &base[i];
+
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t n = 1 << 18, footprint, *lines;
+    int rounds = 5, warmup = 1, nbase = 0, regressions = 0, with_stats = 0;
+    int opt;
+    const char *filter = "", *out_path = NULL, *base_path = NULL;
+    double threshold = 10.0, ns[MAX_ROUNDS];
+    result_t *base = NULL;
+    FILE *out = NULL;
+
+    while ((opt = getopt(argc, argv, "n:r:w:sf:o:b:t:")) != -1) {
+        switch (opt) {
+        case 'n': n = strtoull(optarg, NULL, 0); break;
+        case 'r': rounds = atoi(optarg); break;
+        case 'w': warmup = atoi(optarg); break;
+        case 's': with_stats = 1; break;
+        case 'f': filter = optarg; break;
+        case 'o': out_path = optarg; break;
+        case 'b': base_path = optarg; break;
+        case 't': threshold = atof(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n accesses] [-r rounds] "
+                    "[-w warm-up rounds] [-s] [-f filter] [-o results] "
+                    "[-b baseline [-t percent]]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!n || rounds < 1 || rounds > MAX_ROUNDS || warmup < 0) {
+        fprintf(stderr, "1..%d rounds of at least one access\n", MAX_ROUNDS);
+        return 2;
+    }
+    if (base_path && SUCCEED != load_baseline(base_path, &base, &nbase))
+        return 2;
+    if (out_path && !(out = fopen(out_path, "w"))) {
+        perror(out_path);
+        return 2;
+    }
+
+    printf("%-44s %8s %8s %8s %8s %9s\n", "case (ns/access)", "min",
+           "median", "mean", "stddev", "Macc/s");
+    for (size_t g = 0; g < sizeof(geometries) / sizeof(geometries[0]); ++g) {
+        const geometry_t *geo = &geometries[g];
+
+        /* twice the last level, every pattern misses some */
+        for (footprint = 1; footprint < 2 * geo->size[geo->levels - 1] /
+             LINESIZE; footprint <<= 1)
+            ;
+        for (int p = 0; p < PATTERNS; ++p) {
+            if (!(lines = make_stream(p, n, footprint))) {
+                fprintf(stderr, "out of memory\n");
+                return 2;
+            }
+            for (int hp = H_inclusive; hp <= H_non_exclusive; ++hp) {
+                /* the hierarchy is the relation of a level to the one above */
+                if (geo->levels == 1 && hp != H_non_exclusive)
+                    continue;
+                for (int cp = CP_random; cp <= CP_mru; ++cp) {
+                    char label[LABEL_LEN];
+                    struct list_head caches;
+                    stats_t *stats = NULL;
+                    arena_t *arena;
+                    double mean = 0.0, var = 0.0;
+                    uint64_t chase = 0;
+                    const result_t *b;
+                    sim_t *sim;
+
+                    snprintf(label, sizeof(label), "%s/%s/%s/%s%s", geo->name,
+                             hierarchy_names[hp], policy_names[cp],
+                             pattern_names[p], with_stats ? "/stats" : "");
+                    if (!strstr(label, filter))
+                        continue;
+                    if (!(arena = arena_create(ARENA_THP)) ||
+                        !(sim = make_sim(arena, &caches, geo, hp, cp,
+                                         with_stats ? &stats : NULL))) {
+                        fprintf(stderr, "%s: cannot build the caches\n",
+                                label);
+                        return 2;
+                    }
+
+                    for (int r = 0; r < warmup; ++r)
+                        round_ns(sim, p, lines, n, &chase);
+                    for (int r = 0; r < rounds; ++r) {
+                        ns[r] = round_ns(sim, p, lines, n, &chase);
+                        mean += ns[r] / rounds;
+                    }
+                    for (int r = 0; r < rounds; ++r)
+                        var += (ns[r] - mean) * (ns[r] - mean) / rounds;
+                    qsort(ns, rounds, sizeof(double), cmp_double);
+
+                    printf("%-44s %8.2f %8.2f %8.2f %8.2f %9.1f", label, ns[0],
+                           ns[rounds / 2], mean, sqrt(var),
+                           1e3 / ns[rounds / 2]);
+                    if ((b = find(base, nbase, label))) {
+                        double delta = (ns[rounds / 2] / b->median - 1) * 100;
+
+                        printf(" %+6.1f%%", delta);
+                        if (delta > threshold) {
+                            printf(" REGRESSED");
+                            regressions++;
+                        }
+                    }
+                    putchar('\n');
+                    if (out)
+                        fprintf(out, "%s %.3f\n", label, ns[rounds / 2]);
+
+                    sim_destroy(sim);
+                    stats_destroy(stats);
+                    arena_destroy(arena);
+                }
+            }
+            free(lines);
+        }
+    }
+
+    if (out)
+        fclose(out);
+    free(base);
+    if (base_path)
+        printf("%d regressions over %.1f%%\n", regressions, threshold);
+
+    return regressions ? 1 : 0;
+}
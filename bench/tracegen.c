@@ -0,0 +1,81 @@
+/*
+ * @file tracegen.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Write a synthetic trace (tracegen.h) to a binary trace file, for the
+ * tools that want a file; the simulator itself takes "gen:" paths. To a
+ * "shm:" path it plays a live tracer feeding the ring of a simulator
+ * (tracering.h).
+ *
+ * usage: tracegen specification file
+ * e.g.   tracegen "refs=100M;stencil,n=2K" stencil.trace
+ *        tracegen "refs=100M;stencil,n=2K" shm:/cache-simulator
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "tracegen.h"
+#include "tracering.h"
+
+/* the batches of gen into a ring, until its end or the simulator's */
+static int to_ring(gen_t *gen, const char *name)
+{
+    tracering_t *t = tracering_attach(name);
+    trace_ref_t *refs;
+    int n;
+
+    if (!t)
+        return FAIL;
+    while ((refs = tracering_batch(t)) &&
+           (n = gen_next(gen, refs, TRACE_BATCH)) > 0)
+        tracering_publish(t, n);
+    tracering_end(t);
+    tracering_close(t);
+
+    return refs ? SUCCEED : FAIL;
+}
+
+int main(int argc, char **argv)
+{
+    const char *spec;
+    gen_t *gen;
+    FILE *f;
+    int ret;
+
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s specification file\n", argv[0]);
+        return 2;
+    }
+    spec = argv[1];
+    if (!strncmp(spec, GEN_PREFIX, strlen(GEN_PREFIX)))
+        spec += strlen(GEN_PREFIX);
+    if (!(gen = gen_parse(spec)))
+        return 2;
+    if (!strncmp(argv[2], RING_PREFIX, strlen(RING_PREFIX))) {
+        ret = to_ring(gen, argv[2] + strlen(RING_PREFIX));
+        gen_destroy(gen);
+        return SUCCEED == ret ? 0 : 1;
+    }
+    if (!(f = strcmp(argv[2], "-") ? fopen(argv[2], "wb") : stdout)) {
+        perror(argv[2]);
+        gen_destroy(gen);
+        return 2;
+    }
+
+    ret = gen_write(gen, f);
+    if (f != stdout && fclose(f))
+        ret = FAIL;
+    gen_destroy(gen);
+    if (SUCCEED != ret) {
+        fprintf(stderr, "cannot write %s\n", argv[2]);
+        return 1;
+    }
+
+    return 0;
+}
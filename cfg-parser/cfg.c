@@ -19,6 +19,7 @@
 
 #include "str.h"
 #include "cfg.h"
+#include "sweep.h"
 
 char *CONFIG_FILE           = NULL;
 char *CONFIG_LOG_FILE       = NULL;
@@ -392,6 +393,11 @@ __parse_cfg_file(const char *cfg_file, struct cfg_line *cfg, int level,
 
                     *((uint64_t *)cfg[i].variable) = var;
                     break;
+                case TYPE_SWEEP:
+                    if (SUCCEED != cfg_sweep_add(*(cfg_sweep_t **)cfg[i].variable,
+                                                 parameter, value))
+                        goto incorrect_config;
+                    break;
                 default:
                     break;
                 }
@@ -422,6 +428,11 @@ __parse_cfg_file(const char *cfg_file, struct cfg_line *cfg, int level,
             if (NULL == (*(char **)cfg[i].variable))
                 goto missing_mandatory;
             break;
+        case TYPE_SWEEP:
+            if (!cfg_sweep_has(*(cfg_sweep_t **)cfg[i].variable,
+                               cfg[i].parameter))
+                goto missing_mandatory;
+            break;
         default:
             break;
         }
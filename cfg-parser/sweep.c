@@ -0,0 +1,442 @@
+/*
+ * @file sweep.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Expansion of sweep parameters and the thread pool running the
+ * configurations.
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cfg.h"
+#include "sweep.h"
+
+#define SWEEP_TRIM_CHARS    "\t "
+
+typedef struct sweep_item {
+    int nvalues;
+    char **values;
+} sweep_item_t;
+
+typedef struct sweep_param {
+    char *name;
+    int nitems;
+    sweep_item_t *items;
+} sweep_param_t;
+
+struct cfg_sweep {
+    int nparams;
+    sweep_param_t *params;
+};
+
+typedef struct sweep_job {
+    const cfg_sweep_t *s;
+    cfg_sweep_fn_t fn;
+    void *arg;
+    uint64_t count;
+    uint64_t next;
+    int failed;
+} sweep_job_t;
+
+cfg_sweep_t *cfg_sweep_create(void)
+{
+    return calloc(1, sizeof(cfg_sweep_t));
+}
+
+static void release_items(sweep_item_t *items, int nitems)
+{
+    for (int i = 0; i < nitems; ++i) {
+        for (int v = 0; v < items[i].nvalues; ++v)
+            free(items[i].values[v]);
+        free(items[i].values);
+    }
+    free(items);
+}
+
+void cfg_sweep_destroy(cfg_sweep_t *s)
+{
+    if (!s)
+        return;
+
+    for (int p = 0; p < s->nparams; ++p) {
+        free(s->params[p].name);
+        release_items(s->params[p].items, s->params[p].nitems);
+    }
+    free(s->params);
+    free(s);
+}
+
+static int item_push(sweep_item_t *item, const char *value)
+{
+    char **tmp;
+
+    if (item->nvalues >= CFG_SWEEP_MAX_VALUES) {
+        LOG_ERR("more than %d values in one item", CFG_SWEEP_MAX_VALUES);
+        return FAIL;
+    }
+    tmp = realloc(item->values, sizeof(char *) * (item->nvalues + 1));
+    if (!tmp)
+        return FAIL;
+    item->values = tmp;
+    if (!(item->values[item->nvalues] = str_strdup(value)))
+        return FAIL;
+    item->nvalues++;
+
+    return SUCCEED;
+}
+
+static int parse_bound(const char *str, size_t n, uint64_t *value)
+{
+    char tmp[64];
+
+    if (!n || n >= sizeof(tmp))
+        return FAIL;
+    memcpy(tmp, str, n);
+    tmp[n] = '\0';
+    str_lrtrim(tmp, SWEEP_TRIM_CHARS);
+
+    return str2uint64(tmp, "KMGT", value);
+}
+
+/* "lo..hi[:pow2|:+n|:*n]" */
+static int expand_range(sweep_item_t *item, const char *alt, const char *dots)
+{
+    const char *colon = strchr(dots + 2, ':');
+    uint64_t lo, hi, step = 1, v;
+    char op = '+', buf[32];
+
+    if (SUCCEED != parse_bound(alt, dots - alt, &lo) ||
+        SUCCEED != parse_bound(dots + 2, colon ? (size_t)(colon - dots - 2) :
+                               strlen(dots + 2), &hi))
+        goto bad;
+
+    if (colon) {
+        if (!strcmp(colon + 1, "pow2")) {
+            op = '*';
+            step = 2;
+            /* start at the first power of two in range */
+            for (v = 1; v && v < lo; v <<= 1)
+                ;
+            lo = v;
+        } else if ((colon[1] == '+' || colon[1] == '*') &&
+                   SUCCEED == parse_bound(colon + 2, strlen(colon + 2),
+                                          &step)) {
+            op = colon[1];
+        } else {
+            goto bad;
+        }
+    }
+    if (lo > hi || (!lo && op == '*') || step < (op == '*' ? 2 : 1))
+        goto bad;
+
+    for (v = lo; v <= hi;) {
+        snprintf(buf, sizeof(buf), "%" PRIu64, v);
+        if (SUCCEED != item_push(item, buf))
+            return FAIL;
+        if (op == '*' ? __builtin_mul_overflow(v, step, &v) :
+            __builtin_add_overflow(v, step, &v))
+            break;
+    }
+
+    return SUCCEED;
+bad:
+    LOG_ERR("invalid range [%s]", alt);
+    return FAIL;
+}
+
+static int expand_alt(sweep_item_t *item, char *alt)
+{
+    char *dots;
+
+    str_lrtrim(alt, SWEEP_TRIM_CHARS);
+    if ('\0' == *alt) {
+        LOG_ERR("empty sweep value");
+        return FAIL;
+    }
+    if (strpbrk(alt, "{}")) {
+        LOG_ERR("misplaced brace in [%s]", alt);
+        return FAIL;
+    }
+    if ((dots = strstr(alt, "..")))
+        return expand_range(item, alt, dots);
+
+    return item_push(item, alt);
+}
+
+/* split value into items, each item into its values */
+static int parse_items(char *value, sweep_item_t **items, int *nitems)
+{
+    char *p = value, *end;
+    sweep_item_t *tmp;
+    int braced;
+
+    *items = NULL;
+    *nitems = 0;
+    for (;;) {
+        tmp = realloc(*items, sizeof(sweep_item_t) * (*nitems + 1));
+        if (!tmp)
+            return FAIL;
+        *items = tmp;
+        memset(&tmp[*nitems], 0, sizeof(sweep_item_t));
+        tmp = &tmp[(*nitems)++];
+
+        p += strspn(p, SWEEP_TRIM_CHARS);
+        braced = '{' == *p;
+        if (braced) {
+            if (!(end = strchr(++p, '}')) || memchr(p, '{', end - p)) {
+                LOG_ERR("unbalanced braces in [%s]", value);
+                return FAIL;
+            }
+            *end = '\0';
+            for (char *alt = p, *comma; alt; alt = comma) {
+                if ((comma = strchr(alt, ',')))
+                    *comma++ = '\0';
+                if (SUCCEED != expand_alt(tmp, alt))
+                    return FAIL;
+            }
+            p = end + 1;
+        } else {
+            end = p + strcspn(p, ",");
+            if ('\0' != *end)
+                *end++ = '\0';
+            else
+                end = NULL;
+            if (SUCCEED != expand_alt(tmp, p))
+                return FAIL;
+            if (!end)
+                return SUCCEED;
+            p = end;
+            continue;
+        }
+
+        p += strspn(p, SWEEP_TRIM_CHARS);
+        if ('\0' == *p)
+            return SUCCEED;
+        if (',' != *p && 'x' != *p) {
+            LOG_ERR("expected ',' or 'x' after '}' in [%s]", value);
+            return FAIL;
+        }
+        p++;
+    }
+}
+
+static sweep_param_t *find_param(const cfg_sweep_t *s, const char *parameter)
+{
+    for (int p = 0; p < s->nparams; ++p)
+        if (!strcmp(s->params[p].name, parameter))
+            return &s->params[p];
+
+    return NULL;
+}
+
+/* number of configurations, 0 when above CFG_SWEEP_MAX_CONFIGS */
+static uint64_t count_configs(const cfg_sweep_t *s)
+{
+    uint64_t n = 1;
+
+    for (int p = 0; p < s->nparams; ++p) {
+        for (int i = 0; i < s->params[p].nitems; ++i) {
+            n *= s->params[p].items[i].nvalues;
+            if (n > CFG_SWEEP_MAX_CONFIGS)
+                return 0;
+        }
+    }
+
+    return n;
+}
+
+int cfg_sweep_add(cfg_sweep_t *s, const char *parameter, const char *value)
+{
+    sweep_param_t *param = find_param(s, parameter), *tmp, old;
+    sweep_item_t *items;
+    char *copy = str_strdup(value);
+    int nitems;
+
+    if (!copy)
+        return FAIL;
+    if (SUCCEED != parse_items(copy, &items, &nitems)) {
+        free(copy);
+        release_items(items, nitems);
+        return FAIL;
+    }
+    free(copy);
+
+    if (!param) {
+        tmp = realloc(s->params, sizeof(sweep_param_t) * (s->nparams + 1));
+        if (!tmp)
+            goto fail;
+        s->params = tmp;
+        param = &s->params[s->nparams];
+        if (!(param->name = str_strdup(parameter)))
+            goto fail;
+        param->nitems = 0;
+        param->items = NULL;
+        s->nparams++;
+    }
+
+    old = *param;
+    param->items = items;
+    param->nitems = nitems;
+    if (!count_configs(s)) {
+        LOG_ERR("[%s] makes more than %d configurations", parameter,
+                CFG_SWEEP_MAX_CONFIGS);
+        param->items = old.items;
+        param->nitems = old.nitems;
+        goto fail;
+    }
+    release_items(old.items, old.nitems);
+
+    return SUCCEED;
+fail:
+    release_items(items, nitems);
+    return FAIL;
+}
+
+int cfg_sweep_has(const cfg_sweep_t *s, const char *parameter)
+{
+    return NULL != find_param(s, parameter);
+}
+
+uint64_t cfg_sweep_count(const cfg_sweep_t *s)
+{
+    return count_configs(s);
+}
+
+/* value of an item of param in configuration k */
+static const char *item_value(const cfg_sweep_t *s, const sweep_param_t *param,
+                              int item, uint64_t k)
+{
+    uint64_t stride = 1;
+
+    for (int p = s->nparams - 1; p >= 0; --p) {
+        for (int i = s->params[p].nitems - 1; i >= 0; --i) {
+            const sweep_item_t *it = &s->params[p].items[i];
+
+            if (&s->params[p] == param && i == item)
+                return it->values[k / stride % it->nvalues];
+            stride *= it->nvalues;
+        }
+    }
+
+    return NULL;
+}
+
+static int format_param(const cfg_sweep_t *s, const sweep_param_t *param,
+                        uint64_t k, char *buf, size_t size)
+{
+    size_t used = 0;
+    int n;
+
+    if (!size)
+        return FAIL;
+    buf[0] = '\0';
+    for (int i = 0; i < param->nitems; ++i) {
+        n = snprintf(buf + used, size - used, "%s%s", i ? "," : "",
+                     item_value(s, param, i, k));
+        if (n < 0 || (size_t)n >= size - used)
+            return FAIL;
+        used += n;
+    }
+
+    return SUCCEED;
+}
+
+int cfg_sweep_get(const cfg_sweep_t *s, const char *parameter, uint64_t k,
+                  char *buf, size_t size)
+{
+    const sweep_param_t *param = find_param(s, parameter);
+
+    if (!param)
+        return FAIL;
+
+    return format_param(s, param, k, buf, size);
+}
+
+int cfg_sweep_label(const cfg_sweep_t *s, uint64_t k, char *buf, size_t size)
+{
+    size_t used = 0;
+    int n, swept;
+
+    if (!size)
+        return FAIL;
+    buf[0] = '\0';
+    for (int p = 0; p < s->nparams; ++p) {
+        const sweep_param_t *param = &s->params[p];
+
+        swept = 0;
+        for (int i = 0; i < param->nitems; ++i)
+            swept |= param->items[i].nvalues > 1;
+        if (!swept)
+            continue;
+
+        n = snprintf(buf + used, size - used, "%s%s=", used ? " " : "",
+                     param->name);
+        if (n < 0 || (size_t)n >= size - used)
+            return FAIL;
+        used += n;
+        if (SUCCEED != format_param(s, param, k, buf + used, size - used))
+            return FAIL;
+        used += strlen(buf + used);
+    }
+
+    return SUCCEED;
+}
+
+static void *sweep_worker(void *arg)
+{
+    sweep_job_t *job = arg;
+    uint64_t k;
+
+    while ((k = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) <
+           job->count)
+        if (SUCCEED != job->fn(job->s, k, job->arg))
+            __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+
+    return NULL;
+}
+
+int cfg_sweep_run(const cfg_sweep_t *s, int nthreads, cfg_sweep_fn_t fn,
+                  void *arg)
+{
+    sweep_job_t job = {
+        .s = s,
+        .fn = fn,
+        .arg = arg,
+        .count = count_configs(s),
+    };
+    pthread_t *tids = NULL;
+    int started = 0;
+
+    if (nthreads <= 0)
+        nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads <= 0)
+        nthreads = 1;
+    if ((uint64_t)nthreads > job.count)
+        nthreads = job.count;
+
+    if (nthreads <= 1) {
+        sweep_worker(&job);
+    } else {
+        tids = malloc(sizeof(pthread_t) * nthreads);
+        if (tids)
+            for (; started < nthreads; ++started)
+                if (pthread_create(&tids[started], NULL, sweep_worker, &job))
+                    break;
+        if (!started)
+            sweep_worker(&job);
+        for (int i = 0; i < started; ++i)
+            pthread_join(tids[i], NULL);
+        free(tids);
+    }
+
+    return job.failed ? FAIL : SUCCEED;
+}
@@ -12,3 +12,12 @@ export INCLUSIVE_SRC_DIR
 
 CFG_PARSER := $(CURDIR)/cfg-parser
 export CFG_PARSER
+
+ANALYSIS_DIR := $(CURDIR)/analysis
+export ANALYSIS_DIR
+
+TRACE_DIR := $(CURDIR)/trace
+export TRACE_DIR
+
+SIMULATE_DIR := $(CURDIR)/simulate
+export SIMULATE_DIR
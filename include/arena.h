@@ -0,0 +1,49 @@
+/*
+ * @file arena.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Bump allocator for the storage of a simulation: the cache_t of every
+ * level, its tags and its replacement state. Memory comes in a few
+ * regions mapped on ARENA_ALIGN boundaries, so each one can sit on huge
+ * pages, and goes back all at once: arena_reset() rewinds the arena for
+ * the next configuration and arena_destroy() unmaps it.
+ */
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+#define ARENA_ALIGN         (2UL << 20)         /* a huge page */
+#define ARENA_REGION        (8UL << 20)         /* smallest region */
+
+/* flags of arena_create() */
+#define ARENA_THP           1   /* advise transparent huge pages */
+#define ARENA_HUGETLB       2   /* reserved huge pages first */
+
+typedef struct arena arena_t;
+
+/* return NULL if out of memory */
+arena_t *arena_create(int flags);
+
+/* size bytes, zeroed and cache line aligned. return NULL if out of memory */
+void *arena_alloc(arena_t *a, size_t size);
+
+/* free every allocation, keeping the regions mapped */
+void arena_reset(arena_t *a);
+void arena_destroy(arena_t *a);
+
+/*
+ * bytes mapped, how many of them on reserved huge pages, and how many on
+ * huge pages of either kind. reserved regions of 1GB or more take 1GB
+ * pages when the kernel has some, 2MB ones otherwise.
+ */
+size_t arena_mapped(const arena_t *a);
+size_t arena_hugetlb(const arena_t *a);
+size_t arena_huge(const arena_t *a);
+
+#endif /* __ARENA_H__ */
@@ -0,0 +1,134 @@
+/*
+ * @file bbgraph.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Basic block graph used by the static cache analysis.
+ *
+ * The graph is an array based copy of the linked lists returned by
+ * cfg_make() (example/libdiscfg), plus the orders the analysis needs:
+ * a loop aware reverse postorder, the loop nesting forest and the
+ * strongly connected components.
+ */
+
+#ifndef __BBGRAPH_H__
+#define __BBGRAPH_H__
+
+#include <stddef.h>
+
+#define BB_NONE             (-1)
+
+/*
+ * One memory reference of a block, in program order.
+ * For the ICache these are the instruction fetches.
+ */
+typedef struct bb_ref {
+    unsigned long addr;
+    unsigned int size;
+} bb_ref_t;
+
+typedef struct bb_block {
+    int id;
+    int nrefs;
+    bb_ref_t *refs;
+    int nsucc;
+    int *succ;
+    int npred;
+    int *pred;
+    int rpo;                /* position in loop aware RPO, BB_NONE if dead */
+    int idom;               /* immediate dominator */
+    int dpre;               /* dominator tree preorder, BB_NONE if dead */
+    int dlast;              /* last preorder of the dominated subtree */
+    int loop;               /* innermost loop, BB_NONE if not in a loop */
+    int scc;                /* scc index in topological order */
+} bb_block_t;
+
+/*
+ * A natural loop. Loops are numbered so that a parent loop always has a
+ * smaller index than its children, loops[0..n) is a pre-order of the
+ * loop nesting forest.
+ */
+typedef struct bb_loop {
+    int header;
+    int parent;             /* enclosing loop, BB_NONE for outermost */
+    int depth;              /* 1 for outermost loops */
+    int nblocks;            /* blocks in the body, nested loops included */
+    unsigned int bound;     /* max iterations per entry, 0 if unknown */
+} bb_loop_t;
+
+typedef struct bb_graph {
+    int nblocks;
+    bb_block_t *blocks;
+    int entry;
+    int nreach;             /* blocks reachable from the entry */
+    int *rpo;               /* block ids, rpo[0] == entry */
+    int nloops;
+    bb_loop_t *loops;
+    int nsccs;
+} bb_graph_t;
+
+/*
+ * create a graph with nblocks empty blocks.
+ * return NULL if out of memory.
+ */
+bb_graph_t *bb_graph_create(int nblocks);
+
+/*
+ * release a graph and everything it owns.
+ */
+void bb_graph_destroy(bb_graph_t *g);
+
+/*
+ * append the references of a block, refs are copied.
+ * return SUCCEED or FAIL.
+ */
+int bb_graph_set_refs(bb_graph_t *g, int block, const bb_ref_t *refs, int nrefs);
+
+/*
+ * add an edge from -> to, duplicated edges are ignored.
+ * return SUCCEED or FAIL.
+ */
+int bb_graph_add_edge(bb_graph_t *g, int from, int to);
+
+/*
+ * compute rpo, dominators, loops and sccs starting from block entry.
+ * must be called once all edges are added and before any analysis.
+ * return SUCCEED or FAIL.
+ */
+int bb_graph_finalize(bb_graph_t *g, int entry);
+
+/*
+ * whether loop l contains block b (nested loops included).
+ */
+int bb_loop_contains(const bb_graph_t *g, int l, int b);
+
+/*
+ * whether block d dominates block b, both reachable.
+ */
+int bb_dominates(const bb_graph_t *g, int d, int b);
+
+/*
+ * set the iteration bound of the loop headed by block header.
+ * return SUCCEED or FAIL if the block is not a loop header.
+ */
+int bb_loop_set_bound(bb_graph_t *g, int header, unsigned int bound);
+
+struct cfg_node_list;
+
+/*
+ * build a graph from the output of cfg_make().
+ * bb_graph_t **g           [out] : the new finalized graph
+ * nodes                    [in]  : nodelist_ret of cfg_make()
+ * insts, insts_len         [in]  : the instructions cfg_make() was called with,
+ *                                  passed as void ** to keep libdisasm out of
+ *                                  this header
+ * entry_addr               [in]  : address of the first instruction of the
+ *                                  task, 0 for the first block
+ */
+int bb_graph_from_cfg(bb_graph_t **g, struct cfg_node_list *nodes,
+                      void **insts, int insts_len, unsigned long entry_addr);
+
+#endif /* __BBGRAPH_H__ */
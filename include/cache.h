@@ -18,6 +18,7 @@
 #include <stdbool.h>
 
 #include "cache_ops.h"
+#include "fastmod.h"
 
 // The current cpu architecture has 2 type of cache type:
 //		1 ICache, store the instructions
@@ -49,19 +50,6 @@ typedef enum cache_level {
     L4,
 } cache_level_t;
 
-typedef enum cache_lv_size {
-    lv_unknown = 0,	// not a standard capacity
-    S_16KB = 1,
-    S_32KB = 2,
-    S_64KB = 3,
-    S_128KB = 4,
-    S_1MB = 5,
-    S_2MB = 6,
-    S_4MB = 7,
-    S_8MB = 8,
-    S_16MB = 9,
-} cache_lv_size_t;
-
 // please read this site:
 // https://blog.csdn.net/dongyanxia1000/article/details/53392315
 typedef enum cache_set_associative {
@@ -107,11 +95,15 @@ typedef enum cache_conservative_policy {
 
 /*
  * cache_hit_miss_category
+ * CHMC_first_miss: misses at most once each time its loop scope is entered
+ * CHMC_not_classified: analyzed, but none of the above could be proven
  */
 typedef enum cache_H_M_category {
     CHMC_unknown = 0,
     CHMC_hit = 1,
-    CHMC_miss
+    CHMC_miss,
+    CHMC_first_miss,
+    CHMC_not_classified,
 } cache_H_M_category_t;
 
 typedef struct __attribute__ ((__packed__)) cache_line {
@@ -145,11 +137,26 @@ typedef struct cache {
     cache_hierarchy_policy_t hp_cache;
     cache_conservative_policy_t cp_cache;
     cache_set_associative_t sa_cache;
+    unsigned int sets;          /* any count, not only powers of two */
+    unsigned int ways;
+    unsigned int linesize;
+    fastmod_t set_index;        /* memory block -> set, see cache_set_of */
+    uint64_t *tags;             /* sets * ways, line + 1, 0 if invalid */
+    uint32_t *repl;             /* sets * ways, replacement state */
+    uint8_t *coh;               /* sets * ways, coherence.h, multi-core */
+    uint64_t rng;               /* CP_random */
     void *ops;
     unsigned long long statistical_hit;
     unsigned long long statistical_miss;
-    cache_set_t *c_data[];
+    unsigned long long statistical_evict;   /* valid lines replaced */
 } cache_t;
 
+/* set of an address, set_index initialized with fastmod_init(sets) */
+static inline unsigned int cache_set_of(const cache_t *cache,
+                                        unsigned long address)
+{
+    return (unsigned int)fastmod_reduce(&cache->set_index,
+                                        address / cache->linesize);
+}
 
 #endif /* __CACHE_H__ */
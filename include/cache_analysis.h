@@ -0,0 +1,189 @@
+/*
+ * @file cache_analysis.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Static LRU cache analysis (must / may abstract interpretation).
+ *
+ * A memory block maps to exactly one cache set and the LRU state of a set
+ * only depends on the accesses to that set, so the analysis runs one
+ * independent fixpoint per set and spreads the sets over a pool of
+ * threads. The classification of every access is assembled from the
+ * per-set results.
+ *
+ * Accesses neither always hit nor always miss go through a persistence
+ * analysis: within the outermost loop where at most "ways" distinct
+ * memory blocks of its set are accessed, a block once loaded is never
+ * evicted, so the access is a first miss for that loop scope. Counting
+ * the conflicts per (loop, set) is linear in accesses times loop depth.
+ *
+ * Levels of a hierarchy are analyzed top down. The cache access
+ * classification (CAC) tells whether an access reaches a level: always,
+ * never or uncertain. Every access reaches L1, the CAC below follows
+ * from the CAC and the hit / miss class of the level above, and only
+ * accesses that may reach a level are analyzed there. An uncertain
+ * access updates the abstract set to the join of the states with and
+ * without it.
+ *
+ * The hierarchy policy of a level is its relation to the level above:
+ *   non inclusive: the plain filtering above.
+ *   inclusive: an eviction also invalidates every level above, so hits
+ *       above are uncertain at every level down to it, and a hit or first
+ *       miss above is kept only when the line is proven to stay in it.
+ *   exclusive: lines are filled by evictions from above, which is not
+ *       modeled; reaching accesses are not classified. So is any level
+ *       whose replacement policy is not LRU.
+ *
+ * The task is assumed to start with an invalidated cache.
+ */
+
+#ifndef __CACHE_ANALYSIS_H__
+#define __CACHE_ANALYSIS_H__
+
+#include "cache.h"
+#include "bbgraph.h"
+
+typedef struct ca_geometry {
+    unsigned int sets;
+    unsigned int ways;
+    unsigned int linesize;
+} ca_geometry_t;
+
+/*
+ * One cache line touched by a reference. A reference that crosses a line
+ * boundary yields one access per line.
+ */
+typedef struct ca_access {
+    int block;
+    int ref;                    /* index in bb_block_t.refs */
+    unsigned long mblock;       /* memory block, address / linesize */
+} ca_access_t;
+
+typedef struct ca_result {
+    int nblocks;
+    int *first;                 /* block b owns acc[first[b] .. first[b+1]) */
+    int naccesses;
+    ca_access_t *acc;
+    int shared;                 /* first and acc belong to a ca_program_t */
+    int nanalyzed;              /* accesses that may reach the level */
+    cache_H_M_category_t *chmc; /* per access, CHMC_unknown when never
+                                   reaching or unreachable */
+    int *scope;                 /* per access, loop of a CHMC_first_miss */
+    unsigned long transfers;    /* summed over every set fixpoint */
+    unsigned long memo_hits;    /* transfers and joins answered by the memo */
+    unsigned long states;       /* distinct set states */
+} ca_result_t;
+
+/*
+ * classify every access of the graph.
+ * const bb_graph_t *g          [in]  : finalized graph
+ * const ca_geometry_t *geo     [in]  : cache geometry
+ * int nthreads                 [in]  : worker threads, 0 for one per cpu
+ * ca_result_t *res             [out] : the classification
+ * return SUCCEED or FAIL.
+ */
+int ca_analyze(const bb_graph_t *g, const ca_geometry_t *geo, int nthreads,
+               ca_result_t *res);
+
+typedef enum ca_cac {
+    CAC_never = 0,
+    CAC_always,
+    CAC_uncertain,
+} ca_cac_t;
+
+/*
+ * one level of a hierarchy, L1 first. all levels share the linesize, so
+ * accesses have the same index at every level.
+ */
+typedef struct ca_level {
+    ca_geometry_t geo;
+    cache_hierarchy_policy_t hp;
+    cache_conservative_policy_t cp;
+    ca_cac_t *cac;              /* per access, NULL at L1: all reach it */
+    ca_result_t res;
+} ca_level_t;
+
+/*
+ * ca_analyze restricted to the accesses whose cac is not CAC_never.
+ * const ca_cac_t *cac          [in]  : per access, NULL for all always
+ */
+int ca_analyze_level(const bb_graph_t *g, const ca_geometry_t *geo,
+                     const ca_cac_t *cac, int nthreads, ca_result_t *res);
+
+/*
+ * analyze every level, filling res of each level and cac of every level
+ * but the first. on failure the levels are released.
+ * ca_level_t *levels           [in/out] : geo, hp and cp set by the caller
+ * return SUCCEED or FAIL.
+ */
+int ca_analyze_hierarchy(const bb_graph_t *g, ca_level_t *levels, int nlevels,
+                         int nthreads);
+
+/*
+ * ca_analyze_hierarchy over a cache_t list such as g_caches.
+ * ca_level_t **levels          [out] : one per cache, in list order
+ * int *nlevels                 [out] : number of levels
+ * release with ca_levels_release() then free(*levels).
+ */
+int ca_analyze_caches(const bb_graph_t *g, struct list_head *caches,
+                      int nthreads, ca_level_t **levels, int *nlevels);
+
+void ca_levels_release(ca_level_t *levels, int nlevels);
+
+/*
+ * Program dependent state kept across the configurations of a sweep.
+ * The line accesses of the task only depend on the graph and the
+ * linesize and are shared by every configuration. The raw result of a
+ * level only depends on the configurations of that level and the levels
+ * above, so level results are memoized by that prefix and a sweep only
+ * analyzes the levels whose prefix it has not seen. Safe to share
+ * between threads.
+ *
+ * Library only: cache-simulator itself has no control flow graph input,
+ * so no cfg.cache option reaches the analysis. A tool builds the graph
+ * (bb_graph_from_cfg()) and passes one ca_program_t to its own
+ * cfg_sweep_run() callback, as test/test-sweep.c does.
+ */
+typedef struct ca_program ca_program_t;
+
+/*
+ * const bb_graph_t *g          [in]  : finalized graph, must outlive prog
+ * int nmemo                    [in]  : level results kept, 0 for a default
+ * return NULL if out of memory.
+ */
+ca_program_t *ca_program_create(const bb_graph_t *g, int nmemo);
+void ca_program_destroy(ca_program_t *prog);
+
+/*
+ * ca_analyze_hierarchy on the graph of prog. the results share the line
+ * accesses of prog, release them with ca_levels_release() before
+ * destroying prog.
+ */
+int ca_program_analyze(ca_program_t *prog, ca_level_t *levels, int nlevels,
+                       int nthreads);
+
+/*
+ * ca_analyze_caches on the graph of prog, e.g. for one configuration of a
+ * sweep run by cfg_sweep_run().
+ */
+int ca_program_analyze_caches(ca_program_t *prog, struct list_head *caches,
+                              int nthreads, ca_level_t **levels, int *nlevels);
+
+/*
+ * level results taken from the memo and computed so far.
+ */
+void ca_program_stats(ca_program_t *prog, unsigned long *reused,
+                      unsigned long *analyzed);
+
+/*
+ * classification of a whole reference, the worst of the lines it touches
+ * in the order hit, first miss, not classified, miss.
+ */
+cache_H_M_category_t ca_ref_chmc(const ca_result_t *res, int block, int ref);
+
+void ca_result_release(ca_result_t *res);
+
+#endif /* __CACHE_ANALYSIS_H__ */
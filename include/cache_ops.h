@@ -26,10 +26,5 @@ typedef struct cache_operations {
     void (*NINE)  (cache_level_t level, long address, const char *data, size_t size);
 } cache_operations_t;
 
-/*
- * 
- *
- /
-
 
 #endif /* __CACHE_OPS_H__ */
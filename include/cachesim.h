@@ -0,0 +1,155 @@
+/*
+ * @file cachesim.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * libcachesim: the trace driven simulator as a library, built with
+ * "make lib" into lib/libcachesim.a and lib/libcachesim.so.
+ *
+ * A cachesim_t owns one hierarchy and everything simulating it; the
+ * library keeps no state of its own, so handles on different threads
+ * never meet. One handle is used by one thread at a time.
+ *
+ * This header is the whole interface and includes nothing of the tree:
+ * the structures below only grow at their end, and CACHESIM_VERSION
+ * changes when they do.
+ *
+ *   cachesim_cfg_t cfg;
+ *   cachesim_cfg_init(&cfg);
+ *   cfg.levels[0].size = 32768;
+ *   cachesim_t *cs = cachesim_create(&cfg);
+ *   cachesim_access(cs, &ref);
+ *   cachesim_stats(cs, &stats);
+ *   cachesim_destroy(cs);
+ */
+
+#ifndef __CACHESIM_H__
+#define __CACHESIM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CACHESIM_VERSION        1
+#define CACHESIM_MAX_LEVELS     8
+
+#define CACHESIM_API            __attribute__ ((visibility("default")))
+
+/* operations of a reference */
+#define CACHESIM_READ           0
+#define CACHESIM_WRITE          1
+#define CACHESIM_IFETCH         2
+
+/* hierarchy of a level, as in conf/cfg.cache */
+#define CACHESIM_INCLUSIVE      0
+#define CACHESIM_NON_INCLUSIVE  1
+#define CACHESIM_EXCLUSIVE      2
+
+/* replacement of a level, as in conf/cfg.cache */
+#define CACHESIM_RANDOM         1
+#define CACHESIM_LRU            2
+#define CACHESIM_FIFO           3
+#define CACHESIM_LIFO           4
+#define CACHESIM_TLRU           5
+#define CACHESIM_MRU            6
+
+typedef struct cachesim cachesim_t;
+typedef struct cachesim_snapshot cachesim_snapshot_t;
+
+typedef struct cachesim_level {
+    uint64_t size;                      /* bytes, a whole number of sets */
+    uint32_t ways;
+    int hierarchy;                      /* to the level above */
+    int policy;
+} cachesim_level_t;
+
+typedef struct cachesim_cfg {
+    int icache;                         /* 1: takes the fetches only */
+    uint32_t linesize;                  /* power of two, up to 64 */
+    int nlevels;
+    cachesim_level_t levels[CACHESIM_MAX_LEVELS];
+    int cores;                          /* > 1: private levels above a
+                                           shared last one, coherent */
+    int moesi;                          /* else MESI */
+    int threads;                        /* cachesim_run with cores, <= 0
+                                           for one per online cpu */
+    uint64_t warmup;                    /* cachesim_run, one core */
+    int hugepages;                      /* 0. transparent, 1. reserved,
+                                           2. small pages */
+} cachesim_cfg_t;
+
+/* a reference, laid out as in trace files */
+typedef struct cachesim_ref {
+    uint64_t addr;
+    uint64_t pc;                        /* 0 when unknown */
+    uint32_t size;                      /* bytes, 0 as 1 */
+    uint16_t cpu;                       /* core, modulo the cores */
+    uint8_t op;
+    uint8_t flags;
+} cachesim_ref_t;
+
+typedef struct cachesim_stats {
+    uint64_t refs;                      /* references simulated */
+    uint64_t memory;                    /* lines read from memory */
+    int nlevels;
+    struct {
+        uint64_t hits;                  /* private ones summed over cores */
+        uint64_t misses;
+        uint64_t evictions;
+    } levels[CACHESIM_MAX_LEVELS];
+} cachesim_stats_t;
+
+/* one 32KB 8 way LRU data cache of 64B lines, one core */
+CACHESIM_API void cachesim_cfg_init(cachesim_cfg_t *cfg);
+
+/*
+ * configuration k of a sweep in a file like conf/cfg.cache.
+ * return 0, or -1 on a bad file or k past the sweep.
+ */
+CACHESIM_API int cachesim_cfg_load(const char *path, uint64_t k,
+                                   cachesim_cfg_t *cfg);
+
+/* return NULL on a bad configuration or out of memory */
+CACHESIM_API cachesim_t *cachesim_create(const cachesim_cfg_t *cfg);
+CACHESIM_API void cachesim_destroy(cachesim_t *cs);
+
+/*
+ * simulate one reference, every line it touches.
+ * return the level serving its first line, 1 for L1, nlevels + 1 for
+ * memory, 0 for the cache of another core, or -1 if the cache does not
+ * take the reference (data for an icache and the other way round).
+ */
+CACHESIM_API int cachesim_access(cachesim_t *cs, const cachesim_ref_t *ref);
+
+/* simulate n references, return those taken */
+CACHESIM_API uint64_t cachesim_access_batch(cachesim_t *cs,
+                                            const cachesim_ref_t *refs,
+                                            size_t n);
+
+/*
+ * simulate a trace file, "-" for stdin or "gen:..." for a synthetic one.
+ * return 0, or -1 on a bad trace.
+ */
+CACHESIM_API int cachesim_run(cachesim_t *cs, const char *trace);
+
+CACHESIM_API void cachesim_stats(const cachesim_t *cs,
+                                 cachesim_stats_t *stats);
+
+/* the counters start over, the contents of the caches stay */
+CACHESIM_API void cachesim_reset_stats(cachesim_t *cs);
+
+/*
+ * the contents and counters of the caches, for cachesim_restore() into
+ * cs or into any handle of the same geometry. one core only.
+ * return NULL with several cores or out of memory.
+ */
+CACHESIM_API cachesim_snapshot_t *cachesim_snapshot(const cachesim_t *cs);
+
+/* return 0, or -1 if cs has another geometry */
+CACHESIM_API int cachesim_restore(cachesim_t *cs,
+                                  const cachesim_snapshot_t *snap);
+CACHESIM_API void cachesim_snapshot_free(cachesim_snapshot_t *snap);
+
+#endif /* __CACHESIM_H__ */
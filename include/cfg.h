@@ -25,6 +25,7 @@
 #define TYPE_MULTISTRING    2
 #define TYPE_UINT64         3
 #define TYPE_STRING_LIST    4
+#define TYPE_SWEEP          5   /* variable is a cfg_sweep_t *, see sweep.h */
 
 #define PARM_OPT            0
 #define PARM_MAND           1
@@ -0,0 +1,171 @@
+/*
+ * @file coherence.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Multi-core simulation: every core has a private copy of the levels
+ * above the last one, the last level is the shared LLC. The private
+ * stacks are kept coherent with MESI or MOESI through a directory.
+ *
+ * The directory is sharded by LLC set, so a line, its directory entry
+ * and the LLC set it maps to are all guarded by one shard lock. Every
+ * core has a lock over its private levels. A thread holds at most one
+ * shard and one core lock, and takes the shard first, so the cores of
+ * a trace can be simulated on parallel threads. Each core keeps the
+ * order of its references, the interleaving between cores follows the
+ * threads; one thread replays the trace order exactly.
+ *
+ * The private levels are filled on every miss, an inclusive one
+ * back-invalidates the levels above it. An inclusive LLC back-invalidates
+ * the private copies of its victims, any other LLC is non-inclusive.
+ * Clean lines leave a private stack silently, dirty ones are written
+ * back to the LLC.
+ */
+
+#ifndef __COHERENCE_H__
+#define __COHERENCE_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "arena.h"
+#include "cache.h"
+#include "list.h"
+#include "progress.h"
+#include "series.h"
+#include "stats.h"
+#include "trace.h"
+
+#define COH_MAX_CORES       64
+#define COH_MAX_LEVELS      8
+#define COH_SHARDS          64          /* directory shards, power of two */
+#define COH_PEER            (-1)        /* coh_access: another core served */
+
+typedef enum coh_state {
+    COH_I = 0,
+    COH_S,
+    COH_E,
+    COH_O,                              /* MOESI only */
+    COH_M,
+} coh_state_t;
+
+typedef enum coh_protocol {
+    COH_mesi = 0,
+    COH_moesi,
+} coh_protocol_t;
+
+typedef struct coh_dir_entry {
+    uint64_t line;                      /* line + 1, 0 if free */
+    uint64_t sharers;                   /* cores that may hold the line */
+    int8_t owner;                       /* E, M or O holder, -1 if none */
+    uint8_t state;                      /* coh_state_t of the line */
+} coh_dir_entry_t;
+
+typedef struct coh_shard {
+    pthread_mutex_t lock;
+    coh_dir_entry_t *dir;               /* open addressing */
+    uint32_t cap;
+    uint32_t used;
+    uint64_t rng;                       /* CP_random of its LLC sets */
+    uint64_t llc_hits;
+    uint64_t llc_misses;
+    uint64_t llc_evictions;
+    uint64_t memory;                    /* lines read from memory */
+    uint64_t memory_writebacks;
+} __attribute__ ((aligned(64))) coh_shard_t;
+
+typedef struct coh_core {
+    pthread_mutex_t lock;               /* the private levels */
+    cache_t *levels[COH_MAX_LEVELS];
+    uint64_t refs;
+    uint64_t skipped;                   /* of the other kind than L1 */
+    uint64_t upgrades;                  /* S or O written */
+    uint64_t transfers;                 /* lines supplied by another core */
+    uint64_t writebacks;                /* dirty lines put in the LLC */
+    uint64_t invalidations;             /* copies taken by other cores */
+    int npending;                       /* dirty victims to write back */
+    uint64_t pending[COH_MAX_LEVELS];
+    series_source_t *series;            /* its intervals, NULL if none */
+} __attribute__ ((aligned(64))) coh_core_t;
+
+typedef struct coh {
+    int ncores;
+    int nprivate;                       /* private levels per core */
+    coh_protocol_t protocol;
+    unsigned int lineshift;
+    int error;                          /* out of memory while simulating */
+    coh_core_t *cores;
+    cache_t *llc;                       /* NULL with a single level */
+    unsigned int nshards;
+    coh_shard_t *shards;
+    arena_t *arena;                     /* the private levels, LLC states */
+    stats_t *stats;                     /* a shard per core, NULL if none */
+    progress_t *progress;               /* a source per core, NULL if none */
+} coh_t;
+
+/*
+ * prepare a multi-core simulation.
+ * struct list_head *caches     [in]  : the levels, L1 first, as for
+ *                                      sim_create(). the last one is the
+ *                                      shared LLC unless it is the only one
+ * int ncores                   [in]  : 1..COH_MAX_CORES
+ * coh_protocol_t protocol      [in]  : COH_mesi or COH_moesi
+ * unsigned int nshards         [in]  : directory shards, a power of two
+ * return NULL on a bad configuration or out of memory.
+ */
+coh_t *coh_create(struct list_head *caches, int ncores,
+                  coh_protocol_t protocol, unsigned int nshards);
+void coh_destroy(coh_t *coh);
+
+/*
+ * count into s from now on, s made with a level per private level and
+ * the LLC, and a shard per core: the counts a core causes go to its own.
+ * return SUCCEED or FAIL.
+ */
+int coh_stats(coh_t *coh, stats_t *s);
+
+/*
+ * intervals of the private levels of every core from now on, to s as
+ * configuration config, source the core. the LLC is shared, it has none.
+ * coh_run() flushes the last ones.
+ * return SUCCEED or FAIL.
+ */
+int coh_series(coh_t *coh, series_t *s, uint32_t config);
+
+/*
+ * simulate one line access of a core, op is a trace_op_t. thread safe
+ * between cores, the accesses of one core must come from one thread.
+ * return the private level serving it, nprivate for the LLC, nprivate + 1
+ * for memory (nprivate without an LLC) or COH_PEER.
+ */
+int coh_access(coh_t *coh, int core, uint64_t line, int op);
+
+/* simulate one reference on core ref->cpu modulo the cores */
+void coh_ref(coh_t *coh, const trace_ref_t *ref);
+
+/*
+ * simulate a whole trace.
+ * int nthreads                 [in]  : simulating threads, the cores are
+ *                                      dealt among them. <= 0 for one per
+ *                                      online cpu
+ * return SUCCEED or FAIL.
+ */
+int coh_run(coh_t *coh, const char *trace, int nthreads);
+
+/*
+ * after coh_ref() on every reference of a trace someone else reads: the
+ * last intervals and a warning if every reference was skipped.
+ */
+void coh_end(coh_t *coh, const char *trace);
+
+/* miss ratio of a level over all cores, level nprivate is the LLC */
+double coh_miss_ratio(const coh_t *coh, int level);
+
+/* counters per core and level */
+void coh_report(const coh_t *coh, FILE *out);
+
+#endif /* __COHERENCE_H__ */
@@ -0,0 +1,55 @@
+/*
+ * @file fastmod.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Remainder by a constant divisor, for set indexing with any number of
+ * sets (48KB 12 ways, 1.25MB L2...).
+ *
+ * A power of two divisor is a mask. Any other d uses Lemire's fastmod:
+ * with M = ceil(2^128 / d), a % d is the high 64 bits of the low 128
+ * bits of M * a times d, exact for every 64 bit a and d (Lemire, Kaser,
+ * Kurz, "Faster Remainder by Direct Computation", 2019). Two multiplies
+ * instead of a 64 bit divide.
+ */
+
+#ifndef __FASTMOD_H__
+#define __FASTMOD_H__
+
+#include <stdint.h>
+
+typedef struct fastmod {
+    uint64_t d;
+    uint64_t mask;              /* d - 1 when d is a power of two, else 0 */
+    __uint128_t m;
+} fastmod_t;
+
+/* d must not be 0 */
+static inline void fastmod_init(fastmod_t *f, uint64_t d)
+{
+    f->d = d;
+    f->mask = (d & (d - 1)) ? 0 : d - 1;
+    f->m = ~(__uint128_t)0 / d + 1;
+}
+
+/* high 64 bits of the 192 bit product lo * d */
+static inline uint64_t fastmod_mulhi(__uint128_t lo, uint64_t d)
+{
+    __uint128_t bottom = ((lo & UINT64_MAX) * d) >> 64;
+    __uint128_t top = (lo >> 64) * d;
+
+    return (uint64_t)((bottom + top) >> 64);
+}
+
+static inline uint64_t fastmod_reduce(const fastmod_t *f, uint64_t a)
+{
+    if (f->mask || f->d == 1)
+        return a & f->mask;
+
+    return fastmod_mulhi(f->m * a, f->d);
+}
+
+#endif /* __FASTMOD_H__ */
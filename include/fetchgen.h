@@ -0,0 +1,74 @@
+/*
+ * @file fetchgen.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Instruction fetch traces synthesized from the control flow graph, for
+ * the ICache simulation of a binary that never runs under a tracer.
+ *
+ * The generator walks a finalized block graph (bb_graph_from_cfg() on the
+ * output of cfg_make()) from its entry to a block without successors,
+ * then starts over. A loop runs up to its bound of header executions per
+ * entry, FETCH_BOUND if unknown, and every block leaves it once the bound
+ * is reached. Elsewhere a block takes its successors in turn, or, once
+ * fetch_weight() gave its edges profile counts, draws one in proportion
+ * to them from a seeded PRNG; a bound still caps a weighted loop, and
+ * without one only a block with a profile stays past FETCH_BOUND.
+ *
+ * Every block is fetched as runs of consecutive lines, computed once: a
+ * straight-line block is one ifetch reference of nlines * linesize bytes
+ * at its first line, which the simulator splits into line accesses.
+ */
+
+#ifndef __FETCHGEN_H__
+#define __FETCHGEN_H__
+
+#include <stdint.h>
+
+#include "bbgraph.h"
+#include "simulat.h"
+#include "trace.h"
+
+#define FETCH_BOUND         16          /* iterations of an unbounded loop */
+
+typedef struct fetchgen fetchgen_t;
+
+/*
+ * a generator over g, which must outlive it.
+ * unsigned int linesize        [in]  : a power of two
+ * return NULL if no block reachable from the entry of g has
+ * instructions, on a bad linesize or out of memory.
+ */
+fetchgen_t *fetch_create(const bb_graph_t *g, unsigned int linesize,
+                         uint64_t seed);
+void fetch_destroy(fetchgen_t *f);
+
+/*
+ * the profile count of the edge from -> to, weights of 0 for its other
+ * edges until they get theirs.
+ * return SUCCEED, or FAIL if there is no such edge.
+ */
+int fetch_weight(fetchgen_t *f, int from, int to, uint64_t weight);
+
+/*
+ * the next n fetch references, one per run of lines. the walks never
+ * end, one starting at the entry as the last one leaves.
+ * return n.
+ */
+int fetch_next(fetchgen_t *f, trace_ref_t *refs, int n);
+
+/* walks that reached a block without successors so far */
+uint64_t fetch_walks(const fetchgen_t *f);
+
+/*
+ * simulate walks whole walks, or refs references if refs is not 0, on the
+ * ICache of sim, with no trace in between.
+ * return the references simulated.
+ */
+uint64_t fetch_simulate(fetchgen_t *f, sim_t *sim, uint64_t walks,
+                        uint64_t refs);
+
+#endif /* __FETCHGEN_H__ */
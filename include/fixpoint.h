@@ -0,0 +1,73 @@
+/*
+ * @file fixpoint.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Generic forward dataflow fixpoint solver over a bb_graph_t.
+ *
+ * Blocks are taken from a priority worklist ordered by strongly connected
+ * component (topological) and then by the loop aware reverse postorder,
+ * so every component, and every loop inside it innermost first, is
+ * stabilised before any block behind it is evaluated. Only blocks whose
+ * input actually changed are re-evaluated.
+ *
+ * The abstract domain (must, may, persistence ...) owns its states and
+ * hands them to the solver as 32 bit handles.
+ */
+
+#ifndef __FIXPOINT_H__
+#define __FIXPOINT_H__
+
+#include <stdint.h>
+
+#include "bbgraph.h"
+
+typedef uint32_t fp_state_t;
+
+/* no state reached this program point yet */
+#define FP_STATE_NONE       ((fp_state_t)0xffffffff)
+
+typedef struct fp_domain {
+    void *ctx;
+    /* state at the entry of the entry block */
+    fp_state_t (*entry) (void *ctx);
+    /* effect of a whole block */
+    fp_state_t (*transfer) (void *ctx, const bb_graph_t *g, int block,
+                            fp_state_t in);
+    /* effect of the edge from -> to, NULL for the identity */
+    fp_state_t (*edge) (void *ctx, const bb_graph_t *g, int from, int to,
+                        fp_state_t out);
+    /* least upper bound of two states */
+    fp_state_t (*join) (void *ctx, fp_state_t a, fp_state_t b);
+    /* NULL when handles are canonical, i.e. equal states have equal ids */
+    int (*equal) (void *ctx, fp_state_t a, fp_state_t b);
+    /* optional, called once a component reached its fixpoint */
+    void (*scc_done) (void *ctx, const bb_graph_t *g, int scc);
+} fp_domain_t;
+
+typedef struct fp_result {
+    int nblocks;
+    fp_state_t *in;             /* per block, FP_STATE_NONE if unreached */
+    fp_state_t *out;
+    unsigned long transfers;    /* block transfer evaluations */
+    unsigned long updates;      /* evaluations that changed the output */
+} fp_result_t;
+
+/*
+ * run the domain to its fixpoint.
+ * const bb_graph_t *g      [in]  : finalized graph
+ * const fp_domain_t *dom   [in]  : abstract domain
+ * fp_result_t *res         [out] : in/out state of every block
+ * return SUCCEED or FAIL.
+ */
+int fp_solve(const bb_graph_t *g, const fp_domain_t *dom, fp_result_t *res);
+
+/*
+ * release the arrays of a result, the states belong to the domain.
+ */
+void fp_result_release(fp_result_t *res);
+
+#endif /* __FIXPOINT_H__ */
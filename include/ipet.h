@@ -0,0 +1,85 @@
+/*
+ * @file ipet.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Implicit path enumeration (IPET) of the worst case execution time.
+ *
+ * The IPET problem maximizes sum(cost(b) * x(b)) over the block counts
+ * x(b) under flow conservation, x(entry) = 1 and, for every loop l,
+ * x(header(l)) <= bound(l) * entries(l). On a reducible graph with non
+ * negative costs the optimum of that program is reached by a structural
+ * max cost path: every loop is a region whose header starts a longest
+ * path over the region DAG (back edges removed, inner loops collapsed
+ * to one node per exit), the loop costs bound - 1 best cycles plus the
+ * path to its exit, and the regions are solved innermost first. This is
+ * linear in the graph size per solve.
+ *
+ * Loop regions keep their solution between solves. A new solve only
+ * recomputes the loops whose block costs, entry costs or bounds changed,
+ * and their ancestors, so a sweep over cache configurations that share a
+ * graph warm starts from the previous configuration.
+ */
+
+#ifndef __IPET_H__
+#define __IPET_H__
+
+#include <stdint.h>
+
+#include "bbgraph.h"
+#include "cache_analysis.h"
+
+#define IPET_NONE           UINT64_MAX
+
+typedef struct ipet ipet_t;
+
+typedef struct ipet_result {
+    uint64_t wcet;
+    int sink;                   /* last block of the worst case path */
+    int resolved;               /* loop regions recomputed by this solve */
+} ipet_result_t;
+
+/*
+ * prepare the regions of a finalized graph. the graph must outlive the
+ * context and its loops must all be bounded (bound is the max number of
+ * header executions per entry of the loop).
+ * return NULL if a loop is unbounded, the graph is irreducible or out of
+ * memory.
+ */
+ipet_t *ipet_create(const bb_graph_t *g);
+void ipet_destroy(ipet_t *p);
+
+/*
+ * worst case cost of a run from the entry to a block without successors.
+ * const uint64_t *block_cost   [in]  : per block and execution
+ * const uint64_t *loop_cost    [in]  : per loop and entry, may be NULL
+ * ipet_result_t *res           [out] : the bound
+ * return SUCCEED or FAIL if no block without successors is reachable.
+ */
+int ipet_solve(ipet_t *p, const uint64_t *block_cost,
+               const uint64_t *loop_cost, ipet_result_t *res);
+
+/*
+ * execution count of every block on the worst case path of the last
+ * successful solve.
+ * uint64_t *count              [out] : per block
+ */
+void ipet_counts(const ipet_t *p, uint64_t *count);
+
+/*
+ * memory cost of every block from a cache hierarchy classification.
+ * latency[l] is the time of an access served by level l, latency[nlevels]
+ * of one served by memory. an access costs the latency of the deepest
+ * level it may have to go to; a first miss costs its hit latency per
+ * execution, and the miss below once per entry of its scope loop.
+ * uint64_t *block_cost         [out] : per block
+ * uint64_t *loop_cost          [out] : per loop
+ */
+void ipet_cache_costs(const bb_graph_t *g, const ca_level_t *levels,
+                      int nlevels, const unsigned int *latency,
+                      uint64_t *block_cost, uint64_t *loop_cost);
+
+#endif /* __IPET_H__ */
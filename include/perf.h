@@ -0,0 +1,98 @@
+/*
+ * @file perf.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Hardware and kernel counters of the simulator itself, over
+ * perf_event_open(2). The counters are user space only, so they may be
+ * opened under the default perf_event_paranoid. A counter the cpu or the
+ * kernel does not offer (in most virtual machines: all hardware ones)
+ * is left out and reported as n/a. When there are more counters than
+ * the PMU has, the kernel multiplexes them and the counts are scaled.
+ *
+ * A profile splits the counts of a run into phases: the counts of the
+ * calling thread go to the phase set with perf_phase(), and the counts
+ * of the threads started between perf_threads_start() and
+ * perf_threads_stop(), the trace decoder, to the phase given there.
+ */
+
+#ifndef __PERF_H__
+#define __PERF_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum perf_event {
+    PERF_cycles = 0,
+    PERF_instructions,
+    PERF_l1d_misses,
+    PERF_llc_misses,
+    PERF_dtlb_load_misses,
+    PERF_dtlb_store_misses,
+    PERF_branch_misses,
+    PERF_page_faults,
+    PERF_EVENTS,
+} perf_event_t;
+
+typedef enum perf_phase {
+    PERF_config = 0,            /* load the configuration */
+    PERF_mrc,                   /* the miss ratio curve, all its threads */
+    PERF_build,                 /* build the caches */
+    PERF_decode,                /* decode the trace, on its own thread */
+    PERF_warmup,                /* references before the counted ones */
+    PERF_simulate,
+    PERF_PHASES,
+} perf_phase_t;
+
+#define PERF_NONE           UINT64_MAX      /* a counter not available */
+
+typedef struct perf {
+    int fd[PERF_EVENTS];
+} perf_t;
+
+typedef struct perf_profile {
+    perf_t self;                /* the calling thread */
+    perf_t all;                 /* and the threads it starts */
+    perf_phase_t phase;
+    uint64_t last[PERF_EVENTS]; /* self at the last phase change */
+    uint64_t mark[PERF_EVENTS]; /* self at perf_threads_start() */
+    uint64_t count[PERF_PHASES][PERF_EVENTS];
+    uint64_t refs[PERF_PHASES];
+    int seen[PERF_PHASES];      /* the run went through the phase */
+} perf_profile_t;
+
+/*
+ * open and start every counter of the calling thread, and with inherit
+ * of the threads it starts afterwards. return how many are available.
+ */
+int perf_start(perf_t *p, int inherit);
+
+/* the counts so far, count[e] is PERF_NONE if e is missing */
+void perf_read(const perf_t *p, uint64_t count[PERF_EVENTS]);
+
+/* read and close the counters */
+void perf_stop(perf_t *p, uint64_t count[PERF_EVENTS]);
+
+/* one line of the counts, refs > 0 adds the counts per reference */
+void perf_report(const uint64_t count[PERF_EVENTS], uint64_t refs,
+                 FILE *out);
+
+/* start a profile in phase, return how many counters are available */
+int perf_profile_start(perf_profile_t *p, perf_phase_t phase);
+
+/* the counts since the last change go to the current phase */
+void perf_phase(perf_profile_t *p, perf_phase_t phase);
+
+void perf_threads_start(perf_profile_t *p);
+void perf_threads_stop(perf_profile_t *p, perf_phase_t phase);
+
+/* close the counters, the counts so far go to the current phase */
+void perf_profile_stop(perf_profile_t *p);
+
+/* one line per phase, per reference of the phase where refs[] says */
+void perf_profile_report(const perf_profile_t *p, FILE *out);
+
+#endif /* __PERF_H__ */
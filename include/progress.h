@@ -0,0 +1,105 @@
+/*
+ * @file progress.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Progress of a long run: references done, references per second, hit
+ * rates so far, trace bytes read and the time left, sampled by a thread
+ * of its own every interval.
+ *
+ * The simulating threads never share a counter with it: each one copies
+ * its own counters into a source of its own after every batch of
+ * references, with relaxed atomic stores, and the telemetry thread sums
+ * the sources. A sample goes to stderr as one line, or to a shared page,
+ * a file of PROGRESS_PAGE bytes mapped by both sides (e.g. in /dev/shm),
+ * as "key value" lines that "watch cat" or a script can read:
+ *   elapsed 12.0               seconds
+ *   refs 123456789
+ *   rate 10288065              references per second, last interval
+ *   bytes 2962962936           of the trace read
+ *   size 8589934592            of the whole trace, 0 if unknown
+ *   eta 22.8                   seconds, -1 if unknown
+ *   L1 0.9312                  hit rate so far
+ *   ...
+ *   done 0                     1 once the run is over
+ */
+
+#ifndef __PROGRESS_H__
+#define __PROGRESS_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define PROGRESS_LEVELS     9
+#define PROGRESS_SOURCES    64
+#define PROGRESS_PAGE       4096
+
+typedef struct progress_source {
+    uint64_t refs;
+    uint64_t hits[PROGRESS_LEVELS];
+    uint64_t misses[PROGRESS_LEVELS];
+} __attribute__ ((aligned(64))) progress_source_t;
+
+typedef struct progress {
+    int nlevels;
+    int nsources;
+    progress_source_t sources[PROGRESS_SOURCES];
+    uint64_t bytes;
+    uint64_t size;
+    /* the telemetry thread */
+    unsigned int interval;              /* ms */
+    char *page;                         /* NULL for stderr */
+    pthread_t tid;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int stop;
+    double start;
+    double last;
+    uint64_t last_refs;
+} progress_t;
+
+/*
+ * sample every interval ms, to the page at path or to stderr if NULL.
+ * int nlevels, nsources        [in]  : levels and publishing sources
+ * return NULL if the page cannot be mapped or out of memory.
+ */
+progress_t *progress_start(int nlevels, int nsources, unsigned int interval,
+                           const char *path);
+
+/* a last sample marked done, then join the thread and unmap the page */
+void progress_stop(progress_t *p);
+
+/* the counters of a source, from the one thread simulating it */
+static inline void progress_refs(progress_t *p, int source, uint64_t refs)
+{
+    __atomic_store_n(&p->sources[source].refs, refs, __ATOMIC_RELAXED);
+}
+
+static inline void progress_level(progress_t *p, int source, int level,
+                                  uint64_t hits, uint64_t misses)
+{
+    progress_source_t *s = &p->sources[source];
+
+    __atomic_store_n(&s->hits[level], hits, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->misses[level], misses, __ATOMIC_RELAXED);
+}
+
+/* trace bytes read so far, and of the whole trace once known */
+static inline void progress_bytes(progress_t *p, uint64_t bytes)
+{
+    __atomic_store_n(&p->bytes, bytes, __ATOMIC_RELAXED);
+}
+
+static inline void progress_size(progress_t *p, uint64_t size)
+{
+    __atomic_store_n(&p->size, size, __ATOMIC_RELAXED);
+}
+
+/* take one sample now, to the page or to out */
+void progress_sample(progress_t *p, int done, FILE *out);
+
+#endif /* __PROGRESS_H__ */
@@ -0,0 +1,84 @@
+/*
+ * @file reuse.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Reuse (LRU stack) distance of a trace at line granularity.
+ *
+ * The distance of an access is the number of distinct lines touched
+ * since the previous access to its line; a fully associative LRU cache
+ * of C lines hits exactly the accesses at a distance below C. A hash map
+ * keeps the last access time of every line and a Fenwick tree over the
+ * times marks the last access of each line, so one access costs
+ * O(log lines). Times are renumbered when they run out of tree, which
+ * keeps the tree at most twice the lines seen.
+ *
+ * Distances are binned by octave, REUSE_SUBBINS bins each, the ones
+ * below REUSE_SUBBINS exactly. The miss ratio curve of the histogram is
+ * exact at the lower bound of every bin.
+ */
+
+#ifndef __REUSE_H__
+#define __REUSE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "trace.h"
+
+#define REUSE_SUBBINS       8
+#define REUSE_BINS          (REUSE_SUBBINS * 62)
+#define REUSE_COLD          UINT64_MAX
+
+typedef struct reuse_hist {
+    uint64_t refs;              /* line accesses */
+    uint64_t cold;              /* first accesses, infinite distance */
+    uint64_t bins[REUSE_BINS];
+} reuse_hist_t;
+
+typedef struct reuse reuse_t;
+
+/* return NULL if out of memory */
+reuse_t *reuse_create(unsigned int linesize);
+void reuse_destroy(reuse_t *r);
+
+/* return the distance of an access to line, REUSE_COLD the first time */
+uint64_t reuse_access(reuse_t *r, uint64_t line);
+
+/*
+ * forget line, the distances to come no longer count it. its next
+ * access is cold.
+ */
+void reuse_forget(reuse_t *r, uint64_t line);
+
+/* every line a reference touches, whatever its op */
+void reuse_ref(reuse_t *r, const trace_ref_t *ref);
+
+/*
+ * the distances of a whole trace, decoded on a thread of its own.
+ * return SUCCEED or FAIL.
+ */
+int reuse_run(reuse_t *r, const char *trace);
+
+const reuse_hist_t *reuse_hist(const reuse_t *r);
+
+/* bin of a distance, and the smallest distance in a bin */
+int reuse_bin(uint64_t distance);
+uint64_t reuse_bin_lower(int bin);
+
+/*
+ * miss ratio of a fully associative LRU cache of lines lines, linear
+ * between the bin bounds.
+ */
+double reuse_miss_ratio(const reuse_hist_t *h, uint64_t lines);
+
+/*
+ * the histogram and the miss ratio curve, one "bytes miss_ratio" line
+ * per bin bound from one line up to the largest distance.
+ */
+void reuse_report(const reuse_hist_t *h, unsigned int linesize, FILE *out);
+
+#endif /* __REUSE_H__ */
@@ -0,0 +1,141 @@
+/*
+ * @file series.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Time series of a run: the hits, misses and evictions of every level in
+ * each interval of a fixed number of references, for plotting the phases
+ * of a program without keeping its history.
+ *
+ * A source is one stream of intervals, a sim_t or a core of a coh_t,
+ * sampled by the thread simulating it. Its records go to a block of its
+ * own, a full block to a writer thread that formats and writes it. There
+ * are SERIES_BLOCKS blocks and one more per source, so the memory is
+ * bounded whatever the length of the run: a source finding none free
+ * waits for the writer, which always has some to free.
+ * Sources of several configurations of a sweep share one writer.
+ *
+ * A record counts one level over one interval of one source:
+ *   config     configuration of a sweep, 0 otherwise
+ *   source     core, 0 for a single core
+ *   interval   0 for the first one of the source
+ *   refs       references of the source at the end of the interval
+ *   level      1 for L1
+ *   hits, misses, evictions    in the interval
+ * The last interval of a run may be shorter. The warm-up of a run has
+ * intervals of its own, the counting ones restart at a whole interval
+ * after it, refs go on. The output is CSV with a header line, or binary:
+ * the magic SERIES_MAGIC, a uint32_t version and record size, then
+ * series_record_t in host order. The records of sources interleave, those
+ * of one source are in order.
+ */
+
+#ifndef __SERIES_H__
+#define __SERIES_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cache.h"
+
+#define SERIES_LEVELS       9
+#define SERIES_BLOCK        256         /* records per block */
+#define SERIES_BLOCKS       64          /* blocks beside one per source */
+#define SERIES_EVERY        1000000     /* references per interval */
+#define SERIES_MAGIC        "CSSERIE1"
+#define SERIES_VERSION      1
+
+typedef struct series_record {
+    uint32_t config;
+    uint16_t source;
+    uint8_t level;
+    uint8_t pad;
+    uint64_t interval;
+    uint64_t refs;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+} series_record_t;
+
+typedef struct series_block {
+    struct series_block *next;
+    struct series_block *chain;         /* every block, to free them */
+    int n;
+    series_record_t records[SERIES_BLOCK];
+} series_block_t;
+
+typedef struct series {
+    FILE *f;
+    int binary;
+    uint64_t every;                     /* references per interval */
+    series_block_t *blocks;             /* chained */
+    series_block_t *free;
+    series_block_t *full;               /* oldest first */
+    series_block_t *last;
+    pthread_mutex_t lock;
+    pthread_cond_t freed;
+    pthread_cond_t filled;
+    pthread_t tid;
+    int stop;
+    int error;                          /* a write failed */
+} series_t;
+
+typedef struct series_source {
+    series_t *s;
+    uint32_t config;
+    uint16_t source;
+    int nlevels;
+    uint64_t next;                      /* refs ending the interval */
+    uint64_t interval;
+    uint64_t base;                      /* refs before the warm-up end */
+    uint64_t start;                     /* refs starting the interval */
+    uint64_t last[SERIES_LEVELS][3];    /* counters at its start */
+    series_block_t *b;                  /* NULL until a record */
+} series_source_t;
+
+/*
+ * write the intervals of every references to path, "-" for stdout.
+ * return NULL if path cannot be created or out of memory.
+ */
+series_t *series_open(const char *path, int binary, uint64_t every);
+
+/*
+ * write what is left and close, the sources flushed.
+ * return SUCCEED, or FAIL if a write failed.
+ */
+int series_close(series_t *s);
+
+/*
+ * a source of the first nlevels levels, at most SERIES_LEVELS, of a
+ * hierarchy with its counters at 0. return NULL if out of memory.
+ */
+series_source_t *series_source(series_t *s, uint32_t config,
+                               uint16_t source, int nlevels);
+void series_source_destroy(series_source_t *src);
+
+/* the interval of src is over at refs references */
+static inline int series_due(const series_source_t *src, uint64_t refs)
+{
+    return refs >= src->next;
+}
+
+/* end the interval at refs, levels holding the counters */
+void series_sample(series_source_t *src, uint64_t refs,
+                   cache_t *const *levels);
+
+/* end a shorter last interval, if any, and hand the records over */
+void series_flush(series_source_t *src, uint64_t refs,
+                  cache_t *const *levels);
+
+/*
+ * the counters and refs of levels start over, e.g. after a warm-up:
+ * end the interval at refs and start a whole one.
+ */
+void series_restart(series_source_t *src, uint64_t refs,
+                    cache_t *const *levels);
+
+#endif /* __SERIES_H__ */
@@ -0,0 +1,125 @@
+/*
+ * @file server.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Simulation daemon on a Unix domain socket, for the many short runs of
+ * a CI: the process, its configuration and the decoded traces stay, so a
+ * job only pays for its simulation.
+ *
+ * The state lives in sessions, libcachesim handles (cachesim.h) with a
+ * server wide id that any connection may use, each with one saved state
+ * of its caches: warm a session once, save it, and restore it before
+ * every job. The binary traces a job runs are kept decoded in memory, up
+ * to a bound, the least recently run going first.
+ *
+ * Every frame is a server_frame_t and len bytes of payload, in host order.
+ * A request gets one reply, SERVER_ok, SERVER_stats or SERVER_error with
+ * a message, but for SERVER_refs: the references of a stream go without
+ * one, so a client never waits on them, and a bad one gets SERVER_error
+ * and the connection closed.
+ *   request            payload                         reply
+ *   SERVER_create      cachesim_cfg_t                  ok, uint32_t id
+ *   SERVER_load        uint64_t k, path of a cfg.cache ok, uint32_t id
+ *   SERVER_refs        uint32_t id, cachesim_ref_t[]   none
+ *   SERVER_run         uint32_t id, trace path         stats
+ *   SERVER_stats       uint32_t id                     stats
+ *   SERVER_reset       uint32_t id                     ok
+ *   SERVER_save        uint32_t id                     ok
+ *   SERVER_restore     uint32_t id                     ok
+ *   SERVER_destroy     uint32_t id                     ok
+ *   SERVER_shutdown                                    ok
+ * Paths end with a '\0'. A stats reply is a cachesim_stats_t.
+ */
+
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "cachesim.h"
+
+#define SERVER_FRAME        (16U << 20)     /* most payload bytes */
+#define SERVER_CLIENTS      64
+#define SERVER_SESSIONS     1024
+#define SERVER_TRACES       (1024ULL << 20) /* decoded bytes, by default */
+
+typedef enum server_op {
+    SERVER_create = 1,
+    SERVER_load,
+    SERVER_refs,
+    SERVER_run,
+    SERVER_stats,
+    SERVER_reset,
+    SERVER_save,
+    SERVER_restore,
+    SERVER_destroy,
+    SERVER_shutdown,
+    /* replies */
+    SERVER_ok = 0x100,
+    SERVER_stats_reply,
+    SERVER_error,
+} server_op_t;
+
+typedef struct server_frame {
+    uint32_t op;
+    uint32_t len;
+} server_frame_t;
+
+typedef struct server_session server_session_t;
+typedef struct server_trace server_trace_t;
+
+typedef struct server {
+    int fd;
+    char *path;
+    pthread_t tid;                      /* accepts */
+    pthread_mutex_t lock;               /* all below */
+    pthread_cond_t changed;
+    int stop;
+    int nclients;
+    int clients[SERVER_CLIENTS];        /* -1 if free */
+    server_session_t *sessions[SERVER_SESSIONS];
+    server_trace_t *traces;
+    uint64_t bytes;                     /* of the traces */
+    uint64_t limit;
+    uint64_t tick;
+} server_t;
+
+/*
+ * listen on path, replacing a socket left there, and serve on threads
+ * of their own.
+ * uint64_t limit               [in]  : bytes of decoded traces kept,
+ *                                      SERVER_TRACES if 0
+ * return NULL if the socket cannot be bound or out of memory.
+ */
+server_t *server_start(const char *path, uint64_t limit);
+
+/* wait for a SERVER_shutdown */
+void server_wait(server_t *s);
+
+/* close every connection, drop the sessions and remove the socket */
+void server_stop(server_t *s);
+
+/* the client side. return the socket, -1 if none listens at path */
+int server_connect(const char *path);
+
+/*
+ * one frame, its payload in two parts, e.g. an id and references.
+ * return SUCCEED or FAIL.
+ */
+int server_send(int fd, uint32_t op, const void *a, uint32_t alen,
+                const void *b, uint32_t blen);
+
+/*
+ * the next frame, its payload in buf of size bytes, *len gets its length.
+ * return SUCCEED, or FAIL at the end of the connection or on a payload
+ * larger than size.
+ */
+int server_recv(int fd, uint32_t *op, void *buf, uint32_t size,
+                uint32_t *len);
+
+#endif /* __SERVER_H__ */
@@ -0,0 +1,57 @@
+/*
+ * @file shards.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Sampled reuse distances in constant memory, after SHARDS (Waldspurger
+ * et al., FAST'15), fixed size variant.
+ *
+ * A line is sampled when the hash of its number is below a threshold T,
+ * so all accesses of a sampled line are seen and the rate is R = T/2^64.
+ * The reuse distances of the sampled lines (reuse.h) divided by R
+ * estimate the distances of the whole trace. At most max_lines lines are
+ * sampled: one more lowers T to the largest hash sampled, that line
+ * leaves the sample, and the counts so far are rescaled to the new rate.
+ * The histogram is scaled back to the whole trace at the end, the gap
+ * between expected and sampled accesses going to the shortest distances
+ * (SHARDS_adj), so reuse_miss_ratio() and reuse_report() apply as for an
+ * exact pass.
+ */
+
+#ifndef __SHARDS_H__
+#define __SHARDS_H__
+
+#include <stdint.h>
+
+#include "reuse.h"
+#include "trace.h"
+
+#define SHARDS_LINES        16384   /* sampled lines, under 2MB in all */
+
+typedef struct shards shards_t;
+
+/* return NULL if out of memory */
+shards_t *shards_create(unsigned int linesize, uint64_t max_lines);
+void shards_destroy(shards_t *s);
+
+void shards_access(shards_t *s, uint64_t line);
+
+/* every line a reference touches, whatever its op */
+void shards_ref(shards_t *s, const trace_ref_t *ref);
+
+/*
+ * the sampled distances of a whole trace, decoded on a thread of its own.
+ * return SUCCEED or FAIL.
+ */
+int shards_run(shards_t *s, const char *trace);
+
+/* the sampling rate now */
+double shards_rate(const shards_t *s);
+
+/* the estimated histogram of the whole trace */
+void shards_hist(const shards_t *s, reuse_hist_t *h);
+
+#endif /* __SHARDS_H__ */
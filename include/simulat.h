@@ -1,5 +1,5 @@
 /*
- * @file config.h
+ * @file simulat.h
  * @author charlies
  * @mail: xuguo.wong@gmail.com
  * @date 2018/08/13
@@ -7,46 +7,131 @@
  * authority: GPL v2.0
  *
  * The simulat function definition header.
+ *
+ * Trace driven simulation of a cache_t hierarchy. Every level keeps the
+ * line numbers of its ways in tags and the replacement state in repl,
+ * so all levels must share one power of two linesize.
+ *
+ * The hierarchy policy of a level is its relation to the level above,
+ * as in the static analysis:
+ *   non inclusive: filled on a miss, evicts on its own.
+ *   inclusive: filled on a miss, and a line it evicts is invalidated in
+ *       every level above.
+ *   exclusive: only filled by the lines evicted from the level above; a
+ *       line hitting there moves up.
+ * Replacement: LRU, FIFO, random, MRU, LIFO; TLRU without expiry times is
+ * LRU.
  */
 
-/*
- * Basic function.
- * verify whether a size number is pow of 2,
- * for verify cache size.
- */
 #ifndef __SIMULAT_H__
 #define __SIMULAT_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
 #include "cache.h"
-#include "elf_parser.h"
+#include "perf.h"
+#include "progress.h"
+#include "series.h"
+#include "stats.h"
+#include "trace.h"
+
+#define SIM_NONE            UINT64_MAX
 
-int log2(int num);
+typedef struct sim {
+    int nlevels;
+    cache_t **levels;           /* L1 first */
+    unsigned int lineshift;
+    uint64_t refs;              /* references simulated */
+    uint64_t skipped;           /* of the other kind than the first level */
+    uint64_t memory;            /* line accesses served by memory */
+    uint64_t warmup;            /* references run() does not count */
+    int warming;                /* still in the warm-up */
+    perf_profile_t *prof;       /* phases of run(), NULL if none */
+    stats_t *stats;             /* detailed counters, NULL if none */
+    stats_shard_t *shard;
+    uint8_t **dirty;            /* per level and slot, with stats only */
+    uint64_t writebacks;        /* dirty lines written to memory */
+    progress_t *progress;       /* source 0, run() publishes, NULL if none */
+    series_source_t *series;    /* intervals, NULL if none */
+} sim_t;
 
 /*
- * wrapper of log2 function.
+ * prepare simulate function.
+ * struct list_head *caches     [in]  : the levels, L1 first, with their
+ *                                      tags and repl allocated. they are
+ *                                      emptied, the counters are kept
+ * return NULL on an unsupported hierarchy or out of memory.
  */
-int valid_cache_size(int size);
+sim_t *sim_create(struct list_head *caches);
+void sim_destroy(sim_t *sim);
 
 /*
- * prepare simulate function.
- * concrete the global obj of cache.
- * cache_t cache    [in,out] 	: the global of cache obj
- * int arch             [in]	: type of arch, i386, x86_64
- * int type             [in]	: type of cache hardware type, e.g. ICache
- * int level            [in]  : how many level of this cache arch
- * int linesize         [in]  : how many of cache block size
- * const char * lvsize  [in]  : e.g. [32k, 64k]
- * const char *sw       [in]  : ways of cache
- * const char *hierarchy[in]  : inclusive or exclusive or NINE
- * const char *policy   [in]  : lru, fifo ...
- */
-int prepare_simulate(cache_t **cache, int arch, int type, int level, int linesize,
-             const char *lvsize, const char *sw, const char *hierarchy,
-             const char *policy);
-
-int prepare_elf_data(FILE *elffile, elf_section_t *elf);
-/*
- * 
- */
-int run(cache_t *cache, );
+ * count into shard of s from now on, s made for the levels of sim.
+ * the dirty lines are tracked too, for the writebacks.
+ * return SUCCEED or FAIL.
+ */
+int sim_stats(sim_t *sim, stats_t *s, int shard);
+
+/*
+ * intervals of sim from now on, to s as configuration config, source 0.
+ * run() flushes the last one.
+ * return SUCCEED or FAIL.
+ */
+int sim_series(sim_t *sim, series_t *s, uint32_t config);
+
+/*
+ * simulate one line access, op is a trace_op_t.
+ * return the level serving it, nlevels for memory.
+ */
+int sim_access(sim_t *sim, uint64_t line, int op);
+
+/*
+ * simulate one reference, every line it touches. references the first
+ * level does not hold (data for an ICache and the other way round) are
+ * skipped.
+ */
+void sim_ref(sim_t *sim, const trace_ref_t *ref);
+
+/*
+ * simulate a whole trace, decoded on a thread of its own. the first
+ * sim->warmup references only fill the caches, the counters start over
+ * after them. sim->prof, if set, gets the decode, warm-up and simulate
+ * phases.
+ * const char *trace            [in]  : trace file, "-" for stdin
+ * return SUCCEED or FAIL.
+ */
+int run(sim_t *sim, const char *trace);
+
+/*
+ * run() on a trace stream someone else reads, e.g. one shared by several
+ * simulators: sim_begin(), sim_refs() on every batch, then sim_end().
+ * const char *trace            [in]  : trace file, for the messages
+ */
+void sim_begin(sim_t *sim);
+void sim_refs(sim_t *sim, const trace_ref_t *refs, uint32_t n);
+void sim_end(sim_t *sim, const char *trace);
+
+/* hits and misses per level */
+void sim_report(const sim_t *sim, FILE *out);
+
+/*
+ * line operations on one level, for the engines built on this one. a
+ * slot indexes tags, repl and coh of the level.
+ */
+
+/* return the slot of line, -1 if absent. touch updates the recency */
+int64_t sim_line_lookup(cache_t *c, uint64_t line, int touch);
+
+/*
+ * put line in c, picking the victim with rng for CP_random. *slot gets
+ * the slot of line; coh[*slot] still holds the state of the victim.
+ * return the line evicted or SIM_NONE.
+ */
+uint64_t sim_line_insert(cache_t *c, uint64_t line, uint64_t *rng,
+                         uint64_t *slot);
+
+/* return the slot line was in, -1 if absent */
+int64_t sim_line_invalidate(cache_t *c, uint64_t line);
 
 #endif /* __SIMULAT_H__ */
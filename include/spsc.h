@@ -0,0 +1,69 @@
+/*
+ * @file spsc.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Lock free single producer / single consumer ring of fixed size slots.
+ *
+ * The producer fills the slot returned by spsc_acquire() and hands it
+ * over with spsc_publish(), the consumer reads the slot returned by
+ * spsc_peek() and gives it back with spsc_release(). head and tail live
+ * on their own cache lines and each side caches the other's index, so
+ * the common case touches no shared line. A full ring blocks the
+ * producer, an empty one the consumer: each side spins a while, then
+ * parks on a futex until the other side moves.
+ *
+ * The ring is one position independent block, so it may be placed in
+ * memory shared between processes (shared != 0 at spsc_init).
+ */
+
+#ifndef __SPSC_H__
+#define __SPSC_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SPSC_CACHELINE      64
+
+typedef struct spsc spsc_t;
+
+/* bytes of a ring of nslots (a power of two) slots of slot_size bytes */
+size_t spsc_size(unsigned int nslots, size_t slot_size);
+
+/*
+ * set up a ring in mem, SPSC_CACHELINE aligned and spsc_size() long.
+ * int shared                   [in]  : wake ups across processes
+ * return the ring or NULL if nslots is not a power of two.
+ */
+spsc_t *spsc_init(void *mem, unsigned int nslots, size_t slot_size,
+                  int shared);
+
+/* spsc_init on memory of its own, NULL if out of memory */
+spsc_t *spsc_create(unsigned int nslots, size_t slot_size);
+void spsc_destroy(spsc_t *q);
+
+/*
+ * producer: wait for a free slot.
+ * return the slot, NULL if the consumer closed the ring.
+ */
+void *spsc_acquire(spsc_t *q);
+void spsc_publish(spsc_t *q);
+
+/*
+ * consumer: wait for a published slot.
+ * return the slot, NULL once the ring is closed and drained.
+ */
+void *spsc_peek(spsc_t *q);
+void spsc_release(spsc_t *q);
+
+/* either side: no more slots, wakes the other side */
+void spsc_close(spsc_t *q);
+
+/* times the producer and the consumer parked */
+void spsc_stats(const spsc_t *q, uint64_t *producer_parks,
+                uint64_t *consumer_parks);
+
+#endif /* __SPSC_H__ */
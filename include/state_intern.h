@@ -0,0 +1,66 @@
+/*
+ * @file state_intern.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Hash consing of abstract states.
+ *
+ * A state is an array of 64 bit words. Interning returns the same 32 bit
+ * id for equal arrays, so program points share storage and states can be
+ * compared by id. The memo table caches results of pure functions of two
+ * 32 bit ids, e.g. transfer(state, block) or join(state, state).
+ */
+
+#ifndef __STATE_INTERN_H__
+#define __STATE_INTERN_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fixpoint.h"
+
+typedef struct si_table si_table_t;
+typedef struct si_memo si_memo_t;
+
+si_table_t *si_table_create(void);
+void si_table_destroy(si_table_t *t);
+
+/*
+ * forget every state, memory is kept for reuse.
+ */
+void si_table_reset(si_table_t *t);
+
+/*
+ * return the id of the state w[0..n), FP_STATE_NONE if out of memory.
+ */
+fp_state_t si_intern(si_table_t *t, const uint64_t *w, unsigned int n);
+
+/*
+ * words of an interned state, *n receives the count.
+ */
+const uint64_t *si_state(const si_table_t *t, fp_state_t id, unsigned int *n);
+
+/*
+ * number of distinct states and the bytes they use.
+ */
+unsigned long si_table_count(const si_table_t *t);
+size_t si_table_bytes(const si_table_t *t);
+
+si_memo_t *si_memo_create(void);
+void si_memo_destroy(si_memo_t *m);
+void si_memo_reset(si_memo_t *m);
+
+/*
+ * FP_STATE_NONE when (a, b) was never stored.
+ */
+fp_state_t si_memo_get(const si_memo_t *m, uint32_t a, uint32_t b);
+
+/*
+ * return SUCCEED or FAIL if out of memory.
+ */
+int si_memo_put(si_memo_t *m, uint32_t a, uint32_t b, fp_state_t v);
+
+#endif /* __STATE_INTERN_H__ */
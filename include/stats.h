@@ -0,0 +1,158 @@
+/*
+ * @file stats.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Detailed counters of a simulation: hits, misses, evictions and
+ * writebacks per set of every level, per instruction address and per
+ * memory region.
+ *
+ * The counters live in shards, one per simulating thread, merged at the
+ * end, so the hot path never shares a line or takes a lock. The sets are
+ * plain arrays. The instruction addresses and regions go to fixed tables
+ * of STATS_TABLE entries: an instruction by a short linear probe from a
+ * hash of its address, a region straight at its number modulo the table,
+ * as neighbouring regions are the common case. A key finding no room is
+ * counted under "other". A shard remembers the entries it used last, so
+ * the lines of one reference cost one lookup, and the entry of a new
+ * region is prefetched while the levels are searched.
+ *
+ * For a set, hits and misses are the lookups in that level. For an
+ * instruction or a region, hits are the line accesses some level served
+ * and misses those served by memory. Evictions count the lines pushed
+ * out of a level, writebacks the dirty ones among them; an instruction
+ * or a region gets those its accesses caused.
+ */
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "arena.h"
+
+#define STATS_MAX_LEVELS    9
+#define STATS_TABLE         8192        /* entries per table, power of two */
+#define STATS_PROBES        8
+
+typedef struct stats_count {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t writebacks;
+} stats_count_t;
+
+typedef struct stats_entry {
+    uint64_t key;                       /* key + 1, 0 if free */
+    stats_count_t n;
+} stats_entry_t;
+
+typedef struct stats_shard {
+    stats_count_t *sets[STATS_MAX_LEVELS];
+    stats_entry_t *pcs;
+    stats_entry_t *regions;
+    stats_count_t pc_other;
+    stats_count_t region_other;
+    /* the entries of the reference being simulated */
+    uint64_t pc;
+    stats_count_t *pc_cur;
+    uint64_t region;
+    stats_count_t *region_cur;
+} __attribute__ ((aligned(64))) stats_shard_t;
+
+typedef struct stats {
+    int nlevels;
+    unsigned int sets[STATS_MAX_LEVELS];
+    unsigned int region_shift;          /* address -> region */
+    int nshards;
+    stats_shard_t *shards;
+    arena_t *arena;
+} stats_t;
+
+/*
+ * counters for nlevels levels of sets[l] sets, in nshards shards.
+ * unsigned int region          [in]  : bytes of a region, a power of two
+ * return NULL out of memory.
+ */
+stats_t *stats_create(int nlevels, const unsigned int *sets, int nshards,
+                      unsigned int region);
+void stats_destroy(stats_t *s);
+
+/* the instruction of the next reference, 0 if unknown */
+void stats_ref(stats_t *s, stats_shard_t *sh, uint64_t pc);
+
+/* the entry of sh->region */
+stats_count_t *stats_find_region(stats_shard_t *sh);
+
+/* the region of the next line access */
+static inline void stats_line(stats_t *s, stats_shard_t *sh, uint64_t addr)
+{
+    uint64_t region = addr >> s->region_shift;
+
+    if (region != sh->region || !sh->region_cur) {
+        sh->region = region;
+        sh->region_cur = NULL;
+        __builtin_prefetch(&sh->regions[region & (STATS_TABLE - 1)], 1);
+    }
+}
+
+static inline stats_count_t *stats_region(stats_shard_t *sh)
+{
+    if (!sh->region_cur)
+        sh->region_cur = stats_find_region(sh);
+
+    return sh->region_cur;
+}
+
+static inline stats_count_t *stats_set(stats_shard_t *sh, int level,
+                                       unsigned int set)
+{
+    return &sh->sets[level][set];
+}
+
+/* a line pushed out of a set, by the reference being simulated */
+static inline void stats_evict(stats_shard_t *sh, int level, unsigned int set,
+                               int dirty)
+{
+    stats_count_t *n = stats_set(sh, level, set);
+    stats_count_t *r = stats_region(sh);
+
+    n->evictions++;
+    n->writebacks += dirty;
+    sh->pc_cur->evictions++;
+    sh->pc_cur->writebacks += dirty;
+    r->evictions++;
+    r->writebacks += dirty;
+}
+
+/* a line access some level (hit) or memory served */
+static inline void stats_served(stats_shard_t *sh, int hit)
+{
+    stats_count_t *r = stats_region(sh);
+
+    sh->pc_cur->hits += hit;
+    sh->pc_cur->misses += !hit;
+    r->hits += hit;
+    r->misses += !hit;
+}
+
+/* zero every counter */
+void stats_reset(stats_t *s);
+
+/* add every shard into the first one */
+void stats_merge(stats_t *s);
+
+/*
+ * write the merged counters to path, one line per set, instruction and
+ * region that saw any access, and a summary of the busiest sets to out.
+ * const char **names           [in]  : name of each level
+ * return SUCCEED or FAIL.
+ */
+int stats_export(const stats_t *s, const char **names, const char *path,
+                 FILE *out);
+
+#endif /* __STATS_H__ */
@@ -0,0 +1,84 @@
+/*
+ * @file sweep.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Parameter sweeps in the configuration file.
+ *
+ * The value of a sweep parameter is a comma list with one item per cache
+ * level. An item is either a plain value or a set of values:
+ *   8              the value itself
+ *   2..16          every value from 2 to 16
+ *   2..16:pow2     2, 4, 8, 16
+ *   32K..2M:*4     32K, 128K, 512K, 2M (":+n" steps by adding n)
+ *   {32K,48K,1M}   the listed values, each may be a range
+ * Items with a brace set may also be separated by 'x', so
+ *   lvsize={32K,64K}x{1M,2M}
+ * sweeps two levels over four configurations. The configurations are the
+ * Cartesian product of every item of every parameter, numbered 0 to
+ * count - 1 with the last item of the file varying fastest.
+ */
+
+#ifndef __SWEEP_H__
+#define __SWEEP_H__
+
+#include <stdint.h>
+
+/* bounds on the values of one item and on the configurations */
+#define CFG_SWEEP_MAX_VALUES    4096
+#define CFG_SWEEP_MAX_CONFIGS   (1 << 20)
+
+typedef struct cfg_sweep cfg_sweep_t;
+
+cfg_sweep_t *cfg_sweep_create(void);
+void cfg_sweep_destroy(cfg_sweep_t *s);
+
+/*
+ * expand the value of a parameter, replacing a previous value.
+ * const char *parameter        [in]  : name of the parameter
+ * const char *value            [in]  : sweep syntax as above
+ * return SUCCEED or FAIL on a syntax error or too many configurations.
+ */
+int cfg_sweep_add(cfg_sweep_t *s, const char *parameter, const char *value);
+
+/* return 1 if the parameter was given */
+int cfg_sweep_has(const cfg_sweep_t *s, const char *parameter);
+
+uint64_t cfg_sweep_count(const cfg_sweep_t *s);
+
+/*
+ * value of a parameter in configuration k, the items joined by ','.
+ * range values are decimal, set members are copied as written.
+ * char *buf                    [out] : the value
+ * return SUCCEED or FAIL if the parameter is unknown or buf too small.
+ */
+int cfg_sweep_get(const cfg_sweep_t *s, const char *parameter, uint64_t k,
+                  char *buf, size_t size);
+
+/*
+ * "parameter=value" of every swept parameter of configuration k, space
+ * separated, empty when nothing is swept.
+ */
+int cfg_sweep_label(const cfg_sweep_t *s, uint64_t k, char *buf, size_t size);
+
+/*
+ * run one configuration, called from the threads of cfg_sweep_run().
+ * return SUCCEED or FAIL.
+ */
+typedef int (*cfg_sweep_fn_t)(const cfg_sweep_t *s, uint64_t k, void *arg);
+
+/*
+ * run every configuration on a pool of threads. state shared by the
+ * configurations, e.g. the ca_program_t of a tool analyzing each one
+ * (cache-simulator itself only simulates), goes through arg; work that is
+ * itself parallel should then run single threaded inside fn.
+ * int nthreads                 [in]  : pool size, 0 for one per cpu
+ * return SUCCEED, or FAIL if a configuration failed. the others still run.
+ */
+int cfg_sweep_run(const cfg_sweep_t *s, int nthreads, cfg_sweep_fn_t fn,
+                  void *arg);
+
+#endif /* __SWEEP_H__ */
@@ -0,0 +1,109 @@
+/*
+ * @file trace.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Memory reference traces.
+ *
+ * Two file formats are read, told apart by the first bytes:
+ *   binary: the TRACE_MAGIC header, then trace_ref_t records in host
+ *       byte order.
+ *   text: one reference per line, "op address [size [pc [cpu]]]" with
+ *       numbers in hex (0x optional); op is r, w or i, or the dinero
+ *       codes 0 (read), 1 (write) and 2 (instruction fetch). '#' starts
+ *       a comment.
+ * A path starting with "gen:" is no file but a synthetic trace, see
+ * tracegen.h, and one starting with "shm:" the references of a tracer
+ * in another process, see tracering.h.
+ *
+ * A trace stream decodes a trace on a thread of its own into a ring of
+ * batches (spsc.h), so decoding and simulation overlap. The batches of a
+ * tracer come as they are.
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define TRACE_MAGIC         "CSTRACE1"
+#define TRACE_BATCH         1024        /* references per batch */
+#define TRACE_RING_SLOTS    16          /* batches in flight */
+
+typedef enum trace_op {
+    TRACE_read = 0,
+    TRACE_write,
+    TRACE_ifetch,
+} trace_op_t;
+
+typedef struct trace_ref {
+    uint64_t addr;
+    uint64_t pc;                /* 0 when unknown */
+    uint32_t size;
+    uint16_t cpu;
+    uint8_t op;                 /* trace_op_t */
+    uint8_t flags;
+} trace_ref_t;
+
+typedef struct trace_batch {
+    uint32_t n;                 /* 0 ends the stream */
+    uint64_t bytes;             /* of the trace, read up to this batch */
+    trace_ref_t refs[TRACE_BATCH];
+} trace_batch_t;
+
+typedef struct trace_reader trace_reader_t;
+
+/* return NULL if the file cannot be opened or has no known format */
+trace_reader_t *trace_open(const char *path);
+void trace_close(trace_reader_t *r);
+
+/*
+ * decode up to n references.
+ * return the number decoded, 0 at the end, -1 on a malformed trace.
+ */
+int trace_read(trace_reader_t *r, trace_ref_t *refs, int n);
+
+/*
+ * bytes consumed from the file so far, and the size of the file, 0 if
+ * unknown. a synthetic trace counts the bytes of its binary form.
+ */
+uint64_t trace_bytes(const trace_reader_t *r);
+uint64_t trace_size(const trace_reader_t *r);
+
+/*
+ * write a binary trace: the header once, then the references.
+ * return SUCCEED or FAIL.
+ */
+int trace_write_header(FILE *f);
+int trace_write(FILE *f, const trace_ref_t *refs, int n);
+
+typedef struct trace_stream trace_stream_t;
+
+/*
+ * start decoding r on a thread of its own. r belongs to the stream
+ * until trace_stream_stop().
+ * return NULL if out of memory, r is still the caller's then.
+ */
+trace_stream_t *trace_stream_start(trace_reader_t *r);
+
+/*
+ * the next batch, valid until trace_stream_release().
+ * uint32_t *n                  [out] : its references, read once: the
+ *                                      batch of a trace ring is shared
+ *                                      with the tracer, use n, not b->n
+ * return NULL at the end of the trace or on a corrupt batch.
+ */
+const trace_batch_t *trace_stream_next(trace_stream_t *s, uint32_t *n);
+void trace_stream_release(trace_stream_t *s);
+
+/*
+ * stop the decoder, early or at the end, and free the stream.
+ * return SUCCEED, or FAIL if the trace was malformed.
+ */
+int trace_stream_stop(trace_stream_t *s);
+
+#endif /* __TRACE_H__ */
@@ -0,0 +1,101 @@
+/*
+ * @file tracegen.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Synthetic traces: the references of parameterized access patterns,
+ * generated on the fly from seeded PRNGs, so the same specification gives
+ * the same trace and a run of 10^10 references needs no file.
+ *
+ * A generator interleaves up to GEN_MAX_STREAMS streams, each drawn for
+ * the next reference with a probability of its weight. A trace path of
+ * the form "gen:<specification>" opens a generator instead of a file
+ * (trace.h), the specification being clauses separated by ';':
+ *   refs=N,seed=N                  references in all (1M by default)
+ *                                  and the seed of every PRNG
+ *   <pattern>[,key=value...]       one stream
+ * with the patterns and their keys:
+ *   strided    a[i * stride % n]                           n, stride
+ *   stencil    5-point Jacobi sweeps of an n x n grid into
+ *              a second one, then back                     n
+ *   matmul     C += A * B of n x n matrices, in tile x
+ *              tile blocks                                 n, tile
+ *   hash       lookups of random keys in an open addressed
+ *              table of n buckets, 1 to probes probes      n, probes
+ *   zipf       lookups of n keys, key k drawn with a
+ *              probability of 1 / k^s, scattered           n, s
+ * and for every stream elem (bytes per element, 8), writes (percent of
+ * the lookups that store, strided, hash and zipf), weight (1), base and
+ * pc (addresses of the first array and instruction, apart for every
+ * stream by default) and cpu. Numbers take the K, M, G and T suffixes or
+ * a 0x prefix, e.g.
+ *   gen:refs=10G;zipf,n=1M,s=0.99,weight=3;strided,n=64M,stride=17
+ */
+
+#ifndef __TRACEGEN_H__
+#define __TRACEGEN_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "trace.h"
+
+#define GEN_PREFIX          "gen:"
+#define GEN_MAX_STREAMS     16
+
+typedef enum gen_pattern {
+    GEN_strided = 0,
+    GEN_stencil,
+    GEN_matmul,
+    GEN_hash,
+    GEN_zipf,
+    GEN_PATTERNS,
+} gen_pattern_t;
+
+typedef struct gen_spec {
+    gen_pattern_t pattern;
+    uint64_t n;                 /* elements, or the side of a grid */
+    uint64_t stride;            /* strided, in elements */
+    uint64_t tile;              /* matmul, in elements */
+    uint32_t probes;            /* hash, most buckets of a lookup */
+    double s;                   /* zipf exponent */
+    uint32_t elem;              /* bytes per element */
+    uint32_t writes;            /* percent */
+    uint32_t weight;
+    uint64_t base;
+    uint64_t pc;
+    uint16_t cpu;
+} gen_spec_t;
+
+typedef struct gen gen_t;
+
+/* the defaults of stream k of a pattern */
+void gen_spec_init(gen_spec_t *spec, gen_pattern_t pattern, int k);
+
+/*
+ * a generator of refs references of n streams.
+ * return NULL on a bad specification or out of memory.
+ */
+gen_t *gen_create(const gen_spec_t *specs, int n, uint64_t seed,
+                  uint64_t refs);
+
+/* a generator from the syntax above, without the prefix */
+gen_t *gen_parse(const char *text);
+void gen_destroy(gen_t *g);
+
+/* the next references, up to n. return the number, 0 at the end */
+int gen_next(gen_t *g, trace_ref_t *refs, int n);
+
+/* references in all */
+uint64_t gen_refs(const gen_t *g);
+
+/*
+ * the rest of the references as a binary trace.
+ * return SUCCEED or FAIL.
+ */
+int gen_write(gen_t *g, FILE *f);
+
+#endif /* __TRACEGEN_H__ */
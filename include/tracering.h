@@ -0,0 +1,91 @@
+/*
+ * @file tracering.h
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Trace rings: the references of a tracer in another process, e.g. a
+ * dynamic instrumentation tool or an emulator, handed over live through
+ * shared memory instead of a trace file.
+ *
+ * A ring is a spsc ring (spsc.h) of trace batches in shared memory, so
+ * the tracer fills whole batches in place and both sides park on futexes
+ * when the other falls behind. A trace stream (trace.h) takes the batches
+ * straight from the ring, with no decoder thread and no copy.
+ *
+ * A trace path "shm:<name>" reads a ring:
+ *   shm:/name      a POSIX shared memory object, created by the simulator
+ *                  (replacing one a crashed run left) and removed when the
+ *                  trace is closed; the tracer attaches to it by name,
+ *                  before or after the simulator starts
+ *   shm:N          descriptor N, inherited from a tracer that made the
+ *                  ring with tracering_create(NULL, ...) and started the
+ *                  simulator
+ * The tracer, linking trace/tracering.c and trace/spsc.c:
+ *   tracering_t *t = tracering_attach("/name");
+ *   while (tracing) {
+ *       trace_ref_t *refs = tracering_batch(t);    NULL: simulator gone
+ *       ... up to TRACE_BATCH references ...
+ *       tracering_publish(t, n);
+ *   }
+ *   tracering_end(t);
+ *   tracering_close(t);
+ * A tracer dying without tracering_end() leaves the simulator waiting.
+ */
+
+#ifndef __TRACERING_H__
+#define __TRACERING_H__
+
+#include <stdint.h>
+
+#include "trace.h"
+
+#define RING_PREFIX         "shm:"
+#define RING_MAGIC          "CSRING01"
+#define RING_SLOTS          64          /* batches, by default */
+#define RING_WAIT           60          /* seconds to attach, at most */
+
+typedef struct spsc spsc_t;
+typedef struct tracering tracering_t;
+
+/*
+ * a ring of nslots batches (a power of two, RING_SLOTS if 0).
+ * const char *name             [in]  : a shared memory object, replaced
+ *                                      if there, or NULL for a memfd to
+ *                                      hand to a child, see tracering_fd()
+ * return NULL on a bad name or out of memory.
+ */
+tracering_t *tracering_create(const char *name, unsigned int nslots);
+
+/*
+ * the ring of another process, a shared memory object or the number of
+ * an inherited descriptor, waiting up to RING_WAIT seconds for it to be
+ * created.
+ * return NULL if none comes or it is no ring of this build.
+ */
+tracering_t *tracering_attach(const char *name);
+
+/* unmap, and remove the object if created here */
+void tracering_close(tracering_t *t);
+
+/* the descriptor of the ring, for a child to tracering_attach() */
+int tracering_fd(const tracering_t *t);
+
+/* the batches, for a trace stream */
+spsc_t *tracering_queue(tracering_t *t);
+
+/*
+ * producer: room for TRACE_BATCH references in the next batch.
+ * return NULL once the consumer closed the ring.
+ */
+trace_ref_t *tracering_batch(tracering_t *t);
+
+/* hand over the n references of the batch */
+void tracering_publish(tracering_t *t, uint32_t n);
+
+/* no more references: the consumer drains the ring and ends */
+void tracering_end(tracering_t *t);
+
+#endif /* __TRACERING_H__ */
@@ -11,42 +11,152 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "cfg.h"
+#include "arena.h"
 #include "cache.h"
+#include "coherence.h"
 #include "list.h"
+#include "perf.h"
+#include "progress.h"
+#include "reuse.h"
+#include "series.h"
+#include "server.h"
+#include "shards.h"
+#include "simulat.h"
+#include "spsc.h"
+#include "sweep.h"
+#include "tracering.h"
 
 static char *cfg_file = "conf/cfg.cache";
 
 cache_t g_cache;
 
 /* for read the data from config file */
-int cfg_type;
+int cfg_type = DCache;
 int cfg_level;
-int cfg_linesize;
 int cfg_arch;
-char *cfg_lvsize;
-char *cfg_sw;
-char *cfg_hierarchy;
-char *cfg_policy;
+/* optional trace to simulate, "-" is stdin, "gen:..." synthetic */
+char *cfg_trace;
+/* cores sharing the last level, 0: MESI, 1: MOESI */
+int cfg_cores;
+int cfg_coherence;
+/* miss ratio curve of the trace, 1: exact, 2: sampled */
+int cfg_mrc;
+/* pages of the cache storage, 0: transparent huge, 1: reserved huge, 2: small */
+int cfg_hugepages;
+/* references filling the caches before the counted ones */
+int cfg_warmup;
+/* counters of the simulator per phase of the run */
+int cfg_profile;
+/* file of the counters per set, instruction and region */
+char *cfg_stats;
+/* bytes of a region of cfg_stats, 4096 if 0 */
+int cfg_stats_region;
+/* seconds between progress samples, 0: none; their page, stderr if none */
+int cfg_progress;
+char *cfg_progress_page;
+/* file of the hits, misses and evictions per interval of references */
+char *cfg_series;
+int cfg_series_interval;
+int cfg_series_binary;
+char *cfg_serve;
+int cfg_serve_traces;
+/* linesize, lvsize, sw, hierarchy and policy, may sweep */
+cfg_sweep_t *cfg_sweep;
 struct list_head g_caches;
+arena_t *g_arena;
+perf_profile_t g_prof;
+series_t *g_series;
+
+#define CFG_VALUE_LEN       256
+
+/* the values of one configuration of the sweep */
+typedef struct cache_cfg {
+    char linesize[CFG_VALUE_LEN];
+    char lvsize[CFG_VALUE_LEN];
+    char sw[CFG_VALUE_LEN];
+    char hierarchy[CFG_VALUE_LEN];
+    char policy[CFG_VALUE_LEN];
+} cache_cfg_t;
+
+typedef struct sweep_result {
+    char label[MAX_STRING_LEN];
+    char summary[MAX_STRING_LEN];
+    int ret;
+    struct list_head caches;    /* built, waiting for the trace */
+    arena_t *arena;
+    sim_t *sim;
+    coh_t *coh;
+} sweep_result_t;
+
+/* a thread of the shared trace, feeding the configurations id, id + n.. */
+typedef struct sweep_worker {
+    sweep_result_t *results;
+    uint64_t count;
+    int id;
+    int nworkers;               /* read after the first batch */
+    spsc_t *q;                  /* copies of the batches */
+    pthread_t tid;
+} sweep_worker_t;
 
 extern cache_operations_t cache_inclusive;
 
+static int get_cache_cfg(const cfg_sweep_t *s, uint64_t k, cache_cfg_t *c)
+{
+    if (SUCCEED != cfg_sweep_get(s, "linesize", k, c->linesize,
+                                 sizeof(c->linesize)) ||
+        SUCCEED != cfg_sweep_get(s, "lvsize", k, c->lvsize,
+                                 sizeof(c->lvsize)) ||
+        SUCCEED != cfg_sweep_get(s, "sw", k, c->sw, sizeof(c->sw)) ||
+        SUCCEED != cfg_sweep_get(s, "hierarchy", k, c->hierarchy,
+                                 sizeof(c->hierarchy)) ||
+        SUCCEED != cfg_sweep_get(s, "policy", k, c->policy,
+                                 sizeof(c->policy)))
+        return FAIL;
+
+    return SUCCEED;
+}
+
+/*
+ * one value per level from a comma list, a short list repeats its last
+ * value for the levels below. reentrant, the sweep runs it on threads.
+ */
+static int parse_levels(const char *str, int *v, int n)
+{
+    int index = 0;
+
+    while (index < n) {
+        v[index++] = atoi(str);
+        if (!(str = strchr(str, ',')))
+            break;
+        str++;
+    }
+    for (; index > 0 && index < n; ++index)
+        v[index] = v[index - 1];
+
+    return index ? SUCCEED : FAIL;
+}
+
 static int load_cfg()
 {
     /* read configuration from user settins */
     /*
+      ## linesize, lvsize, sw, hierarchy and policy take sweeps, see
+      ## sweep.h, e.g. sw = 2..16:pow2 or lvsize = {32K,48K}x{1M,2M}
       ## define hardware arch
       ## 1. i386, 2. x86_64, 3. arm
       arch=1
       ## define cache type
-      ## ICache or DCache
+      ## 0. ICache, 1. DCache (if not set)
       type = 0
       ## define the cache level
       level = 3 
-      ## define every cache level's size, 32K, 64K, 2M
-      lvsize = 1,5,8
+      ## define every cache level's size in bytes, 32K, 48K, 1280K, 2M
+      lvsize = 16K,1M,8M
       ## define every cache line's size, 16B, 32B
       ## define cache set associative
       sw = 2
@@ -57,78 +167,138 @@ static int load_cfg()
       hierarchy = 0,1,2
       ## define every cache level's conservative policy
       policy = 1,2,2
+      ## simulate a trace, see trace.h
+      trace = 
+      ## cores with private levels above a shared last level
+      cores = 1
+      ## 0. MESI, 1. MOESI
+      coherence = 0
+      ## miss ratio curve from the reuse distances of the trace
+      ## 1. exact, 2. sampled in constant memory
+      mrc = 0
+      ## pages of the cache storage
+      ## 0. transparent huge pages, 1. reserved huge pages, 2. small pages
+      hugepages = 0
+      ## references only filling the caches, not counted
+      warmup = 0
+      ## hardware counters of the simulator per phase of the run
+      profile = 0
+      ## counters per set, instruction and region written to a file
+      stats = /tmp/stats.txt
+      ## bytes of a region of the stats, a power of two
+      stats_region = 4096
+      ## seconds between progress samples of a trace run, 0 for none
+      progress = 0
+      ## shared page of the samples, stderr if none
+      progress_page = /dev/shm/cache-simulator
+      ## hits, misses and evictions per level and interval of a trace run
+      series = /tmp/series.csv
+      ## references per interval, 1000000 if 0
+      series_interval = 1000000
+      ## 0. CSV, 1. binary records, see series.h
+      series_binary = 0
+      ## serve jobs on a Unix domain socket until shut down, see server.h
+      serve = /tmp/cache-simulator.sock
+      ## MB of decoded traces the server keeps, 1024 if 0
+      serve_traces = 1024
      */
     struct cfg_line cfg[] = {
         {"arch", &cfg_arch, TYPE_INT, PARM_MAND, 0, 1},
-        {"type", &cfg_type, TYPE_INT, PARM_MAND, 0, 1},
+        {"type", &cfg_type, TYPE_INT, PARM_OPT, 0, 1},
         {"level", &cfg_level, TYPE_INT, PARM_MAND, 0, 3},
-        {"linesize", &cfg_linesize, TYPE_INT, PARM_MAND, 0, 64},
-        {"lvsize", &cfg_lvsize, TYPE_STRING, PARM_MAND, 0, 0},
-        {"sw", &cfg_sw, TYPE_STRING, PARM_MAND, 0, 0},
-        {"hierarchy", &cfg_hierarchy, TYPE_STRING, PARM_MAND, 0, 0},
-        {"policy", &cfg_policy, TYPE_STRING, PARM_MAND, 0, 0},
+        {"linesize", &cfg_sweep, TYPE_SWEEP, PARM_MAND, 0, 0},
+        {"lvsize", &cfg_sweep, TYPE_SWEEP, PARM_MAND, 0, 0},
+        {"sw", &cfg_sweep, TYPE_SWEEP, PARM_MAND, 0, 0},
+        {"hierarchy", &cfg_sweep, TYPE_SWEEP, PARM_MAND, 0, 0},
+        {"policy", &cfg_sweep, TYPE_SWEEP, PARM_MAND, 0, 0},
+        {"trace", &cfg_trace, TYPE_STRING, PARM_OPT, 0, 0},
+        {"cores", &cfg_cores, TYPE_INT, PARM_OPT, 0, COH_MAX_CORES},
+        {"coherence", &cfg_coherence, TYPE_INT, PARM_OPT, 0, 1},
+        {"mrc", &cfg_mrc, TYPE_INT, PARM_OPT, 0, 2},
+        {"hugepages", &cfg_hugepages, TYPE_INT, PARM_OPT, 0, 2},
+        {"warmup", &cfg_warmup, TYPE_INT, PARM_OPT, 0, INT_MAX},
+        {"profile", &cfg_profile, TYPE_INT, PARM_OPT, 0, 1},
+        {"stats", &cfg_stats, TYPE_STRING, PARM_OPT, 0, 0},
+        {"stats_region", &cfg_stats_region, TYPE_INT, PARM_OPT, 0, INT_MAX},
+        {"progress", &cfg_progress, TYPE_INT, PARM_OPT, 0, 3600},
+        {"progress_page", &cfg_progress_page, TYPE_STRING, PARM_OPT, 0, 0},
+        {"series", &cfg_series, TYPE_STRING, PARM_OPT, 0, 0},
+        {"series_interval", &cfg_series_interval, TYPE_INT, PARM_OPT, 0,
+         INT_MAX},
+        {"series_binary", &cfg_series_binary, TYPE_INT, PARM_OPT, 0, 1},
+        {"serve", &cfg_serve, TYPE_STRING, PARM_OPT, 0, 0},
+        {"serve_traces", &cfg_serve_traces, TYPE_INT, PARM_OPT, 0, 1 << 20},
         {NULL, NULL, 0, 0, 0, 0}
     };
+    cache_cfg_t first;
 
-    parse_cfg_file(cfg_file, cfg, 1, 1);
+    cfg_sweep = cfg_sweep_create();
+    if (!cfg_sweep)
+        return FAIL;
+    if (SUCCEED != parse_cfg_file(cfg_file, cfg, 1, 1) ||
+        SUCCEED != get_cache_cfg(cfg_sweep, 0, &first))
+        return FAIL;
 
     printf("\nuser settinngs:"                  \
            "\n\t1. arch: %d"                    \
            "\n\t1. type: %d"                    \
            "\n\t2. level: %d"                   \
-           "\n\t3. linesize: %d"                \
+           "\n\t3. linesize: %s"                \
            "\n\t4. lvsize: %s"                  \
            "\n\t5. sw: %s"                      \
            "\n\t6. hierarchy: %s"               \
-           "\n\t7. policy: %s",                 \
-           cfg_arch, cfg_type, cfg_level, cfg_linesize, cfg_lvsize,
-           cfg_sw, cfg_hierarchy, cfg_policy);
+           "\n\t7. policy: %s"                  \
+           "\n\t8. configurations: %llu"        \
+           "\n\t9. trace: %s"                   \
+           "\n\t10. cores: %d",                 \
+           cfg_arch, cfg_type, cfg_level, first.linesize, first.lvsize,
+           first.sw, first.hierarchy, first.policy,
+           (unsigned long long)cfg_sweep_count(cfg_sweep),
+           cfg_trace ? cfg_trace : "none", cfg_cores ? cfg_cores : 1);
+
+    return SUCCEED;
 }
 
-int *get_cache_lvsize()
+/*
+ * one size in bytes per level, K, M, G and T suffixes allowed. a short
+ * list repeats its last size for the levels below.
+ */
+uint64_t *get_cache_lvsize(const char *str)
 {
-	int *lvsize = malloc(sizeof(int)*cfg_level);
-	char *str_lvsize = cfg_lvsize;
-	char *delim = ",", *token = NULL;
+	uint64_t *lvsize = malloc(sizeof(uint64_t)*cfg_level);
+	char token[64];
 	int index = 0;
+	size_t n;
 
-	token = strtok(str_lvsize, delim);
-	while (token) {
-		lvsize[index++]	 = atoi(token);
-		token = strtok(NULL, delim);
+	while (lvsize && index < cfg_level) {
+		n = strcspn(str, ",");
+		if (n >= sizeof(token))
+			goto fail;
+		memcpy(token, str, n);
+		token[n] = '\0';
+		str_lrtrim(token, " \t");
+		if (SUCCEED != str2uint64(token, "KMGT", &lvsize[index++]))
+			goto fail;
+		if (',' != str[n])
+			break;
+		str += n + 1;
 	}
+	for (; lvsize && index < cfg_level; ++index)
+		lvsize[index] = lvsize[index - 1];
 
 	return lvsize;
+fail:
+	free(lvsize);
+	return NULL;
 }
 
-#define CACHE_LV_2_SIZE_K(index) ({int k = 1024; int size = 0;			\
-						switch(index)                                           \
-                {                                                   \
-								case 1: size = 16*k;	 break;                       \
-								case 2: size = 32*k;	break;                        \
-								case 3: size = 64*k;	break;                        \
-								case 4: size = 128*k;	break;                        \
-								case 5: size = k*k;		break;                        \
-								case 6: size = 2*k*k;	break;                        \
-								case 7: size = 4*k*k;	break;                        \
-								case 8: size = 8*k*k;	break;                        \
-              	case 9: size = 16*k*k;	break;                      \
-								default: size = 64*k;	break;                        \
-                }                                                   \
-						size;                                                   \
-					})
-
-int *get_cache_sways()
+int *get_cache_sways(const char *str)
 {
     int *sw = malloc(sizeof(int)*cfg_level);
-    char *str_sw = cfg_sw;
-    char *delim = ",", *token = NULL;
-    int index = 0;
 
-    token = strtok(str_sw, delim);
-    while (token) {
-        sw[index++]	 = atoi(token);
-        token = strtok(NULL, delim);
+    if (sw && SUCCEED != parse_levels(str, sw, cfg_level)) {
+        free(sw);
+        return NULL;
     }
 
     return sw;
@@ -136,59 +306,602 @@ int *get_cache_sways()
 
 #define SET_WAYS_2_SETS(size, linesize, ways) ((size)/(linesize)/(ways))
 
+/* hierarchy in cfg.cache: 0. INCLUSIVE, 1. NON-INCLUSIVE, 2. EXCLUSIVE */
+static cache_hierarchy_policy_t cfg_2_hierarchy[] = {
+    H_inclusive, H_non_exclusive, H_exclusive,
+};
 
-int main()
+cache_hierarchy_policy_t *get_cache_hierarchy(const char *str)
 {
-    int cache_line = 0, linesize;
-    int set_associatives = 0;
-    int *lvsize = NULL;
-    int *sw = NULL;
-    int size = 0;
-    int ways = 0;
+    cache_hierarchy_policy_t *hp = calloc(cfg_level, sizeof(*hp));
+    int *v = malloc(sizeof(int) * cfg_level);
 
-    printf("<usage - first> sets the config files in conf/cfg.cache \n");
-    INIT_LIST_HEAD(&g_caches);
-    load_cfg();
+    if (!hp || !v || SUCCEED != parse_levels(str, v, cfg_level)) {
+        free(hp);
+        free(v);
+        return NULL;
+    }
+    for (int index = 0; index < cfg_level; ++index)
+        hp[index] = (v[index] >= 0 && v[index] <= 2) ?
+                    cfg_2_hierarchy[v[index]] : H_unknown;
+    free(v);
 
-    lvsize = get_cache_lvsize();
-    sw = get_cache_sways();
+    return hp;
+}
 
-    if (!lvsize || !sw) {
-        puts("please adjust cfg.cache file about cache parameters");
-        return -1;
+cache_conservative_policy_t *get_cache_policy(const char *str)
+{
+    cache_conservative_policy_t *cp = calloc(cfg_level, sizeof(*cp));
+    int *v = malloc(sizeof(int) * cfg_level);
+
+    if (!cp || !v || SUCCEED != parse_levels(str, v, cfg_level)) {
+        free(cp);
+        free(v);
+        return NULL;
     }
+    for (int index = 0; index < cfg_level; ++index)
+        cp[index] = (v[index] >= CP_random && v[index] <= CP_mru) ?
+                    v[index] : CP_unknown;
+    free(v);
+
+    return cp;
+}
+
+/* the arena for the levels of one configuration, as cfg_hugepages says */
+arena_t *create_arena(void)
+{
+    static const int flags[] = { ARENA_THP, ARENA_HUGETLB, 0 };
+
+    return arena_create(flags[cfg_hugepages]);
+}
+
+/* drop the levels of a configuration, all at once */
+void release_caches(struct list_head *caches, arena_t *arena)
+{
+    INIT_LIST_HEAD(caches);
+    arena_destroy(arena);
+}
+
+/*
+ * create the levels of one configuration.
+ * const cache_cfg_t *c         [in]  : values of the configuration
+ * struct list_head *caches     [out] : the levels, L1 first
+ * arena_t *arena               [in]  : storage of the levels
+ * int verbose                  [in]  : print every level
+ */
+int init_caches(const cache_cfg_t *c, struct list_head *caches,
+                arena_t *arena, int verbose)
+{
+    unsigned int set_associatives = 0;
+    int linesize = atoi(c->linesize);
+    uint64_t *lvsize = get_cache_lvsize(c->lvsize);
+    int *sw = get_cache_sways(c->sw);
+    cache_hierarchy_policy_t *hp = get_cache_hierarchy(c->hierarchy);
+    cache_conservative_policy_t *cp = get_cache_policy(c->policy);
+    uint64_t size = 0;
+    int ways = 0;
+    int ret = FAIL;
 
-    linesize = cfg_linesize;
+    if (!lvsize || !sw || !hp || !cp || linesize <= 0 || linesize > 64) {
+        puts("please adjust cfg.cache file about cache parameters");
+        goto out;
+    }
 
     for (int i = 0; i < cfg_level; ++i) {
-        printf("\nlvsize is %d", lvsize[i]);
-        size = CACHE_LV_2_SIZE_K(lvsize[i]);
-        printf("\ncache size is %d", size);
+        size = lvsize[i];
         ways = sw[i];
+        if (verbose)
+            printf("\ncache size is %llu", (unsigned long long)size);
+        /* any whole number of sets, 48K 12 ways is 64 sets of 64B */
+        if (ways <= 0 || !size || size % ((uint64_t)linesize * ways) ||
+            size / linesize / ways > UINT32_MAX) {
+            printf("\nlevel %d: %lluB is no whole number of sets of %d "
+                   "ways of %dB lines\n", i + 1, (unsigned long long)size,
+                   ways, linesize);
+            goto out;
+        }
         set_associatives = SET_WAYS_2_SETS(size, linesize, ways);
-        cache_t *cache = malloc(sizeof(cache_t) + sizeof(cache_set_t*)*set_associatives);
+        cache_t *cache = arena_alloc(arena, sizeof(cache_t));
 
         if (!cache) {
             puts("\n---out of memory---\n");
-            return -1;
+            goto out;
         }
 
-        printf("\n---create level %d---\n", i + 1);
+        if (verbose)
+            printf("\n---create level %d---\n", i + 1);
         INIT_LIST_HEAD(&cache->list);
-        list_add(&g_caches, &cache->list);
+        /* keep L1 first, the analysis walks the levels top down */
+        list_add_tail(&cache->list, caches);
         cache->t_cache = cfg_type;
-        cache->l_cache = i;
-        cache->hp_cache = H_inclusive;
-        cache->cp_cache = CP_lru;
-        cache->sw_cache = SW_4ways;
+        cache->l_cache = L1 + i;
+        cache->hp_cache = hp[i];
+        cache->cp_cache = cp[i];
+        cache->sets = set_associatives;
+        cache->ways = ways;
+        cache->linesize = linesize;
+        fastmod_init(&cache->set_index, set_associatives);
         cache->ops = &cache_inclusive;
         cache->statistical_hit = 0;
         cache->statistical_miss = 0;
+        cache->statistical_evict = 0;
+        /* the simulation state, sim_create() empties it */
+        cache->tags = arena_alloc(arena, sizeof(uint64_t) *
+                                  set_associatives * ways);
+        cache->repl = arena_alloc(arena, sizeof(uint32_t) *
+                                  set_associatives * ways);
+        if (!cache->tags || !cache->repl) {
+            puts("\n---out of memory---\n");
+            goto out;
+        }
+    }
+    ret = SUCCEED;
+out:
+    /* what was allocated goes with the arena */
+    if (SUCCEED != ret)
+        INIT_LIST_HEAD(caches);
+    free(lvsize);
+    free(sw);
+    free(hp);
+    free(cp);
+
+    return ret;
+}
+
+/* where the storage of the caches sits, and what its pages cost */
+static void report_pages(const arena_t *arena, const uint64_t *count,
+                         uint64_t refs)
+{
+    printf("storage: %zuKB mapped, %zuKB on huge pages\n",
+           arena_mapped(arena) >> 10, arena_huge(arena) >> 10);
+    perf_report(count, refs, stdout);
+}
+
+/* the counters of cfg_stats for caches, one shard per simulating core */
+static stats_t *create_stats(struct list_head *caches, int nshards)
+{
+    unsigned int sets[STATS_MAX_LEVELS];
+    cache_t *cache;
+    int n = 0;
+
+    list_for_each_entry(cache, caches, list) {
+        if (n == STATS_MAX_LEVELS) {
+            printf("stats: at most %d levels\n", STATS_MAX_LEVELS);
+            return NULL;
+        }
+        sets[n++] = cache->sets;
+    }
+
+    return stats_create(n, sets, nshards,
+                        cfg_stats_region ? cfg_stats_region : 4096);
+}
+
+static int export_stats(stats_t *s)
+{
+    static const char *names[STATS_MAX_LEVELS] = {
+        "L1", "L2", "L3", "L4", "L5", "L6", "L7", "L8", "L9",
+    };
+
+    stats_merge(s);
+    return stats_export(s, names, cfg_stats, stdout);
+}
+
+/* the telemetry of a trace run, NULL if off */
+static progress_t *start_progress(int nlevels, int nsources)
+{
+    if (!cfg_progress)
+        return NULL;
+    if (nlevels > PROGRESS_LEVELS)
+        nlevels = PROGRESS_LEVELS;
+
+    return progress_start(nlevels, nsources, cfg_progress * 1000,
+                          cfg_progress_page);
+}
+
+/* simulate cfg_trace on caches, print the report */
+static int simulate_trace(struct list_head *caches, const arena_t *arena)
+{
+    uint64_t count[PERF_EVENTS], refs = 0;
+    stats_t *stats = NULL;
+    perf_t perf;
+    sim_t *sim;
+    coh_t *coh;
+    int ret;
+
+    if (cfg_cores > 1) {
+        if (!(coh = coh_create(caches, cfg_cores, cfg_coherence, COH_SHARDS)))
+            return FAIL;
+        if ((cfg_stats && (!(stats = create_stats(caches, cfg_cores)) ||
+                           SUCCEED != coh_stats(coh, stats))) ||
+            (g_series && SUCCEED != coh_series(coh, g_series, 0))) {
+            stats_destroy(stats);
+            coh_destroy(coh);
+            return FAIL;
+        }
+        /* the cores and the decoder count as simulate */
+        if (cfg_profile) {
+            perf_phase(&g_prof, PERF_simulate);
+            perf_threads_start(&g_prof);
+        }
+        perf_start(&perf, 1);
+        coh->progress = start_progress(coh->nprivate, coh->ncores);
+        ret = coh_run(coh, cfg_trace, 0);
+        progress_stop(coh->progress);
+        perf_stop(&perf, count);
+        if (cfg_profile)
+            perf_threads_stop(&g_prof, PERF_simulate);
+        if (SUCCEED == ret) {
+            coh_report(coh, stdout);
+            for (int c = 0; c < coh->ncores; ++c)
+                refs += coh->cores[c].refs;
+            g_prof.refs[PERF_simulate] = refs;
+            report_pages(arena, count, refs);
+            if (stats)
+                ret = export_stats(stats);
+        }
+        stats_destroy(stats);
+        coh_destroy(coh);
+        return ret;
+    }
+
+    if (!(sim = sim_create(caches)))
+        return FAIL;
+    if ((cfg_stats && (!(stats = create_stats(caches, 1)) ||
+                       SUCCEED != sim_stats(sim, stats, 0))) ||
+        (g_series && SUCCEED != sim_series(sim, g_series, 0))) {
+        stats_destroy(stats);
+        sim_destroy(sim);
+        return FAIL;
+    }
+    sim->warmup = cfg_warmup;
+    sim->prof = cfg_profile ? &g_prof : NULL;
+    perf_start(&perf, 1);
+    sim->progress = start_progress(sim->nlevels, 1);
+    ret = run(sim, cfg_trace);
+    progress_stop(sim->progress);
+    perf_stop(&perf, count);
+    if (SUCCEED == ret) {
+        sim_report(sim, stdout);
+        report_pages(arena, count, sim->refs);
+        if (stats)
+            ret = export_stats(stats);
+    }
+    stats_destroy(stats);
+    sim_destroy(sim);
+
+    return ret;
+}
+
+/* fully associative LRU miss ratios of cfg_trace at every size */
+static int trace_mrc(int linesize)
+{
+    reuse_hist_t hist;
+    shards_t *s;
+    reuse_t *r;
+    int ret;
 
-        for (int j = 0; j < set_associatives; ++j) {
-            cache->c_data[j] = (cache_set_t*)malloc(sizeof(cache_line_t)*ways);
+    if (cfg_mrc == 2) {
+        if (!(s = shards_create(linesize, SHARDS_LINES)))
+            return FAIL;
+        ret = shards_run(s, cfg_trace);
+        if (SUCCEED == ret) {
+            shards_hist(s, &hist);
+            printf("sampling rate: %.6f\n", shards_rate(s));
+            reuse_report(&hist, linesize, stdout);
         }
+        shards_destroy(s);
+        return ret;
     }
+
+    if (!(r = reuse_create(linesize)))
+        return FAIL;
+    ret = reuse_run(r, cfg_trace);
+    if (SUCCEED == ret)
+        reuse_report(reuse_hist(r), linesize, stdout);
+    reuse_destroy(r);
+
+    return ret;
+}
+
+static void sweep_release(sweep_result_t *r)
+{
+    sim_destroy(r->sim);
+    coh_destroy(r->coh);
+    if (r->arena)
+        release_caches(&r->caches, r->arena);
+    r->sim = NULL;
+    r->coh = NULL;
+    r->arena = NULL;
+}
+
+/* the levels of a configuration and their miss ratios, then release it */
+static void sweep_summary(sweep_result_t *r)
+{
+    cache_t *cache;
+    size_t used = 0;
+    int i = 0;
+
+    list_for_each_entry(cache, &r->caches, list) {
+        uint64_t n = cache->statistical_hit + cache->statistical_miss;
+        char ratio[32] = "";
+        int len;
+
+        if (r->sim)
+            snprintf(ratio, sizeof(ratio), " miss ratio %.4f",
+                     n ? (double)cache->statistical_miss / n : 0.0);
+        if (r->coh)
+            snprintf(ratio, sizeof(ratio), " miss ratio %.4f",
+                     coh_miss_ratio(r->coh, i++));
+        len = snprintf(r->summary + used, sizeof(r->summary) - used,
+                       "%sL%d %u sets x %u ways x %uB%s",
+                       used ? ", " : "", cache->l_cache, cache->sets,
+                       cache->ways, cache->linesize, ratio);
+        if (len < 0 || (size_t)len >= sizeof(r->summary) - used)
+            break;
+        used += len;
+    }
+    sweep_release(r);
+    r->ret = SUCCEED;
+}
+
+/*
+ * build one configuration of a sweep, run on the threads of
+ * cfg_sweep_run. with a trace it waits for sweep_trace(), which reads
+ * the trace once for all of them.
+ */
+static int sweep_config(const cfg_sweep_t *s, uint64_t k, void *arg)
+{
+    sweep_result_t *r = (sweep_result_t *)arg + k;
+    cache_cfg_t c;
+
+    INIT_LIST_HEAD(&r->caches);
+    r->ret = FAIL;
+    if (SUCCEED != cfg_sweep_label(s, k, r->label, sizeof(r->label)) ||
+        SUCCEED != get_cache_cfg(s, k, &c) || !(r->arena = create_arena()))
+        return FAIL;
+    if (SUCCEED != init_caches(&c, &r->caches, r->arena, 0))
+        goto fail;
+    /* the sweep keeps the cpus busy, the cores of one share a thread */
+    if (cfg_trace && cfg_cores > 1 &&
+        (!(r->coh = coh_create(&r->caches, cfg_cores, cfg_coherence,
+                               COH_SHARDS)) ||
+         (g_series && SUCCEED != coh_series(r->coh, g_series, k))))
+        goto fail;
+    if (cfg_trace && cfg_cores <= 1) {
+        if (!(r->sim = sim_create(&r->caches)) ||
+            (g_series && SUCCEED != sim_series(r->sim, g_series, k)))
+            goto fail;
+        r->sim->warmup = cfg_warmup;
+        sim_begin(r->sim);
+    }
+    if (!cfg_trace)
+        sweep_summary(r);
+
+    return SUCCEED;
+fail:
+    sweep_release(r);
+    return FAIL;
+}
+
+/* the n references of a batch to every configuration k, k + step.. */
+static void sweep_feed(sweep_result_t *results, uint64_t count, uint64_t k,
+                       uint64_t step, const trace_ref_t *refs, uint32_t n)
+{
+    for (; k < count; k += step) {
+        if (results[k].sim)
+            sim_refs(results[k].sim, refs, n);
+        else if (results[k].coh)
+            for (uint32_t i = 0; i < n; ++i)
+                coh_ref(results[k].coh, &refs[i]);
+    }
+}
+
+static void *sweep_worker(void *arg)
+{
+    sweep_worker_t *w = arg;
+    const trace_batch_t *b;
+
+    while ((b = spsc_peek(w->q))) {
+        sweep_feed(w->results, w->count, w->id, w->nworkers, b->refs, b->n);
+        spsc_release(w->q);
+    }
+
+    return NULL;
+}
+
+/*
+ * the trace, decoded once, through every configuration built: each
+ * worker thread gets a copy of every batch and simulates its share of
+ * the configurations, so stdin and a trace ring can feed a sweep too.
+ */
+static int sweep_trace(sweep_result_t *results, uint64_t count)
+{
+    trace_reader_t *r = trace_open(cfg_trace);
+    long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    sweep_worker_t *w = NULL;
+    const trace_batch_t *b;
+    trace_stream_t *s;
+    uint32_t n;
+    int nworkers = 0, ret;
+
+    if (!r)
+        return FAIL;
+    if (!(s = trace_stream_start(r))) {
+        trace_close(r);
+        return FAIL;
+    }
+
+    if ((uint64_t)nthreads > count)
+        nthreads = count;
+    /* one thread simulates on the caller */
+    if (nthreads > 1 && (w = calloc(nthreads, sizeof(sweep_worker_t)))) {
+        for (; nworkers < nthreads; ++nworkers) {
+            sweep_worker_t *t = &w[nworkers];
+
+            t->results = results;
+            t->count = count;
+            t->id = nworkers;
+            t->q = spsc_create(TRACE_RING_SLOTS, sizeof(trace_batch_t));
+            if (!t->q || pthread_create(&t->tid, NULL, sweep_worker, t)) {
+                spsc_destroy(t->q);
+                break;
+            }
+        }
+        /* seen by a worker with its first batch */
+        for (int i = 0; i < nworkers; ++i)
+            w[i].nworkers = nworkers;
+    }
+
+    while ((b = trace_stream_next(s, &n))) {
+        for (int i = 0; i < nworkers; ++i) {
+            trace_batch_t *copy = spsc_acquire(w[i].q);
+
+            /* the count checked by the stream, not the one in b */
+            copy->n = n;
+            copy->bytes = b->bytes;
+            memcpy(copy->refs, b->refs, n * sizeof(trace_ref_t));
+            spsc_publish(w[i].q);
+        }
+        if (!nworkers)
+            sweep_feed(results, count, 0, 1, b->refs, n);
+        trace_stream_release(s);
+    }
+
+    for (int i = 0; i < nworkers; ++i) {
+        spsc_close(w[i].q);
+        pthread_join(w[i].tid, NULL);
+        spsc_destroy(w[i].q);
+    }
+    free(w);
+
+    ret = trace_stream_stop(s);
+    for (uint64_t k = 0; k < count; ++k) {
+        if (results[k].sim)
+            sim_end(results[k].sim, cfg_trace);
+        if (results[k].coh)
+            coh_end(results[k].coh, cfg_trace);
+    }
+
+    return ret;
+}
+
+static int run_sweep(uint64_t count)
+{
+    sweep_result_t *results = calloc(count, sizeof(sweep_result_t));
+    int ret;
+
+    if (!results) {
+        puts("\n---out of memory---\n");
+        return FAIL;
+    }
+
+    /* every configuration stays built while the trace goes by */
+    ret = cfg_sweep_run(cfg_sweep, 0, sweep_config, results);
+    if (cfg_trace && SUCCEED != sweep_trace(results, count)) {
+        for (uint64_t k = 0; k < count; ++k)
+            sweep_release(&results[k]);
+        ret = FAIL;
+    }
+    for (uint64_t k = 0; k < count; ++k) {
+        if (results[k].arena)
+            sweep_summary(&results[k]);
+        printf("config %llu: %s: %s\n", (unsigned long long)k,
+               results[k].label, SUCCEED == results[k].ret ?
+               results[k].summary : "invalid");
+    }
+    free(results);
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    cache_cfg_t c;
+    uint64_t count;
+    int ret;
+
+    printf("<usage - first> sets the config files in conf/cfg.cache \n");
+    if (argc > 1)
+        cfg_file = argv[1];
+    INIT_LIST_HEAD(&g_caches);
+    /* the counters start before we know if they are wanted */
+    perf_profile_start(&g_prof, PERF_config);
+    if (SUCCEED != load_cfg()) {
+        puts("please adjust cfg.cache file about cache parameters");
+        return -1;
+    }
+    if (!cfg_profile)
+        perf_profile_stop(&g_prof);
+
+    /* the jobs bring their own configurations */
+    if (cfg_serve) {
+        server_t *server = server_start(cfg_serve,
+                                        (uint64_t)cfg_serve_traces << 20);
+
+        if (!server)
+            return -1;
+        printf("\nserving on %s\n", cfg_serve);
+        server_wait(server);
+        server_stop(server);
+        cfg_sweep_destroy(cfg_sweep);
+        return 0;
+    }
+
+    if (SUCCEED != get_cache_cfg(cfg_sweep, 0, &c))
+        return -1;
+    /* stdin and the references of a tracer go by once, mrc reads first */
+    if (cfg_trace && cfg_mrc && (!strcmp(cfg_trace, "-") ||
+        !strncmp(cfg_trace, RING_PREFIX, strlen(RING_PREFIX)))) {
+        puts("\n---stdin or a trace ring goes by once, no mrc---\n");
+        return -1;
+    }
+    /* the curve only depends on the linesize */
+    puts("");
+    if (cfg_trace && cfg_mrc) {
+        if (cfg_profile) {
+            perf_phase(&g_prof, PERF_mrc);
+            perf_threads_start(&g_prof);
+        }
+        ret = trace_mrc(atoi(c.linesize));
+        if (cfg_profile)
+            perf_threads_stop(&g_prof, PERF_mrc);
+        if (SUCCEED != ret)
+            return -1;
+    }
+
+    /* one writer for the sources of every configuration */
+    if (cfg_trace && cfg_series &&
+        !(g_series = series_open(cfg_series, cfg_series_binary,
+                                 cfg_series_interval ? cfg_series_interval :
+                                 SERIES_EVERY)))
+        return -1;
+    count = cfg_sweep_count(cfg_sweep);
+    if (count > 1) {
+        /* the phases of a sweep overlap, no profile */
+        if (cfg_profile)
+            perf_profile_stop(&g_prof);
+        ret = run_sweep(count);
+        if (SUCCEED != series_close(g_series))
+            ret = FAIL;
+        cfg_sweep_destroy(cfg_sweep);
+        return SUCCEED == ret ? 0 : -1;
+    }
+
+    if (cfg_profile)
+        perf_phase(&g_prof, PERF_build);
+    if (!(g_arena = create_arena()) ||
+        SUCCEED != init_caches(&c, &g_caches, g_arena, 1))
+        return -1;
     puts("init cache done");
-    return 0;
+    ret = cfg_trace ? simulate_trace(&g_caches, g_arena) : SUCCEED;
+    if (SUCCEED != series_close(g_series))
+        ret = FAIL;
+    if (cfg_profile) {
+        perf_profile_stop(&g_prof);
+        perf_profile_report(&g_prof, stdout);
+    }
+    release_caches(&g_caches, g_arena);
+    cfg_sweep_destroy(cfg_sweep);
+
+    return SUCCEED == ret ? 0 : -1;
 }
@@ -0,0 +1,247 @@
+/*
+ * @file arena.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Simulation arena, see arena.h.
+ *
+ * Every region starts with its header; the first one also holds the
+ * arena. Fresh mappings are zero, so only memory handed out before the
+ * last reset, below the dirty mark of its region, is cleared again.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "arena.h"
+
+#define ARENA_LINE          64
+#define ARENA_GIGA          (1UL << 30)
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT      26
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB        (30 << MAP_HUGE_SHIFT)
+#endif
+
+typedef struct region {
+    struct region *next;
+    size_t size;
+    size_t used;
+    size_t dirty;               /* bytes handed out since the mapping */
+    size_t hugetlb;             /* reserved page size, 0 if none */
+} region_t;
+
+struct arena {
+    region_t *first;
+    region_t *cur;
+    int flags;
+};
+
+static inline size_t round_up(size_t n, size_t to)
+{
+    return (n + to - 1) & ~(to - 1);
+}
+
+#define REGION_HEADER       round_up(sizeof(region_t), ARENA_LINE)
+
+/*
+ * reserved huge pages of a region, 1GB ones for a region of 1GB or more.
+ * return NULL if none are left.
+ */
+static region_t *map_hugetlb(size_t *size)
+{
+#ifdef MAP_HUGETLB
+    const int prot = PROT_READ | PROT_WRITE;
+    const int map = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+    size_t giga = round_up(*size, ARENA_GIGA);
+    region_t *r;
+    void *mem;
+
+    /* at most a quarter more than asked for */
+    if (*size >= ARENA_GIGA && giga - *size <= *size / 4) {
+        mem = mmap(NULL, giga, prot, map | MAP_HUGE_1GB, -1, 0);
+        if (mem != MAP_FAILED) {
+            r = mem;
+            r->hugetlb = ARENA_GIGA;
+            *size = giga;
+            return r;
+        }
+    }
+    mem = mmap(NULL, *size, prot, map, -1, 0);
+    if (mem != MAP_FAILED) {
+        r = mem;
+        r->hugetlb = ARENA_ALIGN;
+        return r;
+    }
+#endif
+
+    return NULL;
+}
+
+static region_t *map_region(size_t size, int flags)
+{
+    const int prot = PROT_READ | PROT_WRITE;
+    const int map = MAP_PRIVATE | MAP_ANONYMOUS;
+    uintptr_t p, start;
+    region_t *r;
+    void *mem;
+
+    if ((flags & ARENA_HUGETLB) && (r = map_hugetlb(&size)))
+        goto out;
+
+    /* over map, then trim to an aligned region */
+    mem = mmap(NULL, size + ARENA_ALIGN, prot, map, -1, 0);
+    if (mem == MAP_FAILED)
+        return NULL;
+    p = (uintptr_t)mem;
+    start = round_up(p, ARENA_ALIGN);
+    if (start > p)
+        munmap(mem, start - p);
+    munmap((void *)(start + size), p + ARENA_ALIGN - start);
+#ifdef MADV_HUGEPAGE
+    if (flags & (ARENA_THP | ARENA_HUGETLB))
+        madvise((void *)start, size, MADV_HUGEPAGE);
+#endif
+    r = (region_t *)start;
+    r->hugetlb = 0;
+out:
+    r->next = NULL;
+    r->size = size;
+    r->used = REGION_HEADER;
+    r->dirty = REGION_HEADER;
+
+    return r;
+}
+
+arena_t *arena_create(int flags)
+{
+    region_t *r = map_region(ARENA_REGION, flags);
+    arena_t *a;
+
+    if (!r)
+        return NULL;
+
+    a = (arena_t *)((char *)r + r->used);
+    r->used += round_up(sizeof(arena_t), ARENA_LINE);
+    r->dirty = r->used;
+    a->first = r;
+    a->cur = r;
+    a->flags = flags;
+
+    return a;
+}
+
+void *arena_alloc(arena_t *a, size_t size)
+{
+    region_t *r = a->cur;
+    char *p;
+
+    size = round_up(size ? size : 1, ARENA_LINE);
+    while (r->size - r->used < size) {
+        /* the regions after cur are free since the last reset */
+        if (r->next) {
+            r = r->next;
+            r->used = REGION_HEADER;
+            continue;
+        }
+        r->next = map_region(round_up(size + REGION_HEADER, ARENA_ALIGN) >
+                             2 * r->size ?
+                             round_up(size + REGION_HEADER, ARENA_ALIGN) :
+                             2 * r->size, a->flags);
+        if (!r->next)
+            return NULL;
+        r = r->next;
+    }
+    a->cur = r;
+
+    p = (char *)r + r->used;
+    if (r->used < r->dirty)
+        memset(p, 0, (r->dirty < r->used + size ? r->dirty : r->used + size) -
+                     r->used);
+    r->used += size;
+    if (r->dirty < r->used)
+        r->dirty = r->used;
+
+    return p;
+}
+
+void arena_reset(arena_t *a)
+{
+    a->cur = a->first;
+    a->first->used = (char *)a - (char *)a->first +
+                     round_up(sizeof(arena_t), ARENA_LINE);
+}
+
+void arena_destroy(arena_t *a)
+{
+    region_t *r, *next;
+
+    if (!a)
+        return;
+
+    /* the arena lives in the first region */
+    for (r = a->first; r; r = next) {
+        next = r->next;
+        munmap(r, r->size);
+    }
+}
+
+size_t arena_mapped(const arena_t *a)
+{
+    size_t n = 0;
+
+    for (const region_t *r = a->first; r; r = r->next)
+        n += r->size;
+
+    return n;
+}
+
+size_t arena_hugetlb(const arena_t *a)
+{
+    size_t n = 0;
+
+    for (const region_t *r = a->first; r; r = r->next)
+        n += r->hugetlb ? r->size : 0;
+
+    return n;
+}
+
+/* does [start, end) overlap a region of a not on reserved pages */
+static int overlaps(const arena_t *a, uintptr_t start, uintptr_t end)
+{
+    for (const region_t *r = a->first; r; r = r->next)
+        if (!r->hugetlb && start < (uintptr_t)r + r->size &&
+            (uintptr_t)r < end)
+            return 1;
+
+    return 0;
+}
+
+size_t arena_huge(const arena_t *a)
+{
+    unsigned long long start = 0, end = 0, kb;
+    size_t n = arena_hugetlb(a);
+    int mine = 0;
+    char line[256];
+    FILE *f;
+
+    /* transparent huge pages of the mappings, as the kernel sees them */
+    if (!(f = fopen("/proc/self/smaps", "r")))
+        return n;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%llx-%llx ", &start, &end) == 2)
+            mine = overlaps(a, start, end);
+        else if (mine && sscanf(line, "AnonHugePages: %llu kB", &kb) == 1)
+            n += kb << 10;
+    }
+    fclose(f);
+
+    return n;
+}
@@ -0,0 +1,499 @@
+/*
+ * @file cachesim.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * libcachesim, see cachesim.h. A handle is a hierarchy in an arena of its
+ * own, simulated by a sim_t with one core or a coh_t with several.
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "cachesim.h"
+#include "cfg.h"
+#include "coherence.h"
+#include "simulat.h"
+#include "sweep.h"
+
+#define CFG_VALUE_LEN       256
+
+/* a batch is decoded in place */
+_Static_assert(sizeof(cachesim_ref_t) == sizeof(trace_ref_t) &&
+               offsetof(cachesim_ref_t, size) ==
+               offsetof(trace_ref_t, size) &&
+               offsetof(cachesim_ref_t, op) == offsetof(trace_ref_t, op),
+               "cachesim_ref_t is laid out as trace_ref_t");
+
+struct cachesim {
+    cachesim_cfg_t cfg;
+    arena_t *arena;
+    struct list_head caches;            /* L1 first */
+    sim_t *sim;                         /* one core */
+    coh_t *coh;                         /* several */
+    unsigned int lineshift;
+};
+
+struct cachesim_snapshot {
+    int nlevels;
+    uint64_t refs;
+    uint64_t memory;
+    uint64_t writebacks;
+    struct {
+        unsigned int sets;
+        unsigned int ways;
+        uint64_t rng;
+        unsigned long long hits;
+        unsigned long long misses;
+        unsigned long long evictions;
+        uint64_t *tags;
+        uint32_t *repl;
+    } levels[CACHESIM_MAX_LEVELS];
+};
+
+/* CACHESIM_INCLUSIVE, CACHESIM_NON_INCLUSIVE, CACHESIM_EXCLUSIVE */
+static const cache_hierarchy_policy_t hierarchies[] = {
+    H_inclusive, H_non_exclusive, H_exclusive,
+};
+
+void cachesim_cfg_init(cachesim_cfg_t *cfg)
+{
+    memset(cfg, 0, sizeof(cachesim_cfg_t));
+    cfg->linesize = 64;
+    cfg->nlevels = 1;
+    cfg->levels[0].size = 32768;
+    cfg->levels[0].ways = 8;
+    cfg->levels[0].hierarchy = CACHESIM_NON_INCLUSIVE;
+    cfg->levels[0].policy = CACHESIM_LRU;
+    cfg->cores = 1;
+}
+
+/* one value per level from a comma list, a short one repeats its last */
+static int parse_list(const char *str, int n, uint64_t *v)
+{
+    char token[64];
+    int i = 0;
+    size_t len;
+
+    while (i < n) {
+        len = strcspn(str, ",");
+        if (len >= sizeof(token))
+            return FAIL;
+        memcpy(token, str, len);
+        token[len] = '\0';
+        str_lrtrim(token, " \t");
+        if (SUCCEED != str2uint64(token, "KMGT", &v[i++]))
+            return FAIL;
+        if (',' != str[len])
+            break;
+        str += len + 1;
+    }
+    for (; i > 0 && i < n; ++i)
+        v[i] = v[i - 1];
+
+    return i ? SUCCEED : FAIL;
+}
+
+int cachesim_cfg_load(const char *path, uint64_t k, cachesim_cfg_t *cfg)
+{
+    char linesize[CFG_VALUE_LEN], lvsize[CFG_VALUE_LEN], sw[CFG_VALUE_LEN];
+    char hierarchy[CFG_VALUE_LEN], policy[CFG_VALUE_LEN];
+    uint64_t sizes[CACHESIM_MAX_LEVELS], ways[CACHESIM_MAX_LEVELS];
+    uint64_t hps[CACHESIM_MAX_LEVELS], cps[CACHESIM_MAX_LEVELS], line;
+    int type = DCache, level = 0, cores = 0, coherence = 0, warmup = 0;
+    int hugepages = 0, ret = FAIL;
+    cfg_sweep_t *sweep = cfg_sweep_create();
+    struct cfg_line lines[] = {
+        {"type", &type, TYPE_INT, PARM_OPT, 0, 1},
+        {"level", &level, TYPE_INT, PARM_MAND, 1, CACHESIM_MAX_LEVELS},
+        {"linesize", &sweep, TYPE_SWEEP, PARM_MAND, 0, 0},
+        {"lvsize", &sweep, TYPE_SWEEP, PARM_MAND, 0, 0},
+        {"sw", &sweep, TYPE_SWEEP, PARM_MAND, 0, 0},
+        {"hierarchy", &sweep, TYPE_SWEEP, PARM_MAND, 0, 0},
+        {"policy", &sweep, TYPE_SWEEP, PARM_MAND, 0, 0},
+        {"cores", &cores, TYPE_INT, PARM_OPT, 0, COH_MAX_CORES},
+        {"coherence", &coherence, TYPE_INT, PARM_OPT, 0, 1},
+        {"warmup", &warmup, TYPE_INT, PARM_OPT, 0, INT_MAX},
+        {"hugepages", &hugepages, TYPE_INT, PARM_OPT, 0, 2},
+        {NULL, NULL, 0, 0, 0, 0}
+    };
+
+    if (!sweep)
+        return FAIL;
+    /* the keys of the command line tool are no error */
+    if (SUCCEED != parse_cfg_file(path, lines, CFG_FILE_REQUIRED,
+                                  CFG_NOT_STRICT) ||
+        k >= cfg_sweep_count(sweep) ||
+        SUCCEED != cfg_sweep_get(sweep, "linesize", k, linesize,
+                                 sizeof(linesize)) ||
+        SUCCEED != cfg_sweep_get(sweep, "lvsize", k, lvsize,
+                                 sizeof(lvsize)) ||
+        SUCCEED != cfg_sweep_get(sweep, "sw", k, sw, sizeof(sw)) ||
+        SUCCEED != cfg_sweep_get(sweep, "hierarchy", k, hierarchy,
+                                 sizeof(hierarchy)) ||
+        SUCCEED != cfg_sweep_get(sweep, "policy", k, policy,
+                                 sizeof(policy)) ||
+        SUCCEED != parse_list(linesize, 1, &line) ||
+        SUCCEED != parse_list(lvsize, level, sizes) ||
+        SUCCEED != parse_list(sw, level, ways) ||
+        SUCCEED != parse_list(hierarchy, level, hps) ||
+        SUCCEED != parse_list(policy, level, cps)) {
+        LOG_ERR("no configuration %llu in [%s]", (unsigned long long)k,
+                path);
+        goto out;
+    }
+
+    cachesim_cfg_init(cfg);
+    cfg->icache = type == ICache;
+    cfg->linesize = line;
+    cfg->nlevels = level;
+    for (int l = 0; l < level; ++l) {
+        cfg->levels[l].size = sizes[l];
+        cfg->levels[l].ways = ways[l];
+        cfg->levels[l].hierarchy = hps[l];
+        cfg->levels[l].policy = cps[l];
+    }
+    cfg->cores = cores ? cores : 1;
+    cfg->moesi = coherence;
+    cfg->warmup = warmup;
+    cfg->hugepages = hugepages;
+    ret = SUCCEED;
+out:
+    cfg_sweep_destroy(sweep);
+    return ret;
+}
+
+static int check(const cachesim_cfg_t *cfg)
+{
+    if (cfg->nlevels < 1 || cfg->nlevels > CACHESIM_MAX_LEVELS ||
+        !cfg->linesize || cfg->linesize > 64 ||
+        (cfg->linesize & (cfg->linesize - 1)) || cfg->cores < 1 ||
+        cfg->cores > COH_MAX_CORES || cfg->hugepages < 0 ||
+        cfg->hugepages > 2) {
+        LOG_ERR("bad configuration");
+        return FAIL;
+    }
+    for (int l = 0; l < cfg->nlevels; ++l) {
+        const cachesim_level_t *v = &cfg->levels[l];
+
+        if (!v->ways || !v->size ||
+            v->size % ((uint64_t)cfg->linesize * v->ways) ||
+            v->size / cfg->linesize / v->ways > UINT32_MAX ||
+            v->hierarchy < CACHESIM_INCLUSIVE ||
+            v->hierarchy > CACHESIM_EXCLUSIVE ||
+            v->policy < CACHESIM_RANDOM || v->policy > CACHESIM_MRU) {
+            LOG_ERR("bad level %d", l + 1);
+            return FAIL;
+        }
+    }
+
+    return SUCCEED;
+}
+
+/* the levels of cs->cfg in its arena, as init_caches() of the tool */
+static int build(cachesim_t *cs)
+{
+    const cachesim_cfg_t *cfg = &cs->cfg;
+
+    for (int l = 0; l < cfg->nlevels; ++l) {
+        const cachesim_level_t *v = &cfg->levels[l];
+        unsigned int sets = v->size / cfg->linesize / v->ways;
+        cache_t *cache = arena_alloc(cs->arena, sizeof(cache_t));
+
+        if (!cache)
+            return FAIL;
+        memset(cache, 0, sizeof(cache_t));
+        INIT_LIST_HEAD(&cache->list);
+        list_add_tail(&cache->list, &cs->caches);
+        cache->t_cache = cfg->icache ? ICache : DCache;
+        cache->l_cache = L1 + l;
+        cache->hp_cache = hierarchies[v->hierarchy];
+        cache->cp_cache = v->policy;
+        cache->sets = sets;
+        cache->ways = v->ways;
+        cache->linesize = cfg->linesize;
+        fastmod_init(&cache->set_index, sets);
+        cache->tags = arena_alloc(cs->arena, sizeof(uint64_t) * sets *
+                                  v->ways);
+        cache->repl = arena_alloc(cs->arena, sizeof(uint32_t) * sets *
+                                  v->ways);
+        if (!cache->tags || !cache->repl)
+            return FAIL;
+    }
+
+    return SUCCEED;
+}
+
+cachesim_t *cachesim_create(const cachesim_cfg_t *cfg)
+{
+    static const int flags[] = { ARENA_THP, ARENA_HUGETLB, 0 };
+    cachesim_t *cs;
+
+    if (SUCCEED != check(cfg) || !(cs = calloc(1, sizeof(cachesim_t))))
+        return NULL;
+
+    cs->cfg = *cfg;
+    cs->lineshift = __builtin_ctz(cfg->linesize);
+    INIT_LIST_HEAD(&cs->caches);
+    if (!(cs->arena = arena_create(flags[cfg->hugepages])) ||
+        SUCCEED != build(cs))
+        goto fail;
+    if (cfg->cores > 1)
+        cs->coh = coh_create(&cs->caches, cfg->cores,
+                             cfg->moesi ? COH_moesi : COH_mesi, COH_SHARDS);
+    else
+        cs->sim = sim_create(&cs->caches);
+    if (!cs->sim && !cs->coh)
+        goto fail;
+
+    return cs;
+fail:
+    cachesim_destroy(cs);
+    return NULL;
+}
+
+void cachesim_destroy(cachesim_t *cs)
+{
+    if (!cs)
+        return;
+
+    sim_destroy(cs->sim);
+    coh_destroy(cs->coh);
+    arena_destroy(cs->arena);
+    free(cs);
+}
+
+int cachesim_access(cachesim_t *cs, const cachesim_ref_t *ref)
+{
+    uint64_t line = ref->addr >> cs->lineshift;
+    uint64_t last = (ref->addr + (ref->size ? ref->size - 1 : 0)) >>
+                    cs->lineshift;
+    int c = ref->cpu % cs->cfg.cores, served;
+
+    if ((ref->op == CACHESIM_IFETCH) != !!cs->cfg.icache)
+        return -1;
+
+    if (cs->sim) {
+        cs->sim->refs++;
+        served = sim_access(cs->sim, line, ref->op);
+        while (line++ < last)
+            sim_access(cs->sim, line, ref->op);
+        return served + 1;
+    }
+
+    cs->coh->cores[c].refs++;
+    served = coh_access(cs->coh, c, line, ref->op);
+    while (line++ < last)
+        coh_access(cs->coh, c, line, ref->op);
+    /* the LLC counts as a private level below the others */
+    return served == COH_PEER ? 0 : served + 1;
+}
+
+static uint64_t refs_of(const cachesim_t *cs)
+{
+    uint64_t refs = 0;
+
+    if (cs->sim)
+        return cs->sim->refs;
+    for (int c = 0; c < cs->coh->ncores; ++c)
+        refs += cs->coh->cores[c].refs;
+
+    return refs;
+}
+
+uint64_t cachesim_access_batch(cachesim_t *cs, const cachesim_ref_t *refs,
+                               size_t n)
+{
+    const trace_ref_t *r = (const trace_ref_t *)refs;
+    uint64_t before = refs_of(cs);
+
+    if (cs->sim)
+        for (size_t i = 0; i < n; ++i)
+            sim_ref(cs->sim, &r[i]);
+    else
+        for (size_t i = 0; i < n; ++i)
+            coh_ref(cs->coh, &r[i]);
+
+    return refs_of(cs) - before;
+}
+
+int cachesim_run(cachesim_t *cs, const char *trace)
+{
+    if (cs->coh)
+        return coh_run(cs->coh, trace, cs->cfg.threads);
+
+    cs->sim->warmup = cs->cfg.warmup;
+    return run(cs->sim, trace);
+}
+
+void cachesim_stats(const cachesim_t *cs, cachesim_stats_t *stats)
+{
+    const coh_t *coh = cs->coh;
+
+    memset(stats, 0, sizeof(cachesim_stats_t));
+    stats->refs = refs_of(cs);
+    stats->nlevels = cs->cfg.nlevels;
+    if (cs->sim) {
+        stats->memory = cs->sim->memory;
+        for (int l = 0; l < cs->sim->nlevels; ++l) {
+            const cache_t *c = cs->sim->levels[l];
+
+            stats->levels[l].hits = c->statistical_hit;
+            stats->levels[l].misses = c->statistical_miss;
+            stats->levels[l].evictions = c->statistical_evict;
+        }
+        return;
+    }
+
+    for (int c = 0; c < coh->ncores; ++c) {
+        for (int l = 0; l < coh->nprivate; ++l) {
+            const cache_t *level = coh->cores[c].levels[l];
+
+            stats->levels[l].hits += level->statistical_hit;
+            stats->levels[l].misses += level->statistical_miss;
+            stats->levels[l].evictions += level->statistical_evict;
+        }
+    }
+    for (unsigned int s = 0; s < coh->nshards; ++s) {
+        const coh_shard_t *sh = &coh->shards[s];
+
+        stats->memory += sh->memory;
+        if (coh->llc) {
+            stats->levels[coh->nprivate].hits += sh->llc_hits;
+            stats->levels[coh->nprivate].misses += sh->llc_misses;
+            stats->levels[coh->nprivate].evictions += sh->llc_evictions;
+        }
+    }
+}
+
+static void reset_level(cache_t *c)
+{
+    c->statistical_hit = 0;
+    c->statistical_miss = 0;
+    c->statistical_evict = 0;
+}
+
+void cachesim_reset_stats(cachesim_t *cs)
+{
+    coh_t *coh = cs->coh;
+
+    if (cs->sim) {
+        for (int l = 0; l < cs->sim->nlevels; ++l)
+            reset_level(cs->sim->levels[l]);
+        cs->sim->refs = 0;
+        cs->sim->memory = 0;
+        cs->sim->writebacks = 0;
+        return;
+    }
+
+    for (int c = 0; c < coh->ncores; ++c) {
+        coh_core_t *core = &coh->cores[c];
+
+        for (int l = 0; l < coh->nprivate; ++l)
+            reset_level(core->levels[l]);
+        core->refs = 0;
+        core->upgrades = 0;
+        core->transfers = 0;
+        core->writebacks = 0;
+        core->invalidations = 0;
+    }
+    for (unsigned int s = 0; s < coh->nshards; ++s) {
+        coh_shard_t *sh = &coh->shards[s];
+
+        sh->llc_hits = 0;
+        sh->llc_misses = 0;
+        sh->llc_evictions = 0;
+        sh->memory = 0;
+        sh->memory_writebacks = 0;
+    }
+}
+
+cachesim_snapshot_t *cachesim_snapshot(const cachesim_t *cs)
+{
+    cachesim_snapshot_t *snap;
+    const sim_t *sim = cs->sim;
+
+    if (!sim) {
+        LOG_ERR("no snapshot of several cores");
+        return NULL;
+    }
+    if (!(snap = calloc(1, sizeof(cachesim_snapshot_t))))
+        return NULL;
+
+    snap->nlevels = sim->nlevels;
+    snap->refs = sim->refs;
+    snap->memory = sim->memory;
+    snap->writebacks = sim->writebacks;
+    for (int l = 0; l < sim->nlevels; ++l) {
+        const cache_t *c = sim->levels[l];
+        uint64_t n = (uint64_t)c->sets * c->ways;
+
+        snap->levels[l].sets = c->sets;
+        snap->levels[l].ways = c->ways;
+        snap->levels[l].rng = c->rng;
+        snap->levels[l].hits = c->statistical_hit;
+        snap->levels[l].misses = c->statistical_miss;
+        snap->levels[l].evictions = c->statistical_evict;
+        snap->levels[l].tags = malloc(n * sizeof(uint64_t));
+        snap->levels[l].repl = malloc(n * sizeof(uint32_t));
+        if (!snap->levels[l].tags || !snap->levels[l].repl) {
+            cachesim_snapshot_free(snap);
+            return NULL;
+        }
+        memcpy(snap->levels[l].tags, c->tags, n * sizeof(uint64_t));
+        memcpy(snap->levels[l].repl, c->repl, n * sizeof(uint32_t));
+    }
+
+    return snap;
+}
+
+int cachesim_restore(cachesim_t *cs, const cachesim_snapshot_t *snap)
+{
+    sim_t *sim = cs->sim;
+
+    if (!sim || sim->nlevels != snap->nlevels) {
+        LOG_ERR("snapshot of another hierarchy");
+        return FAIL;
+    }
+    for (int l = 0; l < sim->nlevels; ++l) {
+        if (sim->levels[l]->sets != snap->levels[l].sets ||
+            sim->levels[l]->ways != snap->levels[l].ways) {
+            LOG_ERR("snapshot of another hierarchy");
+            return FAIL;
+        }
+    }
+
+    sim->refs = snap->refs;
+    sim->memory = snap->memory;
+    sim->writebacks = snap->writebacks;
+    for (int l = 0; l < sim->nlevels; ++l) {
+        cache_t *c = sim->levels[l];
+        uint64_t n = (uint64_t)c->sets * c->ways;
+
+        c->rng = snap->levels[l].rng;
+        c->statistical_hit = snap->levels[l].hits;
+        c->statistical_miss = snap->levels[l].misses;
+        c->statistical_evict = snap->levels[l].evictions;
+        memcpy(c->tags, snap->levels[l].tags, n * sizeof(uint64_t));
+        memcpy(c->repl, snap->levels[l].repl, n * sizeof(uint32_t));
+    }
+
+    return SUCCEED;
+}
+
+void cachesim_snapshot_free(cachesim_snapshot_t *snap)
+{
+    if (!snap)
+        return;
+
+    for (int l = 0; l < snap->nlevels; ++l) {
+        free(snap->levels[l].tags);
+        free(snap->levels[l].repl);
+    }
+    free(snap);
+}
@@ -0,0 +1,839 @@
+/*
+ * @file coherence.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Multi-core MESI/MOESI simulation, see coherence.h.
+ *
+ * The private copies of a line always carry the same state, kept in the
+ * coh array of every private level. Hits with enough permission stay
+ * under the core lock. Misses and upgrades release it and run a
+ * transaction under the shard lock of the line, locking the other cores
+ * one at a time to snoop them. Victims leaving a private stack are
+ * queued and reported to their own shard after the transaction, so the
+ * directory knows its sharers exactly up to those in flight.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "cfg.h"
+#include "coherence.h"
+#include "simulat.h"
+#include "spsc.h"
+
+#define COH_DIR_INIT        256
+#define COH_BIT(core)       (1ULL << (core))
+
+/* a queued victim, line << 1 | dirty */
+#define PENDING(line, d)    ((line) << 1 | !!(d))
+
+typedef struct coh_worker {
+    coh_t *coh;
+    spsc_t *q;
+    trace_batch_t *b;           /* being filled by the dispatcher */
+    pthread_t tid;
+    int id;                     /* simulates the cores c % nworkers == id */
+    int nworkers;
+} coh_worker_t;
+
+static inline int dirty(int state)
+{
+    return state == COH_M || state == COH_O;
+}
+
+static inline coh_shard_t *shard_of(coh_t *coh, uint64_t line)
+{
+    uint64_t k = coh->llc ? fastmod_reduce(&coh->llc->set_index, line) : line;
+
+    return &coh->shards[k & (coh->nshards - 1)];
+}
+
+static inline uint32_t dir_hash(const coh_shard_t *sh, uint64_t line)
+{
+    return (uint32_t)((line * 0x9e3779b97f4a7c15ULL) >> 32) & (sh->cap - 1);
+}
+
+static coh_dir_entry_t *dir_find(coh_shard_t *sh, uint64_t line)
+{
+    if (!sh->cap)
+        return NULL;
+
+    for (uint32_t i = dir_hash(sh, line);; i = (i + 1) & (sh->cap - 1)) {
+        if (sh->dir[i].line == line + 1)
+            return &sh->dir[i];
+        if (!sh->dir[i].line)
+            return NULL;
+    }
+}
+
+static int dir_grow(coh_shard_t *sh)
+{
+    uint32_t cap = sh->cap ? sh->cap * 2 : COH_DIR_INIT, oldcap = sh->cap;
+    coh_dir_entry_t *old = sh->dir, *dir = calloc(cap, sizeof(*dir));
+
+    if (!dir)
+        return FAIL;
+
+    sh->dir = dir;
+    sh->cap = cap;
+    for (uint32_t i = 0; i < oldcap; ++i) {
+        uint32_t j;
+
+        if (!old[i].line)
+            continue;
+        for (j = dir_hash(sh, old[i].line - 1); dir[j].line;
+             j = (j + 1) & (cap - 1))
+            ;
+        dir[j] = old[i];
+    }
+    free(old);
+
+    return SUCCEED;
+}
+
+/* the entry of line, a new one without sharers if absent */
+static coh_dir_entry_t *dir_get(coh_t *coh, coh_shard_t *sh, uint64_t line)
+{
+    coh_dir_entry_t *e = dir_find(sh, line);
+    uint32_t i;
+
+    if (e)
+        return e;
+    if ((sh->used + 1) * 2 > sh->cap && SUCCEED != dir_grow(sh)) {
+        __atomic_store_n(&coh->error, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    for (i = dir_hash(sh, line); sh->dir[i].line; i = (i + 1) & (sh->cap - 1))
+        ;
+    e = &sh->dir[i];
+    e->line = line + 1;
+    e->sharers = 0;
+    e->owner = -1;
+    e->state = COH_I;
+    sh->used++;
+
+    return e;
+}
+
+/* backward shift deletion, the probe chains stay whole */
+static void dir_remove(coh_shard_t *sh, coh_dir_entry_t *e)
+{
+    uint32_t mask = sh->cap - 1, i = e - sh->dir, j = i, h;
+
+    for (;;) {
+        j = (j + 1) & mask;
+        if (!sh->dir[j].line)
+            break;
+        /* j may fill the hole unless its home lies cyclically in (i, j] */
+        h = dir_hash(sh, sh->dir[j].line - 1);
+        if (j > i ? (h <= i || h > j) : (h <= i && h > j)) {
+            sh->dir[i] = sh->dir[j];
+            i = j;
+        }
+    }
+    sh->dir[i].line = 0;
+    sh->used--;
+}
+
+/* the private levels, under the core lock */
+
+static int priv_state(const coh_t *coh, coh_core_t *core, uint64_t line)
+{
+    for (int l = 0; l < coh->nprivate; ++l) {
+        int64_t slot = sim_line_lookup(core->levels[l], line, 0);
+
+        if (slot >= 0)
+            return core->levels[l]->coh[slot];
+    }
+
+    return COH_I;
+}
+
+static void priv_set(const coh_t *coh, coh_core_t *core, uint64_t line,
+                     int state)
+{
+    for (int l = 0; l < coh->nprivate; ++l) {
+        int64_t slot = sim_line_lookup(core->levels[l], line, 0);
+
+        if (slot >= 0)
+            core->levels[l]->coh[slot] = state;
+    }
+}
+
+/* drop every copy, return the state they had */
+static int priv_drop(const coh_t *coh, coh_core_t *core, uint64_t line)
+{
+    int state = COH_I;
+
+    for (int l = 0; l < coh->nprivate; ++l) {
+        int64_t slot = sim_line_invalidate(core->levels[l], line);
+
+        if (slot >= 0)
+            state = core->levels[l]->coh[slot];
+    }
+
+    return state;
+}
+
+/* the counters of the core causing an access, NULL if none */
+static inline stats_shard_t *stats_of(const coh_t *coh, const coh_core_t *core)
+{
+    return coh->stats ? &coh->stats->shards[core - coh->cores] : NULL;
+}
+
+/* fill the levels above from, bottom up, queueing the victims that leave */
+static void priv_fill(const coh_t *coh, coh_core_t *core, int from,
+                      uint64_t line, int state)
+{
+    stats_shard_t *st = stats_of(coh, core);
+
+    for (int l = from - 1; l >= 0; --l) {
+        cache_t *c = core->levels[l];
+        uint64_t slot, old = sim_line_insert(c, line, &c->rng, &slot);
+        int ostate = c->coh[slot];
+
+        c->coh[slot] = state;
+        if (old == SIM_NONE)
+            continue;
+        c->statistical_evict++;
+        if (st)
+            stats_evict(st, l, slot / c->ways, dirty(ostate));
+        if (l && c->hp_cache == H_inclusive)
+            for (int j = 0; j < l; ++j)
+                sim_line_invalidate(core->levels[j], old);
+        if (COH_I == priv_state(coh, core, old))
+            core->pending[core->npending++] = PENDING(old, dirty(ostate));
+    }
+}
+
+/* the LLC, under the shard lock of the line */
+
+static void llc_fill(coh_t *coh, coh_shard_t *sh, stats_shard_t *st,
+                     uint64_t line, int state)
+{
+    cache_t *llc = coh->llc;
+    uint64_t slot, old = sim_line_insert(llc, line, &sh->rng, &slot);
+    coh_dir_entry_t *e;
+    int wb;
+
+    if (old != SIM_NONE) {
+        sh->llc_evictions++;
+        wb = llc->coh[slot] == COH_M;
+        /* the victim shares the set, so the shard, of line */
+        if (llc->hp_cache == H_inclusive && (e = dir_find(sh, old))) {
+            for (int o = 0; o < coh->ncores; ++o) {
+                coh_core_t *core = &coh->cores[o];
+                int ostate;
+
+                if (!(e->sharers & COH_BIT(o)))
+                    continue;
+                pthread_mutex_lock(&core->lock);
+                if (COH_I != (ostate = priv_drop(coh, core, old)))
+                    core->invalidations++;
+                pthread_mutex_unlock(&core->lock);
+                wb |= dirty(ostate);
+            }
+            dir_remove(sh, e);
+        }
+        sh->memory_writebacks += wb;
+        if (st)
+            stats_evict(st, coh->nprivate, slot / llc->ways, wb);
+    }
+    llc->coh[slot] = state;
+}
+
+/* a line the private levels miss, return where it came from */
+static int llc_read(coh_t *coh, coh_shard_t *sh, stats_shard_t *st,
+                    uint64_t line)
+{
+    int64_t slot;
+
+    if (!coh->llc) {
+        sh->memory++;
+        return coh->nprivate;
+    }
+    if ((slot = sim_line_lookup(coh->llc, line, 1)) >= 0) {
+        sh->llc_hits++;
+        if (st)
+            stats_set(st, coh->nprivate, slot / coh->llc->ways)->hits++;
+        return coh->nprivate;
+    }
+
+    sh->llc_misses++;
+    sh->memory++;
+    if (st)
+        stats_set(st, coh->nprivate,
+                  fastmod_reduce(&coh->llc->set_index, line))->misses++;
+    llc_fill(coh, sh, st, line, COH_S);
+
+    return coh->nprivate + 1;
+}
+
+static void llc_write(coh_t *coh, coh_shard_t *sh, stats_shard_t *st,
+                      uint64_t line)
+{
+    int64_t slot;
+
+    if (!coh->llc)
+        sh->memory_writebacks++;
+    else if ((slot = sim_line_lookup(coh->llc, line, 0)) >= 0)
+        coh->llc->coh[slot] = COH_M;
+    else
+        llc_fill(coh, sh, st, line, COH_M);
+}
+
+/* report the queued victims of core c to their shards */
+static void retire(coh_t *coh, int c)
+{
+    coh_core_t *core = &coh->cores[c];
+
+    while (core->npending) {
+        uint64_t v = core->pending[--core->npending], line = v >> 1;
+        coh_shard_t *sh = shard_of(coh, line);
+        coh_dir_entry_t *e;
+        int present;
+
+        pthread_mutex_lock(&sh->lock);
+        pthread_mutex_lock(&core->lock);
+        present = COH_I != priv_state(coh, core, line);
+        pthread_mutex_unlock(&core->lock);
+        if (!present) {
+            if ((e = dir_find(sh, line))) {
+                e->sharers &= ~COH_BIT(c);
+                if (e->owner == c) {
+                    e->owner = -1;
+                    e->state = COH_S;
+                }
+                if (!e->sharers)
+                    dir_remove(sh, e);
+            }
+            if (v & 1) {
+                __atomic_fetch_add(&core->writebacks, 1, __ATOMIC_RELAXED);
+                llc_write(coh, sh, stats_of(coh, core), line);
+            }
+        }
+        pthread_mutex_unlock(&sh->lock);
+    }
+}
+
+/* a miss or an upgrade of core c, hit is the level holding the line */
+static int transact(coh_t *coh, int c, uint64_t line, int write, int hit)
+{
+    coh_shard_t *sh = shard_of(coh, line);
+    coh_core_t *core = &coh->cores[c], *o;
+    coh_dir_entry_t *e;
+    uint64_t sharers;
+    int cur, state, ostate, owner = -1, peer = 0, wb = 0, served;
+
+    pthread_mutex_lock(&sh->lock);
+    pthread_mutex_lock(&core->lock);
+    cur = priv_state(coh, core, line);
+    pthread_mutex_unlock(&core->lock);
+    /* another core may have taken the copy meanwhile */
+    if (cur == COH_I)
+        hit = coh->nprivate;
+
+    e = dir_find(sh, line);
+    sharers = e ? e->sharers & ~COH_BIT(c) : 0;
+    if (e && e->owner != c)
+        owner = e->owner;
+
+    if (write) {
+        for (int k = 0; k < coh->ncores; ++k) {
+            if (!(sharers & COH_BIT(k)))
+                continue;
+            o = &coh->cores[k];
+            pthread_mutex_lock(&o->lock);
+            if (COH_I != (ostate = priv_drop(coh, o, line)))
+                o->invalidations++;
+            pthread_mutex_unlock(&o->lock);
+            peer |= dirty(ostate);
+        }
+        sharers = 0;
+        owner = c;
+        state = COH_M;
+    } else {
+        if (owner >= 0) {
+            o = &coh->cores[owner];
+            pthread_mutex_lock(&o->lock);
+            switch ((ostate = priv_state(coh, o, line))) {
+            case COH_M:
+                peer = 1;
+                if (coh->protocol == COH_moesi) {
+                    priv_set(coh, o, line, COH_O);
+                } else {
+                    priv_set(coh, o, line, COH_S);
+                    wb = 1;
+                    owner = -1;
+                }
+                break;
+            case COH_O:
+                peer = 1;
+                break;
+            case COH_E:
+                priv_set(coh, o, line, COH_S);
+                owner = -1;
+                break;
+            case COH_I:
+                sharers &= ~COH_BIT(owner);
+                /* fall through */
+            default:
+                owner = -1;
+                break;
+            }
+            pthread_mutex_unlock(&o->lock);
+        }
+        state = sharers ? COH_S : COH_E;
+        if (state == COH_E)
+            owner = c;
+    }
+
+    /* the entry may move while the LLC evicts */
+    if (wb)
+        llc_write(coh, sh, stats_of(coh, core), line);
+    if (hit < coh->nprivate) {
+        core->upgrades++;
+        served = hit;
+    } else if (peer) {
+        core->transfers++;
+        served = COH_PEER;
+    } else {
+        served = llc_read(coh, sh, stats_of(coh, core), line);
+    }
+    if ((e = dir_get(coh, sh, line))) {
+        e->sharers = sharers | COH_BIT(c);
+        e->owner = owner;
+        e->state = owner < 0 ? COH_S : owner == c ? state : COH_O;
+    }
+
+    pthread_mutex_lock(&core->lock);
+    priv_set(coh, core, line, state);
+    priv_fill(coh, core, hit, line, state);
+    pthread_mutex_unlock(&core->lock);
+    pthread_mutex_unlock(&sh->lock);
+
+    return served;
+}
+
+int coh_access(coh_t *coh, int c, uint64_t line, int op)
+{
+    coh_core_t *core = &coh->cores[c];
+    stats_shard_t *st = stats_of(coh, core);
+    int write = op == TRACE_write, state = COH_I, l, served;
+    int64_t slot;
+
+    if (st)
+        stats_line(coh->stats, st, line << coh->lineshift);
+    pthread_mutex_lock(&core->lock);
+    for (l = 0; l < coh->nprivate; ++l) {
+        cache_t *level = core->levels[l];
+
+        if ((slot = sim_line_lookup(level, line, 1)) >= 0) {
+            level->statistical_hit++;
+            if (st)
+                stats_set(st, l, slot / level->ways)->hits++;
+            state = level->coh[slot];
+            break;
+        }
+        level->statistical_miss++;
+        if (st)
+            stats_set(st, l, fastmod_reduce(&level->set_index, line))->misses++;
+    }
+
+    if (l < coh->nprivate && (!write || state == COH_E || state == COH_M)) {
+        if (write && state == COH_E)
+            priv_set(coh, core, line, state = COH_M);
+        priv_fill(coh, core, l, line, state);
+        pthread_mutex_unlock(&core->lock);
+        served = l;
+    } else {
+        pthread_mutex_unlock(&core->lock);
+        served = transact(coh, c, line, write, l);
+    }
+    if (core->npending)
+        retire(coh, c);
+    if (st)
+        stats_served(st, served != coh->nprivate + !!coh->llc);
+
+    return served;
+}
+
+void coh_ref(coh_t *coh, const trace_ref_t *ref)
+{
+    uint64_t line = ref->addr >> coh->lineshift;
+    uint64_t last = (ref->addr + (ref->size ? ref->size - 1 : 0)) >>
+                    coh->lineshift;
+    int c = ref->cpu % coh->ncores;
+    coh_core_t *core = &coh->cores[c];
+
+    if ((ref->op == TRACE_ifetch) !=
+        (coh->cores[0].levels[0]->t_cache == ICache)) {
+        core->skipped++;
+        return;
+    }
+
+    core->refs++;
+    if (coh->stats)
+        stats_ref(coh->stats, &coh->stats->shards[c], ref->pc);
+    for (; line <= last; ++line)
+        coh_access(coh, c, line, ref->op);
+    if (core->series && series_due(core->series, core->refs))
+        series_sample(core->series, core->refs, core->levels);
+}
+
+static cache_t *clone_level(arena_t *arena, const cache_t *proto,
+                            uint64_t seed)
+{
+    uint64_t n = (uint64_t)proto->sets * proto->ways;
+    cache_t *c = arena_alloc(arena, sizeof(cache_t));
+
+    if (!c)
+        return NULL;
+
+    *c = *proto;
+    INIT_LIST_HEAD(&c->list);
+    c->statistical_hit = 0;
+    c->statistical_miss = 0;
+    c->statistical_evict = 0;
+    c->rng = seed;
+    c->tags = arena_alloc(arena, n * sizeof(uint64_t));
+    c->repl = arena_alloc(arena, n * sizeof(uint32_t));
+    c->coh = arena_alloc(arena, n * sizeof(uint8_t));
+    if (!c->tags || !c->repl || !c->coh)
+        return NULL;
+    for (uint64_t i = 0; i < n; ++i)
+        c->repl[i] = i % c->ways;
+
+    return c;
+}
+
+coh_t *coh_create(struct list_head *caches, int ncores,
+                  coh_protocol_t protocol, unsigned int nshards)
+{
+    cache_t *cache, *proto[COH_MAX_LEVELS + 1];
+    sim_t *sim;
+    coh_t *coh;
+    int n = 0;
+
+    if (ncores < 1 || ncores > COH_MAX_CORES ||
+        (protocol != COH_mesi && protocol != COH_moesi) ||
+        !nshards || (nshards & (nshards - 1))) {
+        LOG_ERR("bad multi-core configuration");
+        return NULL;
+    }
+    list_for_each_entry(cache, caches, list) {
+        if (n > COH_MAX_LEVELS) {
+            LOG_ERR("more than %d private levels", COH_MAX_LEVELS);
+            return NULL;
+        }
+        proto[n++] = cache;
+    }
+    /* the same rules as one core, and a cold LLC */
+    if (!(sim = sim_create(caches)))
+        return NULL;
+    if (!(coh = calloc(1, sizeof(coh_t)))) {
+        sim_destroy(sim);
+        return NULL;
+    }
+    coh->lineshift = sim->lineshift;
+    sim_destroy(sim);
+
+    coh->ncores = ncores;
+    coh->protocol = protocol;
+    coh->nprivate = n > 1 ? n - 1 : 1;
+    coh->nshards = nshards;
+    coh->cores = aligned_alloc(64, sizeof(coh_core_t) * ncores);
+    coh->shards = aligned_alloc(64, sizeof(coh_shard_t) * nshards);
+    /* the private levels take the pages the shared ones do */
+    coh->arena = arena_create(ARENA_THP);
+    if (!coh->cores || !coh->shards || !coh->arena) {
+        arena_destroy(coh->arena);
+        free(coh->cores);
+        free(coh->shards);
+        free(coh);
+        return NULL;
+    }
+    memset(coh->cores, 0, sizeof(coh_core_t) * ncores);
+    memset(coh->shards, 0, sizeof(coh_shard_t) * nshards);
+    for (int c = 0; c < ncores; ++c)
+        pthread_mutex_init(&coh->cores[c].lock, NULL);
+    for (unsigned int s = 0; s < nshards; ++s) {
+        pthread_mutex_init(&coh->shards[s].lock, NULL);
+        coh->shards[s].rng = 0x9e3779b97f4a7c15ULL + s;
+    }
+
+    for (int c = 0; c < ncores; ++c)
+        for (int l = 0; l < coh->nprivate; ++l)
+            if (!(coh->cores[c].levels[l] =
+                  clone_level(coh->arena, proto[l], 0x9e3779b97f4a7c15ULL + c * 8 + l)))
+                goto fail;
+    if (n > 1) {
+        coh->llc = proto[n - 1];
+        coh->llc->coh = arena_alloc(coh->arena, (uint64_t)coh->llc->sets *
+                                    coh->llc->ways);
+        if (!coh->llc->coh)
+            goto fail;
+    }
+
+    return coh;
+fail:
+    coh_destroy(coh);
+    return NULL;
+}
+
+void coh_destroy(coh_t *coh)
+{
+    if (!coh)
+        return;
+
+    for (int c = 0; c < coh->ncores; ++c) {
+        pthread_mutex_destroy(&coh->cores[c].lock);
+        series_source_destroy(coh->cores[c].series);
+    }
+    for (unsigned int s = 0; s < coh->nshards; ++s) {
+        free(coh->shards[s].dir);
+        pthread_mutex_destroy(&coh->shards[s].lock);
+    }
+    /* the private levels and the LLC states go with the arena */
+    if (coh->llc)
+        coh->llc->coh = NULL;
+    arena_destroy(coh->arena);
+    free(coh->cores);
+    free(coh->shards);
+    free(coh);
+}
+
+int coh_stats(coh_t *coh, stats_t *s)
+{
+    int n = coh->nprivate + !!coh->llc;
+
+    if (s->nlevels != n || s->nshards != coh->ncores ||
+        s->sets[0] != coh->cores[0].levels[0]->sets ||
+        (coh->llc && s->sets[n - 1] != coh->llc->sets)) {
+        LOG_ERR("statistics of another hierarchy");
+        return FAIL;
+    }
+    coh->stats = s;
+
+    return SUCCEED;
+}
+
+int coh_series(coh_t *coh, series_t *s, uint32_t config)
+{
+    int n = coh->nprivate < SERIES_LEVELS ? coh->nprivate : SERIES_LEVELS;
+
+    for (int c = 0; c < coh->ncores; ++c) {
+        coh_core_t *core = &coh->cores[c];
+
+        if (!(core->series = series_source(s, config, c, n)))
+            return FAIL;
+        core->series->start = core->refs;
+        core->series->next = core->refs + s->every;
+        for (int l = 0; l < n; ++l) {
+            core->series->last[l][0] = core->levels[l]->statistical_hit;
+            core->series->last[l][1] = core->levels[l]->statistical_miss;
+            core->series->last[l][2] = core->levels[l]->statistical_evict;
+        }
+    }
+
+    return SUCCEED;
+}
+
+/* the counters of every step-th core from first, for the telemetry */
+static void publish(coh_t *coh, int first, int step)
+{
+    for (int c = first; c < coh->ncores; c += step) {
+        const coh_core_t *core = &coh->cores[c];
+
+        progress_refs(coh->progress, c, core->refs);
+        for (int l = 0; l < coh->nprivate && l < PROGRESS_LEVELS; ++l)
+            progress_level(coh->progress, c, l,
+                           core->levels[l]->statistical_hit,
+                           core->levels[l]->statistical_miss);
+    }
+}
+
+static void *worker(void *arg)
+{
+    coh_worker_t *w = arg;
+    const trace_batch_t *b;
+
+    while ((b = spsc_peek(w->q))) {
+        for (uint32_t i = 0; i < b->n; ++i)
+            coh_ref(w->coh, &b->refs[i]);
+        if (w->coh->progress)
+            publish(w->coh, w->id, w->nworkers);
+        spsc_release(w->q);
+    }
+
+    return NULL;
+}
+
+/* deal the references of a batch to the workers of their cores */
+static void dispatch(coh_t *coh, coh_worker_t *w, int nworkers,
+                     const trace_ref_t *refs, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; ++i) {
+        coh_worker_t *t = &w[(refs[i].cpu % coh->ncores) % nworkers];
+
+        if (!t->b) {
+            t->b = spsc_acquire(t->q);
+            t->b->n = 0;
+        }
+        t->b->refs[t->b->n++] = refs[i];
+        if (t->b->n == TRACE_BATCH) {
+            spsc_publish(t->q);
+            t->b = NULL;
+        }
+    }
+}
+
+void coh_end(coh_t *coh, const char *trace)
+{
+    uint64_t refs = 0, skipped = 0;
+
+    for (int c = 0; c < coh->ncores; ++c) {
+        if (coh->cores[c].series)
+            series_flush(coh->cores[c].series, coh->cores[c].refs,
+                         coh->cores[c].levels);
+        refs += coh->cores[c].refs;
+        skipped += coh->cores[c].skipped;
+    }
+    if (!refs && skipped)
+        LOG_ERR("no reference of [%s] for the %s, %llu skipped, see type",
+                trace, coh->cores[0].levels[0]->t_cache == ICache ?
+                "ICache" : "DCache", (unsigned long long)skipped);
+}
+
+int coh_run(coh_t *coh, const char *trace, int nthreads)
+{
+    trace_reader_t *r = trace_open(trace);
+    const trace_batch_t *b;
+    coh_worker_t *w = NULL;
+    trace_stream_t *s;
+    uint32_t n;
+    int nworkers = 0, ret;
+
+    if (!r)
+        return FAIL;
+    if (coh->progress)
+        progress_size(coh->progress, trace_size(r));
+    if (!(s = trace_stream_start(r))) {
+        trace_close(r);
+        return FAIL;
+    }
+
+    if (nthreads <= 0)
+        nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads > coh->ncores)
+        nthreads = coh->ncores;
+    /* one thread simulates on the caller, in trace order */
+    if (nthreads > 1 && (w = calloc(nthreads, sizeof(coh_worker_t)))) {
+        for (; nworkers < nthreads; ++nworkers) {
+            coh_worker_t *t = &w[nworkers];
+
+            t->coh = coh;
+            t->id = nworkers;
+            t->q = spsc_create(TRACE_RING_SLOTS, sizeof(trace_batch_t));
+            if (!t->q || pthread_create(&t->tid, NULL, worker, t)) {
+                spsc_destroy(t->q);
+                break;
+            }
+        }
+        /* seen by a worker with its first batch */
+        for (int i = 0; i < nworkers; ++i)
+            w[i].nworkers = nworkers;
+    }
+
+    while ((b = trace_stream_next(s, &n))) {
+        if (nworkers)
+            dispatch(coh, w, nworkers, b->refs, n);
+        else
+            for (uint32_t i = 0; i < n; ++i)
+                coh_ref(coh, &b->refs[i]);
+        if (coh->progress) {
+            if (!nworkers)
+                publish(coh, 0, 1);
+            progress_bytes(coh->progress, b->bytes);
+        }
+        trace_stream_release(s);
+    }
+
+    for (int i = 0; i < nworkers; ++i) {
+        if (w[i].b)
+            spsc_publish(w[i].q);
+        spsc_close(w[i].q);
+        pthread_join(w[i].tid, NULL);
+        spsc_destroy(w[i].q);
+    }
+    free(w);
+    ret = trace_stream_stop(s);
+    coh_end(coh, trace);
+
+    return coh->error ? FAIL : ret;
+}
+
+double coh_miss_ratio(const coh_t *coh, int level)
+{
+    uint64_t hits = 0, misses = 0;
+
+    if (level < coh->nprivate) {
+        for (int c = 0; c < coh->ncores; ++c) {
+            hits += coh->cores[c].levels[level]->statistical_hit;
+            misses += coh->cores[c].levels[level]->statistical_miss;
+        }
+    } else if (coh->llc) {
+        for (unsigned int s = 0; s < coh->nshards; ++s) {
+            hits += coh->shards[s].llc_hits;
+            misses += coh->shards[s].llc_misses;
+        }
+    }
+
+    return hits + misses ? (double)misses / (hits + misses) : 0.0;
+}
+
+void coh_report(const coh_t *coh, FILE *out)
+{
+    uint64_t hits = 0, misses = 0, memory = 0, writebacks = 0;
+
+    fprintf(out, "%d cores, %s\n", coh->ncores,
+            coh->protocol == COH_moesi ? "MOESI" : "MESI");
+    for (int c = 0; c < coh->ncores; ++c) {
+        const coh_core_t *core = &coh->cores[c];
+
+        fprintf(out, "core %d: %llu refs,", c, (unsigned long long)core->refs);
+        for (int l = 0; l < coh->nprivate; ++l)
+            fprintf(out, " L%d %llu/%llu", l + 1,
+                    core->levels[l]->statistical_hit,
+                    core->levels[l]->statistical_miss);
+        fprintf(out, " hits/misses, %llu upgrades, %llu transfers, "
+                "%llu writebacks, %llu invalidations\n",
+                (unsigned long long)core->upgrades,
+                (unsigned long long)core->transfers,
+                (unsigned long long)core->writebacks,
+                (unsigned long long)core->invalidations);
+    }
+    for (int l = 0; l < coh->nprivate; ++l)
+        fprintf(out, "L%d: miss ratio %.4f\n", l + 1, coh_miss_ratio(coh, l));
+
+    for (unsigned int s = 0; s < coh->nshards; ++s) {
+        hits += coh->shards[s].llc_hits;
+        misses += coh->shards[s].llc_misses;
+        memory += coh->shards[s].memory;
+        writebacks += coh->shards[s].memory_writebacks;
+    }
+    if (coh->llc)
+        fprintf(out, "L%d (shared): %llu hits, %llu misses, miss ratio %.4f\n",
+                coh->nprivate + 1, (unsigned long long)hits,
+                (unsigned long long)misses,
+                coh_miss_ratio(coh, coh->nprivate));
+    fprintf(out, "memory: %llu lines, %llu writebacks\n",
+            (unsigned long long)memory, (unsigned long long)writebacks);
+}
@@ -0,0 +1,206 @@
+/*
+ * @file perf.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Counters of the simulator, see perf.h.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perf.h"
+
+#define CACHE_EVENT(cache, op, result) \
+    ((cache) | ((op) << 8) | ((result) << 16))
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+    const char *name;
+} events[PERF_EVENTS] = {
+    [PERF_cycles] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,
+                      "cycles" },
+    [PERF_instructions] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,
+                            "instructions" },
+    [PERF_l1d_misses] = { PERF_TYPE_HW_CACHE,
+        CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                    PERF_COUNT_HW_CACHE_RESULT_MISS), "L1d misses" },
+    [PERF_llc_misses] = { PERF_TYPE_HW_CACHE,
+        CACHE_EVENT(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ,
+                    PERF_COUNT_HW_CACHE_RESULT_MISS), "LLC misses" },
+    [PERF_dtlb_load_misses] = { PERF_TYPE_HW_CACHE,
+        CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+                    PERF_COUNT_HW_CACHE_RESULT_MISS), "dTLB load misses" },
+    [PERF_dtlb_store_misses] = { PERF_TYPE_HW_CACHE,
+        CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_WRITE,
+                    PERF_COUNT_HW_CACHE_RESULT_MISS), "dTLB store misses" },
+    [PERF_branch_misses] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES,
+                             "branch misses" },
+    [PERF_page_faults] = { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS,
+                           "page faults" },
+};
+
+static const char *phase_names[PERF_PHASES] = {
+    "config", "mrc", "build", "decode", "warm-up", "simulate",
+};
+
+int perf_start(perf_t *p, int inherit)
+{
+    struct perf_event_attr attr;
+    int n = 0;
+
+    for (int e = 0; e < PERF_EVENTS; ++e) {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[e].type;
+        attr.config = events[e].config;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.disabled = 1;
+        attr.inherit = !!inherit;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        p->fd[e] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (p->fd[e] < 0)
+            continue;
+        ioctl(p->fd[e], PERF_EVENT_IOC_RESET, 0);
+        ioctl(p->fd[e], PERF_EVENT_IOC_ENABLE, 0);
+        n++;
+    }
+
+    return n;
+}
+
+void perf_read(const perf_t *p, uint64_t count[PERF_EVENTS])
+{
+    uint64_t v[3];              /* value, time enabled, time running */
+
+    for (int e = 0; e < PERF_EVENTS; ++e) {
+        count[e] = PERF_NONE;
+        if (p->fd[e] < 0 || read(p->fd[e], v, sizeof(v)) != sizeof(v))
+            continue;
+        /* multiplexed, scale to the time enabled */
+        if (v[2] && v[2] < v[1])
+            v[0] = (double)v[0] * v[1] / v[2];
+        count[e] = v[0];
+    }
+}
+
+void perf_stop(perf_t *p, uint64_t count[PERF_EVENTS])
+{
+    perf_read(p, count);
+    for (int e = 0; e < PERF_EVENTS; ++e) {
+        if (p->fd[e] >= 0)
+            close(p->fd[e]);
+        p->fd[e] = -1;
+    }
+}
+
+void perf_report(const uint64_t count[PERF_EVENTS], uint64_t refs, FILE *out)
+{
+    const char *sep = "";
+
+    for (int e = 0; e < PERF_EVENTS; ++e, sep = ", ") {
+        if (count[e] == PERF_NONE) {
+            fprintf(out, "%s%s n/a", sep, events[e].name);
+            continue;
+        }
+        fprintf(out, "%s%llu %s", sep, (unsigned long long)count[e],
+                events[e].name);
+        if (refs)
+            fprintf(out, " (%.2f/ref)", (double)count[e] / refs);
+    }
+    if (count[PERF_cycles] != PERF_NONE && count[PERF_cycles] &&
+        count[PERF_instructions] != PERF_NONE)
+        fprintf(out, ", IPC %.2f",
+                (double)count[PERF_instructions] / count[PERF_cycles]);
+    fputc('\n', out);
+}
+
+/* to += a - b, a counter missing in any stays missing */
+static void add_delta(uint64_t *to, const uint64_t *a, const uint64_t *b)
+{
+    for (int e = 0; e < PERF_EVENTS; ++e) {
+        if (to[e] == PERF_NONE || a[e] == PERF_NONE || b[e] == PERF_NONE) {
+            to[e] = PERF_NONE;
+            continue;
+        }
+        /* scaled counts may step back a little */
+        to[e] += a[e] > b[e] ? a[e] - b[e] : 0;
+    }
+}
+
+int perf_profile_start(perf_profile_t *p, perf_phase_t phase)
+{
+    int n;
+
+    memset(p, 0, sizeof(*p));
+    for (int e = 0; e < PERF_EVENTS; ++e)
+        p->all.fd[e] = -1;
+    p->phase = phase;
+    n = perf_start(&p->self, 0);
+    perf_read(&p->self, p->last);
+
+    return n;
+}
+
+void perf_phase(perf_profile_t *p, perf_phase_t phase)
+{
+    uint64_t now[PERF_EVENTS];
+
+    perf_read(&p->self, now);
+    add_delta(p->count[p->phase], now, p->last);
+    p->seen[p->phase] = 1;
+    memcpy(p->last, now, sizeof(now));
+    p->phase = phase;
+}
+
+void perf_threads_start(perf_profile_t *p)
+{
+    perf_start(&p->all, 1);
+    perf_read(&p->self, p->mark);
+}
+
+void perf_threads_stop(perf_profile_t *p, perf_phase_t phase)
+{
+    uint64_t all[PERF_EVENTS], self[PERF_EVENTS], zero[PERF_EVENTS] = { 0 };
+
+    /* the threads have ended, their counts are in all */
+    perf_stop(&p->all, all);
+    perf_read(&p->self, self);
+    add_delta(p->count[phase], all, zero);
+    p->seen[phase] = 1;
+    for (int e = 0; e < PERF_EVENTS; ++e) {
+        if (p->count[phase][e] == PERF_NONE || self[e] == PERF_NONE ||
+            p->mark[e] == PERF_NONE)
+            continue;
+        /* less what the calling thread did meanwhile */
+        p->count[phase][e] -= self[e] - p->mark[e] < p->count[phase][e] ?
+                              self[e] - p->mark[e] : p->count[phase][e];
+    }
+}
+
+void perf_profile_stop(perf_profile_t *p)
+{
+    uint64_t unused[PERF_EVENTS];
+
+    perf_phase(p, p->phase);
+    perf_stop(&p->self, unused);
+}
+
+void perf_profile_report(const perf_profile_t *p, FILE *out)
+{
+    for (int ph = 0; ph < PERF_PHASES; ++ph) {
+        if (!p->seen[ph])
+            continue;
+        fprintf(out, "profile %s: ", phase_names[ph]);
+        perf_report(p->count[ph], p->refs[ph], out);
+    }
+}
@@ -0,0 +1,209 @@
+/*
+ * @file progress.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Telemetry of a long run, see progress.h.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cfg.h"
+#include "progress.h"
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* 123.4M, 1000 based for counts, 1024 based for bytes */
+static const char *human(double v, double unit, char *buf, size_t size)
+{
+    static const char suffix[] = " KMGTP";
+    int i = 0;
+
+    while (v >= unit && i < (int)sizeof(suffix) - 2) {
+        v /= unit;
+        i++;
+    }
+    if (i)
+        snprintf(buf, size, "%.1f%c", v, suffix[i]);
+    else
+        snprintf(buf, size, "%.0f", v);
+
+    return buf;
+}
+
+void progress_sample(progress_t *p, int done, FILE *out)
+{
+    uint64_t refs = 0, hits[PROGRESS_LEVELS] = { 0 };
+    uint64_t misses[PROGRESS_LEVELS] = { 0 };
+    uint64_t bytes = __atomic_load_n(&p->bytes, __ATOMIC_RELAXED);
+    uint64_t size = __atomic_load_n(&p->size, __ATOMIC_RELAXED);
+    double t = now(), elapsed = t - p->start, rate, eta = -1.0;
+    char text[PROGRESS_PAGE], a[16], b[16], c[16];
+    int n;
+
+    for (int s = 0; s < p->nsources; ++s) {
+        progress_source_t *src = &p->sources[s];
+
+        refs += __atomic_load_n(&src->refs, __ATOMIC_RELAXED);
+        for (int l = 0; l < p->nlevels; ++l) {
+            hits[l] += __atomic_load_n(&src->hits[l], __ATOMIC_RELAXED);
+            misses[l] += __atomic_load_n(&src->misses[l], __ATOMIC_RELAXED);
+        }
+    }
+    rate = t > p->last ? (refs - p->last_refs) / (t - p->last) : 0.0;
+    p->last = t;
+    p->last_refs = refs;
+    /* at the mean speed so far */
+    if (size && bytes && bytes <= size)
+        eta = elapsed * (size - bytes) / bytes;
+
+    if (!p->page) {
+        fprintf(out, "progress: %.1fs, %s refs, %s refs/s,", elapsed,
+                human(refs, 1000, a, sizeof(a)),
+                human(rate, 1000, b, sizeof(b)));
+        for (int l = 0; l < p->nlevels; ++l)
+            fprintf(out, " L%d %.1f%%", l + 1, hits[l] + misses[l] ?
+                    100.0 * hits[l] / (hits[l] + misses[l]) : 0.0);
+        if (size)
+            fprintf(out, ", %sB of %sB read",
+                    human(bytes, 1024, a, sizeof(a)),
+                    human(size, 1024, c, sizeof(c)));
+        else
+            fprintf(out, ", %sB read", human(bytes, 1024, a, sizeof(a)));
+        if (eta >= 0)
+            fprintf(out, ", eta %.0fs", eta);
+        fputs(done ? ", done\n" : "\n", out);
+        fflush(out);
+        return;
+    }
+
+    n = snprintf(text, sizeof(text), "elapsed %.1f\nrefs %llu\nrate %.0f\n"
+                 "bytes %llu\nsize %llu\neta %.1f\n", elapsed,
+                 (unsigned long long)refs, rate, (unsigned long long)bytes,
+                 (unsigned long long)size, eta);
+    for (int l = 0; l < p->nlevels; ++l)
+        n += snprintf(text + n, sizeof(text) - n, "L%d %.4f\n", l + 1,
+                      hits[l] + misses[l] ?
+                      (double)hits[l] / (hits[l] + misses[l]) : 0.0);
+    n += snprintf(text + n, sizeof(text) - n, "done %d\n", done);
+    /* a reader may catch a sample half written, the next one heals it */
+    memcpy(p->page, text, n);
+    memset(p->page + n, 0, PROGRESS_PAGE - n);
+}
+
+static void *telemetry(void *arg)
+{
+    progress_t *p = arg;
+    struct timespec deadline;
+
+    pthread_mutex_lock(&p->lock);
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    while (!p->stop) {
+        deadline.tv_sec += p->interval / 1000;
+        deadline.tv_nsec += (p->interval % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while (!p->stop &&
+               pthread_cond_timedwait(&p->cond, &p->lock, &deadline) !=
+               ETIMEDOUT)
+            ;
+        if (!p->stop)
+            progress_sample(p, 0, stderr);
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return NULL;
+}
+
+static int map_page(progress_t *p, const char *path)
+{
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0 || ftruncate(fd, PROGRESS_PAGE)) {
+        LOG_ERR("cannot create the progress page [%s]", path);
+        if (fd >= 0)
+            close(fd);
+        return FAIL;
+    }
+    p->page = mmap(NULL, PROGRESS_PAGE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fd, 0);
+    close(fd);
+    if (p->page == MAP_FAILED) {
+        p->page = NULL;
+        LOG_ERR("cannot map the progress page [%s]", path);
+        return FAIL;
+    }
+
+    return SUCCEED;
+}
+
+progress_t *progress_start(int nlevels, int nsources, unsigned int interval,
+                           const char *path)
+{
+    progress_t *p;
+
+    if (nlevels < 1 || nlevels > PROGRESS_LEVELS || nsources < 1 ||
+        nsources > PROGRESS_SOURCES || !interval) {
+        LOG_ERR("bad progress configuration");
+        return NULL;
+    }
+    if (!(p = calloc(1, sizeof(progress_t))))
+        return NULL;
+
+    p->nlevels = nlevels;
+    p->nsources = nsources;
+    p->interval = interval;
+    p->start = p->last = now();
+    if (path && SUCCEED != map_page(p, path)) {
+        free(p);
+        return NULL;
+    }
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->cond, NULL);
+    if (pthread_create(&p->tid, NULL, telemetry, p)) {
+        pthread_mutex_destroy(&p->lock);
+        pthread_cond_destroy(&p->cond);
+        if (p->page)
+            munmap(p->page, PROGRESS_PAGE);
+        free(p);
+        return NULL;
+    }
+
+    return p;
+}
+
+void progress_stop(progress_t *p)
+{
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&p->lock);
+    p->stop = 1;
+    pthread_cond_signal(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+    pthread_join(p->tid, NULL);
+
+    progress_sample(p, 1, stderr);
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->cond);
+    if (p->page)
+        munmap(p->page, PROGRESS_PAGE);
+    free(p);
+}
@@ -0,0 +1,298 @@
+/*
+ * @file series.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Time series of a run, see series.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "series.h"
+
+static int write_block(series_t *s, const series_block_t *b)
+{
+    if (s->binary)
+        return fwrite(b->records, sizeof(series_record_t), b->n, s->f) ==
+               (size_t)b->n ? SUCCEED : FAIL;
+
+    for (int i = 0; i < b->n; ++i) {
+        const series_record_t *r = &b->records[i];
+
+        fprintf(s->f, "%u,%u,%llu,%llu,%u,%llu,%llu,%llu\n", r->config,
+                r->source, (unsigned long long)r->interval,
+                (unsigned long long)r->refs, r->level,
+                (unsigned long long)r->hits, (unsigned long long)r->misses,
+                (unsigned long long)r->evictions);
+    }
+
+    return ferror(s->f) ? FAIL : SUCCEED;
+}
+
+/* the full blocks in order, until closed */
+static void *writer(void *arg)
+{
+    series_t *s = arg;
+    series_block_t *b;
+
+    pthread_mutex_lock(&s->lock);
+    for (;;) {
+        while (!s->full && !s->stop)
+            pthread_cond_wait(&s->filled, &s->lock);
+        if (!(b = s->full))
+            break;
+        if (!(s->full = b->next))
+            s->last = NULL;
+        pthread_mutex_unlock(&s->lock);
+
+        if (SUCCEED != write_block(s, b))
+            s->error = 1;
+
+        pthread_mutex_lock(&s->lock);
+        b->next = s->free;
+        s->free = b;
+        pthread_cond_signal(&s->freed);
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    return NULL;
+}
+
+/* one more block in the free list */
+static int add_block(series_t *s)
+{
+    series_block_t *b = malloc(sizeof(series_block_t));
+
+    if (!b)
+        return FAIL;
+
+    pthread_mutex_lock(&s->lock);
+    b->chain = s->blocks;
+    s->blocks = b;
+    b->next = s->free;
+    s->free = b;
+    pthread_cond_signal(&s->freed);
+    pthread_mutex_unlock(&s->lock);
+
+    return SUCCEED;
+}
+
+static void free_blocks(series_t *s)
+{
+    while (s->blocks) {
+        series_block_t *b = s->blocks;
+
+        s->blocks = b->chain;
+        free(b);
+    }
+}
+
+static series_block_t *take_block(series_t *s)
+{
+    series_block_t *b;
+
+    pthread_mutex_lock(&s->lock);
+    while (!s->free)
+        pthread_cond_wait(&s->freed, &s->lock);
+    b = s->free;
+    s->free = b->next;
+    pthread_mutex_unlock(&s->lock);
+    b->n = 0;
+
+    return b;
+}
+
+static void hand_over(series_t *s, series_block_t *b)
+{
+    b->next = NULL;
+    pthread_mutex_lock(&s->lock);
+    if (s->last)
+        s->last->next = b;
+    else
+        s->full = b;
+    s->last = b;
+    pthread_cond_signal(&s->filled);
+    pthread_mutex_unlock(&s->lock);
+}
+
+static int write_header(series_t *s)
+{
+    uint32_t head[2] = { SERIES_VERSION, sizeof(series_record_t) };
+
+    if (!s->binary)
+        return fputs("config,source,interval,refs,level,hits,misses,"
+                     "evictions\n", s->f) < 0 ? FAIL : SUCCEED;
+
+    return fwrite(SERIES_MAGIC, 8, 1, s->f) == 1 &&
+           fwrite(head, sizeof(head), 1, s->f) == 1 ? SUCCEED : FAIL;
+}
+
+series_t *series_open(const char *path, int binary, uint64_t every)
+{
+    series_t *s;
+
+    if (!every) {
+        LOG_ERR("bad series interval");
+        return NULL;
+    }
+    if (!(s = calloc(1, sizeof(series_t))))
+        return NULL;
+
+    s->binary = binary;
+    s->every = every;
+    s->f = strcmp(path, "-") ? fopen(path, binary ? "wb" : "w") : stdout;
+    if (!s->f) {
+        LOG_ERR("cannot create the series [%s]", path);
+        free(s);
+        return NULL;
+    }
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->freed, NULL);
+    pthread_cond_init(&s->filled, NULL);
+    for (int i = 0; i < SERIES_BLOCKS; ++i)
+        if (SUCCEED != add_block(s))
+            goto fail;
+    if (SUCCEED != write_header(s)) {
+        LOG_ERR("cannot write the series [%s]", path);
+        goto fail;
+    }
+    if (pthread_create(&s->tid, NULL, writer, s))
+        goto fail;
+
+    return s;
+fail:
+    free_blocks(s);
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->freed);
+    pthread_cond_destroy(&s->filled);
+    if (s->f != stdout)
+        fclose(s->f);
+    free(s);
+    return NULL;
+}
+
+int series_close(series_t *s)
+{
+    int ret;
+
+    if (!s)
+        return SUCCEED;
+
+    pthread_mutex_lock(&s->lock);
+    s->stop = 1;
+    pthread_cond_signal(&s->filled);
+    pthread_mutex_unlock(&s->lock);
+    pthread_join(s->tid, NULL);
+
+    ret = s->error ? FAIL : SUCCEED;
+    if (s->f == stdout ? fflush(s->f) : fclose(s->f))
+        ret = FAIL;
+    if (SUCCEED != ret)
+        LOG_ERR("cannot write the series");
+    free_blocks(s);
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->freed);
+    pthread_cond_destroy(&s->filled);
+    free(s);
+
+    return ret;
+}
+
+series_source_t *series_source(series_t *s, uint32_t config,
+                               uint16_t source, int nlevels)
+{
+    series_source_t *src;
+
+    if (nlevels < 1 || nlevels > SERIES_LEVELS) {
+        LOG_ERR("bad series levels");
+        return NULL;
+    }
+    /* a block it may hold, the writer keeps SERIES_BLOCKS to free */
+    if (SUCCEED != add_block(s) ||
+        !(src = calloc(1, sizeof(series_source_t))))
+        return NULL;
+
+    src->s = s;
+    src->config = config;
+    src->source = source;
+    src->nlevels = nlevels;
+    src->next = s->every;
+
+    return src;
+}
+
+void series_source_destroy(series_source_t *src)
+{
+    if (!src)
+        return;
+
+    if (src->b)
+        hand_over(src->s, src->b);
+    free(src);
+}
+
+/* a record per level, for the interval ending at refs */
+static void emit(series_source_t *src, uint64_t refs, cache_t *const *levels)
+{
+    for (int l = 0; l < src->nlevels; ++l) {
+        const cache_t *c = levels[l];
+        uint64_t *last = src->last[l];
+        series_record_t *r;
+
+        if (!src->b)
+            src->b = take_block(src->s);
+        r = &src->b->records[src->b->n++];
+        r->config = src->config;
+        r->source = src->source;
+        r->level = l + 1;
+        r->pad = 0;
+        r->interval = src->interval;
+        r->refs = src->base + refs;
+        r->hits = c->statistical_hit - last[0];
+        r->misses = c->statistical_miss - last[1];
+        r->evictions = c->statistical_evict - last[2];
+        last[0] = c->statistical_hit;
+        last[1] = c->statistical_miss;
+        last[2] = c->statistical_evict;
+        if (src->b->n == SERIES_BLOCK) {
+            hand_over(src->s, src->b);
+            src->b = NULL;
+        }
+    }
+    src->interval++;
+    src->start = refs;
+}
+
+void series_sample(series_source_t *src, uint64_t refs,
+                   cache_t *const *levels)
+{
+    emit(src, refs, levels);
+    src->next = refs + src->s->every;
+}
+
+void series_flush(series_source_t *src, uint64_t refs,
+                  cache_t *const *levels)
+{
+    if (refs > src->start)
+        emit(src, refs, levels);
+    if (src->b && src->b->n) {
+        hand_over(src->s, src->b);
+        src->b = NULL;
+    }
+}
+
+void series_restart(series_source_t *src, uint64_t refs,
+                    cache_t *const *levels)
+{
+    if (refs > src->start)
+        emit(src, refs, levels);
+    src->base += refs;
+    src->start = 0;
+    src->next = src->s->every;
+    memset(src->last, 0, sizeof(src->last));
+}
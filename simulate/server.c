@@ -0,0 +1,636 @@
+/*
+ * @file server.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Simulation daemon, see server.h.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "cfg.h"
+#include "server.h"
+#include "trace.h"
+#include "tracegen.h"
+
+#define READ_CHUNK          4096        /* references per trace_read */
+
+struct server_session {
+    pthread_mutex_t lock;               /* one job at a time */
+    cachesim_t *cs;
+    cachesim_cfg_t cfg;
+    cachesim_snapshot_t *saved;
+    int users;                          /* under the server lock */
+    int dead;
+};
+
+struct server_trace {
+    server_trace_t *next;
+    char *path;
+    struct timespec mtime;
+    off_t size;
+    cachesim_ref_t *refs;
+    uint64_t n;
+    int users;
+    uint64_t used;                      /* tick of the last run */
+};
+
+typedef struct client {
+    server_t *s;
+    int fd;
+    int slot;
+} client_t;
+
+/* the whole of n bytes, or FAIL */
+static int read_full(int fd, void *buf, size_t n)
+{
+    char *p = buf;
+    ssize_t got;
+
+    while (n) {
+        if ((got = read(fd, p, n)) < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return FAIL;
+        p += got;
+        n -= got;
+    }
+
+    return SUCCEED;
+}
+
+static int write_full(int fd, const void *buf, size_t n)
+{
+    const char *p = buf;
+    ssize_t put;
+
+    while (n) {
+        /* a client gone is an error, not a SIGPIPE */
+        if ((put = send(fd, p, n, MSG_NOSIGNAL)) < 0 && errno == EINTR)
+            continue;
+        if (put <= 0)
+            return FAIL;
+        p += put;
+        n -= put;
+    }
+
+    return SUCCEED;
+}
+
+int server_send(int fd, uint32_t op, const void *a, uint32_t alen,
+                const void *b, uint32_t blen)
+{
+    server_frame_t f = { op, alen + blen };
+
+    if (alen + blen > SERVER_FRAME || alen + blen < alen)
+        return FAIL;
+    if (SUCCEED != write_full(fd, &f, sizeof(f)) ||
+        (alen && SUCCEED != write_full(fd, a, alen)) ||
+        (blen && SUCCEED != write_full(fd, b, blen)))
+        return FAIL;
+
+    return SUCCEED;
+}
+
+int server_recv(int fd, uint32_t *op, void *buf, uint32_t size,
+                uint32_t *len)
+{
+    server_frame_t f;
+
+    if (SUCCEED != read_full(fd, &f, sizeof(f)) || f.len > size ||
+        SUCCEED != read_full(fd, buf, f.len))
+        return FAIL;
+    *op = f.op;
+    *len = f.len;
+
+    return SUCCEED;
+}
+
+int server_connect(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+    strcpy(addr.sun_path, path);
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int reply_error(int fd, const char *what)
+{
+    return server_send(fd, SERVER_error, what, strlen(what) + 1, NULL, 0);
+}
+
+/* sessions */
+
+static void session_free(server_session_t *ss)
+{
+    cachesim_snapshot_free(ss->saved);
+    cachesim_destroy(ss->cs);
+    pthread_mutex_destroy(&ss->lock);
+    free(ss);
+}
+
+/* return the id, 0 if the table is full */
+static uint32_t session_add(server_t *s, cachesim_t *cs,
+                            const cachesim_cfg_t *cfg)
+{
+    server_session_t *ss = calloc(1, sizeof(server_session_t));
+    uint32_t id = 0;
+
+    if (!ss) {
+        cachesim_destroy(cs);
+        return 0;
+    }
+    pthread_mutex_init(&ss->lock, NULL);
+    ss->cs = cs;
+    ss->cfg = *cfg;
+
+    pthread_mutex_lock(&s->lock);
+    for (uint32_t i = 0; i < SERVER_SESSIONS && !id; ++i)
+        if (!s->sessions[i]) {
+            s->sessions[i] = ss;
+            id = i + 1;
+        }
+    pthread_mutex_unlock(&s->lock);
+    if (!id)
+        session_free(ss);
+
+    return id;
+}
+
+/* the session id, locked for the caller, NULL if none */
+static server_session_t *session_get(server_t *s, uint32_t id)
+{
+    server_session_t *ss = NULL;
+
+    pthread_mutex_lock(&s->lock);
+    if (id && id <= SERVER_SESSIONS && (ss = s->sessions[id - 1]))
+        ss->users++;
+    pthread_mutex_unlock(&s->lock);
+    if (ss)
+        pthread_mutex_lock(&ss->lock);
+
+    return ss;
+}
+
+static void session_put(server_t *s, server_session_t *ss)
+{
+    int last;
+
+    pthread_mutex_unlock(&ss->lock);
+    pthread_mutex_lock(&s->lock);
+    last = !--ss->users && ss->dead;
+    pthread_mutex_unlock(&s->lock);
+    if (last)
+        session_free(ss);
+}
+
+/* ss, got as id, unless another destroy took it (and a create its slot) */
+static int session_remove(server_t *s, uint32_t id, server_session_t *ss)
+{
+    int ret = FAIL;
+
+    pthread_mutex_lock(&s->lock);
+    if (s->sessions[id - 1] == ss) {
+        s->sessions[id - 1] = NULL;
+        ss->dead = 1;
+        ret = SUCCEED;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    return ret;
+}
+
+/* decoded traces */
+
+static void trace_free(server_trace_t *t)
+{
+    free(t->path);
+    free(t->refs);
+    free(t);
+}
+
+/* the whole of a binary trace in memory, NULL if over limit or malformed */
+static server_trace_t *decode(const char *path, uint64_t limit)
+{
+    server_trace_t *t = calloc(1, sizeof(server_trace_t));
+    trace_reader_t *r = trace_open(path);
+    uint64_t cap = 0;
+    int got = 0;
+
+    if (!t || !r || !(t->path = strdup(path)))
+        goto fail;
+    for (;;) {
+        if (t->n + READ_CHUNK > cap) {
+            cachesim_ref_t *refs;
+
+            cap = cap ? cap * 2 : 1 << 16;
+            if (cap * sizeof(cachesim_ref_t) > limit ||
+                !(refs = realloc(t->refs, cap * sizeof(cachesim_ref_t))))
+                goto fail;
+            t->refs = refs;
+        }
+        if ((got = trace_read(r, (trace_ref_t *)t->refs + t->n,
+                              READ_CHUNK)) <= 0)
+            break;
+        t->n += got;
+    }
+    if (got < 0)
+        goto fail;
+    trace_close(r);
+
+    return t;
+fail:
+    if (r)
+        trace_close(r);
+    if (t)
+        trace_free(t);
+    return NULL;
+}
+
+/*
+ * the decoded references of the file at path, kept for the next jobs.
+ * return NULL for a stream or a synthetic trace, a file changed since or
+ * one that does not fit: the job decodes it as it runs.
+ */
+static server_trace_t *trace_get(server_t *s, const char *path)
+{
+    server_trace_t *t, **p, **lru;
+    struct stat st;
+
+    if (!strncmp(path, GEN_PREFIX, strlen(GEN_PREFIX)) ||
+        stat(path, &st) || !S_ISREG(st.st_mode))
+        return NULL;
+
+    pthread_mutex_lock(&s->lock);
+    for (t = s->traces; t; t = t->next)
+        if (!strcmp(t->path, path) && t->size == st.st_size &&
+            t->mtime.tv_sec == st.st_mtim.tv_sec &&
+            t->mtime.tv_nsec == st.st_mtim.tv_nsec)
+            break;
+    if (t) {
+        t->users++;
+        t->used = ++s->tick;
+    }
+    pthread_mutex_unlock(&s->lock);
+    if (t || !(t = decode(path, s->limit)))
+        return t;
+    t->mtime = st.st_mtim;
+    t->size = st.st_size;
+
+    /* room for it, the least recently run unused ones first */
+    pthread_mutex_lock(&s->lock);
+    while (s->bytes + t->n * sizeof(cachesim_ref_t) > s->limit) {
+        for (lru = NULL, p = &s->traces; *p; p = &(*p)->next)
+            if (!(*p)->users && (!lru || (*p)->used < (*lru)->used))
+                lru = p;
+        if (!lru)
+            break;
+        s->bytes -= (*lru)->n * sizeof(cachesim_ref_t);
+        (*lru)->refs = (free((*lru)->refs), NULL);
+        t->next = *lru;
+        *lru = (*lru)->next;
+        trace_free(t->next);
+    }
+    if (s->bytes + t->n * sizeof(cachesim_ref_t) > s->limit) {
+        pthread_mutex_unlock(&s->lock);
+        trace_free(t);
+        return NULL;
+    }
+    s->bytes += t->n * sizeof(cachesim_ref_t);
+    t->users = 1;
+    t->used = ++s->tick;
+    t->next = s->traces;
+    s->traces = t;
+    pthread_mutex_unlock(&s->lock);
+
+    return t;
+}
+
+static void trace_put(server_t *s, server_trace_t *t)
+{
+    pthread_mutex_lock(&s->lock);
+    t->users--;
+    pthread_mutex_unlock(&s->lock);
+}
+
+/* as cachesim_run(), from memory if the trace is kept */
+static int run_job(server_t *s, server_session_t *ss, const char *path)
+{
+    server_trace_t *t = trace_get(s, path);
+    uint64_t i = 0, warm = 0;
+
+    if (!t)
+        return cachesim_run(ss->cs, path);
+
+    /* the warm-up of run(), one core only */
+    if (ss->cfg.warmup && ss->cfg.cores <= 1) {
+        for (; i < t->n && warm < ss->cfg.warmup; ++i)
+            warm += cachesim_access_batch(ss->cs, &t->refs[i], 1);
+        cachesim_reset_stats(ss->cs);
+    }
+    cachesim_access_batch(ss->cs, t->refs + i, t->n - i);
+    trace_put(s, t);
+
+    return SUCCEED;
+}
+
+static int reply_stats(int fd, const cachesim_t *cs)
+{
+    cachesim_stats_t st;
+
+    cachesim_stats(cs, &st);
+    return server_send(fd, SERVER_stats_reply, &st, sizeof(st), NULL, 0);
+}
+
+/* a path ending the payload */
+static const char *path_of(const uint8_t *p, uint32_t len)
+{
+    return len && !p[len - 1] ? (const char *)p : NULL;
+}
+
+/* one request. return FAIL to close the connection */
+static int serve(server_t *s, int fd, uint32_t op, uint8_t *p, uint32_t len)
+{
+    server_session_t *ss = NULL;
+    cachesim_cfg_t cfg;
+    const char *path;
+    cachesim_t *cs;
+    uint32_t id = 0;
+    uint64_t k;
+    int ret;
+
+    switch (op) {
+    case SERVER_create:
+    case SERVER_load:
+        if (op == SERVER_create && len == sizeof(cfg)) {
+            memcpy(&cfg, p, sizeof(cfg));
+        } else if (op != SERVER_load || len <= sizeof(k) ||
+                   !(path = path_of(p + sizeof(k), len - sizeof(k)))) {
+            return reply_error(fd, "bad request");
+        } else {
+            memcpy(&k, p, sizeof(k));
+            if (SUCCEED != cachesim_cfg_load(path, k, &cfg))
+                return reply_error(fd, "bad configuration");
+        }
+        if (!(cs = cachesim_create(&cfg)))
+            return reply_error(fd, "bad configuration");
+        if (!(id = session_add(s, cs, &cfg)))
+            return reply_error(fd, "no session left");
+        return server_send(fd, SERVER_ok, &id, sizeof(id), NULL, 0);
+    case SERVER_shutdown:
+        pthread_mutex_lock(&s->lock);
+        s->stop = 1;
+        pthread_cond_broadcast(&s->changed);
+        pthread_mutex_unlock(&s->lock);
+        return server_send(fd, SERVER_ok, NULL, 0, NULL, 0);
+    default:
+        break;
+    }
+
+    if (len < sizeof(id))
+        return reply_error(fd, "bad request");
+    memcpy(&id, p, sizeof(id));
+    if (!(ss = session_get(s, id))) {
+        reply_error(fd, "no such session");
+        return op == SERVER_refs ? FAIL : SUCCEED;
+    }
+
+    switch (op) {
+    case SERVER_refs:
+        if ((len - sizeof(id)) % sizeof(cachesim_ref_t)) {
+            reply_error(fd, "bad request");
+            ret = FAIL;
+            break;
+        }
+        /* the payload follows the id, copied aligned by the caller */
+        cachesim_access_batch(ss->cs, (cachesim_ref_t *)(p + sizeof(id)),
+                              (len - sizeof(id)) / sizeof(cachesim_ref_t));
+        ret = SUCCEED;
+        break;
+    case SERVER_run:
+        if (!(path = path_of(p + sizeof(id), len - sizeof(id))))
+            ret = reply_error(fd, "bad request");
+        else if (SUCCEED != run_job(s, ss, path))
+            ret = reply_error(fd, "bad trace");
+        else
+            ret = reply_stats(fd, ss->cs);
+        break;
+    case SERVER_stats:
+        ret = reply_stats(fd, ss->cs);
+        break;
+    case SERVER_reset:
+        cachesim_reset_stats(ss->cs);
+        ret = server_send(fd, SERVER_ok, NULL, 0, NULL, 0);
+        break;
+    case SERVER_save:
+        cachesim_snapshot_free(ss->saved);
+        if (!(ss->saved = cachesim_snapshot(ss->cs)))
+            ret = reply_error(fd, "no snapshot");
+        else
+            ret = server_send(fd, SERVER_ok, NULL, 0, NULL, 0);
+        break;
+    case SERVER_restore:
+        if (!ss->saved || SUCCEED != cachesim_restore(ss->cs, ss->saved))
+            ret = reply_error(fd, "nothing saved");
+        else
+            ret = server_send(fd, SERVER_ok, NULL, 0, NULL, 0);
+        break;
+    case SERVER_destroy:
+        if (SUCCEED != session_remove(s, id, ss))
+            ret = reply_error(fd, "no such session");
+        else
+            ret = server_send(fd, SERVER_ok, NULL, 0, NULL, 0);
+        break;
+    default:
+        ret = reply_error(fd, "bad request");
+        break;
+    }
+    session_put(s, ss);
+
+    return ret;
+}
+
+static void *client(void *arg)
+{
+    client_t *c = arg;
+    server_t *s = c->s;
+    server_frame_t f;
+    uint8_t *buf = NULL;
+    uint32_t cap = 0;
+
+    while (SUCCEED == read_full(c->fd, &f, sizeof(f))) {
+        uint8_t *p;
+
+        if (f.len > SERVER_FRAME)
+            break;
+        /* 8 bytes ahead of the payload, so refs after an id are aligned */
+        if (f.len + 8 > cap) {
+            if (!(p = realloc(buf, f.len + 8)))
+                break;
+            buf = p;
+            cap = f.len + 8;
+        }
+        p = f.op == SERVER_refs ? buf + 4 : buf + 8;
+        if (SUCCEED != read_full(c->fd, p, f.len) ||
+            SUCCEED != serve(s, c->fd, f.op, p, f.len))
+            break;
+    }
+    free(buf);
+    close(c->fd);
+
+    pthread_mutex_lock(&s->lock);
+    s->clients[c->slot] = -1;
+    s->nclients--;
+    pthread_cond_broadcast(&s->changed);
+    pthread_mutex_unlock(&s->lock);
+    free(c);
+
+    return NULL;
+}
+
+static void *acceptor(void *arg)
+{
+    server_t *s = arg;
+    pthread_attr_t attr;
+    pthread_t tid;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (;;) {
+        int fd = accept(s->fd, NULL, NULL), slot = -1;
+        client_t *c;
+
+        if (fd < 0 && errno == EINTR)
+            continue;
+        /* server_stop() shuts the socket down */
+        if (fd < 0)
+            break;
+
+        pthread_mutex_lock(&s->lock);
+        for (int i = 0; i < SERVER_CLIENTS && !s->stop && slot < 0; ++i)
+            if (s->clients[i] < 0)
+                slot = i;
+        if (slot >= 0 && (c = malloc(sizeof(client_t)))) {
+            c->s = s;
+            c->fd = fd;
+            c->slot = slot;
+            if (!pthread_create(&tid, &attr, client, c)) {
+                s->clients[slot] = fd;
+                s->nclients++;
+                fd = -1;
+            } else {
+                free(c);
+            }
+        }
+        pthread_mutex_unlock(&s->lock);
+        if (fd >= 0)
+            close(fd);
+    }
+    pthread_attr_destroy(&attr);
+
+    return NULL;
+}
+
+server_t *server_start(const char *path, uint64_t limit)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    server_t *s;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        LOG_ERR("socket path too long [%s]", path);
+        return NULL;
+    }
+    if (!(s = calloc(1, sizeof(server_t))))
+        return NULL;
+    if (!(s->path = strdup(path))) {
+        free(s);
+        return NULL;
+    }
+
+    strcpy(addr.sun_path, path);
+    s->limit = limit ? limit : SERVER_TRACES;
+    for (int i = 0; i < SERVER_CLIENTS; ++i)
+        s->clients[i] = -1;
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->changed, NULL);
+    unlink(path);
+    if ((s->fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+        bind(s->fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        listen(s->fd, SERVER_CLIENTS) ||
+        pthread_create(&s->tid, NULL, acceptor, s)) {
+        LOG_ERR("cannot listen on [%s]", path);
+        if (s->fd >= 0)
+            close(s->fd);
+        pthread_mutex_destroy(&s->lock);
+        pthread_cond_destroy(&s->changed);
+        free(s->path);
+        free(s);
+        return NULL;
+    }
+
+    return s;
+}
+
+void server_wait(server_t *s)
+{
+    pthread_mutex_lock(&s->lock);
+    while (!s->stop)
+        pthread_cond_wait(&s->changed, &s->lock);
+    pthread_mutex_unlock(&s->lock);
+}
+
+void server_stop(server_t *s)
+{
+    if (!s)
+        return;
+
+    pthread_mutex_lock(&s->lock);
+    s->stop = 1;
+    pthread_mutex_unlock(&s->lock);
+    shutdown(s->fd, SHUT_RDWR);
+    pthread_join(s->tid, NULL);
+    close(s->fd);
+    unlink(s->path);
+
+    /* the clients end their jobs, then see the end of their connection */
+    pthread_mutex_lock(&s->lock);
+    for (int i = 0; i < SERVER_CLIENTS; ++i)
+        if (s->clients[i] >= 0)
+            shutdown(s->clients[i], SHUT_RDWR);
+    while (s->nclients)
+        pthread_cond_wait(&s->changed, &s->lock);
+    pthread_mutex_unlock(&s->lock);
+
+    for (int i = 0; i < SERVER_SESSIONS; ++i)
+        if (s->sessions[i])
+            session_free(s->sessions[i]);
+    while (s->traces) {
+        server_trace_t *t = s->traces;
+
+        s->traces = t->next;
+        trace_free(t);
+    }
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->changed);
+    free(s->path);
+    free(s);
+}
@@ -1,5 +1,5 @@
 /*
- * @file config.h
+ * @file simulat.c
  * @author charlies
  * @mail: xuguo.wong@gmail.com
  * @date 2018/08/13
@@ -7,17 +7,503 @@
  * authority: GPL v2.0
  *
  * The real simulat action function.
+ *
+ * The ways of a set are contiguous in tags and repl. For the recency
+ * and insertion order policies repl holds a permutation of 0..ways-1
+ * per set, 0 the most recent: promoting a way increments every rank
+ * below its own. An empty way always wins the eviction.
  */
 
-int valid_cache_size(int size)
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "simulat.h"
+
+static inline unsigned int set_base(const cache_t *c, uint64_t line)
+{
+    return (unsigned int)fastmod_reduce(&c->set_index, line) * c->ways;
+}
+
+static inline void promote(uint32_t *repl, unsigned int ways, unsigned int w)
+{
+    uint32_t r = repl[w];
+
+    for (unsigned int v = 0; v < ways; ++v)
+        repl[v] += repl[v] < r;
+    repl[w] = 0;
+}
+
+static inline int lookup(const cache_t *c, unsigned int base, uint64_t line)
+{
+    for (unsigned int w = 0; w < c->ways; ++w)
+        if (c->tags[base + w] == line + 1)
+            return w;
+
+    return -1;
+}
+
+static inline void touch(cache_t *c, unsigned int base, unsigned int w)
+{
+    switch (c->cp_cache) {
+    case CP_lru:
+    case CP_tlru:
+    case CP_mru:
+        promote(c->repl + base, c->ways, w);
+        break;
+    default:
+        break;
+    }
+}
+
+static unsigned int victim(cache_t *c, unsigned int base, uint64_t *rng)
+{
+    const uint32_t *repl = c->repl + base;
+    uint32_t want = 0;
+
+    for (unsigned int w = 0; w < c->ways; ++w)
+        if (!c->tags[base + w])
+            return w;
+
+    switch (c->cp_cache) {
+    case CP_random:
+        *rng ^= *rng << 13;
+        *rng ^= *rng >> 7;
+        *rng ^= *rng << 17;
+        return *rng % c->ways;
+    case CP_mru:
+    case CP_lifo:
+        want = 0;
+        break;
+    default:
+        want = c->ways - 1;
+        break;
+    }
+    for (unsigned int w = 0; w < c->ways; ++w)
+        if (repl[w] == want)
+            return w;
+
+    return 0;
+}
+
+/* put line in c, return the line evicted or SIM_NONE */
+static inline uint64_t insert(cache_t *c, uint64_t line, uint64_t *rng,
+                              uint64_t *slot)
+{
+    unsigned int base = set_base(c, line), w = victim(c, base, rng);
+    uint64_t old = c->tags[base + w];
+
+    c->tags[base + w] = line + 1;
+    if (c->cp_cache != CP_random)
+        promote(c->repl + base, c->ways, w);
+    *slot = base + w;
+
+    return old ? old - 1 : SIM_NONE;
+}
+
+static inline void invalidate(cache_t *c, uint64_t line)
+{
+    unsigned int base = set_base(c, line);
+    int w = lookup(c, base, line);
+
+    if (w >= 0)
+        c->tags[base + w] = 0;
+}
+
+int64_t sim_line_lookup(cache_t *c, uint64_t line, int touch_it)
 {
-    if (!log2(size))
+    unsigned int base = set_base(c, line);
+    int w = lookup(c, base, line);
+
+    if (w < 0)
         return -1;
+    if (touch_it)
+        touch(c, base, w);
+
+    return base + w;
+}
+
+uint64_t sim_line_insert(cache_t *c, uint64_t line, uint64_t *rng,
+                         uint64_t *slot)
+{
+    return insert(c, line, rng, slot);
+}
+
+int64_t sim_line_invalidate(cache_t *c, uint64_t line)
+{
+    unsigned int base = set_base(c, line);
+    int w = lookup(c, base, line);
+
+    if (w < 0)
+        return -1;
+    c->tags[base + w] = 0;
+
+    return base + w;
+}
+
+/* invalidate line in level l, return if the copy was dirty */
+static int drop(sim_t *sim, int l, uint64_t line)
+{
+    cache_t *c = sim->levels[l];
+    unsigned int base = set_base(c, line);
+    int w = lookup(c, base, line);
+
+    if (w < 0)
+        return 0;
+    c->tags[base + w] = 0;
+
+    return sim->shard ? sim->dirty[l][base + w] : 0;
+}
+
+/* a dirty line leaving a level goes to the first one from l holding it */
+static void write_back(sim_t *sim, int l, uint64_t line)
+{
+    for (; l < sim->nlevels; ++l) {
+        cache_t *c = sim->levels[l];
+        unsigned int base = set_base(c, line);
+        int w = lookup(c, base, line);
+
+        if (w >= 0) {
+            sim->dirty[l][base + w] = 1;
+            return;
+        }
+    }
+    sim->writebacks++;
+}
+
+/* put line in level l, return its slot */
+static uint64_t fill(sim_t *sim, int l, uint64_t line)
+{
+    cache_t *c = sim->levels[l];
+    uint64_t slot, old = insert(c, line, &c->rng, &slot);
+    int dirty = 0;
+
+    /* the slot still has the dirty bit of the victim */
+    if (sim->shard) {
+        dirty = sim->dirty[l][slot];
+        sim->dirty[l][slot] = 0;
+    }
+    if (old == SIM_NONE)
+        return slot;
+
+    c->statistical_evict++;
+    if (l && c->hp_cache == H_inclusive)
+        for (int j = 0; j < l; ++j)
+            dirty |= drop(sim, j, old);
+    if (l + 1 < sim->nlevels && sim->levels[l + 1]->hp_cache == H_exclusive) {
+        uint64_t below = fill(sim, l + 1, old);
+
+        if (dirty)
+            sim->dirty[l + 1][below] = 1;
+    } else if (dirty) {
+        write_back(sim, l + 1, old);
+    }
+    if (sim->shard)
+        stats_evict(sim->shard, l, fastmod_reduce(&c->set_index, line),
+                    dirty);
 
+    return slot;
+}
+
+int sim_access(sim_t *sim, uint64_t line, int op)
+{
+    stats_shard_t *sh = sim->shard;
+    int l, n = sim->nlevels, dirty = op == TRACE_write;
+    uint64_t slot = 0;
+
+    if (sh)
+        stats_line(sim->stats, sh, line << sim->lineshift);
+    for (l = 0; l < n; ++l) {
+        cache_t *c = sim->levels[l];
+        unsigned int set = fastmod_reduce(&c->set_index, line);
+        unsigned int base = set * c->ways;
+        int w;
+
+        if (sh)
+            __builtin_prefetch(stats_set(sh, l, set), 1);
+        w = lookup(c, base, line);
+
+        if (w >= 0) {
+            touch(c, base, w);
+            c->statistical_hit++;
+            if (sh)
+                stats_set(sh, l, set)->hits++;
+            slot = base + w;
+            break;
+        }
+        c->statistical_miss++;
+        if (sh)
+            stats_set(sh, l, set)->misses++;
+    }
+
+    if (sh)
+        stats_served(sh, l < n);
+    if (l == n)
+        sim->memory++;
+    else if (l && sim->levels[l]->hp_cache == H_exclusive)
+        dirty |= drop(sim, l, line);
+
+    /* bottom up, so a back invalidation never hits the new line */
+    for (int j = l - 1; j >= 0; --j)
+        if (!j || sim->levels[j]->hp_cache != H_exclusive)
+            slot = fill(sim, j, line);
+    /* a write dirties the copy in the first level */
+    if (sh && dirty)
+        sim->dirty[0][slot] = 1;
+
+    return l;
+}
+
+void sim_ref(sim_t *sim, const trace_ref_t *ref)
+{
+    uint64_t line = ref->addr >> sim->lineshift;
+    uint64_t last = (ref->addr + (ref->size ? ref->size - 1 : 0)) >>
+                    sim->lineshift;
+
+    if ((ref->op == TRACE_ifetch) != (sim->levels[0]->t_cache == ICache)) {
+        sim->skipped++;
+        return;
+    }
+
+    sim->refs++;
+    if (sim->shard)
+        stats_ref(sim->stats, sim->shard, ref->pc);
+    for (; line <= last; ++line)
+        sim_access(sim, line, ref->op);
+    if (sim->series && series_due(sim->series, sim->refs))
+        series_sample(sim->series, sim->refs, sim->levels);
+}
+
+sim_t *sim_create(struct list_head *caches)
+{
+    sim_t *sim = calloc(1, sizeof(sim_t));
+    cache_t *cache;
+    int n = 0;
+
+    if (!sim)
+        return NULL;
+
+    list_for_each_entry(cache, caches, list)
+        n++;
+    sim->levels = malloc(sizeof(cache_t *) * (n ? n : 1));
+    if (!n || !sim->levels)
+        goto fail;
+
+    list_for_each_entry(cache, caches, list) {
+        if (!cache->tags || !cache->repl || !cache->sets || !cache->ways) {
+            LOG_ERR("level %d has no storage", sim->nlevels + 1);
+            goto fail;
+        }
+        if (cache->linesize != list_first_entry(caches, cache_t,
+                                                list)->linesize ||
+            (cache->linesize & (cache->linesize - 1))) {
+            LOG_ERR("levels need one power of two linesize");
+            goto fail;
+        }
+        if (cache->cp_cache < CP_random || cache->cp_cache > CP_mru) {
+            LOG_ERR("level %d has no replacement policy", sim->nlevels + 1);
+            goto fail;
+        }
+        /* start cold, ranks in way order */
+        memset(cache->tags, 0, sizeof(uint64_t) * cache->sets * cache->ways);
+        for (uint64_t i = 0; i < (uint64_t)cache->sets * cache->ways; ++i)
+            cache->repl[i] = i % cache->ways;
+        cache->rng = 0x9e3779b97f4a7c15ULL + sim->nlevels;
+        sim->levels[sim->nlevels++] = cache;
+    }
+    sim->lineshift = __builtin_ctz(sim->levels[0]->linesize);
+
+    return sim;
+fail:
+    sim_destroy(sim);
+    return NULL;
+}
+
+void sim_destroy(sim_t *sim)
+{
+    if (!sim)
+        return;
+
+    if (sim->dirty)
+        for (int l = 0; l < sim->nlevels; ++l)
+            free(sim->dirty[l]);
+    free(sim->dirty);
+    series_source_destroy(sim->series);
+    free(sim->levels);
+    free(sim);
+}
+
+int sim_stats(sim_t *sim, stats_t *s, int shard)
+{
+    if (s->nlevels != sim->nlevels || shard < 0 || shard >= s->nshards) {
+        LOG_ERR("statistics of another hierarchy");
+        return FAIL;
+    }
+    for (int l = 0; l < sim->nlevels; ++l) {
+        if (s->sets[l] != sim->levels[l]->sets) {
+            LOG_ERR("statistics of another hierarchy");
+            return FAIL;
+        }
+    }
+    if (!(sim->dirty = calloc((unsigned int)sim->nlevels,
+                              sizeof(uint8_t *))))
+        return FAIL;
+    for (int l = 0; l < sim->nlevels; ++l)
+        if (!(sim->dirty[l] = calloc((uint64_t)sim->levels[l]->sets *
+                                     sim->levels[l]->ways, 1)))
+            return FAIL;
+    sim->stats = s;
+    sim->shard = &s->shards[shard];
+
+    return SUCCEED;
+}
+
+int sim_series(sim_t *sim, series_t *s, uint32_t config)
+{
+    int n = sim->nlevels < SERIES_LEVELS ? sim->nlevels : SERIES_LEVELS;
+
+    if (!(sim->series = series_source(s, config, 0, n)))
+        return FAIL;
+    /* the counters so far are not an interval */
+    sim->series->start = sim->refs;
+    sim->series->next = sim->refs + s->every;
+    for (int l = 0; l < n; ++l) {
+        sim->series->last[l][0] = sim->levels[l]->statistical_hit;
+        sim->series->last[l][1] = sim->levels[l]->statistical_miss;
+        sim->series->last[l][2] = sim->levels[l]->statistical_evict;
+    }
 
+    return SUCCEED;
 }
 
-int log2(int num)
+/* the caches are warm, count from here */
+static void end_warmup(sim_t *sim)
 {
-    return !(num & (num - 1));
+    if (sim->prof) {
+        sim->prof->refs[PERF_warmup] = sim->refs;
+        perf_phase(sim->prof, PERF_simulate);
+    }
+    if (sim->series)
+        series_restart(sim->series, sim->refs, sim->levels);
+    for (int l = 0; l < sim->nlevels; ++l) {
+        sim->levels[l]->statistical_hit = 0;
+        sim->levels[l]->statistical_miss = 0;
+        sim->levels[l]->statistical_evict = 0;
+    }
+    sim->refs = 0;
+    sim->memory = 0;
+    sim->writebacks = 0;
+    if (sim->stats)
+        stats_reset(sim->stats);
+}
+
+/* the counters after a batch, for the telemetry thread */
+static void publish(sim_t *sim, uint64_t done, uint64_t bytes)
+{
+    progress_t *p = sim->progress;
+
+    progress_refs(p, 0, done);
+    for (int l = 0; l < sim->nlevels && l < PROGRESS_LEVELS; ++l)
+        progress_level(p, 0, l, sim->levels[l]->statistical_hit,
+                       sim->levels[l]->statistical_miss);
+    progress_bytes(p, bytes);
+}
+
+void sim_begin(sim_t *sim)
+{
+    sim->warming = sim->warmup > 0;
+}
+
+void sim_refs(sim_t *sim, const trace_ref_t *refs, uint32_t n)
+{
+    uint32_t i = 0;
+
+    for (; sim->warming && i < n; ++i) {
+        sim_ref(sim, &refs[i]);
+        if (sim->refs >= sim->warmup) {
+            end_warmup(sim);
+            sim->warming = 0;
+        }
+    }
+    for (; i < n; ++i)
+        sim_ref(sim, &refs[i]);
+}
+
+void sim_end(sim_t *sim, const char *trace)
+{
+    /* a trace shorter than the warm-up counts nothing */
+    if (sim->warming) {
+        end_warmup(sim);
+        sim->warming = 0;
+    }
+    if (!sim->refs && sim->skipped)
+        LOG_ERR("no reference of [%s] for the %s, %llu skipped, see type",
+                trace, sim->levels[0]->t_cache == ICache ? "ICache" :
+                "DCache", (unsigned long long)sim->skipped);
+    if (sim->series)
+        series_flush(sim->series, sim->refs, sim->levels);
+}
+
+int run(sim_t *sim, const char *trace)
+{
+    trace_reader_t *r = trace_open(trace);
+    const trace_batch_t *b;
+    trace_stream_t *s;
+    uint64_t done = 0;
+    uint32_t n;
+    int ret;
+
+    if (!r)
+        return FAIL;
+    sim_begin(sim);
+    if (sim->progress)
+        progress_size(sim->progress, trace_size(r));
+    if (sim->prof) {
+        perf_phase(sim->prof, sim->warming ? PERF_warmup : PERF_simulate);
+        perf_threads_start(sim->prof);
+    }
+    if (!(s = trace_stream_start(r))) {
+        trace_close(r);
+        if (sim->prof)
+            perf_threads_stop(sim->prof, PERF_decode);
+        return FAIL;
+    }
+
+    while ((b = trace_stream_next(s, &n))) {
+        sim_refs(sim, b->refs, n);
+        done += n;
+        if (sim->progress)
+            publish(sim, done, b->bytes);
+        trace_stream_release(s);
+    }
+
+    ret = trace_stream_stop(s);
+    sim_end(sim, trace);
+    if (sim->prof) {
+        perf_threads_stop(sim->prof, PERF_decode);
+        sim->prof->refs[PERF_simulate] = sim->refs;
+        sim->prof->refs[PERF_decode] = sim->refs +
+                                       sim->prof->refs[PERF_warmup];
+    }
+
+    return ret;
+}
+
+void sim_report(const sim_t *sim, FILE *out)
+{
+    fprintf(out, "references: %llu\n", (unsigned long long)sim->refs);
+    for (int l = 0; l < sim->nlevels; ++l) {
+        const cache_t *c = sim->levels[l];
+        unsigned long long n = c->statistical_hit + c->statistical_miss;
+
+        fprintf(out, "L%d: %llu hits, %llu misses, miss ratio %.4f\n",
+                l + 1, c->statistical_hit, c->statistical_miss,
+                n ? (double)c->statistical_miss / n : 0.0);
+    }
+    if (sim->shard)
+        fprintf(out, "memory: %llu lines, %llu writebacks\n",
+                (unsigned long long)sim->memory,
+                (unsigned long long)sim->writebacks);
+    else
+        fprintf(out, "memory: %llu lines\n", (unsigned long long)sim->memory);
 }
@@ -0,0 +1,274 @@
+/*
+ * @file stats.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Detailed counters of a simulation, see stats.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "stats.h"
+
+#define STATS_TOP           5           /* busiest sets in the summary */
+
+/* splitmix64 finalizer */
+static inline uint64_t hash_key(uint64_t key)
+{
+    key += 0x9e3779b97f4a7c15ULL;
+    key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+
+    return key ^ (key >> 31);
+}
+
+/*
+ * the entry of key, a new one if absent, other if none of the probes
+ * slots from i is left
+ */
+static stats_count_t *find(stats_entry_t *table, stats_count_t *other,
+                           uint64_t key, uint64_t i, int probes)
+{
+    for (int p = 0; p < probes; ++p, ++i) {
+        stats_entry_t *e = &table[i & (STATS_TABLE - 1)];
+
+        if (e->key == key + 1)
+            return &e->n;
+        if (!e->key) {
+            e->key = key + 1;
+            return &e->n;
+        }
+    }
+
+    return other;
+}
+
+stats_t *stats_create(int nlevels, const unsigned int *sets, int nshards,
+                      unsigned int region)
+{
+    stats_t *s;
+
+    if (nlevels < 1 || nlevels > STATS_MAX_LEVELS || nshards < 1 ||
+        !region || (region & (region - 1))) {
+        LOG_ERR("bad statistics configuration");
+        return NULL;
+    }
+    if (!(s = calloc(1, sizeof(stats_t))))
+        return NULL;
+
+    s->nlevels = nlevels;
+    s->nshards = nshards;
+    s->region_shift = __builtin_ctz(region);
+    memcpy(s->sets, sets, sizeof(unsigned int) * nlevels);
+    if (!(s->arena = arena_create(ARENA_THP)) ||
+        !(s->shards = arena_alloc(s->arena, sizeof(stats_shard_t) *
+                                  nshards)))
+        goto fail;
+
+    for (int k = 0; k < nshards; ++k) {
+        stats_shard_t *sh = &s->shards[k];
+
+        for (int l = 0; l < nlevels; ++l)
+            if (!(sh->sets[l] = arena_alloc(s->arena, sizeof(stats_count_t) *
+                                            sets[l])))
+                goto fail;
+        sh->pcs = arena_alloc(s->arena, sizeof(stats_entry_t) * STATS_TABLE);
+        sh->regions = arena_alloc(s->arena,
+                                  sizeof(stats_entry_t) * STATS_TABLE);
+        if (!sh->pcs || !sh->regions)
+            goto fail;
+        stats_ref(s, sh, 0);
+    }
+
+    return s;
+fail:
+    stats_destroy(s);
+    return NULL;
+}
+
+void stats_destroy(stats_t *s)
+{
+    if (!s)
+        return;
+
+    arena_destroy(s->arena);
+    free(s);
+}
+
+void stats_ref(stats_t *s, stats_shard_t *sh, uint64_t pc)
+{
+    if (pc != sh->pc || !sh->pc_cur) {
+        sh->pc = pc;
+        sh->pc_cur = find(sh->pcs, &sh->pc_other, pc, hash_key(pc),
+                          STATS_PROBES);
+    }
+}
+
+stats_count_t *stats_find_region(stats_shard_t *sh)
+{
+    return find(sh->regions, &sh->region_other, sh->region, sh->region, 1);
+}
+
+void stats_reset(stats_t *s)
+{
+    for (int k = 0; k < s->nshards; ++k) {
+        stats_shard_t *sh = &s->shards[k];
+
+        for (int l = 0; l < s->nlevels; ++l)
+            memset(sh->sets[l], 0, sizeof(stats_count_t) * s->sets[l]);
+        memset(sh->pcs, 0, sizeof(stats_entry_t) * STATS_TABLE);
+        memset(sh->regions, 0, sizeof(stats_entry_t) * STATS_TABLE);
+        memset(&sh->pc_other, 0, sizeof(stats_count_t));
+        memset(&sh->region_other, 0, sizeof(stats_count_t));
+        sh->pc_cur = NULL;
+        sh->region_cur = NULL;
+        stats_ref(s, sh, sh->pc);
+    }
+}
+
+static void add(stats_count_t *to, const stats_count_t *n)
+{
+    to->hits += n->hits;
+    to->misses += n->misses;
+    to->evictions += n->evictions;
+    to->writebacks += n->writebacks;
+}
+
+static void merge_pcs(stats_shard_t *to, const stats_shard_t *from)
+{
+    for (int i = 0; i < STATS_TABLE; ++i) {
+        uint64_t pc = from->pcs[i].key - 1;
+
+        if (from->pcs[i].key)
+            add(find(to->pcs, &to->pc_other, pc, hash_key(pc), STATS_PROBES),
+                &from->pcs[i].n);
+    }
+}
+
+static void merge_regions(stats_shard_t *to, const stats_shard_t *from)
+{
+    for (int i = 0; i < STATS_TABLE; ++i) {
+        uint64_t region = from->regions[i].key - 1;
+
+        if (from->regions[i].key)
+            add(find(to->regions, &to->region_other, region, region, 1),
+                &from->regions[i].n);
+    }
+}
+
+void stats_merge(stats_t *s)
+{
+    stats_shard_t *to = &s->shards[0];
+
+    for (int k = 1; k < s->nshards; ++k) {
+        stats_shard_t *sh = &s->shards[k];
+
+        for (int l = 0; l < s->nlevels; ++l)
+            for (unsigned int set = 0; set < s->sets[l]; ++set)
+                add(&to->sets[l][set], &sh->sets[l][set]);
+        merge_pcs(to, sh);
+        merge_regions(to, sh);
+        add(&to->pc_other, &sh->pc_other);
+        add(&to->region_other, &sh->region_other);
+    }
+}
+
+static int busy(const stats_count_t *n)
+{
+    return n->hits || n->misses || n->evictions || n->writebacks;
+}
+
+static void print_count(FILE *f, const stats_count_t *n)
+{
+    fprintf(f, " %llu %llu %llu %llu\n", (unsigned long long)n->hits,
+            (unsigned long long)n->misses, (unsigned long long)n->evictions,
+            (unsigned long long)n->writebacks);
+}
+
+static void print_table(FILE *f, const char *kind, const stats_entry_t *t,
+                        const stats_count_t *other, unsigned int shift)
+{
+    for (int i = 0; i < STATS_TABLE; ++i) {
+        if (!t[i].key)
+            continue;
+        fprintf(f, "%s 0x%llx", kind,
+                (unsigned long long)(t[i].key - 1) << shift);
+        print_count(f, &t[i].n);
+    }
+    if (busy(other)) {
+        fprintf(f, "%s other", kind);
+        print_count(f, other);
+    }
+}
+
+/* the STATS_TOP sets of a level with the most misses */
+static void top_sets(const stats_t *s, int l, const char *name, FILE *out)
+{
+    const stats_count_t *sets = s->shards[0].sets[l];
+    unsigned int top[STATS_TOP];
+    uint64_t misses = 0;
+    int n = 0;
+
+    for (unsigned int set = 0; set < s->sets[l]; ++set) {
+        int i;
+
+        misses += sets[set].misses;
+        if (!sets[set].misses)
+            continue;
+        if (n < STATS_TOP)
+            n++;
+        else if (sets[top[n - 1]].misses >= sets[set].misses)
+            continue;
+        for (i = n - 1; i > 0 && sets[top[i - 1]].misses < sets[set].misses;
+             --i)
+            top[i] = top[i - 1];
+        top[i] = set;
+    }
+
+    fprintf(out, "%s: busiest sets by misses (mean %.1f):", name,
+            (double)misses / s->sets[l]);
+    for (int i = 0; i < n; ++i)
+        fprintf(out, " %u:%llu", top[i],
+                (unsigned long long)sets[top[i]].misses);
+    fputc('\n', out);
+}
+
+int stats_export(const stats_t *s, const char **names, const char *path,
+                 FILE *out)
+{
+    const stats_shard_t *sh = &s->shards[0];
+    FILE *f = fopen(path, "w");
+
+    if (!f) {
+        LOG_ERR("cannot write statistics [%s]", path);
+        return FAIL;
+    }
+
+    fprintf(f, "# kind key hits misses evictions writebacks\n");
+    for (int l = 0; l < s->nlevels; ++l) {
+        for (unsigned int set = 0; set < s->sets[l]; ++set) {
+            if (!busy(&sh->sets[l][set]))
+                continue;
+            fprintf(f, "set %s:%u", names[l], set);
+            print_count(f, &sh->sets[l][set]);
+        }
+    }
+    print_table(f, "pc", sh->pcs, &sh->pc_other, 0);
+    print_table(f, "region", sh->regions, &sh->region_other,
+                s->region_shift);
+
+    if (fclose(f)) {
+        LOG_ERR("cannot write statistics [%s]", path);
+        return FAIL;
+    }
+    for (int l = 0; l < s->nlevels; ++l)
+        top_sets(s, l, names[l], out);
+    fprintf(out, "statistics: %s\n", path);
+
+    return SUCCEED;
+}
@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "arena.h"
+
+static void test_alloc(int flags)
+{
+    arena_t *a = arena_create(flags);
+    char *p[64];
+
+    assert(a);
+    /* aligned, zeroed and apart */
+    for (int i = 0; i < 64; ++i) {
+        assert((p[i] = arena_alloc(a, 1 + i * 37)));
+        assert(!((uintptr_t)p[i] & 63));
+        for (int k = 0; k < 1 + i * 37; ++k)
+            assert(!p[i][k]);
+        memset(p[i], 0xa5, 1 + i * 37);
+    }
+    for (int i = 1; i < 64; ++i)
+        assert(p[i] >= p[i - 1] + 1 + (i - 1) * 37);
+    assert(arena_mapped(a) == ARENA_REGION);
+
+    /* past the first region, then one bigger than any region */
+    assert((p[0] = arena_alloc(a, ARENA_REGION)));
+    assert((p[1] = arena_alloc(a, 5 * ARENA_REGION)));
+    memset(p[0], 0xa5, ARENA_REGION);
+    memset(p[1], 0xa5, 5 * ARENA_REGION);
+    assert(arena_mapped(a) >= 7 * ARENA_REGION);
+    assert(!(arena_mapped(a) % ARENA_ALIGN));
+
+    /* the regions stay, the memory comes back zeroed */
+    arena_reset(a);
+    for (int round = 0; round < 2; ++round) {
+        size_t mapped = arena_mapped(a);
+        char *q = arena_alloc(a, 5 * ARENA_REGION);
+
+        assert(q);
+        for (size_t k = 0; k < 5 * ARENA_REGION; k += 4093)
+            assert(!q[k]);
+        memset(q, 0x5a, 5 * ARENA_REGION);
+        assert(arena_mapped(a) == mapped);
+        arena_reset(a);
+    }
+    printf("arena %d: %zu bytes mapped, %zu on huge pages, %zu reserved\n",
+           flags, arena_mapped(a), arena_huge(a), arena_hugetlb(a));
+    assert(arena_hugetlb(a) <= arena_huge(a));
+    assert(arena_huge(a) <= arena_mapped(a));
+    arena_destroy(a);
+    arena_destroy(NULL);
+}
+
+int main(void)
+{
+    test_alloc(0);
+    test_alloc(ARENA_THP);
+    /* falls back to small pages if none are reserved */
+    test_alloc(ARENA_HUGETLB);
+    puts("test-arena passed");
+
+    return 0;
+}
@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "str.h"
+#include "list.h"
+#include "fastmod.h"
+#include "bbgraph.h"
+#include "cache_analysis.h"
+#include "simulat.h"
+
+/*
+ * 64B lines, 4 sets, 2 ways: set of a line is (addr / 64) % 4.
+ *
+ * block 0: 0x000, 0x004        line 0 twice
+ * block 1: 0x100, 0x200        lines 4, 8 (set 0), loop header
+ * block 2: 0x040               line 1 (set 1), loop body, back to 1
+ * block 3: 0x000, 0x03e        line 0 evicted by 4 and 8, then a fetch
+ *                              crossing lines 0 and 1
+ */
+static bb_graph_t *make_graph(void)
+{
+    bb_ref_t b0[] = {{0x000, 4}, {0x004, 4}};
+    bb_ref_t b1[] = {{0x100, 4}, {0x200, 4}};
+    bb_ref_t b2[] = {{0x040, 4}};
+    bb_ref_t b3[] = {{0x000, 4}, {0x03e, 4}};
+    bb_graph_t *g = bb_graph_create(4);
+
+    assert(g);
+    assert(SUCCEED == bb_graph_set_refs(g, 0, b0, 2));
+    assert(SUCCEED == bb_graph_set_refs(g, 1, b1, 2));
+    assert(SUCCEED == bb_graph_set_refs(g, 2, b2, 1));
+    assert(SUCCEED == bb_graph_set_refs(g, 3, b3, 2));
+    assert(SUCCEED == bb_graph_add_edge(g, 0, 1));
+    assert(SUCCEED == bb_graph_add_edge(g, 1, 2));
+    assert(SUCCEED == bb_graph_add_edge(g, 2, 1));
+    assert(SUCCEED == bb_graph_add_edge(g, 1, 3));
+    assert(SUCCEED == bb_graph_finalize(g, 0));
+
+    return g;
+}
+
+/*
+ * accesses in order: 0 line 0 miss, 1 line 0 hit, 2 line 4, 3 line 8,
+ * 4 line 1 (first misses of the loop), 5 line 0 miss, 6 line 0 hit,
+ * 7 line 1 not classified.
+ */
+static void test_hierarchy(bb_graph_t *g)
+{
+    ca_level_t lv[3] = {
+        {.geo = {4, 2, 64}, .cp = CP_lru},
+        {.geo = {8, 4, 64}, .hp = H_non_exclusive, .cp = CP_lru},
+        {.geo = {16, 4, 64}, .hp = H_exclusive, .cp = CP_lru},
+    };
+
+    assert(SUCCEED == ca_analyze_hierarchy(g, lv, 3, 2));
+    assert(lv[1].cac[0] == CAC_always && lv[1].cac[1] == CAC_never);
+    assert(lv[1].cac[2] == CAC_uncertain && lv[1].cac[7] == CAC_uncertain);
+    assert(lv[1].res.nanalyzed == 6);
+    assert(lv[1].res.chmc[1] == CHMC_unknown);
+    /* L1 misses line 0 after the loop, L2 keeps it through the loop */
+    assert(lv[1].res.chmc[0] == CHMC_miss);
+    assert(lv[1].res.chmc[3] == CHMC_first_miss);
+    /* the uncertain access to line 8 may age line 0 on every iteration */
+    assert(lv[1].res.chmc[5] == CHMC_not_classified);
+    assert(lv[2].cac[1] == CAC_never && lv[2].cac[0] == CAC_always);
+    assert(lv[2].cac[3] == CAC_uncertain);
+    assert(lv[2].res.chmc[1] == CHMC_unknown);
+    assert(lv[2].res.chmc[0] == CHMC_not_classified);
+    ca_levels_release(lv, 3);
+
+    /* inclusive and roomy: the L1 classes hold */
+    ca_level_t inc[2] = {
+        {.geo = {4, 2, 64}, .cp = CP_lru},
+        {.geo = {8, 4, 64}, .hp = H_inclusive, .cp = CP_lru},
+    };
+
+    assert(SUCCEED == ca_analyze_hierarchy(g, inc, 2, 1));
+    assert(inc[1].cac[1] == CAC_uncertain);
+    assert(inc[0].res.chmc[1] == CHMC_hit && inc[0].res.chmc[6] == CHMC_hit);
+    assert(inc[0].res.chmc[2] == CHMC_first_miss);
+    ca_levels_release(inc, 2);
+
+    /* inclusive with one line: the loop thrashes it, back invalidating L1 */
+    inc[1].geo = (ca_geometry_t){1, 1, 64};
+    assert(SUCCEED == ca_analyze_hierarchy(g, inc, 2, 1));
+    assert(inc[0].res.chmc[1] == CHMC_hit);
+    assert(inc[0].res.chmc[2] == CHMC_not_classified);
+    ca_levels_release(inc, 2);
+}
+
+/*
+ * L1 1x2, L2 non inclusive 1x4, L3 inclusive 1x1, lines A B A: B evicts
+ * A from L3 and so from L1 and L2, the second A comes from memory. the
+ * classes of every level hold for the simulator.
+ */
+static void test_deep_inclusive(void)
+{
+    bb_ref_t refs[] = {{0x000, 4}, {0x040, 4}, {0x000, 4}};
+    ca_level_t lv[3] = {
+        {.geo = {1, 2, 64}, .cp = CP_lru},
+        {.geo = {1, 4, 64}, .hp = H_non_exclusive, .cp = CP_lru},
+        {.geo = {1, 1, 64}, .hp = H_inclusive, .cp = CP_lru},
+    };
+    bb_graph_t *g = bb_graph_create(1);
+    cache_t c[3], *level[3];
+    struct list_head caches;
+    sim_t *sim;
+
+    assert(g);
+    assert(SUCCEED == bb_graph_set_refs(g, 0, refs, 3));
+    assert(SUCCEED == bb_graph_finalize(g, 0));
+    assert(SUCCEED == ca_analyze_hierarchy(g, lv, 3, 1));
+    assert(lv[0].res.naccesses == 3);
+    assert(lv[0].res.chmc[2] == CHMC_not_classified);
+    assert(lv[1].cac[2] == CAC_uncertain && lv[2].cac[2] == CAC_uncertain);
+    assert(lv[2].res.chmc[2] == CHMC_miss);
+
+    INIT_LIST_HEAD(&caches);
+    for (int l = 0; l < 3; ++l) {
+        memset(&c[l], 0, sizeof(cache_t));
+        c[l].t_cache = DCache;
+        c[l].l_cache = L1 + l;
+        c[l].hp_cache = lv[l].hp;
+        c[l].cp_cache = CP_lru;
+        c[l].sets = lv[l].geo.sets;
+        c[l].ways = lv[l].geo.ways;
+        c[l].linesize = 64;
+        fastmod_init(&c[l].set_index, c[l].sets);
+        c[l].tags = calloc(c[l].sets * c[l].ways, sizeof(uint64_t));
+        c[l].repl = calloc(c[l].sets * c[l].ways, sizeof(uint32_t));
+        list_add_tail(&c[l].list, &caches);
+        level[l] = &c[l];
+    }
+    assert((sim = sim_create(&caches)));
+    sim_begin(sim);
+    for (int i = 0; i < 3; ++i) {
+        trace_ref_t ref = {.addr = refs[i].addr, .size = refs[i].size,
+                           .op = TRACE_read};
+        uint64_t miss[3];
+
+        for (int l = 0; l < 3; ++l)
+            miss[l] = level[l]->statistical_miss;
+        sim_refs(sim, &ref, 1);
+        for (int l = 0; l < 3; ++l) {
+            if (lv[l].res.chmc[i] == CHMC_hit)
+                assert(level[l]->statistical_miss == miss[l]);
+            if (lv[l].res.chmc[i] == CHMC_miss)
+                assert(level[l]->statistical_miss == miss[l] + 1);
+        }
+    }
+    assert(sim->memory == 3);
+    sim_end(sim, "test");
+    sim_destroy(sim);
+    for (int l = 0; l < 3; ++l) {
+        free(c[l].tags);
+        free(c[l].repl);
+    }
+    ca_levels_release(lv, 3);
+    bb_graph_destroy(g);
+}
+
+/* an L2 sweep under one L1 analyzes L1 once and matches a cold run */
+static void test_program(bb_graph_t *g)
+{
+    ca_program_t *prog = ca_program_create(g, 0);
+    unsigned int ways[] = {1, 2, 4, 2};
+    unsigned long reused, analyzed;
+
+    assert(prog);
+    for (int k = 0; k < 4; ++k) {
+        ca_level_t warm[2] = {
+            {.geo = {4, 2, 64}, .cp = CP_lru},
+            {.geo = {8, ways[k], 64}, .hp = H_inclusive, .cp = CP_lru},
+        };
+        ca_level_t cold[2] = {warm[0], warm[1]};
+
+        assert(SUCCEED == ca_program_analyze(prog, warm, 2, 1));
+        assert(SUCCEED == ca_analyze_hierarchy(g, cold, 2, 1));
+        for (int l = 0; l < 2; ++l) {
+            assert(warm[l].res.shared && !cold[l].res.shared);
+            for (int i = 0; i < cold[l].res.naccesses; ++i) {
+                assert(warm[l].res.chmc[i] == cold[l].res.chmc[i]);
+                assert(warm[l].res.scope[i] == cold[l].res.scope[i]);
+            }
+        }
+        ca_levels_release(warm, 2);
+        ca_levels_release(cold, 2);
+    }
+
+    /* L1 once, L2 for 1, 2 and 4 ways, the last L2 again from the memo */
+    ca_program_stats(prog, &reused, &analyzed);
+    assert(analyzed == 4 && reused == 4);
+    ca_program_destroy(prog);
+}
+
+static void test_fastmod(void)
+{
+    uint64_t a = 0x9e3779b97f4a7c15ULL;
+    fastmod_t f;
+
+    for (uint64_t d = 1; d < 2000; ++d) {
+        fastmod_init(&f, d);
+        for (int i = 0; i < 200; ++i) {
+            a = a * 6364136223846793005ULL + 1442695040888963407ULL;
+            assert(fastmod_reduce(&f, a) == a % d);
+            assert(fastmod_reduce(&f, i) == i % d);
+        }
+        assert(fastmod_reduce(&f, UINT64_MAX) == UINT64_MAX % d);
+    }
+    fastmod_init(&f, UINT64_MAX - 2);
+    assert(fastmod_reduce(&f, UINT64_MAX) == 2);
+}
+
+/*
+ * 3 sets: line 0 in set 0, lines 4 and 1 in set 1, line 8 in set 2, so
+ * nothing evicts line 0 any more.
+ */
+static void test_odd_sets(bb_graph_t *g)
+{
+    ca_geometry_t geo = {.sets = 3, .ways = 2, .linesize = 64};
+    ca_result_t res;
+
+    assert(SUCCEED == ca_analyze(g, &geo, 2, &res));
+    assert(ca_ref_chmc(&res, 1, 0) == CHMC_first_miss);
+    assert(ca_ref_chmc(&res, 3, 0) == CHMC_hit);
+    ca_result_release(&res);
+}
+
+int main(void)
+{
+    ca_geometry_t geo = {.sets = 4, .ways = 2, .linesize = 64};
+    bb_graph_t *g = make_graph();
+    ca_result_t res;
+
+    for (int threads = 1; threads <= 4; threads *= 2) {
+        assert(SUCCEED == ca_analyze(g, &geo, threads, &res));
+        assert(res.naccesses == 8);
+
+        assert(ca_ref_chmc(&res, 0, 0) == CHMC_miss);
+        assert(ca_ref_chmc(&res, 0, 1) == CHMC_hit);
+        /* lines 4, 8 and 1 fit their sets inside the loop */
+        assert(ca_ref_chmc(&res, 1, 0) == CHMC_first_miss);
+        assert(ca_ref_chmc(&res, 1, 1) == CHMC_first_miss);
+        assert(ca_ref_chmc(&res, 2, 0) == CHMC_first_miss);
+        assert(res.scope[res.first[2]] == g->blocks[1].loop);
+        /* 4 and 8 always push line 0 out of the 2 ways of set 0 */
+        assert(ca_ref_chmc(&res, 3, 0) == CHMC_miss);
+        /* line 0 hits, line 1 may or may not be cached, not in a loop */
+        assert(ca_ref_chmc(&res, 3, 1) == CHMC_not_classified);
+
+        ca_result_release(&res);
+    }
+
+    test_fastmod();
+    test_odd_sets(g);
+    test_hierarchy(g);
+    test_deep_inclusive();
+    test_program(g);
+    bb_graph_destroy(g);
+    puts("test-cache-analysis: ok");
+
+    return 0;
+}
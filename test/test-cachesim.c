@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "cachesim.h"
+
+#define REFS        200000
+
+static cachesim_ref_t g_refs[REFS];
+
+/* a hot set of lines and a cold stream, reads and writes */
+static void make_refs(void)
+{
+    uint64_t x = 42;
+
+    for (int i = 0; i < REFS; ++i) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        g_refs[i].addr = (x >> 40) & 1 ? (x >> 20) % 512 * 64 :
+                         (uint64_t)i * 64 + (1 << 24);
+        g_refs[i].size = 8;
+        g_refs[i].op = (x >> 50) % 4 ? CACHESIM_READ : CACHESIM_WRITE;
+    }
+}
+
+static void two_levels(cachesim_cfg_t *cfg)
+{
+    cachesim_cfg_init(cfg);
+    cfg->nlevels = 2;
+    cfg->levels[0].size = 4096;
+    cfg->levels[0].ways = 4;
+    cfg->levels[1] = cfg->levels[0];
+    cfg->levels[1].size = 65536;
+    cfg->levels[1].ways = 8;
+    cfg->hugepages = 2;
+}
+
+static void test_access(void)
+{
+    cachesim_ref_t ref = { .addr = 0x1000, .size = 4, .op = CACHESIM_READ };
+    cachesim_stats_t st;
+    cachesim_cfg_t cfg;
+    cachesim_t *cs;
+
+    two_levels(&cfg);
+    cfg.levels[1].ways = 7;
+    assert(!cachesim_create(&cfg));
+    two_levels(&cfg);
+    assert((cs = cachesim_create(&cfg)));
+
+    assert(cachesim_access(cs, &ref) == 3);
+    assert(cachesim_access(cs, &ref) == 1);
+    /* two lines, the first one held */
+    ref.size = 128;
+    assert(cachesim_access(cs, &ref) == 1);
+    ref.op = CACHESIM_IFETCH;
+    assert(cachesim_access(cs, &ref) == -1);
+
+    cachesim_stats(cs, &st);
+    assert(st.refs == 3 && st.nlevels == 2 && st.memory == 2);
+    assert(st.levels[0].hits == 2 && st.levels[0].misses == 2);
+    assert(st.levels[1].hits == 0 && st.levels[1].misses == 2);
+    cachesim_reset_stats(cs);
+    cachesim_stats(cs, &st);
+    assert(!st.refs && !st.levels[0].misses);
+    /* the contents stay */
+    ref.op = CACHESIM_READ;
+    ref.size = 4;
+    assert(cachesim_access(cs, &ref) == 1);
+    cachesim_destroy(cs);
+}
+
+static void test_snapshot(void)
+{
+    cachesim_stats_t a, b;
+    cachesim_snapshot_t *snap;
+    cachesim_cfg_t cfg;
+    cachesim_t *cs, *other;
+
+    two_levels(&cfg);
+    assert((cs = cachesim_create(&cfg)) && (other = cachesim_create(&cfg)));
+    assert(cachesim_access_batch(cs, g_refs, REFS / 2) == REFS / 2);
+    assert((snap = cachesim_snapshot(cs)));
+
+    /* the second half from the snapshot, twice and on another handle */
+    cachesim_access_batch(cs, g_refs + REFS / 2, REFS / 2);
+    cachesim_stats(cs, &a);
+    assert(a.refs == REFS && a.levels[0].evictions);
+    assert(!cachesim_restore(cs, snap));
+    cachesim_access_batch(cs, g_refs + REFS / 2, REFS / 2);
+    cachesim_stats(cs, &b);
+    assert(!memcmp(&a, &b, sizeof(a)));
+    assert(!cachesim_restore(other, snap));
+    cachesim_access_batch(other, g_refs + REFS / 2, REFS / 2);
+    cachesim_stats(other, &b);
+    assert(!memcmp(&a, &b, sizeof(a)));
+    cachesim_snapshot_free(snap);
+    cachesim_destroy(other);
+
+    /* another geometry */
+    cfg.levels[1].ways = 4;
+    assert((other = cachesim_create(&cfg)));
+    assert((snap = cachesim_snapshot(cs)));
+    assert(cachesim_restore(other, snap));
+    cachesim_snapshot_free(snap);
+    cachesim_destroy(other);
+    cachesim_destroy(cs);
+}
+
+static void *simulate(void *arg)
+{
+    cachesim_stats_t *st = arg;
+    cachesim_cfg_t cfg;
+    cachesim_t *cs;
+
+    two_levels(&cfg);
+    assert((cs = cachesim_create(&cfg)));
+    for (int i = 0; i < REFS; ++i)
+        cachesim_access(cs, &g_refs[i]);
+    cachesim_stats(cs, st);
+    cachesim_destroy(cs);
+
+    return NULL;
+}
+
+/* handles on threads of their own count as one alone */
+static void test_threads(void)
+{
+    cachesim_stats_t alone, st[4];
+    pthread_t tid[4];
+
+    simulate(&alone);
+    for (int t = 0; t < 4; ++t)
+        assert(!pthread_create(&tid[t], NULL, simulate, &st[t]));
+    for (int t = 0; t < 4; ++t) {
+        pthread_join(tid[t], NULL);
+        assert(!memcmp(&alone, &st[t], sizeof(alone)));
+    }
+    assert(alone.refs == REFS);
+}
+
+static void test_cores(void)
+{
+    cachesim_ref_t ref = { .addr = 0x2000, .size = 4, .op = CACHESIM_READ };
+    cachesim_stats_t st;
+    cachesim_cfg_t cfg;
+    cachesim_t *cs;
+    int served;
+
+    two_levels(&cfg);
+    cfg.cores = 2;
+    assert((cs = cachesim_create(&cfg)));
+    assert(cachesim_access(cs, &ref) == 3);
+    /* from the other core, or the LLC */
+    ref.cpu = 1;
+    served = cachesim_access(cs, &ref);
+    assert(served == 0 || served == 2);
+    assert(!cachesim_snapshot(cs));
+    assert(!cachesim_run(cs, "gen:refs=10000;strided,n=64K,elem=64,cpu=1"));
+    cachesim_stats(cs, &st);
+    assert(st.refs == 10002 && st.nlevels == 2);
+    assert(st.levels[0].hits + st.levels[0].misses == 10002);
+    assert(st.levels[1].misses && st.levels[1].evictions);
+    cachesim_destroy(cs);
+}
+
+static void test_load(void)
+{
+    cachesim_cfg_t cfg;
+    cachesim_t *cs;
+
+    assert(cachesim_cfg_load("/nonexistent.cache", 0, &cfg));
+    assert(!cachesim_cfg_load("../conf/cfg.cache", 0, &cfg));
+    assert(cachesim_cfg_load("../conf/cfg.cache", 1, &cfg));
+    assert(cfg.nlevels == 3 && cfg.linesize == 64 && cfg.icache);
+    assert(cfg.levels[0].size == 16384 && cfg.levels[2].size == 8 << 20);
+    assert(cfg.levels[1].ways == 4 && cfg.levels[2].policy == CACHESIM_LRU);
+    assert(cfg.levels[2].hierarchy == CACHESIM_EXCLUSIVE);
+    cfg.hugepages = 2;
+    assert((cs = cachesim_create(&cfg)));
+    cachesim_destroy(cs);
+}
+
+int main(void)
+{
+    make_refs();
+    test_access();
+    test_snapshot();
+    test_threads();
+    test_cores();
+    test_load();
+    puts("test-cachesim passed");
+
+    return 0;
+}
@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "str.h"
+#include "cfg.h"
+#include "list.h"
+#include "trace.h"
+#include "simulat.h"
+#include "coherence.h"
+#include "series.h"
+
+static cache_t *level(struct list_head *caches, int l, unsigned int sets,
+                      unsigned int ways, cache_hierarchy_policy_t hp)
+{
+    cache_t *c = calloc(1, sizeof(cache_t));
+
+    assert(c);
+    c->t_cache = DCache;
+    c->l_cache = L1 + l;
+    c->hp_cache = hp;
+    c->cp_cache = CP_lru;
+    c->sets = sets;
+    c->ways = ways;
+    c->linesize = 64;
+    fastmod_init(&c->set_index, sets);
+    c->tags = calloc(sets * ways, sizeof(uint64_t));
+    c->repl = calloc(sets * ways, sizeof(uint32_t));
+    list_add_tail(&c->list, caches);
+
+    return c;
+}
+
+static void release(struct list_head *caches)
+{
+    cache_t *c, *next;
+
+    list_for_each_entry_safe(c, next, caches, list) {
+        list_del(&c->list);
+        free(c->tags);
+        free(c->repl);
+        free(c);
+    }
+}
+
+static int state(coh_t *coh, int core, uint64_t line)
+{
+    cache_t *l1 = coh->cores[core].levels[0];
+    int64_t slot = sim_line_lookup(l1, line, 0);
+
+    return slot < 0 ? COH_I : l1->coh[slot];
+}
+
+static const coh_dir_entry_t *entry(const coh_t *coh, uint64_t line)
+{
+    uint64_t k = coh->llc ? fastmod_reduce(&coh->llc->set_index, line) : line;
+    const coh_shard_t *sh = &coh->shards[k & (coh->nshards - 1)];
+
+    for (uint32_t i = 0; i < sh->cap; ++i)
+        if (sh->dir[i].line == line + 1)
+            return &sh->dir[i];
+
+    return NULL;
+}
+
+static void test_mesi(coh_protocol_t protocol)
+{
+    struct list_head caches;
+    coh_t *coh;
+    int moesi = protocol == COH_moesi;
+
+    INIT_LIST_HEAD(&caches);
+    level(&caches, 0, 4, 2, H_non_exclusive);
+    level(&caches, 1, 16, 4, H_non_exclusive);
+    assert((coh = coh_create(&caches, 3, protocol, 4)));
+    assert(coh->nprivate == 1);
+
+    /* alone: E, then M without asking anybody */
+    assert(2 == coh_access(coh, 0, 8, TRACE_read));
+    assert(COH_E == state(coh, 0, 8));
+    assert(0 == coh_access(coh, 0, 8, TRACE_write));
+    assert(COH_M == state(coh, 0, 8));
+    assert(!coh->cores[0].upgrades);
+
+    /* the dirty owner supplies the line */
+    assert(COH_PEER == coh_access(coh, 1, 8, TRACE_read));
+    assert(state(coh, 0, 8) == (moesi ? COH_O : COH_S));
+    assert(COH_S == state(coh, 1, 8));
+    assert(coh->cores[1].transfers == 1);
+    assert(COH_PEER == coh_access(coh, 2, 8, TRACE_read) || !moesi);
+    assert(entry(coh, 8)->sharers == 7);
+
+    /* a write to a shared copy takes the others */
+    assert(0 == coh_access(coh, 1, 8, TRACE_write));
+    assert(coh->cores[1].upgrades == 1);
+    assert(COH_M == state(coh, 1, 8));
+    assert(COH_I == state(coh, 0, 8) && COH_I == state(coh, 2, 8));
+    assert(coh->cores[0].invalidations == 1 &&
+           coh->cores[2].invalidations == 1);
+    assert(entry(coh, 8)->sharers == 2 && entry(coh, 8)->owner == 1);
+
+    /* a clean exclusive copy turns shared, the LLC supplies the line */
+    assert(2 == coh_access(coh, 0, 9, TRACE_read));
+    assert(1 == coh_access(coh, 2, 9, TRACE_read));
+    assert(COH_S == state(coh, 0, 9) && COH_S == state(coh, 2, 9));
+
+    /* a write miss */
+    assert(1 == coh_access(coh, 1, 9, TRACE_write));
+    assert(COH_M == state(coh, 1, 9) && COH_I == state(coh, 0, 9));
+
+    coh_destroy(coh);
+    assert(!list_last_entry(&caches, cache_t, list)->coh);
+    release(&caches);
+}
+
+static void test_evictions(void)
+{
+    struct list_head caches;
+    coh_t *coh;
+
+    /* a dirty line leaving L1 is written back and leaves the directory */
+    INIT_LIST_HEAD(&caches);
+    level(&caches, 0, 1, 1, H_non_exclusive);
+    level(&caches, 1, 1, 4, H_non_exclusive);
+    assert((coh = coh_create(&caches, 2, COH_mesi, 1)));
+    coh_access(coh, 0, 1, TRACE_write);
+    assert(COH_M == state(coh, 0, 1));
+    coh_access(coh, 0, 2, TRACE_read);
+    assert(coh->cores[0].writebacks == 1);
+    assert(!entry(coh, 1) && entry(coh, 2));
+    assert(1 == coh_access(coh, 1, 1, TRACE_read));
+    assert(COH_E == state(coh, 1, 1));
+    coh_destroy(coh);
+    release(&caches);
+
+    /* an inclusive LLC takes its victims out of every core */
+    INIT_LIST_HEAD(&caches);
+    level(&caches, 0, 1, 2, H_non_exclusive);
+    level(&caches, 1, 1, 1, H_inclusive);
+    assert((coh = coh_create(&caches, 2, COH_moesi, 2)));
+    coh_access(coh, 0, 1, TRACE_write);
+    coh_access(coh, 1, 2, TRACE_read);
+    assert(COH_I == state(coh, 0, 1));
+    assert(coh->cores[0].invalidations == 1);
+    assert(coh->shards[0].memory_writebacks == 1);
+    assert(2 == coh_access(coh, 0, 1, TRACE_read));
+    assert(COH_I == state(coh, 1, 2));
+    coh_destroy(coh);
+    release(&caches);
+
+    assert(!coh_create(&caches, 2, COH_mesi, 4));
+    INIT_LIST_HEAD(&caches);
+    level(&caches, 0, 1, 2, H_non_exclusive);
+    assert(!coh_create(&caches, 0, COH_mesi, 4));
+    assert(!coh_create(&caches, 65, COH_mesi, 4));
+    assert(!coh_create(&caches, 2, COH_mesi, 3));
+    release(&caches);
+}
+
+/* no line is writable in one core and held by another */
+static void check_coherent(coh_t *coh)
+{
+    for (int c = 0; c < coh->ncores; ++c) {
+        cache_t *l1 = coh->cores[c].levels[0];
+
+        for (uint64_t i = 0; i < (uint64_t)l1->sets * l1->ways; ++i) {
+            uint64_t line = l1->tags[i] - 1;
+            const coh_dir_entry_t *e;
+
+            if (!l1->tags[i])
+                continue;
+            assert((e = entry(coh, line)) && (e->sharers & (1ULL << c)));
+            if (l1->coh[i] != COH_M && l1->coh[i] != COH_E)
+                continue;
+            for (int o = 0; o < coh->ncores; ++o)
+                assert(o == c || COH_I == state(coh, o, line));
+        }
+    }
+}
+
+static void test_parallel(void)
+{
+    char path[] = "/tmp/test-coherence-XXXXXX";
+    char spath[] = "/tmp/test-series-XXXXXX";
+    struct list_head caches;
+    uint64_t refs, total = 0, seen[8][3];
+    series_record_t rec;
+    series_t *s;
+    trace_ref_t ref;
+    coh_t *coh;
+    int fd = mkstemp(path);
+    FILE *f = fdopen(fd, "wb");
+
+    assert((fd = mkstemp(spath)) >= 0);
+    close(fd);
+
+    assert(f && SUCCEED == trace_write_header(f));
+    srand(7);
+    memset(&ref, 0, sizeof(ref));
+    for (int i = 0; i < 400000; ++i) {
+        ref.cpu = rand() % 8;
+        /* a small shared region and a private one per cpu */
+        ref.addr = (rand() & 1 ? (uint64_t)(rand() % 256) :
+                    (uint64_t)(ref.cpu + 1) << 20 | rand() % 4096) * 64;
+        ref.size = 4;
+        ref.op = rand() % 3 ? TRACE_read : TRACE_write;
+        assert(SUCCEED == trace_write(f, &ref, 1));
+    }
+    fclose(f);
+
+    for (int threads = 1; threads <= 8; threads *= 8) {
+        INIT_LIST_HEAD(&caches);
+        level(&caches, 0, 16, 4, H_non_exclusive);
+        level(&caches, 1, 64, 8, H_non_exclusive);
+        level(&caches, 2, 256, 16, threads > 1 ? H_inclusive :
+              H_non_exclusive);
+        assert((coh = coh_create(&caches, 8, COH_moesi, COH_SHARDS)));
+        assert(coh->nprivate == 2);
+        /* intervals per core from the simulating threads */
+        assert((s = series_open(spath, 1, 10000)));
+        assert(SUCCEED == coh_series(coh, s, threads));
+        assert(SUCCEED == coh_run(coh, path, threads));
+        assert(SUCCEED == series_close(s));
+        memset(seen, 0, sizeof(seen));
+        assert((f = fopen(spath, "rb")) && !fseek(f, 16, SEEK_SET));
+        while (fread(&rec, sizeof(rec), 1, f) == 1) {
+            assert(rec.config == threads && rec.source < 8 &&
+                   rec.level >= 1 && rec.level <= 2);
+            if (rec.level == 1) {
+                assert(rec.refs > seen[rec.source][2]);
+                seen[rec.source][2] = rec.refs;
+                seen[rec.source][0] += rec.hits + rec.misses;
+                seen[rec.source][1] += rec.evictions;
+            }
+        }
+        fclose(f);
+        refs = 0;
+        for (int c = 0; c < 8; ++c) {
+            cache_t *l1 = coh->cores[c].levels[0];
+
+            refs += coh->cores[c].refs;
+            total += coh->cores[c].invalidations;
+            assert(seen[c][2] == coh->cores[c].refs &&
+                   seen[c][0] == l1->statistical_hit + l1->statistical_miss &&
+                   seen[c][1] == l1->statistical_evict);
+        }
+        assert(refs == 400000);
+        check_coherent(coh);
+        if (threads > 1)
+            coh_report(coh, stdout);
+        coh_destroy(coh);
+        release(&caches);
+    }
+    assert(total);
+    unlink(path);
+    unlink(spath);
+}
+
+int main(void)
+{
+    test_mesi(COH_mesi);
+    test_mesi(COH_moesi);
+    test_evictions();
+    test_parallel();
+    puts("test-coherence passed");
+
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "str.h"
+#include "list.h"
+#include "bbgraph.h"
+#include "fetchgen.h"
+
+/* a block of n instructions of size bytes from addr */
+static void code(bb_graph_t *g, int b, unsigned long addr, int n,
+                 unsigned int size)
+{
+    bb_ref_t refs[16];
+
+    for (int i = 0; i < n; ++i) {
+        refs[i].addr = addr + i * size;
+        refs[i].size = size;
+    }
+    assert(SUCCEED == bb_graph_set_refs(g, b, refs, n));
+}
+
+/*
+ * 0 -> 1 -> 3, 1 <-> 2, the loop {1, 2} runs 5 times.
+ * 1 straddles two lines, 2 jumps to a line far away.
+ */
+static bb_graph_t *make_loop(void)
+{
+    bb_graph_t *g = bb_graph_create(4);
+    bb_ref_t far = { 0x3000, 4 };
+
+    assert(g);
+    code(g, 0, 0x1000, 4, 4);
+    code(g, 1, 0x1070, 4, 8);
+    code(g, 2, 0x2000, 1, 4);
+    assert(SUCCEED == bb_graph_set_refs(g, 2, &far, 1));
+    code(g, 3, 0x4000, 2, 4);
+    assert(SUCCEED == bb_graph_add_edge(g, 0, 1));
+    assert(SUCCEED == bb_graph_add_edge(g, 1, 2));
+    assert(SUCCEED == bb_graph_add_edge(g, 2, 1));
+    assert(SUCCEED == bb_graph_add_edge(g, 1, 3));
+    assert(SUCCEED == bb_graph_finalize(g, 0));
+    assert(SUCCEED == bb_loop_set_bound(g, 1, 5));
+
+    return g;
+}
+
+static void test_walk(void)
+{
+    bb_graph_t *g = make_loop();
+    uint64_t expect[][2] = {{0x1000, 64}, {0x1040, 128}, {0x2000, 64},
+                            {0x3000, 64}, {0x1040, 128}};
+    trace_ref_t refs[64];
+    fetchgen_t *f;
+
+    assert(!fetch_create(g, 48, 0));
+    assert((f = fetch_create(g, 64, 0)));
+    /* the header 5 times, the body 4 */
+    assert(fetch_next(f, refs, 15) == 15 && fetch_walks(f) == 1);
+    for (int i = 0; i < 5; ++i)
+        assert(refs[i].addr == expect[i][0] && refs[i].size == expect[i][1]);
+    for (int i = 0; i < 15; ++i)
+        assert(refs[i].op == TRACE_ifetch);
+    assert(refs[0].pc == 0x1000 && refs[3].pc == 0x2000);
+    assert(refs[14].addr == 0x4000 && refs[14].size == 64);
+    /* the next walk starts over */
+    assert(fetch_next(f, refs, 15) == 15 && fetch_walks(f) == 2);
+    assert(refs[0].addr == 0x1000 && refs[14].addr == 0x4000);
+    fetch_destroy(f);
+
+    /* an unknown bound */
+    g->loops[0].bound = 0;
+    assert((f = fetch_create(g, 64, 0)));
+    assert(fetch_next(f, refs, 1 + FETCH_BOUND + 2 * (FETCH_BOUND - 1) + 1) ==
+           1 + FETCH_BOUND + 2 * (FETCH_BOUND - 1) + 1);
+    assert(fetch_walks(f) == 1);
+    /* a profile outside the loop leaves it alone */
+    assert(SUCCEED == fetch_weight(f, 0, 1, 1));
+    assert(fetch_next(f, refs, 1 + FETCH_BOUND + 2 * (FETCH_BOUND - 1) + 1) ==
+           1 + FETCH_BOUND + 2 * (FETCH_BOUND - 1) + 1);
+    assert(fetch_walks(f) == 2);
+    fetch_destroy(f);
+    bb_graph_destroy(g);
+}
+
+/* 0 -> 1 | 2 -> 3 */
+static void test_weights(void)
+{
+    bb_graph_t *g = bb_graph_create(4);
+    trace_ref_t refs[3];
+    fetchgen_t *f;
+    int taken = 0;
+
+    assert(g);
+    for (int b = 0; b < 4; ++b)
+        code(g, b, 0x1000 * (b + 1), 2, 4);
+    assert(SUCCEED == bb_graph_add_edge(g, 0, 1));
+    assert(SUCCEED == bb_graph_add_edge(g, 0, 2));
+    assert(SUCCEED == bb_graph_add_edge(g, 1, 3));
+    assert(SUCCEED == bb_graph_add_edge(g, 2, 3));
+    assert(SUCCEED == bb_graph_finalize(g, 0));
+
+    /* in turn */
+    assert((f = fetch_create(g, 64, 1)));
+    for (int w = 0; w < 4; ++w) {
+        assert(fetch_next(f, refs, 3) == 3);
+        assert(refs[1].addr == (w & 1 ? 0x3000 : 0x2000));
+    }
+
+    /* as profiled */
+    assert(FAIL == fetch_weight(f, 1, 2, 1));
+    assert(SUCCEED == fetch_weight(f, 0, 1, 3));
+    assert(SUCCEED == fetch_weight(f, 0, 2, 1));
+    for (int w = 0; w < 4000; ++w) {
+        assert(fetch_next(f, refs, 3) == 3);
+        taken += refs[1].addr == 0x2000;
+    }
+    assert(taken > 2800 && taken < 3200);
+    assert(SUCCEED == fetch_weight(f, 0, 1, 0));
+    for (int w = 0; w < 100; ++w) {
+        assert(fetch_next(f, refs, 3) == 3);
+        assert(refs[1].addr == 0x3000);
+    }
+    fetch_destroy(f);
+    bb_graph_destroy(g);
+}
+
+/* 0 -> 1, 0 -> 2: nothing to fetch from the entry, then only from 2 */
+static void test_empty(void)
+{
+    bb_graph_t *g = bb_graph_create(3);
+    trace_ref_t refs[4];
+    fetchgen_t *f;
+
+    assert(g);
+    assert(SUCCEED == bb_graph_finalize(g, 0));
+    assert(!fetch_create(g, 64, 0));
+    bb_graph_destroy(g);
+
+    assert((g = bb_graph_create(3)));
+    code(g, 2, 0x1000, 2, 4);
+    assert(SUCCEED == bb_graph_add_edge(g, 0, 1));
+    assert(SUCCEED == bb_graph_finalize(g, 0));
+    assert(!fetch_create(g, 64, 0));
+    bb_graph_destroy(g);
+
+    assert((g = bb_graph_create(3)));
+    code(g, 2, 0x1000, 2, 4);
+    assert(SUCCEED == bb_graph_add_edge(g, 0, 1));
+    assert(SUCCEED == bb_graph_add_edge(g, 0, 2));
+    assert(SUCCEED == bb_graph_finalize(g, 0));
+    assert((f = fetch_create(g, 64, 0)));
+    assert(fetch_next(f, refs, 4) == 4 && fetch_walks(f) == 8);
+    assert(refs[3].addr == 0x1000);
+    fetch_destroy(f);
+    bb_graph_destroy(g);
+}
+
+/* the walks straight into a simulated ICache, only cold misses */
+static void test_simulate(void)
+{
+    bb_graph_t *g = make_loop();
+    cache_t *c = calloc(1, sizeof(cache_t));
+    struct list_head caches;
+    fetchgen_t *f;
+    sim_t *sim;
+
+    INIT_LIST_HEAD(&caches);
+    assert(c);
+    c->t_cache = ICache;
+    c->l_cache = L1;
+    c->hp_cache = H_non_exclusive;
+    c->cp_cache = CP_lru;
+    c->sets = 16;
+    c->ways = 4;
+    c->linesize = 64;
+    fastmod_init(&c->set_index, c->sets);
+    c->tags = calloc(c->sets * c->ways, sizeof(uint64_t));
+    c->repl = calloc(c->sets * c->ways, sizeof(uint32_t));
+    list_add_tail(&c->list, &caches);
+
+    assert((f = fetch_create(g, 64, 0)) && (sim = sim_create(&caches)));
+    assert(!fetch_simulate(f, sim, 0, 0));
+    assert(fetch_simulate(f, sim, 2, 0) == 30 && fetch_walks(f) == 2);
+    /* 20 lines a walk, 6 of them apart */
+    assert(sim->refs == 30 && c->statistical_miss == 6);
+    assert(c->statistical_hit == 34);
+    assert(fetch_simulate(f, sim, 0, 7) == 7 && sim->refs == 37);
+    sim_destroy(sim);
+    fetch_destroy(f);
+    bb_graph_destroy(g);
+    free(c->tags);
+    free(c->repl);
+    free(c);
+}
+
+int main(void)
+{
+    test_walk();
+    test_weights();
+    test_empty();
+    test_simulate();
+    puts("test-fetchgen passed");
+
+    return 0;
+}
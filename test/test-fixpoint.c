@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "str.h"
+#include "bbgraph.h"
+#include "fixpoint.h"
+
+/*
+ * 0 -> 1 -> 2 -> 3 -> 4 -> 5
+ *      ^    ^    |    |
+ *      |    +----+    |
+ *      +--------------+
+ * outer loop {1,2,3,4}, inner loop {2,3}
+ */
+static bb_graph_t *make_graph(void)
+{
+    int edges[][2] = {{0, 1}, {1, 2}, {2, 3}, {3, 2}, {3, 4}, {4, 1}, {4, 5}};
+    bb_graph_t *g = bb_graph_create(6);
+
+    assert(g);
+    for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); ++i)
+        assert(SUCCEED == bb_graph_add_edge(g, edges[i][0], edges[i][1]));
+    assert(SUCCEED == bb_graph_finalize(g, 0));
+
+    return g;
+}
+
+/* toy domain: the set of blocks seen on some path, as a bit mask */
+static unsigned long pool[1024];
+static fp_state_t npool;
+
+static fp_state_t intern(unsigned long v)
+{
+    for (fp_state_t i = 0; i < npool; ++i)
+        if (pool[i] == v)
+            return i;
+    pool[npool] = v;
+    return npool++;
+}
+
+static fp_state_t seen_entry(void *ctx)
+{
+    return intern(0);
+}
+
+static fp_state_t seen_transfer(void *ctx, const bb_graph_t *g, int b,
+                                fp_state_t in)
+{
+    return intern(pool[in] | 1UL << b);
+}
+
+static fp_state_t seen_join(void *ctx, fp_state_t a, fp_state_t b)
+{
+    return intern(pool[a] | pool[b]);
+}
+
+static void test_structure(void)
+{
+    bb_graph_t *g = make_graph();
+    int outer = g->blocks[1].loop, inner = g->blocks[2].loop;
+
+    assert(g->nreach == 6);
+    assert(g->rpo[0] == 0);
+    assert(g->nloops == 2);
+    assert(outer != BB_NONE && inner != BB_NONE && outer != inner);
+    assert(g->loops[outer].header == 1 && g->loops[outer].depth == 1);
+    assert(g->loops[inner].header == 2 && g->loops[inner].depth == 2);
+    assert(g->loops[inner].parent == outer);
+    assert(bb_loop_contains(g, outer, 3) && !bb_loop_contains(g, inner, 4));
+    assert(g->blocks[0].loop == BB_NONE && g->blocks[5].loop == BB_NONE);
+
+    /* inner loop body sits right behind its header in the order */
+    assert(g->blocks[3].rpo == g->blocks[2].rpo + 1);
+    assert(g->blocks[4].rpo > g->blocks[3].rpo);
+
+    assert(g->nsccs == 3);
+    assert(g->blocks[0].scc < g->blocks[1].scc);
+    assert(g->blocks[1].scc == g->blocks[4].scc);
+    assert(g->blocks[4].scc < g->blocks[5].scc);
+
+    bb_graph_destroy(g);
+}
+
+static void test_solve(void)
+{
+    bb_graph_t *g = make_graph();
+    fp_domain_t dom = {
+        .entry = seen_entry,
+        .transfer = seen_transfer,
+        .join = seen_join,
+    };
+    fp_result_t res;
+
+    assert(SUCCEED == fp_solve(g, &dom, &res));
+    assert(pool[res.in[0]] == 0);
+    assert(pool[res.in[1]] == 0x1f);
+    assert(pool[res.out[5]] == 0x3f);
+    printf("transfers %lu, updates %lu\n", res.transfers, res.updates);
+    assert(res.transfers <= 2 * g->nblocks);
+
+    fp_result_release(&res);
+    bb_graph_destroy(g);
+}
+
+int main(void)
+{
+    test_structure();
+    test_solve();
+    puts("test-fixpoint: ok");
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "str.h"
+#include "bbgraph.h"
+#include "ipet.h"
+
+/*
+ * 0 -> 1 -> 2 -> 3 -> 4 -> 5
+ *      ^    ^    |    |
+ *      |    +----+    |
+ *      +--------------+
+ * outer loop {1,2,3,4} runs 10 times, inner loop {2,3} 5 times per entry.
+ * 1 -> 6 -> 4 is a costly way around the inner loop.
+ */
+static bb_graph_t *make_graph(void)
+{
+    int edges[][2] = {{0, 1}, {1, 2}, {2, 3}, {3, 2}, {3, 4}, {4, 1}, {4, 5},
+                      {1, 6}, {6, 4}};
+    bb_graph_t *g = bb_graph_create(7);
+
+    assert(g);
+    for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); ++i)
+        assert(SUCCEED == bb_graph_add_edge(g, edges[i][0], edges[i][1]));
+    assert(SUCCEED == bb_graph_finalize(g, 0));
+
+    return g;
+}
+
+int main(void)
+{
+    bb_graph_t *g = make_graph();
+    uint64_t cost[7] = {1, 1, 1, 1, 1, 1, 1}, count[7];
+    uint64_t *lcost = calloc(g->nloops, sizeof(uint64_t));
+    int outer = g->blocks[1].loop, inner = g->blocks[2].loop;
+    ipet_result_t res;
+    ipet_t *p;
+
+    /* unbounded loops are refused */
+    assert(!ipet_create(g));
+    assert(SUCCEED == bb_loop_set_bound(g, 1, 10));
+    assert(SUCCEED == bb_loop_set_bound(g, 2, 5));
+    p = ipet_create(g);
+    assert(p);
+
+    /* inner entry: 4 cycles of 2 + exit path 2 = 10, outer iteration 12 */
+    assert(SUCCEED == ipet_solve(p, cost, NULL, &res));
+    assert(res.wcet == 1 + 10 * 12 + 1 && res.sink == 5);
+    assert(res.resolved == 2);
+    ipet_counts(p, count);
+    assert(count[0] == 1 && count[1] == 10 && count[2] == 50);
+    assert(count[3] == 50 && count[4] == 10 && count[5] == 1);
+    assert(count[6] == 0);
+
+    /* only the task level changes */
+    cost[0] = 7;
+    assert(SUCCEED == ipet_solve(p, cost, NULL, &res));
+    assert(res.wcet == 7 + 120 + 1 && res.resolved == 0);
+
+    /* the way around now beats the inner loop, only the outer is redone */
+    cost[6] = 20;
+    assert(SUCCEED == ipet_solve(p, cost, NULL, &res));
+    assert(res.wcet == 7 + 10 * 22 + 1 && res.resolved == 1);
+    ipet_counts(p, count);
+    assert(count[6] == 10 && count[2] == 0);
+
+    cost[6] = 1;
+    cost[3] = 2;
+    lcost[inner] = 100;
+    assert(SUCCEED == ipet_solve(p, cost, lcost, &res));
+    /* inner entry 5 * 3 + 100, outer iteration 117 */
+    assert(res.wcet == 7 + 10 * 117 + 1 && res.resolved == 2);
+    assert(outer != inner);
+
+    ipet_destroy(p);
+    free(lcost);
+    bb_graph_destroy(g);
+    puts("test-ipet: ok");
+
+    return 0;
+}
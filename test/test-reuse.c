@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "str.h"
+#include "cfg.h"
+#include "list.h"
+#include "reuse.h"
+#include "shards.h"
+#include "simulat.h"
+
+/* distance by walking an LRU stack */
+static uint64_t stack_distance(uint64_t *stack, uint64_t *depth, uint64_t line)
+{
+    uint64_t d;
+
+    for (d = 0; d < *depth; ++d)
+        if (stack[d] == line)
+            break;
+    if (d == *depth) {
+        memmove(stack + 1, stack, sizeof(uint64_t) * (*depth)++);
+        stack[0] = line;
+        return REUSE_COLD;
+    }
+    memmove(stack + 1, stack, sizeof(uint64_t) * d);
+    stack[0] = line;
+
+    return d;
+}
+
+static void test_bins(void)
+{
+    for (uint64_t d = 0; d < 100000; ++d) {
+        int b = reuse_bin(d);
+
+        assert(reuse_bin_lower(b) <= d && d < reuse_bin_lower(b + 1));
+    }
+    assert(reuse_bin(UINT64_MAX - 1) == REUSE_BINS - 1);
+    assert(reuse_bin_lower(REUSE_BINS - 1) > (1ULL << 62));
+}
+
+static void test_exact(void)
+{
+    uint64_t stack[3000], depth = 0;
+    reuse_t *r = reuse_create(64);
+
+    assert(r);
+    srand(3);
+    /* long enough to renumber the times many times */
+    for (int i = 0; i < 300000; ++i) {
+        uint64_t line = i % 7 ? rand() % 64 : rand() % 3000;
+
+        assert(reuse_access(r, line) == stack_distance(stack, &depth, line));
+    }
+    assert(reuse_hist(r)->cold == depth);
+    assert(reuse_hist(r)->refs == 300000);
+    reuse_destroy(r);
+}
+
+static cache_t *fully_associative(struct list_head *caches, unsigned int ways)
+{
+    cache_t *c = calloc(1, sizeof(cache_t));
+
+    assert(c);
+    c->t_cache = DCache;
+    c->l_cache = L1;
+    c->hp_cache = H_non_exclusive;
+    c->cp_cache = CP_lru;
+    c->sets = 1;
+    c->ways = ways;
+    c->linesize = 64;
+    fastmod_init(&c->set_index, 1);
+    c->tags = calloc(ways, sizeof(uint64_t));
+    c->repl = calloc(ways, sizeof(uint32_t));
+    list_add_tail(&c->list, caches);
+
+    return c;
+}
+
+/* the curve agrees with simulation at the bin bounds */
+static void test_curve(void)
+{
+    char path[] = "/tmp/test-reuse-XXXXXX";
+    reuse_t *r = reuse_create(64);
+    int fd = mkstemp(path);
+    FILE *f = fdopen(fd, "w");
+
+    assert(r && f);
+    srand(5);
+    for (int i = 0; i < 100000; ++i)
+        fprintf(f, "%c %x 4\n", i & 3 ? 'r' : 'w',
+                (rand() % 4 ? rand() % 200 : rand() % 2000) * 64);
+    fclose(f);
+    assert(SUCCEED == reuse_run(r, path));
+
+    for (int b = 1; reuse_bin_lower(b) <= 1024; ++b) {
+        unsigned int ways = reuse_bin_lower(b);
+        struct list_head caches;
+        cache_t *c;
+        sim_t *sim;
+        double ratio;
+
+        INIT_LIST_HEAD(&caches);
+        c = fully_associative(&caches, ways);
+        assert((sim = sim_create(&caches)));
+        assert(SUCCEED == run(sim, path));
+        ratio = (double)c->statistical_miss / reuse_hist(r)->refs;
+        assert(ratio - reuse_miss_ratio(reuse_hist(r), ways) < 1e-12 &&
+               reuse_miss_ratio(reuse_hist(r), ways) - ratio < 1e-12);
+        sim_destroy(sim);
+        free(c->tags);
+        free(c->repl);
+        free(c);
+    }
+    assert(reuse_miss_ratio(reuse_hist(r), 0) == 1.0);
+    reuse_report(reuse_hist(r), 64, stdout);
+    assert(FAIL == reuse_run(r, "/nonexistent/trace"));
+    reuse_destroy(r);
+    unlink(path);
+}
+
+static double max_error(const reuse_hist_t *a, const reuse_hist_t *b)
+{
+    double worst = 0.0;
+
+    for (int k = 0; k < REUSE_BINS; ++k) {
+        double e = reuse_miss_ratio(a, reuse_bin_lower(k)) -
+                   reuse_miss_ratio(b, reuse_bin_lower(k));
+
+        if (e < 0)
+            e = -e;
+        if (e > worst)
+            worst = e;
+    }
+
+    return worst;
+}
+
+static void test_shards(void)
+{
+    reuse_t *r = reuse_create(64);
+    shards_t *small = shards_create(64, 1 << 20), *s = shards_create(64, SHARDS_LINES);
+    reuse_hist_t h, few;
+    uint64_t x = 1;
+
+    assert(r && s && small);
+    /* a skewed working set of 2^18 lines */
+    for (int i = 0; i < 3000000; ++i) {
+        uint64_t line;
+
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        line = x % (1 << (6 + (x >> 40) % 13));
+        reuse_access(r, line);
+        shards_access(s, line);
+        if (i < 100000)
+            shards_access(small, line);
+    }
+    shards_hist(s, &h);
+    printf("shards: rate %.5f, max miss ratio error %.4f\n", shards_rate(s),
+           max_error(reuse_hist(r), &h));
+    assert(shards_rate(s) < 0.1);
+    assert(h.refs == reuse_hist(r)->refs);
+    assert(max_error(reuse_hist(r), &h) < 0.04);
+
+    /* a sample holding every line is exact */
+    shards_hist(small, &few);
+    assert(shards_rate(small) > 0.999999);
+    assert(few.refs == 100000 && few.cold > 1000);
+    shards_destroy(small);
+    shards_destroy(s);
+    reuse_destroy(r);
+}
+
+int main(void)
+{
+    test_bins();
+    test_exact();
+    test_curve();
+    test_shards();
+    puts("test-reuse passed");
+
+    return 0;
+}
@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "str.h"
+#include "server.h"
+#include "trace.h"
+
+#define REFS        100000
+#define GEN         "gen:refs=5000;strided,n=1M"
+
+static cachesim_ref_t g_refs[REFS];
+
+static void make_refs(void)
+{
+    uint64_t x = 7;
+
+    for (int i = 0; i < REFS; ++i) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        g_refs[i].addr = (x >> 40) & 1 ? (x >> 20) % 512 * 64 :
+                         (uint64_t)i * 64 + (1 << 24);
+        g_refs[i].size = 8;
+        g_refs[i].op = (x >> 50) % 4 ? CACHESIM_READ : CACHESIM_WRITE;
+    }
+}
+
+static void two_levels(cachesim_cfg_t *cfg)
+{
+    cachesim_cfg_init(cfg);
+    cfg->nlevels = 2;
+    cfg->levels[0].size = 4096;
+    cfg->levels[0].ways = 4;
+    cfg->levels[1] = cfg->levels[0];
+    cfg->levels[1].size = 65536;
+    cfg->levels[1].ways = 8;
+    cfg->hugepages = 2;
+}
+
+/* one request, its reply payload in buf */
+static uint32_t call(int fd, uint32_t op, const void *a, uint32_t alen,
+                     const void *b, uint32_t blen, void *buf, uint32_t *len)
+{
+    static char scratch[256];
+    uint32_t reply, n;
+
+    assert(SUCCEED == server_send(fd, op, a, alen, b, blen));
+    assert(SUCCEED == server_recv(fd, &reply, buf ? buf : scratch,
+                                  buf ? sizeof(cachesim_stats_t) :
+                                  sizeof(scratch), &n));
+    if (len)
+        *len = n;
+
+    return reply;
+}
+
+static uint32_t create(int fd, const cachesim_cfg_t *cfg)
+{
+    uint32_t id, len;
+
+    assert(call(fd, SERVER_create, cfg, sizeof(*cfg), NULL, 0, &id, &len) ==
+           SERVER_ok && len == sizeof(id));
+
+    return id;
+}
+
+static void stats(int fd, uint32_t id, cachesim_stats_t *st)
+{
+    assert(call(fd, SERVER_stats, &id, sizeof(id), NULL, 0, st, NULL) ==
+           SERVER_stats_reply);
+}
+
+/* references streamed count as on a handle of one's own */
+static void test_refs(const char *path)
+{
+    cachesim_stats_t alone, st;
+    cachesim_cfg_t cfg;
+    cachesim_t *cs;
+    uint32_t id, bad = 999;
+    int fd;
+
+    two_levels(&cfg);
+    assert((cs = cachesim_create(&cfg)));
+    cachesim_access_batch(cs, g_refs, REFS);
+    cachesim_stats(cs, &alone);
+    cachesim_destroy(cs);
+
+    assert((fd = server_connect(path)) >= 0);
+    id = create(fd, &cfg);
+    for (int i = 0; i < REFS; i += 1000)
+        assert(SUCCEED == server_send(fd, SERVER_refs, &id, sizeof(id),
+                                      g_refs + i,
+                                      1000 * sizeof(cachesim_ref_t)));
+    stats(fd, id, &st);
+    assert(!memcmp(&alone, &st, sizeof(st)));
+
+    /* a bad configuration or session is an error, the connection stays */
+    cfg.levels[1].ways = 7;
+    assert(call(fd, SERVER_create, &cfg, sizeof(cfg), NULL, 0, NULL, NULL) ==
+           SERVER_error);
+    assert(call(fd, SERVER_stats, &bad, sizeof(bad), NULL, 0, NULL, NULL) ==
+           SERVER_error);
+    assert(call(fd, SERVER_destroy, &id, sizeof(id), NULL, 0, NULL, NULL) ==
+           SERVER_ok);
+    assert(call(fd, SERVER_stats, &id, sizeof(id), NULL, 0, NULL, NULL) ==
+           SERVER_error);
+    close(fd);
+}
+
+/* a warmed session saved once, restored before every job */
+static void test_save(const char *path)
+{
+    cachesim_stats_t a, b;
+    cachesim_cfg_t cfg;
+    uint32_t id;
+    int fd;
+
+    assert((fd = server_connect(path)) >= 0);
+    two_levels(&cfg);
+    id = create(fd, &cfg);
+    assert(call(fd, SERVER_restore, &id, sizeof(id), NULL, 0, NULL, NULL) ==
+           SERVER_error);
+    assert(SUCCEED == server_send(fd, SERVER_refs, &id, sizeof(id), g_refs,
+                                  REFS / 2 * sizeof(cachesim_ref_t)));
+    assert(call(fd, SERVER_reset, &id, sizeof(id), NULL, 0, NULL, NULL) ==
+           SERVER_ok);
+    assert(call(fd, SERVER_save, &id, sizeof(id), NULL, 0, NULL, NULL) ==
+           SERVER_ok);
+
+    for (int job = 0; job < 2; ++job) {
+        assert(call(fd, SERVER_restore, &id, sizeof(id), NULL, 0, NULL,
+                    NULL) == SERVER_ok);
+        assert(SUCCEED == server_send(fd, SERVER_refs, &id, sizeof(id),
+                                      g_refs + REFS / 2,
+                                      REFS / 2 * sizeof(cachesim_ref_t)));
+        stats(fd, id, job ? &b : &a);
+    }
+    assert(a.refs == REFS / 2 && !memcmp(&a, &b, sizeof(a)));
+    close(fd);
+}
+
+/* a trace file decoded once, then from memory, on another connection */
+static void test_run(server_t *s, const char *path)
+{
+    char trace[] = "/tmp/test-server-XXXXXX";
+    cachesim_stats_t a, b;
+    cachesim_cfg_t cfg;
+    uint32_t id;
+    int fd, tfd;
+    FILE *f;
+
+    assert((tfd = mkstemp(trace)) >= 0 && (f = fdopen(tfd, "w")));
+    assert(SUCCEED == trace_write_header(f));
+    assert(SUCCEED == trace_write(f, (trace_ref_t *)g_refs, REFS));
+    fclose(f);
+
+    two_levels(&cfg);
+    cfg.warmup = 1000;
+    for (int job = 0; job < 2; ++job) {
+        assert((fd = server_connect(path)) >= 0);
+        id = create(fd, &cfg);
+        assert(call(fd, SERVER_run, &id, sizeof(id), trace,
+                    strlen(trace) + 1, job ? &b : &a, NULL) ==
+               SERVER_stats_reply);
+        close(fd);
+        assert(s->traces && s->bytes == REFS * sizeof(cachesim_ref_t));
+    }
+    assert(a.refs == REFS - 1000 && !memcmp(&a, &b, sizeof(a)));
+
+    /* a synthetic trace runs without being kept */
+    assert((fd = server_connect(path)) >= 0);
+    id = create(fd, &cfg);
+    assert(call(fd, SERVER_run, &id, sizeof(id), GEN, sizeof(GEN), &a,
+                NULL) == SERVER_stats_reply);
+    assert(a.refs == 4000 && s->bytes == REFS * sizeof(cachesim_ref_t));
+    assert(call(fd, SERVER_run, &id, sizeof(id), "/nonexistent",
+                sizeof("/nonexistent"), NULL, NULL) == SERVER_error);
+    close(fd);
+    unlink(trace);
+}
+
+int main(void)
+{
+    char path[] = "/tmp/test-server.sock";
+    server_t *s;
+    int fd;
+
+    make_refs();
+    assert((s = server_start(path, 0)));
+    test_refs(path);
+    test_save(path);
+    test_run(s, path);
+
+    /* a client that never says goodbye */
+    assert((fd = server_connect(path)) >= 0);
+    assert(call(fd, SERVER_shutdown, NULL, 0, NULL, 0, NULL, NULL) ==
+           SERVER_ok);
+    server_wait(s);
+    server_stop(s);
+    close(fd);
+    assert(server_connect(path) < 0);
+    puts("test-server passed");
+
+    return 0;
+}
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "str.h"
+#include "cfg.h"
+#include "sweep.h"
+#include "bbgraph.h"
+#include "cache_analysis.h"
+
+static void expect(const cfg_sweep_t *s, const char *parameter, uint64_t k,
+                   const char *value)
+{
+    char buf[128];
+
+    assert(SUCCEED == cfg_sweep_get(s, parameter, k, buf, sizeof(buf)));
+    if (strcmp(buf, value)) {
+        fprintf(stderr, "%s #%llu: [%s] != [%s]\n", parameter,
+                (unsigned long long)k, buf, value);
+        assert(0);
+    }
+}
+
+static void test_expand(void)
+{
+    cfg_sweep_t *s = cfg_sweep_create();
+    char buf[128];
+
+    assert(s);
+    assert(SUCCEED == cfg_sweep_add(s, "level", "3"));
+    assert(cfg_sweep_count(s) == 1);
+    assert(SUCCEED == cfg_sweep_label(s, 0, buf, sizeof(buf)) && !*buf);
+
+    assert(SUCCEED == cfg_sweep_add(s, "lvsize", "{32K, 48K}x{1M,2M}, 8M"));
+    assert(SUCCEED == cfg_sweep_add(s, "sw", "3..16:pow2"));
+    assert(cfg_sweep_count(s) == 12);
+    /* the last item varies fastest */
+    expect(s, "lvsize", 0, "32K,1M,8M");
+    expect(s, "sw", 0, "4");
+    expect(s, "sw", 2, "16");
+    expect(s, "lvsize", 3, "32K,2M,8M");
+    expect(s, "lvsize", 11, "48K,2M,8M");
+    expect(s, "level", 11, "3");
+    assert(SUCCEED == cfg_sweep_label(s, 7, buf, sizeof(buf)));
+    assert(!strcmp(buf, "lvsize=48K,1M,8M sw=8"));
+    assert(FAIL == cfg_sweep_get(s, "policy", 0, buf, sizeof(buf)));
+    assert(FAIL == cfg_sweep_get(s, "lvsize", 0, buf, 4));
+
+    /* a new value replaces the old one */
+    assert(SUCCEED == cfg_sweep_add(s, "sw", "{1K..4K:*2,1..3}"));
+    assert(cfg_sweep_count(s) == 24);
+    expect(s, "sw", 0, "1024");
+    expect(s, "sw", 2, "4096");
+    expect(s, "sw", 5, "3");
+
+    assert(FAIL == cfg_sweep_add(s, "sw", "{1,2"));
+    assert(FAIL == cfg_sweep_add(s, "sw", "8..2"));
+    assert(FAIL == cfg_sweep_add(s, "sw", "2..8:pow3"));
+    assert(FAIL == cfg_sweep_add(s, "sw", "1,,2"));
+    assert(FAIL == cfg_sweep_add(s, "sw", "{1}{2}"));
+    assert(FAIL == cfg_sweep_add(s, "sw", "1..1000000,1..1000000"));
+    /* a failed add keeps the previous value */
+    assert(cfg_sweep_count(s) == 24);
+
+    cfg_sweep_destroy(s);
+}
+
+static void test_cfg_file(void)
+{
+    char path[] = "/tmp/test-sweep-XXXXXX";
+    cfg_sweep_t *s = cfg_sweep_create();
+    int level = 0, fd = mkstemp(path);
+    struct cfg_line cfg[] = {
+        {"level", &level, TYPE_INT, PARM_MAND, 0, 3},
+        {"sw", &s, TYPE_SWEEP, PARM_MAND, 0, 0},
+        {"policy", &s, TYPE_SWEEP, PARM_MAND, 0, 0},
+        {NULL, NULL, 0, 0, 0, 0}
+    };
+    FILE *f = fdopen(fd, "w");
+
+    assert(s && f);
+    fputs("level=2\nsw = 2..8:pow2\n", f);
+    fclose(f);
+    /* policy is mandatory */
+    assert(FAIL == parse_cfg_file(path, cfg, CFG_FILE_REQUIRED, CFG_STRICT));
+
+    f = fopen(path, "a");
+    assert(f);
+    fputs("policy={1,2}x2\n", f);
+    fclose(f);
+    assert(SUCCEED == parse_cfg_file(path, cfg, CFG_FILE_REQUIRED, CFG_STRICT));
+    assert(level == 2 && cfg_sweep_count(s) == 6);
+    expect(s, "policy", 5, "2,2");
+
+    unlink(path);
+    cfg_sweep_destroy(s);
+}
+
+/* a loop over one block touching 16 consecutive lines */
+static bb_graph_t *make_graph(void)
+{
+    bb_graph_t *g = bb_graph_create(3);
+    bb_ref_t refs[16];
+
+    assert(g);
+    for (int i = 0; i < 16; ++i) {
+        refs[i].addr = i * 64;
+        refs[i].size = 4;
+    }
+    assert(SUCCEED == bb_graph_set_refs(g, 1, refs, 16));
+    assert(SUCCEED == bb_graph_add_edge(g, 0, 1));
+    assert(SUCCEED == bb_graph_add_edge(g, 1, 1));
+    assert(SUCCEED == bb_graph_add_edge(g, 1, 2));
+    assert(SUCCEED == bb_graph_finalize(g, 0));
+
+    return g;
+}
+
+typedef struct run {
+    ca_program_t *prog;
+    int first_miss[16];
+    int calls[16];
+} run_t;
+
+static int run_config(const cfg_sweep_t *s, uint64_t k, void *arg)
+{
+    run_t *run = arg;
+    char sets[32], ways[32];
+    ca_level_t lv[2] = {
+        {.geo = {4, 1, 64}, .cp = CP_lru},
+        {.geo = {0, 0, 64}, .hp = H_non_exclusive, .cp = CP_lru},
+    };
+    int first_miss = 0;
+
+    if (SUCCEED != cfg_sweep_get(s, "sets", k, sets, sizeof(sets)) ||
+        SUCCEED != cfg_sweep_get(s, "ways", k, ways, sizeof(ways)))
+        return FAIL;
+    lv[1].geo.sets = atoi(sets);
+    lv[1].geo.ways = atoi(ways);
+
+    /* the pool runs the configurations in parallel, not the sets */
+    if (SUCCEED != ca_program_analyze(run->prog, lv, 2, 1))
+        return FAIL;
+    for (int i = 0; i < lv[1].res.naccesses; ++i)
+        first_miss += lv[1].res.chmc[i] == CHMC_first_miss;
+    run->first_miss[k] = first_miss;
+    __atomic_fetch_add(&run->calls[k], 1, __ATOMIC_RELAXED);
+    ca_levels_release(lv, 2);
+
+    return SUCCEED;
+}
+
+static void test_run(void)
+{
+    bb_graph_t *g = make_graph();
+    cfg_sweep_t *s = cfg_sweep_create();
+    run_t run = {.prog = ca_program_create(g, 0)};
+    unsigned long reused, analyzed;
+
+    assert(s && run.prog);
+    assert(SUCCEED == cfg_sweep_add(s, "sets", "1..8:pow2"));
+    assert(SUCCEED == cfg_sweep_add(s, "ways", "{2,4,8,16}"));
+    assert(cfg_sweep_count(s) == 16);
+    assert(SUCCEED == cfg_sweep_run(s, 4, run_config, &run));
+
+    for (int k = 0; k < 16; ++k) {
+        int sets = 1 << (k / 4), ways = 2 << (k % 4);
+
+        assert(run.calls[k] == 1);
+        /* the 16 lines stay once the loop runs if they fit in L2 */
+        assert(run.first_miss[k] == (sets * ways >= 16 ? 16 : 0));
+    }
+    /* L2 once per configuration, L1 once plus threads racing for it */
+    ca_program_stats(run.prog, &reused, &analyzed);
+    assert(analyzed >= 17 && analyzed + reused == 32);
+
+    ca_program_destroy(run.prog);
+    cfg_sweep_destroy(s);
+    bb_graph_destroy(g);
+}
+
+int main(void)
+{
+    test_expand();
+    test_cfg_file();
+    test_run();
+    puts("test-sweep: ok");
+
+    return 0;
+}
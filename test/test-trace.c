@@ -0,0 +1,765 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "str.h"
+#include "cfg.h"
+#include "list.h"
+#include "spsc.h"
+#include "trace.h"
+#include "simulat.h"
+#include "progress.h"
+#include "series.h"
+#include "stats.h"
+#include "tracegen.h"
+#include "tracering.h"
+
+#define ITEMS       200000
+
+static void *producer(void *arg)
+{
+    spsc_t *q = arg;
+    uint64_t *v;
+
+    for (uint64_t i = 0; i < ITEMS; ++i) {
+        assert((v = spsc_acquire(q)));
+        *v = i;
+        spsc_publish(q);
+    }
+    spsc_close(q);
+
+    return NULL;
+}
+
+/* a tiny ring, so both sides keep parking */
+static void test_ring(void)
+{
+    spsc_t *q = spsc_create(2, sizeof(uint64_t));
+    uint64_t *v, next = 0, pparks, cparks;
+    pthread_t tid;
+
+    assert(q);
+    assert(!spsc_create(3, 8));
+    assert(!pthread_create(&tid, NULL, producer, q));
+    while ((v = spsc_peek(q))) {
+        assert(*v == next);
+        next++;
+        spsc_release(q);
+    }
+    assert(next == ITEMS);
+    pthread_join(tid, NULL);
+    spsc_stats(q, &pparks, &cparks);
+    printf("ring: %llu producer, %llu consumer parks\n",
+           (unsigned long long)pparks, (unsigned long long)cparks);
+    spsc_destroy(q);
+
+    /* in place, as in shared memory */
+    void *mem = aligned_alloc(SPSC_CACHELINE, spsc_size(4, 100));
+    assert(!spsc_init((char *)mem + 8, 4, 100, 1));
+    assert((q = spsc_init(mem, 4, 100, 1)));
+    for (int i = 0; i < 4; ++i) {
+        assert((v = spsc_acquire(q)));
+        *v = i;
+        spsc_publish(q);
+    }
+    spsc_close(q);
+    assert(!spsc_acquire(q));
+    for (int i = 0; i < 4; ++i) {
+        assert((v = spsc_peek(q)) && *v == i);
+        spsc_release(q);
+    }
+    assert(!spsc_peek(q));
+    spsc_destroy(q);
+    free(mem);
+}
+
+static void write_file(const char *path, const char *text)
+{
+    FILE *f = fopen(path, "w");
+
+    assert(f);
+    fputs(text, f);
+    fclose(f);
+}
+
+static void test_formats(void)
+{
+    char path[] = "/tmp/test-trace-XXXXXX";
+    trace_reader_t *r;
+    trace_ref_t refs[8];
+    FILE *f;
+    int fd = mkstemp(path);
+
+    assert(fd >= 0);
+    close(fd);
+    write_file(path, "# comment\n"
+                     "r 1000\n"
+                     "\n"
+                     "W 0x2000 8 400123\n"
+                     "2 40 4 40 3\n");
+    assert((r = trace_open(path)));
+    assert(3 == trace_read(r, refs, 8));
+    assert(refs[0].op == TRACE_read && refs[0].addr == 0x1000 &&
+           refs[0].size == 1);
+    assert(refs[1].op == TRACE_write && refs[1].addr == 0x2000 &&
+           refs[1].size == 8 && refs[1].pc == 0x400123);
+    assert(refs[2].op == TRACE_ifetch && refs[2].cpu == 3);
+    assert(0 == trace_read(r, refs, 8));
+    trace_close(r);
+
+    write_file(path, "r 10\nx 20\n");
+    assert((r = trace_open(path)));
+    assert(-1 == trace_read(r, refs, 8));
+    trace_close(r);
+
+    /* binary round trip */
+    assert((f = fopen(path, "wb")));
+    assert(SUCCEED == trace_write_header(f));
+    for (int i = 0; i < 8; ++i) {
+        memset(&refs[i], 0, sizeof(refs[i]));
+        refs[i].addr = i * 64;
+        refs[i].size = 4;
+        refs[i].op = i & 1;
+    }
+    assert(SUCCEED == trace_write(f, refs, 8));
+    fclose(f);
+    memset(refs, 0, sizeof(refs));
+    assert((r = trace_open(path)));
+    assert(5 == trace_read(r, refs, 5));
+    assert(refs[4].addr == 4 * 64 && refs[3].op == TRACE_write);
+    assert(3 == trace_read(r, refs, 8));
+    assert(refs[2].addr == 7 * 64);
+    trace_close(r);
+
+    write_file(path, "CSTRACE9");
+    assert(!trace_open(path));
+    assert(!trace_open("/nonexistent/trace"));
+    unlink(path);
+}
+
+static void test_stream(void)
+{
+    char path[] = "/tmp/test-trace-XXXXXX";
+    const trace_batch_t *b;
+    trace_stream_t *s;
+    trace_ref_t ref;
+    uint64_t n = 0;
+    uint32_t count;
+    int fd = mkstemp(path);
+    FILE *f = fdopen(fd, "wb");
+
+    assert(f && SUCCEED == trace_write_header(f));
+    memset(&ref, 0, sizeof(ref));
+    for (uint64_t i = 0; i < 10 * TRACE_BATCH + 7; ++i) {
+        ref.addr = i;
+        assert(SUCCEED == trace_write(f, &ref, 1));
+    }
+    fclose(f);
+
+    assert((s = trace_stream_start(trace_open(path))));
+    while ((b = trace_stream_next(s, &count))) {
+        assert(count == b->n);
+        for (uint32_t i = 0; i < count; ++i)
+            assert(b->refs[i].addr == n++);
+        trace_stream_release(s);
+    }
+    assert(n == 10 * TRACE_BATCH + 7);
+    assert(SUCCEED == trace_stream_stop(s));
+
+    /* stopped early, with the decoder blocked on a full ring */
+    assert((s = trace_stream_start(trace_open(path))));
+    assert(trace_stream_next(s, &count));
+    usleep(10000);
+    assert(SUCCEED == trace_stream_stop(s));
+
+    write_file(path, "r 10\nbad\n");
+    assert((s = trace_stream_start(trace_open(path))));
+    while (trace_stream_next(s, &count))
+        trace_stream_release(s);
+    assert(FAIL == trace_stream_stop(s));
+    unlink(path);
+}
+
+#define TRACED      (10 * TRACE_BATCH + 7)
+
+/* a tracer: references 0.. in batches of 100, until the ring closes */
+static uint64_t tracer(tracering_t *t, uint64_t n)
+{
+    trace_ref_t *refs;
+    uint64_t i = 0;
+
+    while (i < n && (refs = tracering_batch(t))) {
+        uint32_t k;
+
+        for (k = 0; k < 100 && i < n; ++k) {
+            memset(&refs[k], 0, sizeof(refs[k]));
+            refs[k].addr = i++;
+        }
+        tracering_publish(t, k);
+    }
+    tracering_end(t);
+
+    return i;
+}
+
+static void *ring_reader(void *arg)
+{
+    trace_ref_t refs[333];
+    uint64_t *n = arg, i = 0;
+    char path[32];
+    trace_reader_t *r;
+    int got;
+
+    snprintf(path, sizeof(path), RING_PREFIX "%d", (int)*n);
+    assert((r = trace_open(path)));
+    while ((got = trace_read(r, refs, 333)) > 0)
+        for (int k = 0; k < got; ++k)
+            assert(refs[k].addr == i++);
+    assert(!got && trace_bytes(r) == i * sizeof(trace_ref_t));
+    trace_close(r);
+    *n = i;
+
+    return NULL;
+}
+
+static void test_tracering(void)
+{
+    char path[64], name[32];
+    const trace_batch_t *b;
+    trace_stream_t *s;
+    tracering_t *t;
+    uint64_t n = 0;
+    uint32_t count;
+    pthread_t tid;
+    pid_t pid;
+    int status;
+
+    /* a tracer in another process, attached by name, batches as they are */
+    snprintf(name, sizeof(name), "/test-trace-%d", (int)getpid());
+    snprintf(path, sizeof(path), RING_PREFIX "%s", name);
+    assert((s = trace_stream_start(trace_open(path))));
+    if (!(pid = fork())) {
+        assert((t = tracering_attach(name)));
+        _exit(tracer(t, TRACED) == TRACED ? 0 : 1);
+    }
+    while ((b = trace_stream_next(s, &count))) {
+        for (uint32_t i = 0; i < count; ++i)
+            assert(b->refs[i].addr == n++);
+        assert(b->bytes == n * sizeof(trace_ref_t));
+        trace_stream_release(s);
+    }
+    assert(n == TRACED && SUCCEED == trace_stream_stop(s));
+    assert(pid == waitpid(pid, &status, 0) && !WEXITSTATUS(status));
+    /* removed at the close */
+    assert(shm_open(name, O_RDWR, 0) < 0);
+
+    /* an inherited memfd, references copied out */
+    assert((t = tracering_create(NULL, 4)));
+    n = tracering_fd(t);
+    assert(!pthread_create(&tid, NULL, ring_reader, &n));
+    assert(tracer(t, TRACED) == TRACED);
+    pthread_join(tid, NULL);
+    assert(n == TRACED);
+    tracering_close(t);
+
+    /* the simulator stopping early stops the tracer */
+    assert((t = tracering_create(NULL, 4)));
+    snprintf(path, sizeof(path), RING_PREFIX "%d", tracering_fd(t));
+    assert((s = trace_stream_start(trace_open(path))));
+    assert(tracering_batch(t));
+    tracering_publish(t, 1);
+    assert(trace_stream_next(s, &count));
+    assert(SUCCEED == trace_stream_stop(s));
+    assert(tracer(t, TRACED) < TRACED);
+    tracering_close(t);
+
+    /* a batch of more references than it holds is a corrupt ring */
+    for (int direct = 0; direct < 2; ++direct) {
+        trace_ref_t refs[1];
+        trace_reader_t *r;
+
+        assert((t = tracering_create(NULL, 4)));
+        snprintf(path, sizeof(path), RING_PREFIX "%d", tracering_fd(t));
+        assert((r = trace_open(path)));
+        assert(tracering_batch(t));
+        tracering_publish(t, TRACE_BATCH + 1);
+        if (direct) {
+            assert((s = trace_stream_start(r)));
+            assert(!trace_stream_next(s, &count));
+            assert(FAIL == trace_stream_stop(s));
+        } else {
+            assert(trace_read(r, refs, 1) < 0);
+            trace_close(r);
+        }
+        tracering_close(t);
+    }
+
+    /* a count rewritten after the publish goes unseen by either reader */
+    for (int direct = 0; direct < 2; ++direct) {
+        trace_ref_t refs[2 * TRACE_BATCH];
+        trace_batch_t *batch;
+        trace_reader_t *r;
+
+        assert((t = tracering_create(NULL, 4)));
+        snprintf(path, sizeof(path), RING_PREFIX "%d", tracering_fd(t));
+        assert((r = trace_open(path)));
+        batch = (trace_batch_t *)((char *)tracering_batch(t) -
+                                  offsetof(trace_batch_t, refs));
+        tracering_publish(t, 5);
+        if (direct) {
+            assert((s = trace_stream_start(r)));
+            assert((b = trace_stream_next(s, &count)) && count == 5);
+            /* the same batch, mapped twice */
+            batch->n = 2 * TRACE_BATCH;
+            assert(b->n == 2 * TRACE_BATCH && count == 5);
+            trace_stream_release(s);
+            tracering_end(t);
+            assert(!trace_stream_next(s, &count));
+            assert(SUCCEED == trace_stream_stop(s));
+        } else {
+            assert(trace_read(r, refs, 2) == 2);
+            batch->n = 2 * TRACE_BATCH;
+            tracering_end(t);
+            assert(trace_read(r, refs, 2 * TRACE_BATCH) == 3);
+            assert(!trace_read(r, refs, 2 * TRACE_BATCH));
+            trace_close(r);
+        }
+        tracering_close(t);
+    }
+}
+
+static cache_t *level(struct list_head *caches, int l, unsigned int sets,
+                      unsigned int ways, cache_hierarchy_policy_t hp,
+                      cache_conservative_policy_t cp)
+{
+    cache_t *c = calloc(1, sizeof(cache_t));
+
+    assert(c);
+    c->t_cache = DCache;
+    c->l_cache = L1 + l;
+    c->hp_cache = hp;
+    c->cp_cache = cp;
+    c->sets = sets;
+    c->ways = ways;
+    c->linesize = 64;
+    fastmod_init(&c->set_index, sets);
+    c->tags = calloc(sets * ways, sizeof(uint64_t));
+    c->repl = calloc(sets * ways, sizeof(uint32_t));
+    list_add_tail(&c->list, caches);
+
+    return c;
+}
+
+static void release(struct list_head *caches)
+{
+    cache_t *c, *next;
+
+    list_for_each_entry_safe(c, next, caches, list) {
+        list_del(&c->list);
+        free(c->tags);
+        free(c->repl);
+        free(c);
+    }
+}
+
+static void test_policies(void)
+{
+    struct list_head caches;
+    sim_t *sim;
+
+    /* one set of 2 ways: a b a c, LRU keeps a, FIFO evicts it */
+    INIT_LIST_HEAD(&caches);
+    level(&caches, 0, 1, 2, H_non_exclusive, CP_lru);
+    assert((sim = sim_create(&caches)));
+    assert(1 == sim_access(sim, 0, TRACE_read));
+    assert(1 == sim_access(sim, 1, TRACE_read));
+    assert(0 == sim_access(sim, 0, TRACE_read));
+    assert(1 == sim_access(sim, 2, TRACE_read));
+    assert(0 == sim_access(sim, 0, TRACE_read));
+    assert(1 == sim_access(sim, 1, TRACE_read));
+    sim_destroy(sim);
+    list_first_entry(&caches, cache_t, list)->cp_cache = CP_fifo;
+    assert((sim = sim_create(&caches)));
+    sim_access(sim, 0, TRACE_read);
+    sim_access(sim, 1, TRACE_read);
+    sim_access(sim, 0, TRACE_read);
+    sim_access(sim, 2, TRACE_read);
+    assert(1 == sim_access(sim, 0, TRACE_read));
+    sim_destroy(sim);
+    release(&caches);
+
+    /* an inclusive L2 of one way takes its line out of L1 */
+    INIT_LIST_HEAD(&caches);
+    level(&caches, 0, 1, 2, H_non_exclusive, CP_lru);
+    level(&caches, 1, 1, 1, H_inclusive, CP_lru);
+    assert((sim = sim_create(&caches)));
+    sim_access(sim, 0, TRACE_read);
+    sim_access(sim, 1, TRACE_read);
+    assert(2 == sim_access(sim, 0, TRACE_read));
+    sim_destroy(sim);
+    release(&caches);
+
+    /* an exclusive L2 holds the L1 victims, a hit there moves up */
+    INIT_LIST_HEAD(&caches);
+    level(&caches, 0, 1, 1, H_non_exclusive, CP_lru);
+    level(&caches, 1, 1, 2, H_exclusive, CP_lru);
+    assert((sim = sim_create(&caches)));
+    sim_access(sim, 0, TRACE_read);
+    sim_access(sim, 1, TRACE_read);
+    assert(1 == sim_access(sim, 0, TRACE_read));
+    assert(1 == sim_access(sim, 1, TRACE_read));
+    assert(0 == sim_access(sim, 1, TRACE_read));
+    assert(sim->memory == 2);
+    sim_destroy(sim);
+    release(&caches);
+}
+
+static void test_run(void)
+{
+    char path[] = "/tmp/test-trace-XXXXXX";
+    struct list_head caches;
+    perf_profile_t prof;
+    cache_t *l1;
+    sim_t *sim;
+    int fd = mkstemp(path);
+
+    assert(fd >= 0);
+    close(fd);
+    /* the last one straddles two lines, the fetch is no data */
+    write_file(path, "r 0\nw 8 8\ni 1000 4\nr 3c 8\n");
+    INIT_LIST_HEAD(&caches);
+    l1 = level(&caches, 0, 4, 2, H_non_exclusive, CP_lru);
+    assert((sim = sim_create(&caches)));
+    assert(SUCCEED == run(sim, path));
+    assert(sim->refs == 3);
+    assert(l1->statistical_hit == 2 && l1->statistical_miss == 2);
+    assert(FAIL == run(sim, "/nonexistent/trace"));
+    sim_destroy(sim);
+
+    /* the first reference only warms the caches up */
+    assert((sim = sim_create(&caches)));
+    perf_profile_start(&prof, PERF_build);
+    sim->warmup = 1;
+    sim->prof = &prof;
+    assert(SUCCEED == run(sim, path));
+    perf_profile_stop(&prof);
+    assert(sim->refs == 2);
+    assert(l1->statistical_hit == 2 && l1->statistical_miss == 1);
+    assert(prof.refs[PERF_warmup] == 1 && prof.refs[PERF_simulate] == 2 &&
+           prof.refs[PERF_decode] == 3);
+    assert(prof.seen[PERF_build] && prof.seen[PERF_decode] &&
+           prof.seen[PERF_warmup] && prof.seen[PERF_simulate] &&
+           !prof.seen[PERF_config]);
+    perf_profile_report(&prof, stdout);
+    sim_destroy(sim);
+    release(&caches);
+    unlink(path);
+}
+
+static void test_stats(void)
+{
+    char path[] = "/tmp/test-stats-XXXXXX", text[1024];
+    const char *names[] = {"L1", "L2"};
+    const unsigned int sets[] = {1, 1};
+    struct list_head caches;
+    stats_shard_t *sh;
+    stats_t *s;
+    sim_t *sim;
+    size_t n;
+    FILE *f;
+    int fd = mkstemp(path);
+
+    assert(fd >= 0);
+    close(fd);
+    INIT_LIST_HEAD(&caches);
+    level(&caches, 0, 1, 1, H_non_exclusive, CP_lru);
+    level(&caches, 1, 1, 2, H_non_exclusive, CP_lru);
+    assert((sim = sim_create(&caches)));
+    assert(!stats_create(2, sets, 1, 1000));
+    assert((s = stats_create(2, sets, 1, 4096)));
+    assert(SUCCEED == sim_stats(sim, s, 0));
+    sh = &s->shards[0];
+
+    /*
+     * the dirty line 0 goes back to L2 when 1 takes L1, then to memory
+     * when 2 takes the LRU way of L2
+     */
+    stats_ref(s, sh, 0x400);
+    sim_access(sim, 0, TRACE_write);
+    sim_access(sim, 1, TRACE_read);
+    sim_access(sim, 2, TRACE_read);
+    assert(sim->writebacks == 1);
+    assert(stats_set(sh, 0, 0)->misses == 3 &&
+           stats_set(sh, 0, 0)->evictions == 2 &&
+           stats_set(sh, 0, 0)->writebacks == 1);
+    assert(stats_set(sh, 1, 0)->misses == 3 &&
+           stats_set(sh, 1, 0)->evictions == 1 &&
+           stats_set(sh, 1, 0)->writebacks == 1);
+    assert(sh->pc_cur->misses == 3 && sh->pc_cur->evictions == 3 &&
+           sh->pc_cur->writebacks == 2);
+    assert(stats_region(sh)->misses == 3);
+
+    /* a hit in L1 counts for the instruction and the region */
+    stats_ref(s, sh, 0x404);
+    assert(0 == sim_access(sim, 2, TRACE_read));
+    assert(sh->pc_cur->hits == 1 && sh->pc_cur->misses == 0);
+    assert(stats_region(sh)->hits == 1);
+
+    stats_merge(s);
+    assert(SUCCEED == stats_export(s, names, path, stdout));
+    assert((f = fopen(path, "r")));
+    n = fread(text, 1, sizeof(text) - 1, f);
+    text[n] = 0;
+    fclose(f);
+    assert(strstr(text, "set L1:0 1 3 2 1\n"));
+    assert(strstr(text, "set L2:0 0 3 1 1\n"));
+    assert(strstr(text, "pc 0x400 0 3 3 2\n"));
+    assert(strstr(text, "pc 0x404 1 0 0 0\n"));
+    assert(strstr(text, "region 0x0 1 3 3 2\n"));
+    assert(FAIL == stats_export(s, names, "/nonexistent/stats", stdout));
+
+    stats_reset(s);
+    assert(!stats_set(sh, 0, 0)->misses && !sh->pc_cur->hits);
+    sim_destroy(sim);
+    stats_destroy(s);
+    release(&caches);
+    unlink(path);
+}
+
+static void test_gen(void)
+{
+    static trace_ref_t a[TRACE_BATCH], b[TRACE_BATCH];
+    const uint64_t matmul[] = {
+        0x40, 0x0, 0x20, 0x8, 0x30, 0x40,       /* C00 = A0. * B.0 */
+        0x48, 0x0, 0x28, 0x8, 0x38, 0x48,       /* C01 = A0. * B.1 */
+    };
+    uint64_t base = (uint64_t)1 << 40, zero = 0, cpu1 = 0;
+    trace_reader_t *r;
+    gen_spec_t spec;
+    gen_t *g, *h;
+    int n;
+
+    /* a[i * 3 % 4] */
+    assert((g = gen_parse("refs=6;strided,n=4,stride=3,base=0x1000")));
+    assert(6 == gen_next(g, a, TRACE_BATCH));
+    assert(a[0].addr == 0x1000 && a[1].addr == 0x1018 &&
+           a[2].addr == 0x1010 && a[3].addr == 0x1008 &&
+           a[4].addr == 0x1000 && a[0].size == 8 && a[0].pc == 0x400000);
+    assert(0 == gen_next(g, a, TRACE_BATCH));
+    gen_destroy(g);
+
+    /* 2 x 2 matrices in one tile, A, B and C one after the other */
+    gen_spec_init(&spec, GEN_matmul, 0);
+    spec.n = 2;
+    spec.base = 0;
+    assert((g = gen_create(&spec, 1, 1, 12)));
+    assert(12 == gen_next(g, a, TRACE_BATCH));
+    for (int i = 0; i < 12; ++i)
+        assert(a[i].addr == matmul[i] &&
+               a[i].op == (i % 6 == 5 ? TRACE_write : TRACE_read));
+    gen_destroy(g);
+
+    /* the same seed gives the same trace, another one does not */
+    assert((g = gen_parse("seed=7;zipf,n=1000;hash,n=64K,writes=100")));
+    assert((h = gen_parse("seed=7;zipf,n=1000;hash,n=64K,writes=100")));
+    assert(TRACE_BATCH == gen_next(g, a, TRACE_BATCH));
+    assert(TRACE_BATCH == gen_next(h, b, TRACE_BATCH));
+    assert(!memcmp(a, b, sizeof(a)));
+    gen_destroy(h);
+    assert((h = gen_parse("seed=8;zipf,n=1000;hash,n=64K,writes=100")));
+    gen_next(h, b, TRACE_BATCH);
+    assert(memcmp(a, b, sizeof(a)));
+    gen_destroy(h);
+    gen_destroy(g);
+
+    /* key 0 takes about 1 / H(1000, 0.99), 13%, of the lookups */
+    assert((g = gen_parse("refs=100K;zipf,n=1000,base=0")));
+    while ((n = gen_next(g, a, TRACE_BATCH)))
+        for (int i = 0; i < n; ++i)
+            zero += !a[i].addr;
+    assert(zero > 10000 && zero < 17000);
+    gen_destroy(g);
+
+    /* one in four references from the second stream */
+    assert((g = gen_parse("refs=100K;strided;hash,probes=1,cpu=1,weight=3,"
+                          "writes=100")));
+    while ((n = gen_next(g, a, TRACE_BATCH))) {
+        for (int i = 0; i < n; ++i) {
+            cpu1 += a[i].cpu;
+            assert(a[i].cpu ? a[i].op == TRACE_write && a[i].addr >= 2 * base :
+                   a[i].op == TRACE_read && a[i].addr < 2 * base);
+        }
+    }
+    assert(cpu1 > 73000 && cpu1 < 77000);
+    gen_destroy(g);
+
+    assert(!gen_parse("stencil,n=2"));
+    assert(!gen_parse("zipf,q=1"));
+    assert(!gen_parse("refs=1;walk"));
+    assert((r = trace_open("gen:refs=3000;stencil,n=100")));
+    assert(TRACE_BATCH == trace_read(r, a, TRACE_BATCH));
+    assert(a[5].op == TRACE_write && a[6].addr == a[0].addr + 8);
+    assert(3000 - TRACE_BATCH == trace_read(r, a, TRACE_BATCH) +
+           trace_read(r, a, TRACE_BATCH));
+    assert(0 == trace_read(r, a, TRACE_BATCH));
+    trace_close(r);
+}
+
+static void test_progress(void)
+{
+    char path[] = "/tmp/test-progress-XXXXXX", text[PROGRESS_PAGE + 1];
+    struct list_head caches;
+    progress_t *p;
+    sim_t *sim;
+    FILE *f;
+    int fd = mkstemp(path);
+
+    assert(fd >= 0);
+    close(fd);
+    assert(!progress_start(0, 1, 1000, NULL));
+    assert(!progress_start(1, 1, 1000, "/nonexistent/page"));
+
+    /* two sources summed, a line to out without a page */
+    assert((p = progress_start(2, 2, 1000, NULL)));
+    progress_refs(p, 0, 1500);
+    progress_refs(p, 1, 500);
+    progress_level(p, 0, 0, 30, 10);
+    progress_level(p, 1, 0, 50, 10);
+    progress_bytes(p, 1024);
+    progress_size(p, 4096);
+    assert((f = tmpfile()));
+    progress_sample(p, 0, f);
+    rewind(f);
+    assert(fgets(text, sizeof(text), f));
+    assert(strstr(text, " 2.0K refs,") && strstr(text, " L1 80.0% L2 0.0%") &&
+           strstr(text, "1.0KB of 4.0KB read"));
+    fclose(f);
+    progress_stop(p);
+
+    /* run() publishes into the page, done once stopped */
+    INIT_LIST_HEAD(&caches);
+    level(&caches, 0, 4, 2, H_non_exclusive, CP_lru);
+    assert((sim = sim_create(&caches)));
+    assert((sim->progress = progress_start(1, 1, 10, path)));
+    assert(SUCCEED == run(sim, "gen:refs=5000;strided,n=64,elem=64"));
+    progress_stop(sim->progress);
+    assert((f = fopen(path, "r")));
+    text[fread(text, 1, PROGRESS_PAGE, f)] = 0;
+    fclose(f);
+    assert(strstr(text, "refs 5000\n") &&
+           strstr(text, "bytes 120000\nsize 120000\n") &&
+           strstr(text, "L1 0.0000\n") && strstr(text, "done 1\n"));
+    sim_destroy(sim);
+    release(&caches);
+    unlink(path);
+}
+
+static void test_series(void)
+{
+    char path[] = "/tmp/test-series-XXXXXX", line[128];
+    struct list_head caches;
+    series_source_t *a, *b;
+    series_record_t rec;
+    cache_t *l1, *l2, *both[2];
+    uint32_t head[2];
+    series_t *s;
+    sim_t *sim;
+    FILE *f;
+    int fd = mkstemp(path), n = 0;
+
+    assert(fd >= 0);
+    close(fd);
+    assert(!series_open(path, 0, 0));
+    assert(!series_open("/nonexistent/series", 0, 1000));
+
+    /* 64 lines in a row: L1 of 8 always misses, L2 of 64 keeps them */
+    INIT_LIST_HEAD(&caches);
+    l1 = level(&caches, 0, 4, 2, H_non_exclusive, CP_lru);
+    l2 = level(&caches, 1, 16, 4, H_non_exclusive, CP_lru);
+    assert((sim = sim_create(&caches)));
+    assert((s = series_open(path, 0, 1000)));
+    assert(SUCCEED == sim_series(sim, s, 3));
+    /* the warm-up ends with a shorter interval, refs go on */
+    sim->warmup = 1500;
+    assert(SUCCEED == run(sim, "gen:refs=5000;strided,n=64,elem=64"));
+    sim_destroy(sim);
+    assert(SUCCEED == series_close(s));
+    assert(l1->statistical_evict == 3500 && !l2->statistical_evict);
+    assert((f = fopen(path, "r")));
+    assert(fgets(line, sizeof(line), f) &&
+           !strcmp(line, "config,source,interval,refs,level,hits,misses,"
+                   "evictions\n"));
+    while (fgets(line, sizeof(line), f)) {
+        if (n == 0)
+            assert(!strcmp(line, "3,0,0,1000,1,0,1000,992\n"));
+        if (n == 1)
+            assert(!strcmp(line, "3,0,0,1000,2,936,64,0\n"));
+        if (n == 2)
+            assert(!strcmp(line, "3,0,1,1500,1,0,500,500\n"));
+        if (n == 5)
+            assert(!strcmp(line, "3,0,2,2500,2,1000,0,0\n"));
+        if (n == 10)
+            assert(!strcmp(line, "3,0,5,5000,1,0,500,500\n"));
+        n++;
+    }
+    assert(n == 12);
+    fclose(f);
+
+    /* binary, two sources through more records than the blocks hold */
+    l1->statistical_hit = l1->statistical_miss = 0;
+    l2->statistical_hit = l2->statistical_miss = 0;
+    assert((s = series_open(path, 1, 1)));
+    assert((a = series_source(s, 0, 0, 1)) && (b = series_source(s, 0, 1, 2)));
+    both[0] = l1;
+    both[1] = l2;
+    for (uint64_t i = 1; i <= SERIES_BLOCKS * SERIES_BLOCK; ++i) {
+        l1->statistical_hit++;
+        l2->statistical_miss += 2;
+        assert(series_due(a, i) && series_due(b, i));
+        series_sample(a, i, &l1);
+        series_sample(b, i, both);
+    }
+    series_flush(a, SERIES_BLOCKS * SERIES_BLOCK, &l1);
+    series_source_destroy(a);
+    series_source_destroy(b);
+    assert(SUCCEED == series_close(s));
+    assert((f = fopen(path, "rb")));
+    assert(fread(line, 8, 1, f) == 1 && !memcmp(line, SERIES_MAGIC, 8));
+    assert(fread(head, sizeof(head), 1, f) == 1 &&
+           head[0] == SERIES_VERSION && head[1] == sizeof(series_record_t));
+    for (n = 0; fread(&rec, sizeof(rec), 1, f) == 1; ++n) {
+        assert(rec.refs == rec.interval + 1);
+        if (rec.source == 0)
+            assert(rec.level == 1 && rec.hits == 1 && !rec.misses);
+        if (rec.source == 1 && rec.level == 2)
+            assert(rec.misses == 2);
+    }
+    assert(n == 3 * SERIES_BLOCKS * SERIES_BLOCK);
+    fclose(f);
+    release(&caches);
+    unlink(path);
+}
+
+int main(void)
+{
+    test_ring();
+    test_formats();
+    test_stream();
+    test_tracering();
+    test_policies();
+    test_run();
+    test_stats();
+    test_gen();
+    test_progress();
+    test_series();
+    puts("test-trace passed");
+
+    return 0;
+}
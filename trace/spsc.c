@@ -0,0 +1,232 @@
+/*
+ * @file spsc.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Single producer / single consumer ring, see spsc.h.
+ *
+ * A side that has to wait spins SPSC_SPINS rounds, then parks on the
+ * sequence word of its side. Lost wake ups are ruled out Dekker style:
+ * the waiter raises its wait flag and re-checks the index after a full
+ * fence, the other side moves the index and reads the flag after a full
+ * fence, so at least one of them sees the other. The futex wait itself
+ * fails when the sequence moved since the waiter read it.
+ */
+
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "spsc.h"
+
+#define SPSC_SPINS          1024
+
+#define SPSC_ALIGNED        __attribute__ ((aligned(SPSC_CACHELINE)))
+
+struct spsc {
+    /* written by the producer */
+    uint64_t head SPSC_ALIGNED;
+    uint64_t tail_cache;        /* last tail seen */
+    uint64_t producer_parks;
+
+    /* written by the consumer */
+    uint64_t tail SPSC_ALIGNED;
+    uint64_t head_cache;        /* last head seen */
+    uint64_t consumer_parks;
+
+    /* the producer parks on pseq, the consumer on cseq */
+    uint32_t pseq SPSC_ALIGNED;
+    uint32_t pwait;
+    uint32_t cseq SPSC_ALIGNED;
+    uint32_t cwait;
+
+    /* set once */
+    uint32_t closed SPSC_ALIGNED;
+    uint32_t nslots;
+    uint64_t slot_size;
+    int futex_op_private;
+    int owned;
+    char slots[] SPSC_ALIGNED;
+};
+
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+static inline uint64_t slot_bytes(size_t slot_size)
+{
+    return (slot_size + SPSC_CACHELINE - 1) & ~(uint64_t)(SPSC_CACHELINE - 1);
+}
+
+static inline void *slot(spsc_t *q, uint64_t i)
+{
+    return q->slots + (i & (q->nslots - 1)) * q->slot_size;
+}
+
+size_t spsc_size(unsigned int nslots, size_t slot_size)
+{
+    return sizeof(spsc_t) + nslots * slot_bytes(slot_size);
+}
+
+spsc_t *spsc_init(void *mem, unsigned int nslots, size_t slot_size,
+                  int shared)
+{
+    spsc_t *q = mem;
+
+    if (!nslots || (nslots & (nslots - 1)) ||
+        ((uintptr_t)mem & (SPSC_CACHELINE - 1)))
+        return NULL;
+
+    memset(q, 0, sizeof(spsc_t));
+    q->nslots = nslots;
+    q->slot_size = slot_bytes(slot_size);
+    q->futex_op_private = shared ? 0 : FUTEX_PRIVATE_FLAG;
+
+    return q;
+}
+
+spsc_t *spsc_create(unsigned int nslots, size_t slot_size)
+{
+    size_t size = spsc_size(nslots, slot_size);
+    void *mem;
+    spsc_t *q;
+
+    size = (size + SPSC_CACHELINE - 1) & ~(size_t)(SPSC_CACHELINE - 1);
+    if (!(mem = aligned_alloc(SPSC_CACHELINE, size)))
+        return NULL;
+    if (!(q = spsc_init(mem, nslots, slot_size, 0))) {
+        free(mem);
+        return NULL;
+    }
+    q->owned = 1;
+
+    return q;
+}
+
+void spsc_destroy(spsc_t *q)
+{
+    if (q && q->owned)
+        free(q);
+}
+
+static void futex_wait(spsc_t *q, uint32_t *seq, uint32_t val)
+{
+    syscall(SYS_futex, seq, FUTEX_WAIT | q->futex_op_private, val, NULL,
+            NULL, 0);
+}
+
+static void futex_wake(spsc_t *q, uint32_t *seq)
+{
+    syscall(SYS_futex, seq, FUTEX_WAKE | q->futex_op_private, INT_MAX, NULL,
+            NULL, 0);
+}
+
+static int producer_ready(spsc_t *q)
+{
+    q->tail_cache = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+
+    return q->head - q->tail_cache < q->nslots ||
+           __atomic_load_n(&q->closed, __ATOMIC_ACQUIRE);
+}
+
+static int consumer_ready(spsc_t *q)
+{
+    q->head_cache = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+
+    return q->head_cache != q->tail ||
+           __atomic_load_n(&q->closed, __ATOMIC_ACQUIRE);
+}
+
+static void wait_until(spsc_t *q, int (*ready)(spsc_t *), uint32_t *seq,
+                       uint32_t *wait, uint64_t *parks)
+{
+    for (int i = 0; i < SPSC_SPINS; ++i) {
+        if (ready(q))
+            return;
+        cpu_relax();
+    }
+
+    for (;;) {
+        uint32_t val = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+
+        __atomic_store_n(wait, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (ready(q))
+            break;
+        (*parks)++;
+        futex_wait(q, seq, val);
+    }
+    __atomic_store_n(wait, 0, __ATOMIC_RELAXED);
+}
+
+static void notify(spsc_t *q, uint32_t *seq, uint32_t *wait)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(wait, __ATOMIC_RELAXED)) {
+        __atomic_fetch_add(seq, 1, __ATOMIC_RELEASE);
+        futex_wake(q, seq);
+    }
+}
+
+void *spsc_acquire(spsc_t *q)
+{
+    if (q->head - q->tail_cache >= q->nslots)
+        wait_until(q, producer_ready, &q->pseq, &q->pwait,
+                   &q->producer_parks);
+    if (__atomic_load_n(&q->closed, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    return slot(q, q->head);
+}
+
+void spsc_publish(spsc_t *q)
+{
+    __atomic_store_n(&q->head, q->head + 1, __ATOMIC_RELEASE);
+    notify(q, &q->cseq, &q->cwait);
+}
+
+void *spsc_peek(spsc_t *q)
+{
+    if (q->tail == q->head_cache)
+        wait_until(q, consumer_ready, &q->cseq, &q->cwait,
+                   &q->consumer_parks);
+    /* closed: drain what was published before */
+    if (q->tail == q->head_cache)
+        q->head_cache = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+    if (q->tail == q->head_cache)
+        return NULL;
+
+    return slot(q, q->tail);
+}
+
+void spsc_release(spsc_t *q)
+{
+    __atomic_store_n(&q->tail, q->tail + 1, __ATOMIC_RELEASE);
+    notify(q, &q->pseq, &q->pwait);
+}
+
+void spsc_close(spsc_t *q)
+{
+    __atomic_store_n(&q->closed, 1, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&q->pseq, 1, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&q->cseq, 1, __ATOMIC_RELEASE);
+    futex_wake(q, &q->pseq);
+    futex_wake(q, &q->cseq);
+}
+
+void spsc_stats(const spsc_t *q, uint64_t *producer_parks,
+                uint64_t *consumer_parks)
+{
+    *producer_parks = q->producer_parks;
+    *consumer_parks = q->consumer_parks;
+}
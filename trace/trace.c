@@ -0,0 +1,364 @@
+/*
+ * @file trace.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Trace readers and the decoder thread of a trace stream.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "cfg.h"
+#include "spsc.h"
+#include "trace.h"
+#include "tracegen.h"
+#include "tracering.h"
+
+#define TRACE_VERSION       1
+#define TRACE_IO_BUFFER     (1 << 20)
+#define TRACE_LINE          256
+
+typedef struct trace_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+} trace_header_t;
+
+struct trace_reader {
+    FILE *f;
+    int binary;
+    char *buf;                  /* stdio buffer */
+    uint64_t bytes;
+    uint64_t size;              /* 0 if unknown */
+    uint64_t lineno;
+    gen_t *gen;                 /* a synthetic trace, no file */
+    tracering_t *ring;          /* a tracer's, no file */
+    const trace_batch_t *batch; /* of the ring, being read */
+    uint32_t count;             /* of batch, read once */
+    uint32_t next;              /* in batch */
+};
+
+struct trace_stream {
+    trace_reader_t *r;
+    spsc_t *q;
+    pthread_t tid;
+    int direct;                 /* the batches of a ring, no decoder */
+    int error;
+};
+
+trace_reader_t *trace_open(const char *path)
+{
+    trace_reader_t *r = calloc(1, sizeof(trace_reader_t));
+    trace_header_t h;
+    struct stat st;
+    int c;
+
+    if (!r)
+        return NULL;
+
+    if (!strncmp(path, GEN_PREFIX, strlen(GEN_PREFIX))) {
+        if (!(r->gen = gen_parse(path + strlen(GEN_PREFIX)))) {
+            free(r);
+            return NULL;
+        }
+        r->size = gen_refs(r->gen) * sizeof(trace_ref_t);
+        return r;
+    }
+    if (!strncmp(path, RING_PREFIX, strlen(RING_PREFIX))) {
+        path += strlen(RING_PREFIX);
+        r->ring = *path == '/' ? tracering_create(path, 0) :
+                  tracering_attach(path);
+        if (!r->ring) {
+            free(r);
+            return NULL;
+        }
+        return r;
+    }
+    r->f = strcmp(path, "-") ? fopen(path, "rb") : stdin;
+    if (!r->f) {
+        LOG_ERR("cannot open trace [%s]", path);
+        free(r);
+        return NULL;
+    }
+    if ((r->buf = malloc(TRACE_IO_BUFFER)))
+        setvbuf(r->f, r->buf, _IOFBF, TRACE_IO_BUFFER);
+    if (!fstat(fileno(r->f), &st) && S_ISREG(st.st_mode))
+        r->size = st.st_size;
+
+    /* no text line starts with the 'C' of the magic */
+    c = getc(r->f);
+    if (c == TRACE_MAGIC[0]) {
+        h.magic[0] = c;
+        if (1 != fread(h.magic + 1, sizeof(h) - 1, 1, r->f) ||
+            memcmp(h.magic, TRACE_MAGIC, sizeof(h.magic)) ||
+            h.version != TRACE_VERSION ||
+            h.record_size != sizeof(trace_ref_t)) {
+            LOG_ERR("[%s] is no trace of version %d", path, TRACE_VERSION);
+            trace_close(r);
+            return NULL;
+        }
+        r->binary = 1;
+        r->bytes = sizeof(h);
+    } else if (c != EOF) {
+        ungetc(c, r->f);
+    }
+
+    return r;
+}
+
+void trace_close(trace_reader_t *r)
+{
+    if (!r)
+        return;
+
+    if (r->f && r->f != stdin)
+        fclose(r->f);
+    gen_destroy(r->gen);
+    /* a tracer still going stops at its next batch */
+    if (r->ring)
+        spsc_close(tracering_queue(r->ring));
+    tracering_close(r->ring);
+    free(r->buf);
+    free(r);
+}
+
+uint64_t trace_bytes(const trace_reader_t *r)
+{
+    return r->bytes;
+}
+
+uint64_t trace_size(const trace_reader_t *r)
+{
+    return r->size;
+}
+
+static int parse_hex(char **p, uint64_t *v)
+{
+    char *end;
+
+    while (**p == ' ' || **p == '\t' || **p == ',')
+        (*p)++;
+    *v = strtoull(*p, &end, 16);
+    if (end == *p)
+        return FAIL;
+    *p = end;
+
+    return SUCCEED;
+}
+
+/* return 1 for a reference, 0 for a blank or comment line, -1 if bad */
+static int parse_line(char *line, trace_ref_t *ref)
+{
+    char *p = line + strspn(line, " \t");
+    uint64_t v;
+
+    memset(ref, 0, sizeof(*ref));
+    switch (*p++) {
+    case 'r': case 'R': case '0':
+        ref->op = TRACE_read;
+        break;
+    case 'w': case 'W': case '1':
+        ref->op = TRACE_write;
+        break;
+    case 'i': case 'I': case '2':
+        ref->op = TRACE_ifetch;
+        break;
+    case '#': case '\n': case '\r': case '\0':
+        return 0;
+    default:
+        return -1;
+    }
+    if (*p != ' ' && *p != '\t')
+        return -1;
+
+    if (SUCCEED != parse_hex(&p, &ref->addr))
+        return -1;
+    ref->size = 1;
+    if (SUCCEED == parse_hex(&p, &v))
+        ref->size = v ? v : 1;
+    if (SUCCEED == parse_hex(&p, &v))
+        ref->pc = v;
+    if (SUCCEED == parse_hex(&p, &v))
+        ref->cpu = v;
+
+    return 1;
+}
+
+/* the references of the batches of a ring, copied out */
+static int ring_read(trace_reader_t *r, trace_ref_t *refs, int n)
+{
+    spsc_t *q = tracering_queue(r->ring);
+    int got = 0, take;
+
+    while (got < n) {
+        if (!r->batch) {
+            if (!(r->batch = spsc_peek(q)))
+                break;
+            /* written by another process, trust no second look */
+            r->count = __atomic_load_n(&r->batch->n, __ATOMIC_RELAXED);
+            if (r->count > TRACE_BATCH) {
+                LOG_ERR("corrupt trace ring, a batch of %u references",
+                        r->count);
+                return -1;
+            }
+        }
+        take = r->count - r->next;
+        if (take > n - got)
+            take = n - got;
+        memcpy(refs + got, r->batch->refs + r->next,
+               take * sizeof(trace_ref_t));
+        got += take;
+        r->next += take;
+        r->bytes = r->batch->bytes - (uint64_t)(r->count - r->next) *
+                   sizeof(trace_ref_t);
+        if (r->next == r->count) {
+            r->batch = NULL;
+            r->next = 0;
+            spsc_release(q);
+        }
+    }
+
+    return got;
+}
+
+int trace_read(trace_reader_t *r, trace_ref_t *refs, int n)
+{
+    char line[TRACE_LINE];
+    int got = 0, ret;
+
+    if (r->ring)
+        return ring_read(r, refs, n);
+    if (r->gen) {
+        got = gen_next(r->gen, refs, n);
+        r->bytes += (uint64_t)got * sizeof(trace_ref_t);
+        return got;
+    }
+    if (r->binary) {
+        got = fread(refs, sizeof(trace_ref_t), n, r->f);
+        r->bytes += (uint64_t)got * sizeof(trace_ref_t);
+        if (got < n && ferror(r->f))
+            return -1;
+        return got;
+    }
+
+    while (got < n && fgets(line, sizeof(line), r->f)) {
+        r->bytes += strlen(line);
+        r->lineno++;
+        if ((ret = parse_line(line, &refs[got])) < 0) {
+            LOG_ERR("malformed trace line %llu",
+                    (unsigned long long)r->lineno);
+            return -1;
+        }
+        got += ret;
+    }
+
+    return got;
+}
+
+int trace_write_header(FILE *f)
+{
+    trace_header_t h = {
+        .version = TRACE_VERSION,
+        .record_size = sizeof(trace_ref_t),
+    };
+
+    memcpy(h.magic, TRACE_MAGIC, sizeof(h.magic));
+
+    return 1 == fwrite(&h, sizeof(h), 1, f) ? SUCCEED : FAIL;
+}
+
+int trace_write(FILE *f, const trace_ref_t *refs, int n)
+{
+    return (size_t)n == fwrite(refs, sizeof(trace_ref_t), n, f) ?
+           SUCCEED : FAIL;
+}
+
+static void *decoder(void *arg)
+{
+    trace_stream_t *s = arg;
+    trace_batch_t *b;
+    int n;
+
+    while ((b = spsc_acquire(s->q))) {
+        n = trace_read(s->r, b->refs, TRACE_BATCH);
+        if (n <= 0) {
+            s->error = n < 0;
+            break;
+        }
+        b->n = n;
+        b->bytes = trace_bytes(s->r);
+        spsc_publish(s->q);
+    }
+    spsc_close(s->q);
+
+    return NULL;
+}
+
+trace_stream_t *trace_stream_start(trace_reader_t *r)
+{
+    trace_stream_t *s = calloc(1, sizeof(trace_stream_t));
+
+    if (!s)
+        return NULL;
+
+    s->r = r;
+    /* the tracer fills the batches, nothing to decode */
+    if (r->ring && !r->batch) {
+        s->q = tracering_queue(r->ring);
+        s->direct = 1;
+        return s;
+    }
+    s->q = spsc_create(TRACE_RING_SLOTS, sizeof(trace_batch_t));
+    if (!s->q || pthread_create(&s->tid, NULL, decoder, s)) {
+        spsc_destroy(s->q);
+        free(s);
+        return NULL;
+    }
+
+    return s;
+}
+
+const trace_batch_t *trace_stream_next(trace_stream_t *s, uint32_t *n)
+{
+    const trace_batch_t *b = spsc_peek(s->q);
+
+    if (!b)
+        return NULL;
+    /* straight from the tracer if direct, as ring_read() checks it */
+    *n = __atomic_load_n(&b->n, __ATOMIC_RELAXED);
+    if (*n > TRACE_BATCH) {
+        LOG_ERR("corrupt trace ring, a batch of %u references", *n);
+        s->error = 1;
+        return NULL;
+    }
+
+    return b;
+}
+
+void trace_stream_release(trace_stream_t *s)
+{
+    spsc_release(s->q);
+}
+
+int trace_stream_stop(trace_stream_t *s)
+{
+    int ret;
+
+    /* wakes a decoder blocked on a full ring */
+    spsc_close(s->q);
+    if (!s->direct) {
+        pthread_join(s->tid, NULL);
+        spsc_destroy(s->q);
+    }
+    ret = s->error ? FAIL : SUCCEED;
+    trace_close(s->r);
+    free(s);
+
+    return ret;
+}
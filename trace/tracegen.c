@@ -0,0 +1,537 @@
+/*
+ * @file tracegen.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Synthetic traces, see tracegen.h.
+ *
+ * Every stream is a small state machine walking the loops of its
+ * pattern, one reference per call, so a generator takes constant memory
+ * whatever its length. Zipf ranks come from rejection-inversion sampling
+ * (Hoermann and Derflinger, 1996), in constant memory and time too.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "str.h"
+#include "cfg.h"
+#include "tracegen.h"
+
+#define GEN_SPEC_LEN        1024
+#define GEN_SCATTER         2654435761ULL       /* a prime */
+
+typedef struct stream {
+    gen_spec_t spec;
+    uint64_t rng;
+    /* loop indices of the pattern */
+    uint64_t i, j, k;
+    uint64_t ii, jj, kk;
+    int step;
+    uint64_t sweep;
+    uint32_t left;                      /* hash, probes of the lookup */
+    int store;
+    /* zipf sampler */
+    double h_x1, h_n, zs;
+} stream_t;
+
+struct gen {
+    int nstreams;
+    stream_t streams[GEN_MAX_STREAMS];
+    uint64_t weights;
+    uint64_t rng;
+    uint64_t refs;
+    uint64_t left;
+};
+
+static const char *pattern_names[GEN_PATTERNS] = {
+    "strided", "stencil", "matmul", "hash", "zipf",
+};
+
+/* splitmix64, the seed of every PRNG and the hash of the keys */
+static uint64_t mix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+
+    return x ^ (x >> 31);
+}
+
+static inline uint64_t xorshift(uint64_t *x)
+{
+    *x ^= *x << 13;
+    *x ^= *x >> 7;
+    *x ^= *x << 17;
+
+    return *x;
+}
+
+static inline double uniform(uint64_t *x)
+{
+    return (xorshift(x) >> 11) * 0x1.0p-53;
+}
+
+static inline int store(stream_t *st)
+{
+    return st->spec.writes && xorshift(&st->rng) % 100 < st->spec.writes;
+}
+
+/* log1p(x) / x and expm1(x) / x, exact near 0 */
+static double helper1(double x)
+{
+    return fabs(x) > 1e-8 ? log1p(x) / x :
+           1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+}
+
+static double helper2(double x)
+{
+    return fabs(x) > 1e-8 ? expm1(x) / x :
+           1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+}
+
+/* the integral of 1 / x^s, its integrand and its inverse */
+static double h_integral(double s, double x)
+{
+    double lx = log(x);
+
+    return helper2((1.0 - s) * lx) * lx;
+}
+
+static double h(double s, double x)
+{
+    return exp(-s * log(x));
+}
+
+static double h_integral_inverse(double s, double x)
+{
+    double t = x * (1.0 - s);
+
+    return exp(helper1(t < -1.0 ? -1.0 : t) * x);
+}
+
+static void zipf_init(stream_t *st)
+{
+    double s = st->spec.s;
+
+    st->h_x1 = h_integral(s, 1.5) - 1.0;
+    st->h_n = h_integral(s, st->spec.n + 0.5);
+    st->zs = 2.0 - h_integral_inverse(s, h_integral(s, 2.5) - h(s, 2.0));
+}
+
+/* a rank from 1 to n */
+static uint64_t zipf_rank(stream_t *st)
+{
+    double s = st->spec.s;
+
+    for (;;) {
+        double u = st->h_n + uniform(&st->rng) * (st->h_x1 - st->h_n);
+        double x = h_integral_inverse(s, u);
+        uint64_t k = x + 0.5;
+
+        if (k < 1)
+            k = 1;
+        else if (k > st->spec.n)
+            k = st->spec.n;
+        if (k - x <= st->zs || u >= h_integral(s, k + 0.5) - h(s, k))
+            return k;
+    }
+}
+
+static void next_strided(stream_t *st, trace_ref_t *ref)
+{
+    const gen_spec_t *sp = &st->spec;
+
+    ref->addr = sp->base + st->i * sp->elem;
+    ref->op = store(st) ? TRACE_write : TRACE_read;
+    st->i = (st->i + sp->stride) % sp->n;
+}
+
+/* the center and its four neighbours in the source, then the target */
+static void next_stencil(stream_t *st, trace_ref_t *ref)
+{
+    static const int dy[] = { 0, -1, 1, 0, 0 }, dx[] = { 0, 0, 0, -1, 1 };
+    const gen_spec_t *sp = &st->spec;
+    uint64_t grid = sp->n * sp->n * sp->elem;
+    uint64_t src = sp->base + (st->sweep & 1) * grid;
+    uint64_t dst = sp->base + !(st->sweep & 1) * grid;
+
+    ref->pc += st->step * 4;
+    if (st->step < 5) {
+        ref->addr = src + ((st->i + dy[st->step]) * sp->n +
+                           st->j + dx[st->step]) * sp->elem;
+        ref->op = TRACE_read;
+        st->step++;
+        return;
+    }
+    ref->addr = dst + (st->i * sp->n + st->j) * sp->elem;
+    ref->op = TRACE_write;
+    st->step = 0;
+    if (++st->j < sp->n - 1)
+        return;
+    st->j = 1;
+    if (++st->i < sp->n - 1)
+        return;
+    st->i = 1;
+    st->sweep++;
+}
+
+/* C[i][j] in, A[i][k] and B[k][j] for k in the tile, C[i][j] out */
+static void next_matmul(stream_t *st, trace_ref_t *ref)
+{
+    const gen_spec_t *sp = &st->spec;
+    uint64_t n = sp->n, t = sp->tile, size = n * n * sp->elem;
+    uint64_t a = sp->base, b = a + size, c = b + size;
+    uint64_t iend = st->ii + t < n ? st->ii + t : n;
+    uint64_t jend = st->jj + t < n ? st->jj + t : n;
+    uint64_t kend = st->kk + t < n ? st->kk + t : n;
+
+    ref->pc += st->step * 4;
+    switch (st->step) {
+    case 0:
+        ref->addr = c + (st->i * n + st->j) * sp->elem;
+        ref->op = TRACE_read;
+        st->k = st->kk;
+        st->step = 1;
+        return;
+    case 1:
+        ref->addr = a + (st->i * n + st->k) * sp->elem;
+        ref->op = TRACE_read;
+        st->step = 2;
+        return;
+    case 2:
+        ref->addr = b + (st->k * n + st->j) * sp->elem;
+        ref->op = TRACE_read;
+        st->step = ++st->k < kend ? 1 : 3;
+        return;
+    default:
+        ref->addr = c + (st->i * n + st->j) * sp->elem;
+        ref->op = TRACE_write;
+        st->step = 0;
+        break;
+    }
+
+    /* the next element of the tile, else the next tile */
+    if (++st->j < jend)
+        return;
+    st->j = st->jj;
+    if (++st->i < iend)
+        return;
+    if ((st->kk += t) >= n) {
+        st->kk = 0;
+        if ((st->jj += t) >= n) {
+            st->jj = 0;
+            if ((st->ii += t) >= n)
+                st->ii = 0;
+        }
+    }
+    st->i = st->ii;
+    st->j = st->jj;
+}
+
+/* linear probing from the hash of a random key, an insert stores last */
+static void next_hash(stream_t *st, trace_ref_t *ref)
+{
+    const gen_spec_t *sp = &st->spec;
+
+    if (!st->left) {
+        st->i = mix(xorshift(&st->rng)) % sp->n;
+        st->left = 1 + xorshift(&st->rng) % sp->probes;
+        st->store = store(st);
+    }
+    ref->addr = sp->base + st->i * sp->elem;
+    ref->op = --st->left || !st->store ? TRACE_read : TRACE_write;
+    st->i = st->i + 1 < sp->n ? st->i + 1 : 0;
+}
+
+static void next_zipf(stream_t *st, trace_ref_t *ref)
+{
+    const gen_spec_t *sp = &st->spec;
+    uint64_t key = (zipf_rank(st) - 1) * GEN_SCATTER % sp->n;
+
+    ref->addr = sp->base + key * sp->elem;
+    ref->op = store(st) ? TRACE_write : TRACE_read;
+}
+
+static void next_ref(stream_t *st, trace_ref_t *ref)
+{
+    memset(ref, 0, sizeof(*ref));
+    ref->pc = st->spec.pc;
+    ref->size = st->spec.elem;
+    ref->cpu = st->spec.cpu;
+
+    switch (st->spec.pattern) {
+    case GEN_strided:
+        next_strided(st, ref);
+        break;
+    case GEN_stencil:
+        next_stencil(st, ref);
+        break;
+    case GEN_matmul:
+        next_matmul(st, ref);
+        break;
+    case GEN_hash:
+        next_hash(st, ref);
+        break;
+    default:
+        next_zipf(st, ref);
+        break;
+    }
+}
+
+void gen_spec_init(gen_spec_t *spec, gen_pattern_t pattern, int k)
+{
+    memset(spec, 0, sizeof(*spec));
+    spec->pattern = pattern;
+    spec->n = 1 << 20;
+    spec->stride = 1;
+    spec->tile = 32;
+    spec->probes = 4;
+    spec->s = 0.99;
+    spec->elem = 8;
+    spec->weight = 1;
+    /* 1TB apart, past any sensible array */
+    spec->base = (uint64_t)(k + 1) << 40;
+    spec->pc = 0x400000 + ((uint64_t)k << 12);
+}
+
+static int check(const gen_spec_t *sp)
+{
+    if (sp->pattern < 0 || sp->pattern >= GEN_PATTERNS || !sp->n ||
+        !sp->elem || !sp->weight || sp->writes > 100)
+        return FAIL;
+
+    switch (sp->pattern) {
+    case GEN_strided:
+        return sp->stride ? SUCCEED : FAIL;
+    case GEN_stencil:
+        return sp->n >= 3 ? SUCCEED : FAIL;
+    case GEN_matmul:
+        return sp->tile ? SUCCEED : FAIL;
+    case GEN_hash:
+        return sp->probes ? SUCCEED : FAIL;
+    default:
+        return sp->s >= 0 ? SUCCEED : FAIL;
+    }
+}
+
+gen_t *gen_create(const gen_spec_t *specs, int n, uint64_t seed,
+                  uint64_t refs)
+{
+    gen_t *g;
+
+    if (n < 1 || n > GEN_MAX_STREAMS) {
+        LOG_ERR("a trace generator takes 1 to %d streams", GEN_MAX_STREAMS);
+        return NULL;
+    }
+    for (int k = 0; k < n; ++k) {
+        if (SUCCEED != check(&specs[k])) {
+            LOG_ERR("bad %s stream %d of the trace generator",
+                    pattern_names[specs[k].pattern % GEN_PATTERNS], k);
+            return NULL;
+        }
+    }
+    if (!(g = calloc(1, sizeof(gen_t))))
+        return NULL;
+
+    g->nstreams = n;
+    g->refs = g->left = refs;
+    /* xorshift never leaves 0, mix() never gives it twice in a row */
+    g->rng = mix(seed) | 1;
+    for (int k = 0; k < n; ++k) {
+        stream_t *st = &g->streams[k];
+
+        st->spec = specs[k];
+        st->rng = mix(seed + k + 1) | 1;
+        g->weights += specs[k].weight;
+        if (st->spec.pattern == GEN_stencil)
+            st->i = st->j = 1;
+        else if (st->spec.pattern == GEN_zipf)
+            zipf_init(st);
+    }
+
+    return g;
+}
+
+void gen_destroy(gen_t *g)
+{
+    free(g);
+}
+
+int gen_next(gen_t *g, trace_ref_t *refs, int n)
+{
+    int got = 0;
+
+    for (; got < n && g->left; ++got, --g->left) {
+        stream_t *st = g->streams;
+
+        if (g->nstreams > 1) {
+            uint64_t w = xorshift(&g->rng) % g->weights;
+
+            while (w >= st->spec.weight)
+                w -= st++->spec.weight;
+        }
+        next_ref(st, &refs[got]);
+    }
+
+    return got;
+}
+
+uint64_t gen_refs(const gen_t *g)
+{
+    return g->refs;
+}
+
+int gen_write(gen_t *g, FILE *f)
+{
+    trace_ref_t refs[TRACE_BATCH];
+    int n;
+
+    if (SUCCEED != trace_write_header(f))
+        return FAIL;
+    while ((n = gen_next(g, refs, TRACE_BATCH)))
+        if (SUCCEED != trace_write(f, refs, n))
+            return FAIL;
+
+    return SUCCEED;
+}
+
+/* a decimal number with an optional K, M, G or T, or a hex one */
+static int parse_number(const char *text, uint64_t *v)
+{
+    char *end;
+
+    if (!strncmp(text, "0x", 2) || !strncmp(text, "0X", 2)) {
+        *v = strtoull(text + 2, &end, 16);
+        return end > text + 2 && !*end ? SUCCEED : FAIL;
+    }
+
+    return *text ? str2uint64(text, "KMGT", v) : FAIL;
+}
+
+static int parse_key(gen_spec_t *sp, const char *key, const char *value)
+{
+    uint64_t v;
+    char *end;
+
+    if (!strcmp(key, "s")) {
+        sp->s = strtod(value, &end);
+        return end > value && !*end ? SUCCEED : FAIL;
+    }
+    if (SUCCEED != parse_number(value, &v))
+        return FAIL;
+
+    if (!strcmp(key, "n"))
+        sp->n = v;
+    else if (!strcmp(key, "stride"))
+        sp->stride = v;
+    else if (!strcmp(key, "tile"))
+        sp->tile = v;
+    else if (!strcmp(key, "probes") && v <= UINT32_MAX)
+        sp->probes = v;
+    else if (!strcmp(key, "elem") && v <= UINT32_MAX)
+        sp->elem = v;
+    else if (!strcmp(key, "writes") && v <= 100)
+        sp->writes = v;
+    else if (!strcmp(key, "weight") && v <= UINT32_MAX)
+        sp->weight = v;
+    else if (!strcmp(key, "base"))
+        sp->base = v;
+    else if (!strcmp(key, "pc"))
+        sp->pc = v;
+    else if (!strcmp(key, "cpu") && v <= UINT16_MAX)
+        sp->cpu = v;
+    else
+        return FAIL;
+
+    return SUCCEED;
+}
+
+/* refs=N,seed=N */
+static int parse_globals(char *clause, uint64_t *seed, uint64_t *refs)
+{
+    char *save, *item;
+
+    for (item = strtok_r(clause, ",", &save); item;
+         item = strtok_r(NULL, ",", &save)) {
+        char *value = strchr(item, '=');
+
+        if (!value)
+            return FAIL;
+        *value++ = '\0';
+        if (!strcmp(item, "refs")) {
+            if (SUCCEED != parse_number(value, refs))
+                return FAIL;
+        } else if (!strcmp(item, "seed")) {
+            if (SUCCEED != parse_number(value, seed))
+                return FAIL;
+        } else {
+            return FAIL;
+        }
+    }
+
+    return SUCCEED;
+}
+
+static int parse_stream(char *clause, gen_spec_t *sp, int k)
+{
+    char *save, *item = strtok_r(clause, ",", &save);
+    int p;
+
+    for (p = 0; p < GEN_PATTERNS; ++p)
+        if (!strcmp(item, pattern_names[p]))
+            break;
+    if (p == GEN_PATTERNS)
+        return FAIL;
+    gen_spec_init(sp, p, k);
+
+    while ((item = strtok_r(NULL, ",", &save))) {
+        char *value = strchr(item, '=');
+
+        if (!value)
+            return FAIL;
+        *value++ = '\0';
+        if (SUCCEED != parse_key(sp, item, value))
+            return FAIL;
+    }
+
+    return SUCCEED;
+}
+
+gen_t *gen_parse(const char *text)
+{
+    gen_spec_t specs[GEN_MAX_STREAMS];
+    uint64_t seed = 1, refs = 1 << 20;
+    char buf[GEN_SPEC_LEN], *save, *clause;
+    int n = 0;
+
+    if (strlen(text) >= sizeof(buf)) {
+        LOG_ERR("trace generator specification too long");
+        return NULL;
+    }
+    strcpy(buf, text);
+
+    for (clause = strtok_r(buf, ";", &save); clause;
+         clause = strtok_r(NULL, ";", &save)) {
+        int ret;
+
+        /* a clause of globals starts with a key, a stream with a pattern */
+        if (memchr(clause, '=', strcspn(clause, ",")))
+            ret = parse_globals(clause, &seed, &refs);
+        else if (n < GEN_MAX_STREAMS) {
+            ret = parse_stream(clause, &specs[n], n);
+            n++;
+        } else
+            ret = FAIL;
+        if (SUCCEED != ret) {
+            LOG_ERR("bad trace generator specification [%s]", text);
+            return NULL;
+        }
+    }
+
+    return gen_create(specs, n, seed, refs);
+}
@@ -0,0 +1,225 @@
+/*
+ * @file tracering.c
+ * @author charlies
+ * @mail: xuguo.wong@gmail.com
+ * @date 2026/10/18
+ *
+ * authority: GPL v2.0
+ *
+ * Trace rings in shared memory, see tracering.h.
+ *
+ * The object is a header line, then the spsc ring. Its creator sizes it,
+ * sets up the ring and raises ready last, the other side waits for the
+ * object to have a size, maps it and waits for ready on a shared futex
+ * before it checks the header.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cfg.h"
+#include "spsc.h"
+#include "tracering.h"
+
+#define RING_VERSION        1
+#define RING_POLL           10          /* ms between looks for the object */
+
+typedef struct ring_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t batch_size;
+    uint32_t nslots;
+    uint32_t ready;                     /* futex */
+} ring_header_t;
+
+_Static_assert(sizeof(ring_header_t) <= SPSC_CACHELINE,
+               "the ring starts on the second line");
+
+struct tracering {
+    int fd;
+    char *name;                         /* to remove, if created here */
+    void *map;
+    size_t size;
+    spsc_t *q;
+    trace_batch_t *b;                   /* producer: the batch filled */
+    uint64_t bytes;                     /* producer: handed over so far */
+};
+
+static size_t ring_size(unsigned int nslots)
+{
+    return SPSC_CACHELINE + spsc_size(nslots, sizeof(trace_batch_t));
+}
+
+static void poll_wait(void)
+{
+    struct timespec ts = { 0, RING_POLL * 1000000L };
+
+    nanosleep(&ts, NULL);
+}
+
+tracering_t *tracering_create(const char *name, unsigned int nslots)
+{
+    tracering_t *t = calloc(1, sizeof(tracering_t));
+    ring_header_t *h;
+
+    if (!nslots)
+        nslots = RING_SLOTS;
+    if (!t)
+        return NULL;
+    t->fd = -1;
+    t->size = ring_size(nslots);
+    if (name) {
+        if (!(t->name = strdup(name)))
+            goto fail;
+        shm_unlink(name);
+        t->fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    } else {
+        /* no wrapper in every libc */
+        t->fd = syscall(SYS_memfd_create, "cache-simulator-trace", 0);
+    }
+    if (t->fd < 0 || ftruncate(t->fd, t->size) ||
+        MAP_FAILED == (t->map = mmap(NULL, t->size, PROT_READ | PROT_WRITE,
+                                     MAP_SHARED, t->fd, 0))) {
+        LOG_ERR("cannot create trace ring [%s]", name ? name : "memfd");
+        t->map = NULL;
+        goto fail;
+    }
+    if (!(t->q = spsc_init((char *)t->map + SPSC_CACHELINE, nslots,
+                           sizeof(trace_batch_t), 1)))
+        goto fail;
+
+    h = t->map;
+    memcpy(h->magic, RING_MAGIC, sizeof(h->magic));
+    h->version = RING_VERSION;
+    h->record_size = sizeof(trace_ref_t);
+    h->batch_size = sizeof(trace_batch_t);
+    h->nslots = nslots;
+    __atomic_store_n(&h->ready, 1, __ATOMIC_RELEASE);
+    syscall(SYS_futex, &h->ready, FUTEX_WAKE, 1 << 30, NULL, NULL, 0);
+
+    return t;
+fail:
+    tracering_close(t);
+    return NULL;
+}
+
+/* the descriptor of an object or of an inherited ring, -1 if not there */
+static int attach_fd(const char *name)
+{
+    char *end;
+    long fd = strtol(name, &end, 10);
+
+    if (*name && !*end)
+        return fd >= 0 ? dup(fd) : -1;
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0 && errno != ENOENT)
+        LOG_ERR("cannot open trace ring [%s]", name);
+
+    return fd;
+}
+
+tracering_t *tracering_attach(const char *name)
+{
+    tracering_t *t = calloc(1, sizeof(tracering_t));
+    int polls = RING_WAIT * 1000 / RING_POLL;
+    ring_header_t *h;
+    struct stat st;
+
+    if (!t)
+        return NULL;
+    t->fd = -1;
+
+    /* the object, then its size: both come from the other side */
+    while ((t->fd = attach_fd(name)) < 0 && errno == ENOENT && --polls)
+        poll_wait();
+    while (t->fd >= 0 && !fstat(t->fd, &st) && !st.st_size && --polls)
+        poll_wait();
+    if (t->fd < 0 || polls <= 0 || fstat(t->fd, &st) ||
+        st.st_size < (off_t)ring_size(1)) {
+        LOG_ERR("no trace ring [%s]", name);
+        goto fail;
+    }
+    t->size = st.st_size;
+    if (MAP_FAILED == (t->map = mmap(NULL, t->size, PROT_READ | PROT_WRITE,
+                                     MAP_SHARED, t->fd, 0))) {
+        t->map = NULL;
+        goto fail;
+    }
+
+    h = t->map;
+    while (!__atomic_load_n(&h->ready, __ATOMIC_ACQUIRE))
+        syscall(SYS_futex, &h->ready, FUTEX_WAIT, 0, NULL, NULL, 0);
+    if (memcmp(h->magic, RING_MAGIC, sizeof(h->magic)) ||
+        h->version != RING_VERSION ||
+        h->record_size != sizeof(trace_ref_t) ||
+        h->batch_size != sizeof(trace_batch_t) ||
+        t->size != ring_size(h->nslots)) {
+        LOG_ERR("[%s] is no trace ring of version %d", name, RING_VERSION);
+        goto fail;
+    }
+    t->q = (spsc_t *)((char *)t->map + SPSC_CACHELINE);
+
+    return t;
+fail:
+    tracering_close(t);
+    return NULL;
+}
+
+void tracering_close(tracering_t *t)
+{
+    if (!t)
+        return;
+
+    if (t->map)
+        munmap(t->map, t->size);
+    if (t->fd >= 0)
+        close(t->fd);
+    if (t->name)
+        shm_unlink(t->name);
+    free(t->name);
+    free(t);
+}
+
+int tracering_fd(const tracering_t *t)
+{
+    return t->fd;
+}
+
+spsc_t *tracering_queue(tracering_t *t)
+{
+    return t->q;
+}
+
+trace_ref_t *tracering_batch(tracering_t *t)
+{
+    if (!t->b && !(t->b = spsc_acquire(t->q)))
+        return NULL;
+
+    return t->b->refs;
+}
+
+void tracering_publish(tracering_t *t, uint32_t n)
+{
+    if (!n)
+        return;
+
+    t->bytes += (uint64_t)n * sizeof(trace_ref_t);
+    t->b->n = n;
+    t->b->bytes = t->bytes;
+    t->b = NULL;
+    spsc_publish(t->q);
+}
+
+void tracering_end(tracering_t *t)
+{
+    spsc_close(t->q);
+}